@@ -0,0 +1,53 @@
+/**********************************
+Caffe Model Files
+  Just enough of Caffe's file formats to run the deploy nets in dl_models
+  without linking Caffe:
+  - a protobuf text format reader for the .prototxt
+  - a protobuf wire format reader that pulls the blobs of every layer out
+    of the .caffemodel (current `layer` and V1 `layers` entries)
+***********************************/
+#ifndef CLASSIFICATION_CAFFE_MODEL_H
+#define CLASSIFICATION_CAFFE_MODEL_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace classification
+{
+
+// One message of a text format protobuf, fields in file order. Enum values
+// (pool: MAX) are kept as their name, strings without the quotes.
+struct TextMessage
+{
+  std::vector< std::pair<std::string, std::string> > values;
+  std::vector< std::pair<std::string, std::shared_ptr<TextMessage> > > messages;
+
+  bool has(const std::string& key) const;
+  std::string get(const std::string& key, const std::string& fallback = "") const;
+  double getNumber(const std::string& key, double fallback) const;
+  std::vector<std::string> getAll(const std::string& key) const;
+  // NULL if absent
+  const TextMessage* message(const std::string& key) const;
+  std::vector<const TextMessage*> messagesNamed(const std::string& key) const;
+};
+
+bool parseTextProto(const std::string& text, TextMessage& out, std::string* error);
+bool readTextProto(const std::string& path, TextMessage& out, std::string* error);
+
+struct BlobData
+{
+  std::vector<int> shape;
+  std::vector<float> data;
+};
+
+// layer name -> its blobs (weights, bias) in file order
+typedef std::map<std::string, std::vector<BlobData> > LayerBlobs;
+
+bool readCaffemodel(const std::string& path, LayerBlobs& out, std::string* error);
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,67 @@
+/**********************************
+CPU Kernels
+  Float kernels behind CpuNet (see cpu_net.h). The GEMMs cut their output
+  into tiles and run one tile per task on the pool; the inner loops use
+  SSE when the compiler targets it and plain loops otherwise.
+  Everything is row-major, images are CHW.
+  The INT8 kernels take symmetric int8 values (q = round(x / scale),
+  |q| <= 127) and accumulate in int32; the convolution path keeps them in
+  int16 so pairs of k multiply-add in one pmaddwd.
+***********************************/
+#ifndef CLASSIFICATION_CPU_KERNELS_H
+#define CLASSIFICATION_CPU_KERNELS_H
+
+#include <stdint.h>
+#include <velodyne_perception/task_pool.h>
+
+namespace classification
+{
+
+using velodyne_perception::TaskPool;
+
+// C[M x N] = A[M x K] * B[K x N], plus bias[m] on row m if bias is set
+void gemm(int M, int N, int K, const float* A, const float* B, const float* bias,
+          float* C, TaskPool& pool);
+
+// C[M x N] = A[M x K] * B[N x K]^T, plus bias[n] on column n if bias is set
+// (InnerProduct: A is the batch, B the weights)
+void gemmTransB(int M, int N, int K, const float* A, const float* B, const float* bias,
+                float* C, TaskPool& pool);
+
+// Caffe's im2col: col is (channels*kh*kw) x (out_h*out_w)
+void im2col(const float* im, int channels, int height, int width,
+            int kh, int kw, int ph, int pw, int sh, int sw, float* col);
+
+// one channel plane each; out is out_h x out_w (Caffe pooling geometry)
+void maxPool(const float* in, int height, int width, int kh, int kw, int ph, int pw,
+             int sh, int sw, int out_h, int out_w, float* out);
+void avePool(const float* in, int height, int width, int kh, int kw, int ph, int pw,
+             int sh, int sw, int out_h, int out_w, float* out);
+
+// LRN across channels on one CHW image:
+// out = in * (k + alpha/size * sum of in^2 over size channels)^-beta
+void lrnAcrossChannels(const float* in, int channels, int spatial, int size,
+                       float alpha, float beta, float k, float* out);
+
+void relu(float* data, size_t n, float negative_slope);
+
+// softmax over `channels` values spaced `spatial` apart, for every position
+void softmax(float* data, int channels, int spatial);
+
+// ======= INT8 =======
+void quantize(const float* x, size_t n, float scale, int8_t* q);
+void quantize(const float* x, size_t n, float scale, int16_t* q);
+
+// C[M x N] = (A[M x K] * B[K x N]) * row_scale[m] + bias[m], K even
+// (Convolution: A the weights, B the quantized im2col)
+void gemmS16(int M, int N, int K, const int16_t* A, const int16_t* B, const float* row_scale,
+             const float* bias, float* C, TaskPool& pool);
+
+// C[M x N] = (A[M x K] * B[N x K]^T) * col_scale[n] + bias[n]
+// (InnerProduct: A the quantized batch, B the weights)
+void gemmTransBS8(int M, int N, int K, const int8_t* A, const int8_t* B, const float* col_scale,
+                  const float* bias, float* C, TaskPool& pool);
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,149 @@
+/**********************************
+CPU Net
+  Runs a Caffe deploy net (.prototxt + .caffemodel from dl_models) on the
+  CPU without Caffe, for the processing box that has no GPU. Supports the
+  layers of the CaffeNet models:
+    Input, Convolution (with group), ReLU, Pooling (MAX, AVE),
+    LRN (across channels), InnerProduct, Dropout, Softmax
+  Convolutions run as im2col + GEMM; every layer is spread over a
+  TaskPool. Blobs are NCHW floats, the same layout as net.blobs in pycaffe.
+  INT8 mode (setInt8) runs the Convolution and InnerProduct layers on
+  int8 weights (one scale per output channel) and int8 activations (one
+  scale per layer, from a calibration table written by calibrate_int8);
+  everything between them stays float.
+***********************************/
+#ifndef CLASSIFICATION_CPU_NET_H
+#define CLASSIFICATION_CPU_NET_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <classification/caffe_model.h>
+#include <classification/cpu_kernels.h>
+
+namespace classification
+{
+
+struct Blob
+{
+  std::vector<int> shape;
+  std::vector<float> data;
+
+  size_t count() const;
+  // product of the dims from axis on
+  size_t count(size_t axis) const;
+  int dim(size_t axis) const { return axis < shape.size() ? shape[axis] : 1; }
+  void reshape(const std::vector<int>& new_shape);
+};
+
+class CpuNet
+{
+public:
+  // threads < 0 uses every core
+  explicit CpuNet(int threads = -1);
+  // share the workers of another net (nets run one after the other);
+  // nets that run concurrently need a pool each
+  explicit CpuNet(const std::shared_ptr<TaskPool>& pool);
+
+  bool load(const std::string& prototxt, const std::string& caffemodel, std::string* error);
+
+  // one input image, C x H x W
+  int inputChannels() const { return input_shape_.size() > 1 ? input_shape_[1] : 1; }
+  int inputHeight() const { return input_shape_.size() > 2 ? input_shape_[2] : 1; }
+  int inputWidth() const { return input_shape_.size() > 3 ? input_shape_[3] : 1; }
+  size_t inputSize() const { return (size_t)inputChannels() * inputHeight() * inputWidth(); }
+
+  // input holds batch * inputSize() floats (NCHW). Returns the top blob of
+  // the last layer, "prob" for the classifiers: batch x classes.
+  const Blob& forward(const float* input, int batch);
+  // image i starts at input + i * stride (stride >= inputSize()), e.g. the
+  // first 3 channels of a 6 channel batch
+  const Blob& forward(const float* input, int batch, size_t stride);
+
+  // any blob by name after forward(), NULL if there is none
+  const Blob* blob(const std::string& name) const;
+
+  TaskPool& pool() { return *pool_; }
+  const std::shared_ptr<TaskPool>& sharedPool() const { return pool_; }
+
+  // ======= INT8 =======
+  // Convolution / InnerProduct layers as (layer name, bottom blob name):
+  // what a calibration table has to cover
+  std::vector<std::pair<std::string, std::string> > quantizableLayers() const;
+
+  // Quantize the layers found in max_abs, the largest |bottom| value to
+  // keep per layer; the others stay float. False if max_abs names a layer
+  // that cannot be quantized.
+  bool setInt8(const std::map<std::string, float>& max_abs, std::string* error);
+  void setFloat();
+  bool isInt8() const { return int8_; }
+
+private:
+  enum LayerType
+  {
+    INPUT, CONVOLUTION, RELU, POOLING, LRN, INNER_PRODUCT, DROPOUT, SOFTMAX
+  };
+
+  struct Layer
+  {
+    LayerType type;
+    std::string name;
+    int bottom;
+    int top;
+    // Convolution, Pooling, InnerProduct
+    int num_output;
+    int kernel_h, kernel_w;
+    int pad_h, pad_w;
+    int stride_h, stride_w;
+    int group;
+    bool bias_term;
+    bool max_pool;
+    bool global_pooling;
+    // LRN
+    int local_size;
+    float alpha, beta, k;
+    // ReLU
+    float negative_slope;
+    Blob weights;
+    Blob bias;
+    // INT8 mode: bottom scale, weights rounded to weights * 127 / max|row|,
+    // and the per output channel scale that turns the int32 sums back
+    bool quantized;
+    float in_scale;
+    int K_pad;                          // Convolution: K rounded up to even
+    std::vector<int16_t> weights_s16;   // Convolution, num_output x K_pad
+    std::vector<int8_t> weights_s8;     // InnerProduct, num_output x K
+    std::vector<float> out_scale;
+  };
+
+  bool addLayer(const TextMessage& def, const LayerBlobs& weights, std::string* error);
+  bool setWeights(Layer& layer, const LayerBlobs& weights, std::string* error);
+  int blobIndex(const std::string& name);
+  void reshape(int batch);
+  void forwardLayer(const Layer& layer);
+  void convolution(const Layer& layer, const Blob& bottom, Blob& top);
+  void convolutionInt8(const Layer& layer, const Blob& bottom, Blob& top);
+  void innerProductInt8(const Layer& layer, const Blob& bottom, Blob& top);
+
+  std::vector<Layer> layers_;
+  std::vector<Blob> blobs_;
+  std::map<std::string, int> blob_index_;
+  std::vector<int> input_shape_;
+  int batch_;
+  std::vector<float> col_;  // im2col of one image
+  bool int8_;
+  std::vector<int16_t> col_s16_;
+  std::vector<int8_t> input_s8_;
+  std::shared_ptr<TaskPool> pool_;
+};
+
+// Calibration table: one "layer_name max_abs" line per layer, # comments
+bool readInt8Table(const std::string& path, std::map<std::string, float>& max_abs, std::string* error);
+bool writeInt8Table(const std::string& path, const std::map<std::string, float>& max_abs,
+                    const std::string& comment, std::string* error);
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,66 @@
+/**********************************
+Frame Cache
+  Ring of the latest camera frames keyed by stamp, so a LiDAR scan can be
+  matched with the frame nearest in time and only the ROIs it needs are
+  cropped from it, instead of every ObjectPoseList carrying image data.
+  Frames are kept as received (the message is shared, not copied) and
+  converted to bgr8 the first time they are asked for, once per frame.
+  Thread-safe.
+***********************************/
+#ifndef CLASSIFICATION_FRAME_CACHE_H
+#define CLASSIFICATION_FRAME_CACHE_H
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <cv_bridge/cv_bridge.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+namespace classification
+{
+
+// a frame in bgr8, `step` bytes per row; pixels stay valid as long as the
+// frame is held
+struct CameraFrame
+{
+  std_msgs::Header header;
+  int width, height, step;
+  const uint8_t* pixels;
+  sensor_msgs::ImageConstPtr image;         // bgr8 frames: the pixels of the message
+  cv_bridge::CvImageConstPtr converted;     // other encodings
+};
+typedef boost::shared_ptr<const CameraFrame> CameraFrameConstPtr;
+
+class FrameCache
+{
+public:
+  explicit FrameCache(size_t capacity = 8);
+
+  void insert(const sensor_msgs::ImageConstPtr& image);
+  // the frame nearest to stamp, NULL if none is within max_dt seconds or
+  // it cannot be converted to bgr8
+  CameraFrameConstPtr nearest(const ros::Time& stamp, double max_dt, std::string* error = NULL);
+  size_t size() const;
+  void clear();
+
+private:
+  struct Slot
+  {
+    sensor_msgs::ImageConstPtr image;
+    CameraFrameConstPtr frame;    // NULL until asked for
+  };
+
+  static CameraFrameConstPtr convert(const sensor_msgs::ImageConstPtr& image, std::string* error);
+
+  mutable std::mutex mutex_;
+  std::vector<Slot> ring_;
+  size_t next_;
+  size_t count_;
+};
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,74 @@
+/**********************************
+Geometric Cascade
+  Decision tree on the cluster descriptor (velodyne_perception/
+  cluster_descriptor.h) in front of the CNN: clusters that end in a leaf
+  with a high enough confidence get its label directly, the rest go to the
+  net. Trained offline by train_cascade.
+  Model file, one node per line in preorder (left subtree first), # comments:
+    labels buoy totem dock
+    split extent_z 1.25         <- goes left when feature < threshold
+      leaf buoy 0.993 412       <- label (- for none), confidence, samples
+      leaf - 0.5 80
+  The confidence is the Laplace-smoothed purity of the training samples in
+  the leaf, (majority + 1) / (samples + labels).
+***********************************/
+#ifndef CLASSIFICATION_GEOMETRIC_CASCADE_H
+#define CLASSIFICATION_GEOMETRIC_CASCADE_H
+
+#include <string>
+#include <vector>
+
+namespace classification
+{
+
+class GeometricCascade
+{
+public:
+  struct Sample
+  {
+    std::vector<float> descriptor;
+    int label;
+  };
+
+  GeometricCascade();
+
+  bool load(const std::string& path, std::string* error);
+  bool save(const std::string& path, const std::string& comment, std::string* error) const;
+
+  // CART on the Gini impurity; nodes with fewer than 2 * min_leaf samples,
+  // a single label or at max_depth become leaves
+  void train(const std::vector<Sample>& samples, const std::vector<std::string>& labels,
+             int max_depth, int min_leaf);
+
+  // Label index of the leaf the descriptor falls into, -1 if its confidence
+  // is below min_confidence or it has no label
+  int classify(const float* descriptor, float min_confidence, float* confidence = NULL) const;
+
+  bool empty() const { return nodes_.empty(); }
+  const std::vector<std::string>& labels() const { return labels_; }
+  int leaves() const;
+  int depth() const;
+
+private:
+  struct Node
+  {
+    int feature;        // -1 for a leaf
+    float threshold;
+    int left, right;    // node indices
+    int label;          // leaf: majority label, -1 for none
+    float confidence;
+    int samples;
+  };
+
+  int grow(std::vector<const Sample*>& samples, int depth, int max_depth, int min_leaf);
+  int parse(const std::vector<std::vector<std::string> >& lines, size_t& line, std::string* error);
+  void write(int node, int indent, std::string& out) const;
+  int depth(int node) const;
+
+  std::vector<Node> nodes_;
+  std::vector<std::string> labels_;
+};
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,37 @@
+/**********************************
+ROI Crop
+  Camera side of the 6 channel classifiers: the pixel box of a cluster in
+  a calibrated camera image, and the crop letterboxed straight into the
+  net input size (resize_keep_ratio() of classify_6_channels.py: fit,
+  centre, black border). The resize is bilinear with cv::resize's pixel
+  centres; the vertical pass runs on SSE2 when the compiler targets it.
+  Images are bgr8, row-major, `step` bytes per row.
+***********************************/
+#ifndef CLASSIFICATION_ROI_CROP_H
+#define CLASSIFICATION_ROI_CROP_H
+
+#include <stdint.h>
+
+namespace classification
+{
+
+struct PixelRect
+{
+  int x, y, width, height;
+};
+
+// Pixel bounds of the 8 corners (x, y, z in the camera optical frame)
+// under the 3x4 row-major projection P (CameraInfo.P), grown by padding
+// (fraction of the size) and clipped to the image. Corners closer than
+// min_depth are pushed out to min_depth. False if no corner is in front
+// of the camera or nothing is left inside the image.
+bool projectBox(const double P[12], const double corners[8][3], int image_width, int image_height,
+                double min_depth, double padding, PixelRect& rect);
+
+// rect of the image resized to fit size x size, centred on black; out
+// holds size * size * 3 bytes
+void letterboxCrop(const uint8_t* image, int step, const PixelRect& rect, int size, uint8_t* out);
+
+} // namespace classification
+
+#endif
@@ -0,0 +1,73 @@
+/**********************************
+ROI Extractor
+  Camera ROIs of clusters on demand: keeps the latest frames of
+  image_topic in a FrameCache and the calibration of ~camera_info_topic,
+  and letterboxes the box of a cluster from the frame nearest to the scan
+  (roi_crop.h). Used by camera_roi to fill ObjectPose.img, and by
+  classify_cpu (~image_topic) to crop without it.
+  The box is the bearing-aligned one of the cluster node (~local_frame)
+  when present, otherwise the axis-aligned box of pcl_points or cloud.
+  P of the camera info is used, so image_topic should be rectified.
+Params (private):
+  ~camera_info_topic    (default /camera/camera_info)
+  ~padding              (fraction of the box size, default 0.1)
+  ~min_depth            (m, default 0.5)
+  ~min_pixels           (default 4)
+  ~cache_size           (frames, default 8)
+  ~max_frame_dt         (s between scan and frame, default 0.1)
+***********************************/
+#ifndef CLASSIFICATION_ROI_EXTRACTOR_H
+#define CLASSIFICATION_ROI_EXTRACTOR_H
+
+#include <stdint.h>
+#include <string>
+#include <ros/ros.h>
+#include <robotx_msgs/ObjectPoseList.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <tf/transform_listener.h>
+
+#include <classification/frame_cache.h>
+
+namespace classification
+{
+
+class RoiExtractor
+{
+public:
+  RoiExtractor(ros::NodeHandle& nh, ros::NodeHandle& private_nh, const std::string& image_topic);
+
+  // what one scan needs from the camera
+  struct Scan
+  {
+    CameraFrameConstPtr frame;
+    tf::StampedTransform transform;   // list frame -> camera optical frame
+    double P[12];
+  };
+
+  // the frame nearest to the stamp of the list and the transform into the
+  // camera; false (with a throttled warning) if either is missing
+  bool prepare(const std_msgs::Header& header, Scan& scan);
+  // the ROI of obj letterboxed into size * size * 3 bytes of bgr8, false if
+  // the cluster is not in view; safe to call from several threads
+  bool crop(const Scan& scan, const robotx_msgs::ObjectPose& obj, int size, uint8_t* out) const;
+
+private:
+  void imageCallback(const sensor_msgs::ImageConstPtr& image);
+  void infoCallback(const sensor_msgs::CameraInfoConstPtr& info);
+  static bool clusterBox(const robotx_msgs::ObjectPose& obj, double corners[8][3]);
+
+  std::string node_name_;
+  double padding_;
+  double min_depth_;
+  int min_pixels_;
+  double max_frame_dt_;
+  FrameCache cache_;
+  sensor_msgs::CameraInfoConstPtr info_;
+  tf::TransformListener listener_;
+  ros::Subscriber sub_image_;
+  ros::Subscriber sub_info_;
+};
+
+} // namespace classification
+
+#endif
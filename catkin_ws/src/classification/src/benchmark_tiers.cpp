@@ -0,0 +1,172 @@
+/**********************************
+Benchmark Tiers
+  Accuracy / latency of the render resolution tiers of classify_cpu on
+  labelled clusters, e.g. caffenet at 227x227 against caffenet_113:
+
+  benchmark_tiers list.txt net.prototxt net.caffemodel [net2.prototxt net2.caffemodel ...]
+
+  The list has one "cluster.pcd label" per line (the clouds saved by the
+  data collection, sensor frame; paths relative to the list). Every cluster
+  is rendered at each net's input size, rotated by the bearing of its
+  centroid like classify_cpu, and classified in batches of 8. Per tier it
+  prints top-1 accuracy overall and by point count, and the render and net
+  time per cluster.
+***********************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+
+#include <classification/cpu_net.h>
+#include <velodyne_perception/multiview_renderer.h>
+
+using namespace std;
+
+struct Cluster
+{
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  double yaw;
+  int label;
+};
+
+const int kBatch = 8;
+// point count buckets: [0, 20), [20, 100), [100, inf)
+const int kBuckets = 3;
+const int kBucketEdges[kBuckets - 1] = {20, 100};
+const char* kBucketNames[kBuckets] = {"< 20 points", "20-99 points", ">= 100 points"};
+
+int bucket(size_t points)
+{
+  int b = 0;
+  while (b < kBuckets - 1 && (int)points >= kBucketEdges[b])
+    b++;
+  return b;
+}
+
+bool readList(const string& path, vector<Cluster>& out)
+{
+  ifstream file(path.c_str());
+  if (!file)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  string dir = path.find('/') == string::npos ? "" : path.substr(0, path.rfind('/') + 1);
+  string line;
+  while (getline(file, line))
+  {
+    istringstream ss(line);
+    string pcd;
+    int label;
+    if (!(ss >> pcd) || pcd[0] == '#')
+      continue;
+    if (!(ss >> label))
+    {
+      fprintf(stderr, "%s: no label for %s\n", path.c_str(), pcd.c_str());
+      return false;
+    }
+    Cluster cluster;
+    if (pcl::io::loadPCDFile<pcl::PointXYZ>(pcd[0] == '/' ? pcd : dir + pcd, cluster.cloud) != 0)
+      return false;
+    if (cluster.cloud.points.empty())
+      continue;
+    double cx = 0, cy = 0;
+    for (size_t i = 0; i < cluster.cloud.points.size(); i++)
+    {
+      cx += cluster.cloud.points[i].x;
+      cy += cluster.cloud.points[i].y;
+    }
+    cluster.yaw = atan2(cy, cx);
+    cluster.label = label;
+    out.push_back(cluster);
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 4 || argc % 2)
+  {
+    fprintf(stderr, "usage: %s list.txt net.prototxt net.caffemodel [net2.prototxt net2.caffemodel ...]\n", argv[0]);
+    return 1;
+  }
+  vector<Cluster> clusters;
+  if (!readList(argv[1], clusters))
+    return 1;
+  if (clusters.empty())
+  {
+    fprintf(stderr, "no clusters in %s\n", argv[1]);
+    return 1;
+  }
+  int total[kBuckets] = {0};
+  for (size_t i = 0; i < clusters.size(); i++)
+    total[bucket(clusters[i].cloud.points.size())]++;
+  printf("%d clusters:", (int)clusters.size());
+  for (int b = 0; b < kBuckets; b++)
+    printf(" %d %s%s", total[b], kBucketNames[b], b + 1 < kBuckets ? "," : "\n");
+
+  for (int a = 2; a + 1 < argc; a += 2)
+  {
+    classification::CpuNet net;
+    string error;
+    if (!net.load(argv[a], argv[a + 1], &error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    if (net.inputChannels() != 3 || net.inputHeight() != net.inputWidth())
+    {
+      fprintf(stderr, "%s: expected a square 3 channel input\n", argv[a]);
+      return 1;
+    }
+    velodyne_perception::MultiViewRenderer renderer =
+        velodyne_perception::MultiViewRenderer::scaledTo(net.inputHeight());
+    const float zero[3] = {0, 0, 0};
+    vector<uint8_t> image(renderer.imageBytes());
+    vector<float> input(kBatch * net.inputSize());
+    int correct[kBuckets] = {0};
+    double render_ms = 0, net_ms = 0;
+    for (size_t begin = 0; begin < clusters.size(); begin += kBatch)
+    {
+      const size_t n = min(clusters.size() - begin, (size_t)kBatch);
+      chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+      for (size_t k = 0; k < n; k++)
+      {
+        const Cluster& c = clusters[begin + k];
+        renderer.render(c.cloud, c.yaw, &image[0]);
+        renderer.toTensor(&image[0], zero, &input[k * net.inputSize()]);
+      }
+      chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+      const classification::Blob& prob = net.forward(&input[0], n);
+      chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+      render_ms += chrono::duration<double, milli>(t1 - t0).count();
+      net_ms += chrono::duration<double, milli>(t2 - t1).count();
+      const int classes = prob.count(1);
+      for (size_t k = 0; k < n; k++)
+      {
+        const float* p = &prob.data[k * classes];
+        const Cluster& c = clusters[begin + k];
+        if (max_element(p, p + classes) - p == c.label)
+          correct[bucket(c.cloud.points.size())]++;
+      }
+    }
+    int all = 0;
+    for (int b = 0; b < kBuckets; b++)
+      all += correct[b];
+    printf("\n%s (%dx%d)\n", argv[a], net.inputHeight(), net.inputWidth());
+    printf("  top-1 %.2f%%", 100.0 * all / clusters.size());
+    for (int b = 0; b < kBuckets; b++)
+      if (total[b])
+        printf(", %s %.2f%%", kBucketNames[b], 100.0 * correct[b] / total[b]);
+    printf("\n  per cluster: render %.3f ms, net %.2f ms (batches of %d)\n",
+           render_ms / clusters.size(), net_ms / clusters.size(), kBatch);
+  }
+  return 0;
+}
@@ -0,0 +1,498 @@
+/**********************************
+Caffe Model Files
+  see caffe_model.h
+***********************************/
+#include <classification/caffe_model.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+namespace classification
+{
+
+//========== TextMessage ==========
+bool TextMessage::has(const std::string& key) const
+{
+  for (size_t i = 0; i < values.size(); i++)
+    if (values[i].first == key)
+      return true;
+  return message(key) != NULL;
+}
+
+std::string TextMessage::get(const std::string& key, const std::string& fallback) const
+{
+  for (size_t i = 0; i < values.size(); i++)
+    if (values[i].first == key)
+      return values[i].second;
+  return fallback;
+}
+
+double TextMessage::getNumber(const std::string& key, double fallback) const
+{
+  std::string v = get(key);
+  return v.empty() ? fallback : std::atof(v.c_str());
+}
+
+std::vector<std::string> TextMessage::getAll(const std::string& key) const
+{
+  std::vector<std::string> all;
+  for (size_t i = 0; i < values.size(); i++)
+    if (values[i].first == key)
+      all.push_back(values[i].second);
+  return all;
+}
+
+const TextMessage* TextMessage::message(const std::string& key) const
+{
+  for (size_t i = 0; i < messages.size(); i++)
+    if (messages[i].first == key)
+      return messages[i].second.get();
+  return NULL;
+}
+
+std::vector<const TextMessage*> TextMessage::messagesNamed(const std::string& key) const
+{
+  std::vector<const TextMessage*> all;
+  for (size_t i = 0; i < messages.size(); i++)
+    if (messages[i].first == key)
+      all.push_back(messages[i].second.get());
+  return all;
+}
+
+//========== Text format ==========
+namespace
+{
+
+class TextParser
+{
+public:
+  explicit TextParser(const std::string& text) : text_(text), pos_(0), line_(1) {}
+
+  bool parse(TextMessage& out, std::string* error)
+  {
+    if (!parseFields(out, true))
+    {
+      if (error)
+      {
+        std::ostringstream ss;
+        ss << "line " << line_ << ": " << error_;
+        *error = ss.str();
+      }
+      return false;
+    }
+    return true;
+  }
+
+private:
+  void skipSpace()
+  {
+    while (pos_ < text_.size())
+    {
+      char c = text_[pos_];
+      if (c == '\n')
+        line_++;
+      if (c == '#')
+      {
+        while (pos_ < text_.size() && text_[pos_] != '\n')
+          pos_++;
+        continue;
+      }
+      if (!std::isspace((unsigned char)c))
+        return;
+      pos_++;
+    }
+  }
+
+  // next token: one of { } < > [ ] : , or a word or a quoted string
+  bool next(std::string& token, bool& quoted)
+  {
+    skipSpace();
+    quoted = false;
+    token.clear();
+    if (pos_ >= text_.size())
+      return false;
+    char c = text_[pos_];
+    if (std::strchr("{}<>[]:,", c))
+    {
+      token = c;
+      pos_++;
+      return true;
+    }
+    if (c == '"' || c == '\'')
+    {
+      quoted = true;
+      pos_++;
+      while (pos_ < text_.size() && text_[pos_] != c)
+      {
+        if (text_[pos_] == '\\' && pos_ + 1 < text_.size())
+          pos_++;
+        token += text_[pos_++];
+      }
+      pos_++;
+      return true;
+    }
+    while (pos_ < text_.size() && (std::isalnum((unsigned char)text_[pos_]) ||
+                                   std::strchr("_.-+", text_[pos_])))
+      token += text_[pos_++];
+    if (token.empty())
+    {
+      error_ = std::string("unexpected '") + c + "'";
+      return false;
+    }
+    return true;
+  }
+
+  bool parseFields(TextMessage& out, bool top)
+  {
+    std::string key, token;
+    bool quoted;
+    while (true)
+    {
+      if (!next(key, quoted))
+      {
+        if (top && error_.empty())
+          return true;
+        if (error_.empty())
+          error_ = "unexpected end of file";
+        return false;
+      }
+      if (!quoted && (key == "}" || key == ">"))
+      {
+        if (top)
+        {
+          error_ = "unbalanced " + key;
+          return false;
+        }
+        return true;
+      }
+      if (!next(token, quoted))
+      {
+        error_ = "missing value of " + key;
+        return false;
+      }
+      if (!quoted && token == ":")
+      {
+        if (!next(token, quoted))
+        {
+          error_ = "missing value of " + key;
+          return false;
+        }
+      }
+      if (!quoted && (token == "{" || token == "<"))
+      {
+        std::shared_ptr<TextMessage> child(new TextMessage);
+        if (!parseFields(*child, false))
+          return false;
+        out.messages.push_back(std::make_pair(key, child));
+      }
+      else if (!quoted && token == "[")
+      {
+        // key: [a, b, c]
+        while (next(token, quoted) && (quoted || token != "]"))
+          if (quoted || token != ",")
+            out.values.push_back(std::make_pair(key, token));
+      }
+      else
+        out.values.push_back(std::make_pair(key, token));
+    }
+  }
+
+  const std::string& text_;
+  size_t pos_;
+  int line_;
+  std::string error_;
+};
+
+bool readFile(const std::string& path, std::string& out, std::string* error)
+{
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    if (error)
+      *error = "cannot open " + path;
+    return false;
+  }
+  std::ostringstream ss;
+  ss << file.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+} // namespace
+
+bool parseTextProto(const std::string& text, TextMessage& out, std::string* error)
+{
+  TextParser parser(text);
+  return parser.parse(out, error);
+}
+
+bool readTextProto(const std::string& path, TextMessage& out, std::string* error)
+{
+  std::string text;
+  if (!readFile(path, text, error))
+    return false;
+  if (!parseTextProto(text, out, error))
+  {
+    if (error)
+      *error = path + ", " + *error;
+    return false;
+  }
+  return true;
+}
+
+//========== Wire format ==========
+namespace
+{
+
+enum WireType { kVarint = 0, kFixed64 = 1, kLengthDelimited = 2, kFixed32 = 5 };
+
+class WireReader
+{
+public:
+  WireReader(const uint8_t* begin, size_t size) : p_(begin), end_(begin + size) {}
+
+  bool done() const { return p_ >= end_; }
+
+  bool varint(uint64_t& v)
+  {
+    v = 0;
+    for (int shift = 0; shift < 64 && p_ < end_; shift += 7)
+    {
+      uint8_t b = *p_++;
+      v |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool tag(int& field, int& wire)
+  {
+    uint64_t v;
+    if (!varint(v))
+      return false;
+    field = (int)(v >> 3);
+    wire = (int)(v & 7);
+    return true;
+  }
+
+  bool bytes(WireReader& sub)
+  {
+    uint64_t len;
+    if (!varint(len) || len > (uint64_t)(end_ - p_))
+      return false;
+    sub = WireReader(p_, len);
+    p_ += len;
+    return true;
+  }
+
+  bool fixed(void* out, size_t n)
+  {
+    if ((size_t)(end_ - p_) < n)
+      return false;
+    std::memcpy(out, p_, n);
+    p_ += n;
+    return true;
+  }
+
+  bool skip(int wire)
+  {
+    uint64_t v;
+    WireReader sub(NULL, 0);
+    switch (wire)
+    {
+      case kVarint: return varint(v);
+      case kFixed64: return fixed(&v, 8);
+      case kLengthDelimited: return bytes(sub);
+      case kFixed32: return fixed(&v, 4);
+    }
+    return false;
+  }
+
+  // the rest of the buffer, for packed repeated fields
+  const uint8_t* pos() const { return p_; }
+  size_t left() const { return end_ - p_; }
+
+private:
+  const uint8_t* p_;
+  const uint8_t* end_;
+};
+
+// repeated float / double, packed or not
+bool readReals(WireReader& r, int wire, bool is_double, std::vector<float>& out)
+{
+  if (wire == kLengthDelimited)
+  {
+    WireReader sub(NULL, 0);
+    if (!r.bytes(sub))
+      return false;
+    const size_t width = is_double ? 8 : 4;
+    size_t n = sub.left() / width;
+    size_t base = out.size();
+    out.resize(base + n);
+    for (size_t i = 0; i < n; i++)
+    {
+      if (is_double)
+      {
+        double d = 0;
+        sub.fixed(&d, 8);
+        out[base + i] = (float)d;
+      }
+      else
+        sub.fixed(&out[base + i], 4);
+    }
+    return true;
+  }
+  if (is_double)
+  {
+    double d;
+    if (!r.fixed(&d, 8))
+      return false;
+    out.push_back((float)d);
+    return true;
+  }
+  float f;
+  if (!r.fixed(&f, 4))
+    return false;
+  out.push_back(f);
+  return true;
+}
+
+// BlobShape { repeated int64 dim = 1 [packed]; }
+bool readShape(WireReader r, std::vector<int>& shape)
+{
+  int field, wire;
+  while (!r.done())
+  {
+    if (!r.tag(field, wire))
+      return false;
+    uint64_t v;
+    if (field == 1 && wire == kLengthDelimited)
+    {
+      WireReader sub(NULL, 0);
+      if (!r.bytes(sub))
+        return false;
+      while (!sub.done())
+      {
+        if (!sub.varint(v))
+          return false;
+        shape.push_back((int)v);
+      }
+    }
+    else if (field == 1 && wire == kVarint)
+    {
+      if (!r.varint(v))
+        return false;
+      shape.push_back((int)v);
+    }
+    else if (!r.skip(wire))
+      return false;
+  }
+  return true;
+}
+
+// BlobProto: num/channels/height/width = 1..4, data = 5, shape = 7, double_data = 8
+bool readBlob(WireReader r, BlobData& blob)
+{
+  int legacy[4] = {0, 0, 0, 0};
+  bool has_legacy = false;
+  int field, wire;
+  while (!r.done())
+  {
+    if (!r.tag(field, wire))
+      return false;
+    bool ok;
+    if (field >= 1 && field <= 4 && wire == kVarint)
+    {
+      uint64_t v;
+      ok = r.varint(v);
+      legacy[field - 1] = (int)v;
+      has_legacy = true;
+    }
+    else if (field == 5)
+      ok = readReals(r, wire, false, blob.data);
+    else if (field == 8)
+      ok = readReals(r, wire, true, blob.data);
+    else if (field == 7 && wire == kLengthDelimited)
+    {
+      WireReader sub(NULL, 0);
+      ok = r.bytes(sub) && readShape(sub, blob.shape);
+    }
+    else
+      ok = r.skip(wire);
+    if (!ok)
+      return false;
+  }
+  if (blob.shape.empty() && has_legacy)
+    blob.shape.assign(legacy, legacy + 4);
+  return true;
+}
+
+// LayerParameter: name = 1, blobs = 7; V1LayerParameter: name = 4, blobs = 6
+bool readLayer(WireReader r, bool v1, std::string& name, std::vector<BlobData>& blobs)
+{
+  const int name_field = v1 ? 4 : 1;
+  const int blobs_field = v1 ? 6 : 7;
+  int field, wire;
+  while (!r.done())
+  {
+    if (!r.tag(field, wire))
+      return false;
+    WireReader sub(NULL, 0);
+    if (field == name_field && wire == kLengthDelimited)
+    {
+      if (!r.bytes(sub))
+        return false;
+      name.assign((const char*)sub.pos(), sub.left());
+    }
+    else if (field == blobs_field && wire == kLengthDelimited)
+    {
+      blobs.push_back(BlobData());
+      if (!r.bytes(sub) || !readBlob(sub, blobs.back()))
+        return false;
+    }
+    else if (!r.skip(wire))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool readCaffemodel(const std::string& path, LayerBlobs& out, std::string* error)
+{
+  std::string buffer;
+  if (!readFile(path, buffer, error))
+    return false;
+  // NetParameter: layers (V1) = 2, layer = 100
+  WireReader r((const uint8_t*)buffer.data(), buffer.size());
+  int field, wire;
+  while (!r.done())
+  {
+    bool ok = r.tag(field, wire);
+    if (ok && (field == 2 || field == 100) && wire == kLengthDelimited)
+    {
+      WireReader sub(NULL, 0);
+      std::string name;
+      std::vector<BlobData> blobs;
+      ok = r.bytes(sub) && readLayer(sub, field == 2, name, blobs);
+      if (ok && !blobs.empty())
+        out[name].swap(blobs);
+    }
+    else if (ok)
+      ok = r.skip(wire);
+    if (!ok)
+    {
+      if (error)
+        *error = path + " is not a valid caffemodel";
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace classification
@@ -0,0 +1,323 @@
+/**********************************
+Calibrate INT8
+  Offline INT8 calibration of a caffenet for CpuNet (classify_cpu ~int8_table).
+  Runs the FP32 net over a calibration set, takes the given percentile of
+  |x| at the input of every Convolution / InnerProduct layer, then runs a
+  held-out set in FP32 and INT8 and reports the accuracy of both.
+  The table is written with the report in its header.
+
+  calibrate_int8 net.prototxt net.caffemodel calib_list held_out_list out_table [percentile]
+
+  A list has one image per line and a label index (caffe ImageData style),
+  two images for 6 channel nets (views, then camera ROI):
+    buoy/0001.png 0
+    dock/0042_views.png dock/0042_roi.png 3
+  Paths are relative to the list file. The first image (the xy/yz/xz
+  views of a cluster, or the placard crop for the placard nets) is
+  resized to the net input if needed, the ROI is letterboxed like
+  classify_6_channels.py. The calibration list may leave out the labels.
+***********************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <classification/cpu_net.h>
+#include <velodyne_perception/multiview_renderer.h>
+
+using namespace std;
+using classification::Blob;
+using classification::CpuNet;
+
+struct Sample
+{
+  vector<string> images;
+  int label;
+};
+
+const int kBatch = 8;
+const int kBins = 2048;
+
+bool readList(const string& path, int images, bool need_label, vector<Sample>& out)
+{
+  ifstream file(path.c_str());
+  if (!file)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  string dir = path.find('/') == string::npos ? "" : path.substr(0, path.rfind('/') + 1);
+  string line;
+  int line_no = 0;
+  while (getline(file, line))
+  {
+    line_no++;
+    istringstream ss(line);
+    vector<string> tokens;
+    string token;
+    while (ss >> token)
+      tokens.push_back(token);
+    if (tokens.empty() || tokens[0][0] == '#')
+      continue;
+    if ((int)tokens.size() != images + 1 && (need_label || (int)tokens.size() != images))
+    {
+      fprintf(stderr, "%s, line %d: expected %d image(s)%s\n", path.c_str(), line_no, images,
+              need_label ? " and a label" : "");
+      return false;
+    }
+    Sample sample;
+    for (int i = 0; i < images; i++)
+      sample.images.push_back(tokens[i][0] == '/' ? tokens[i] : dir + tokens[i]);
+    sample.label = (int)tokens.size() > images ? atoi(tokens[images].c_str()) : -1;
+    out.push_back(sample);
+  }
+  return true;
+}
+
+// fit, centre, black border (resize_keep_ratio() of classify_6_channels.py)
+cv::Mat letterbox(const cv::Mat& src, int size)
+{
+  cv::Mat out = cv::Mat::zeros(size, size, CV_8UC3);
+  double ratio = min((double)size / src.rows, (double)size / src.cols);
+  int w = (int)(ratio * src.cols), h = (int)(ratio * src.rows);
+  if (w > 0 && h > 0)
+  {
+    cv::Mat resized;
+    cv::resize(src, resized, cv::Size(w, h));
+    resized.copyTo(out(cv::Rect((size - w) / 2, (size - h) / 2, w, h)));
+  }
+  return out;
+}
+
+// one batch of samples [begin, end) as the net input, raw 0/255 like classify_cpu
+bool loadBatch(const vector<Sample>& samples, size_t begin, size_t end, CpuNet& net,
+               const velodyne_perception::MultiViewRenderer& renderer, vector<float>& input)
+{
+  const int size = net.inputHeight();
+  const float zero[3] = {0, 0, 0};
+  input.resize((end - begin) * net.inputSize());
+  for (size_t s = begin; s < end; s++)
+  {
+    float* dst = &input[(s - begin) * net.inputSize()];
+    for (size_t i = 0; i < samples[s].images.size(); i++)
+    {
+      cv::Mat image = cv::imread(samples[s].images[i], CV_LOAD_IMAGE_COLOR);
+      if (image.empty())
+      {
+        fprintf(stderr, "cannot read %s\n", samples[s].images[i].c_str());
+        return false;
+      }
+      if (i > 0)
+        image = letterbox(image, size);
+      else if (image.rows != size || image.cols != size)
+        cv::resize(image, image, cv::Size(size, size));
+      renderer.toTensor(image.data, zero, dst + i * 3 * size * size);
+    }
+  }
+  return true;
+}
+
+// forward the whole list; every batch goes through visit(begin, output)
+template <typename Visit>
+bool runList(const vector<Sample>& samples, CpuNet& net,
+             const velodyne_perception::MultiViewRenderer& renderer, Visit visit)
+{
+  vector<float> input;
+  for (size_t begin = 0; begin < samples.size(); begin += kBatch)
+  {
+    size_t end = min(samples.size(), begin + (size_t)kBatch);
+    if (!loadBatch(samples, begin, end, net, renderer, input))
+      return false;
+    visit(begin, net.forward(&input[0], end - begin));
+  }
+  return true;
+}
+
+struct Eval
+{
+  vector<int> top1;
+  vector<float> prob;   // samples x classes
+  int classes;
+  double ms_per_image;  // net only
+};
+
+bool evaluate(const vector<Sample>& samples, CpuNet& net,
+              const velodyne_perception::MultiViewRenderer& renderer, Eval& eval)
+{
+  double ms = 0;
+  eval.top1.clear();
+  eval.prob.clear();
+  vector<float> input;
+  for (size_t begin = 0; begin < samples.size(); begin += kBatch)
+  {
+    size_t end = min(samples.size(), begin + (size_t)kBatch);
+    if (!loadBatch(samples, begin, end, net, renderer, input))
+      return false;
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    const Blob& prob = net.forward(&input[0], end - begin);
+    ms += chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+    eval.classes = prob.count(1);
+    for (size_t k = 0; k < end - begin; k++)
+    {
+      const float* p = &prob.data[k * eval.classes];
+      eval.top1.push_back(max_element(p, p + eval.classes) - p);
+      eval.prob.insert(eval.prob.end(), p, p + eval.classes);
+    }
+  }
+  eval.ms_per_image = ms / max((size_t)1, samples.size());
+  return true;
+}
+
+double accuracy(const vector<Sample>& samples, const Eval& eval)
+{
+  int correct = 0;
+  for (size_t i = 0; i < samples.size(); i++)
+    correct += eval.top1[i] == samples[i].label;
+  return 100.0 * correct / max((size_t)1, samples.size());
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 6)
+  {
+    fprintf(stderr, "usage: %s net.prototxt net.caffemodel calib_list held_out_list out_table [percentile]\n", argv[0]);
+    return 1;
+  }
+  const double percentile = argc > 6 ? atof(argv[6]) : 99.99;
+  if (!(percentile > 0 && percentile <= 100))
+  {
+    fprintf(stderr, "percentile must be in (0, 100]\n");
+    return 1;
+  }
+
+  CpuNet net;
+  string error;
+  if (!net.load(argv[1], argv[2], &error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  const int channels = net.inputChannels();
+  if ((channels != 3 && channels != 6) || net.inputHeight() != net.inputWidth())
+  {
+    fprintf(stderr, "expected a square 3 or 6 channel input\n");
+    return 1;
+  }
+  velodyne_perception::MultiViewRenderer renderer(net.inputHeight());
+  vector<Sample> calib, held_out;
+  if (!readList(argv[3], channels / 3, false, calib) || !readList(argv[4], channels / 3, true, held_out))
+    return 1;
+  if (calib.empty() || held_out.empty())
+  {
+    fprintf(stderr, "empty calibration or held-out list\n");
+    return 1;
+  }
+
+  // pass 1: the range of every quantized input, pass 2: its histogram
+  vector<pair<string, string> > layers = net.quantizableLayers();
+  vector<float> max_abs(layers.size(), 0);
+  printf("calibrating %d layers on %d images\n", (int)layers.size(), (int)calib.size());
+  bool ok = runList(calib, net, renderer, [&](size_t, const Blob&)
+  {
+    for (size_t l = 0; l < layers.size(); l++)
+    {
+      const vector<float>& x = net.blob(layers[l].second)->data;
+      for (size_t i = 0; i < x.size(); i++)
+        max_abs[l] = max(max_abs[l], fabs(x[i]));
+    }
+  });
+  if (!ok)
+    return 1;
+  vector<vector<double> > hist(layers.size(), vector<double>(kBins, 0));
+  if (percentile < 100)
+  {
+    ok = runList(calib, net, renderer, [&](size_t, const Blob&)
+    {
+      for (size_t l = 0; l < layers.size(); l++)
+      {
+        const vector<float>& x = net.blob(layers[l].second)->data;
+        const float to_bin = max_abs[l] > 0 ? kBins / max_abs[l] : 0;
+        for (size_t i = 0; i < x.size(); i++)
+          hist[l][min(kBins - 1, (int)(fabs(x[i]) * to_bin))]++;
+      }
+    });
+    if (!ok)
+      return 1;
+  }
+  map<string, float> table;
+  for (size_t l = 0; l < layers.size(); l++)
+  {
+    float range = max_abs[l];
+    if (percentile < 100)
+    {
+      double total = 0, seen = 0;
+      for (int b = 0; b < kBins; b++)
+        total += hist[l][b];
+      int b = 0;
+      for (; b < kBins - 1 && (seen += hist[l][b]) < total * percentile / 100; b++)
+        ;
+      range = max_abs[l] * (b + 1) / kBins;
+    }
+    if (range > 0)
+      table[layers[l].first] = range;
+    printf("  %-16s input %-12s max %10.4g  range %10.4g\n", layers[l].first.c_str(),
+           layers[l].second.c_str(), max_abs[l], range);
+  }
+
+  // held-out accuracy, FP32 against INT8
+  Eval fp32, int8;
+  if (!evaluate(held_out, net, renderer, fp32))
+    return 1;
+  if (!net.setInt8(table, &error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (!evaluate(held_out, net, renderer, int8))
+    return 1;
+  int agree = 0;
+  double mean_dp = 0, max_dp = 0;
+  for (size_t i = 0; i < held_out.size(); i++)
+  {
+    agree += fp32.top1[i] == int8.top1[i];
+    for (int c = 0; c < fp32.classes; c++)
+    {
+      double dp = fabs(fp32.prob[i * fp32.classes + c] - int8.prob[i * fp32.classes + c]);
+      mean_dp += dp / fp32.classes;
+      max_dp = max(max_dp, dp);
+    }
+  }
+  mean_dp /= held_out.size();
+
+  const double acc_fp32 = accuracy(held_out, fp32), acc_int8 = accuracy(held_out, int8);
+  ostringstream report;
+  report << "calibrate_int8 " << argv[1] << " " << argv[2] << "\n";
+  report << calib.size() << " calibration images, percentile " << percentile << "\n";
+  report << held_out.size() << " held-out images:\n";
+  char line[256];
+  snprintf(line, sizeof(line), "  top-1 FP32 %.2f%%  INT8 %.2f%%  delta %+.2f%%\n", acc_fp32, acc_int8, acc_int8 - acc_fp32);
+  report << line;
+  snprintf(line, sizeof(line), "  FP32 / INT8 top-1 agreement %.2f%%\n", 100.0 * agree / held_out.size());
+  report << line;
+  snprintf(line, sizeof(line), "  |prob FP32 - prob INT8| mean %.5f max %.5f\n", mean_dp, max_dp);
+  report << line;
+  snprintf(line, sizeof(line), "  net time per image FP32 %.2f ms  INT8 %.2f ms", fp32.ms_per_image, int8.ms_per_image);
+  report << line;
+  printf("%s\n", report.str().c_str());
+
+  if (!classification::writeInt8Table(argv[5], table, report.str(), &error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("wrote %s\n", argv[5]);
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**********************************
+Camera ROI
+  Camera stage in front of the Python 6 channel classifiers: letterboxes
+  the camera ROI of every cluster into a ~size x ~size bgr8 ObjectPose.img
+  (roi_extractor.h), so the classifiers take it as is. The scan is matched
+  with the cached camera frame nearest in time, which is converted at most
+  once, never per cluster. classify_cpu crops from the frame cache itself
+  (~image_topic) and does not need this node.
+Subscribe:
+  ~input_topic          (robotx_msgs/ObjectPoseList, default /obj_list)
+  ~image_topic          (sensor_msgs/Image, default /camera/image_rect_color)
+  ~camera_info_topic    (sensor_msgs/CameraInfo, default /camera/camera_info)
+Publish:
+  /obj_list/roi         (robotx_msgs/ObjectPoseList, img left empty for
+                         clusters outside the image)
+***********************************/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <robotx_msgs/ObjectPoseList.h>
+
+#include <classification/roi_extractor.h>
+#include <velodyne_perception/task_pool.h>
+
+using namespace std;
+
+class CameraRoi
+{
+public:
+  CameraRoi(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+
+private:
+  void callBack(const robotx_msgs::ObjectPoseListConstPtr& msg);
+
+  string node_name_;
+  int size_;
+  unique_ptr<velodyne_perception::TaskPool> pool_;
+  unique_ptr<classification::RoiExtractor> extractor_;
+  ros::Subscriber sub_obj_;
+  ros::Publisher pub_obj_;
+};
+
+CameraRoi::CameraRoi(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+  : node_name_(ros::this_node::getName())
+{
+  string input_topic, image_topic;
+  int threads;
+  private_nh.param<string>("input_topic", input_topic, "/obj_list");
+  private_nh.param<string>("image_topic", image_topic, "/camera/image_rect_color");
+  private_nh.param("size", size_, 227);
+  private_nh.param("threads", threads, -1);
+  ROS_INFO("[%s] Param [size] = %d", node_name_.c_str(), size_);
+  pool_.reset(new velodyne_perception::TaskPool(threads));
+  extractor_.reset(new classification::RoiExtractor(nh, private_nh, image_topic));
+
+  pub_obj_ = nh.advertise<robotx_msgs::ObjectPoseList>("/obj_list/roi", 1);
+  sub_obj_ = nh.subscribe(input_topic, 1, &CameraRoi::callBack, this);
+}
+
+void CameraRoi::callBack(const robotx_msgs::ObjectPoseListConstPtr& msg)
+{
+  robotx_msgs::ObjectPoseList obj_list = *msg;
+  ros::WallTime t_start = ros::WallTime::now();
+  classification::RoiExtractor::Scan scan;
+  if (!extractor_->prepare(obj_list.header, scan))
+  {
+    pub_obj_.publish(obj_list);
+    return;
+  }
+
+  vector<char> in_view(obj_list.list.size(), 0);
+  pool_->parallelFor(obj_list.list.size(), [&](size_t k)
+  {
+    robotx_msgs::ObjectPose& obj = obj_list.list[k];
+    obj.img = sensor_msgs::Image();
+    vector<uint8_t> crop(3 * size_ * size_);
+    if (!extractor_->crop(scan, obj, size_, &crop[0]))
+      return;
+    obj.img.header = scan.frame->header;
+    obj.img.height = size_;
+    obj.img.width = size_;
+    obj.img.encoding = "bgr8";
+    obj.img.step = 3 * size_;
+    obj.img.data.swap(crop);
+    in_view[k] = 1;
+  });
+  pub_obj_.publish(obj_list);
+  ROS_INFO_THROTTLE(1, "[%s] %d of %d clusters in view, %.2f ms", node_name_.c_str(),
+                    (int)count(in_view.begin(), in_view.end(), 1), (int)obj_list.list.size(),
+                    (ros::WallTime::now() - t_start).toSec() * 1000);
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "camera_roi");
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  CameraRoi roi(nh, private_nh);
+  ros::spin();
+  return 0;
+}
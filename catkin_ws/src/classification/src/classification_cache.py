@@ -0,0 +1,157 @@
+# Per-track cache of classification results, shared by classify_rot.py and
+# classify_all.py. Clusters are associated across scans by their centroid
+# in ~fixed_frame (nearest track within ~cache_match_distance). A confident
+# label is reused until ~cache_refresh seconds have passed, or the point
+# count or extent of the cluster has changed materially since it was
+# classified.
+import math
+import numpy as np
+import rospy
+import tf
+
+class Track():
+	def __init__(self, x, y, stamp):
+		self.x = x
+		self.y = y
+		self.last_seen = stamp
+		self.label = None
+		self.stamp = None	# when label was classified
+		self.count = 0
+		self.extent = None
+		self.deferred = 0	# scans in a row the scheduler skipped it
+
+class ClassificationCache():
+	def __init__(self):
+		self.node_name = rospy.get_name()
+		self.enabled = rospy.get_param('~cache', False)
+		self.fixed_frame = rospy.get_param('~fixed_frame', 'odom')
+		self.match_distance = rospy.get_param('~cache_match_distance', 1.0)
+		self.refresh = rospy.get_param('~cache_refresh', 2.0)
+		self.count_change = rospy.get_param('~cache_count_change', 0.3)
+		self.extent_change = rospy.get_param('~cache_extent_change', 0.5)
+		self.timeout = rospy.get_param('~cache_timeout', 1.0)
+		self.tf_timeout = rospy.get_param('~cache_tf_timeout', 0.05)	# s to wait for the transform of a scan
+		rospy.loginfo("[%s] Param [cache] = %s, fixed_frame = %s, refresh = %.1f s" %(self.node_name, self.enabled, self.fixed_frame, self.refresh))
+		self.listener = tf.TransformListener() if self.enabled else None
+		self.tracks = []
+		self.frame_tracks = []
+		self.frame_geometry = []
+		self.stamp = None
+		self.hits = 0
+		self.lookups = 0
+
+	def begin(self, obj_list):
+		# Associate the clusters of a new scan with the tracks. Returns the
+		# cached label of every cluster, None where it has to be classified
+		labels = [None] * obj_list.size
+		if not self.enabled:
+			return labels
+		self.stamp = obj_list.header.stamp if not obj_list.header.stamp.is_zero() else rospy.Time.now()
+		centroids = self.to_fixed(obj_list)
+		self.tracks = [t for t in self.tracks if (self.stamp - t.last_seen).to_sec() < self.timeout]
+
+		# ======= Greedy nearest neighbour, one cluster per track =======
+		pairs = []
+		for i in range(len(centroids)):
+			for j in range(len(self.tracks)):
+				d = math.hypot(centroids[i][0] - self.tracks[j].x, centroids[i][1] - self.tracks[j].y)
+				if d < self.match_distance:
+					pairs.append((d, i, j))
+		pairs.sort()
+		self.frame_tracks = [None] * len(centroids)
+		used = set()
+		for d, i, j in pairs:
+			if self.frame_tracks[i] is None and j not in used:
+				self.frame_tracks[i] = self.tracks[j]
+				used.add(j)
+		for i in range(len(centroids)):
+			if self.frame_tracks[i] is None:
+				self.frame_tracks[i] = Track(centroids[i][0], centroids[i][1], self.stamp)
+				self.tracks.append(self.frame_tracks[i])
+
+		self.frame_geometry = [self.geometry(obj) for obj in obj_list.list]
+		for i in range(len(centroids)):
+			t = self.frame_tracks[i]
+			t.x, t.y = centroids[i]
+			t.last_seen = self.stamp
+			if t.label is not None and (self.stamp - t.stamp).to_sec() < self.refresh and not self.changed(t, self.frame_geometry[i]):
+				labels[i] = t.label
+		self.lookups += len(labels)
+		self.hits += sum(1 for l in labels if l is not None)
+		if self.lookups > 0:
+			rospy.loginfo_throttle(5, "[%s] %d tracks, cache hit rate %.1f%%" %(self.node_name, len(self.tracks), 100.0*self.hits/self.lookups))
+		return labels
+
+	def store(self, i, label):
+		# Result of the net for cluster i of the scan passed to begin()
+		if not self.enabled:
+			return
+		t = self.frame_tracks[i]
+		if label == "None":
+			t.label = None
+			t.deferred = 0
+			return
+		t.label = label
+		t.stamp = self.stamp
+		t.count, t.extent = self.frame_geometry[i]
+		t.deferred = 0
+
+	def previous(self, i):
+		# last confident label of cluster i, even if it is due for a refresh
+		if not self.enabled:
+			return None
+		return self.frame_tracks[i].label
+
+	def defer(self, i):
+		if self.enabled:
+			self.frame_tracks[i].deferred += 1
+
+	def deferred(self, i):
+		if not self.enabled:
+			return 0
+		return self.frame_tracks[i].deferred
+
+	def changed(self, track, geometry):
+		count, extent = geometry
+		if abs(count - track.count) > self.count_change * max(track.count, 1):
+			return True
+		return np.max(np.abs(extent - track.extent)) > self.extent_change
+
+	def geometry(self, obj):
+		# point count and bearing aligned extent (dx, dy, dz), like the views see it
+		if len(obj.pcl_points_local.poses) > 0:
+			count = len(obj.pcl_points_local.poses)
+			extent = np.array([obj.local_max.x - obj.local_min.x, obj.local_max.y - obj.local_min.y, obj.local_max.z - obj.local_min.z])
+			return count, extent
+		count = len(obj.pcl_points.poses)
+		if count == 0:
+			return 0, np.zeros(3)
+		p = np.array([[q.position.x, q.position.y, q.position.z] for q in obj.pcl_points.poses])
+		rad = math.atan2(obj.position.y, obj.position.x)
+		c, s = math.cos(rad), math.sin(rad)
+		x = c*p[:, 0] + s*p[:, 1]
+		y = -s*p[:, 0] + c*p[:, 1]
+		extent = np.array([x.max() - x.min(), y.max() - y.min(), p[:, 2].max() - p[:, 2].min()])
+		return count, extent
+
+	def to_fixed(self, obj_list):
+		# centroids (x, y) in the fixed frame; sensor frame if tf has no transform
+		centroids = [(obj.position.x, obj.position.y) for obj in obj_list.list]
+		frame = obj_list.header.frame_id
+		if self.fixed_frame == "" or frame == "" or frame == self.fixed_frame:
+			return centroids
+		# the transform at the time of the scan, not the latest one: the
+		# boat moves between the two and so would the centroids
+		stamp = obj_list.header.stamp
+		try:
+			self.listener.waitForTransform(self.fixed_frame, frame, stamp, rospy.Duration(self.tf_timeout))
+			(trans, rot) = self.listener.lookupTransform(self.fixed_frame, frame, stamp)
+		except (tf.Exception, tf.LookupException, tf.ConnectivityException, tf.ExtrapolationException):
+			rospy.logwarn_throttle(5, "[%s] no tf %s -> %s, tracking in the sensor frame" %(self.node_name, frame, self.fixed_frame))
+			return centroids
+		matrix = self.listener.fromTranslationRotation(trans, rot)
+		fixed = []
+		for x, y in centroids:
+			p = np.dot(matrix, np.array([x, y, 0, 1]))
+			fixed.append((p[0], p[1]))
+		return fixed
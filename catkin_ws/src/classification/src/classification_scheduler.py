@@ -0,0 +1,56 @@
+# Per-scan time budget in front of the net, shared by classify_rot.py and
+# classify_all.py. The clusters the cache could not answer are ordered:
+#   1. deferred for ~max_defer scans already (bounds their latency)
+#   2. within ~classify_range (what mapping_tf.py uses) before farther ones
+#   3. never classified before stale ones
+#   4. nearest first
+# and classified while ~frame_budget seconds last; the rest keep their last
+# label (or "None") and are deferred to the next scans.
+import math
+import time
+import rospy
+
+class ClassificationScheduler():
+	def __init__(self):
+		self.node_name = rospy.get_name()
+		self.budget = rospy.get_param('~frame_budget', 0.)	# s per scan, 0 = no limit
+		self.classify_range = rospy.get_param('~classify_range', 10.)
+		self.max_defer = rospy.get_param('~max_defer', 10)
+		rospy.loginfo("[%s] Param [frame_budget] = %.3f s, classify_range = %.1f m" %(self.node_name, self.budget, self.classify_range))
+		self.cost = None	# running estimate of seconds per cluster
+		self.start = None
+
+	def plan(self, obj_list, cached, cache):
+		# Indices to classify in priority order, cut to what the estimated
+		# cost per cluster fits into the budget. Starts the clock.
+		pending = [i for i in range(obj_list.size) if cached[i] is None]
+		def priority(i):
+			p = obj_list.list[i].position
+			r = math.hypot(p.x, p.y)
+			return (cache.deferred(i) < self.max_defer, r > self.classify_range, cache.previous(i) is not None, r)
+		pending.sort(key = priority)
+		if self.budget > 0 and self.cost is not None:
+			pending = pending[:max(1, int(self.budget / self.cost))]
+		self.start = time.time()
+		return pending
+
+	def has_time(self, classified):
+		# room for one more cluster; the first one of a scan always runs
+		if self.budget <= 0 or classified == 0 or self.cost is None:
+			return True
+		return time.time() - self.start + self.cost <= self.budget
+
+	def finish(self, obj_list, cached, classified, cache):
+		# classified: indices the net has labelled this scan
+		if len(classified) > 0:
+			cost = (time.time() - self.start) / len(classified)
+			self.cost = cost if self.cost is None else 0.8*self.cost + 0.2*cost
+		deferred = 0
+		for i in range(obj_list.size):
+			if cached[i] is None and i not in classified:
+				label = cache.previous(i)
+				obj_list.list[i].type = label if label is not None else "None"
+				cache.defer(i)
+				deferred += 1
+		if deferred > 0:
+			rospy.loginfo_throttle(5, "[%s] budget %.0f ms: %d clusters classified, %d deferred" %(self.node_name, self.budget*1000, len(classified), deferred))
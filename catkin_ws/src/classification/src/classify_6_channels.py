@@ -96,30 +96,39 @@ class classify_6_channels():
 			plane_xz = []
 			pcl_size = len(tf_points.poses)
 
-			# ======= Coordinate transform for better project performance ======
-			position = [0, 0, 0]
-			rad = math.atan2(centroids.y, centroids.x)
-			quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
-			transformer = tf.TransformerROS()
-			transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
-			for m in range(pcl_size):
-				new_x = tf_points.poses[m].position.x
-				new_y = tf_points.poses[m].position.y
-				new_z = tf_points.poses[m].position.z
-				orig_point = np.array([new_x, new_y, new_z, 1])
-				new_center = np.dot(transpose_matrix, orig_point)
-				tf_points.poses[m].position.x = new_center[0]
-				tf_points.poses[m].position.y = new_center[1]
-				tf_points.poses[m].position.z = new_center[2]
+			# ======= Views already rendered by the cluster node (~render_views) ======
+			if len(obj_list.list[i].views.data) > 0:
+				self.image = self.bridge.imgmsg_to_cv2(obj_list.list[i].views, "bgr8")
+			else:
+				# ======= Coordinate transform for better project performance ======
+				if len(obj_list.list[i].pcl_points_local.poses) > 0:
+					# already rotated by the cluster node (~local_frame)
+					tf_points = obj_list.list[i].pcl_points_local
+					pcl_size = len(tf_points.poses)
+				else:
+					position = [0, 0, 0]
+					rad = math.atan2(centroids.y, centroids.x)
+					quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
+					transformer = tf.TransformerROS()
+					transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
+					for m in range(pcl_size):
+						new_x = tf_points.poses[m].position.x
+						new_y = tf_points.poses[m].position.y
+						new_z = tf_points.poses[m].position.z
+						orig_point = np.array([new_x, new_y, new_z, 1])
+						new_center = np.dot(transpose_matrix, orig_point)
+						tf_points.poses[m].position.x = new_center[0]
+						tf_points.poses[m].position.y = new_center[1]
+						tf_points.poses[m].position.z = new_center[2]
 
-			# ======= project to XY, YZ, XZ plane =======
-			for j in range(pcl_size):
-				plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
-				plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
-				plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
-			self.toIMG(pcl_size, plane_xy, 'xy')
-			self.toIMG(pcl_size, plane_yz, 'yz')
-			self.toIMG(pcl_size, plane_xz, 'xz')
+				# ======= project to XY, YZ, XZ plane =======
+				for j in range(pcl_size):
+					plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
+					plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
+					plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
+				self.toIMG(pcl_size, plane_xy, 'xy')
+				self.toIMG(pcl_size, plane_yz, 'yz')
+				self.toIMG(pcl_size, plane_xz, 'xz')
 			model_type = self.classify()
 
 			# ***************************************************************
@@ -155,6 +164,9 @@ class classify_6_channels():
 	def resize_keep_ratio(self, img, width, height, fill_color=(0, 0, 0, 0)):
 		#======= Make sure image is smaller than background =======
 		h, w, channel = img.shape
+		if h == height and w == width:
+			# already letterboxed by camera_roi
+			return img
 		h_ratio = float(float(height)/float(h))
 		w_ratio = float(float(width)/float(w))
 		#if h_ratio <= 1 or w_ratio <= 1:
@@ -21,6 +21,8 @@ sys.path.insert(0, caffe_root + '/caffe/python')
 import caffe
 import os
 from PIL import Image
+from classification_cache import ClassificationCache
+from classification_scheduler import ClassificationScheduler
 
 class classify_all():
 	def __init__(self):
@@ -29,6 +31,10 @@ class classify_all():
 		rospy.Subscriber('/obj_list/roi', ObjectPoseList, self.call_back)
 		self.pub_obj = rospy.Publisher("/obj_list/classify", ObjectPoseList, queue_size = 1)
 		self.pub_marker = rospy.Publisher("/obj_classify", MarkerArray, queue_size = 1)
+		# labels of clusters tracked across scans are reused (see classification_cache.py)
+		self.cache = ClassificationCache()
+		# the rest is classified nearest / unclassified first within ~frame_budget
+		self.scheduler = ClassificationScheduler()
 		#rospy.Subscriber('/pcl_array', PoseArray, self.call_back)
 		self.boundary = 50
 		self.height = 227.
@@ -102,7 +108,14 @@ class classify_all():
 		#tf_points = msg
 		#cluster_num = len(tf_points.list)
 		#pcl_size = len(msg.poses)
+		cached = self.cache.begin(obj_list)
 		for i in range(cluster_num):
+			if cached[i] is not None:
+				obj_list.list[i].type = cached[i]
+		classified = set()
+		for i in self.scheduler.plan(obj_list, cached, self.cache):
+			if not self.scheduler.has_time(len(classified)):
+				break
 			self.no_camera_img = False
 			self.get_roi_image(obj_list.list[i].img)
 			self.image = np.zeros((int(self.height), int(self.width), 3), np.uint8)
@@ -115,30 +128,39 @@ class classify_all():
 			plane_xz = []
 			pcl_size = len(tf_points.poses)
 
-			# ======= Coordinate transform for better project performance ======
-			position = [0, 0, 0]
-			rad = math.atan2(centroids.y, centroids.x)
-			quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
-			transformer = tf.TransformerROS()
-			transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
-			for m in range(pcl_size):
-				new_x = tf_points.poses[m].position.x
-				new_y = tf_points.poses[m].position.y
-				new_z = tf_points.poses[m].position.z
-				orig_point = np.array([new_x, new_y, new_z, 1])
-				new_center = np.dot(transpose_matrix, orig_point)
-				tf_points.poses[m].position.x = new_center[0]
-				tf_points.poses[m].position.y = new_center[1]
-				tf_points.poses[m].position.z = new_center[2]
+			# ======= Views already rendered by the cluster node (~render_views) ======
+			if len(obj_list.list[i].views.data) > 0:
+				self.image = self.bridge.imgmsg_to_cv2(obj_list.list[i].views, "bgr8")
+			else:
+				# ======= Coordinate transform for better project performance ======
+				if len(obj_list.list[i].pcl_points_local.poses) > 0:
+					# already rotated by the cluster node (~local_frame)
+					tf_points = obj_list.list[i].pcl_points_local
+					pcl_size = len(tf_points.poses)
+				else:
+					position = [0, 0, 0]
+					rad = math.atan2(centroids.y, centroids.x)
+					quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
+					transformer = tf.TransformerROS()
+					transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
+					for m in range(pcl_size):
+						new_x = tf_points.poses[m].position.x
+						new_y = tf_points.poses[m].position.y
+						new_z = tf_points.poses[m].position.z
+						orig_point = np.array([new_x, new_y, new_z, 1])
+						new_center = np.dot(transpose_matrix, orig_point)
+						tf_points.poses[m].position.x = new_center[0]
+						tf_points.poses[m].position.y = new_center[1]
+						tf_points.poses[m].position.z = new_center[2]
 
-			# ======= project to XY, YZ, XZ plane =======
-			for j in range(pcl_size):
-				plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
-				plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
-				plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
-			self.toIMG(pcl_size, plane_xy, 'xy')
-			self.toIMG(pcl_size, plane_yz, 'yz')
-			self.toIMG(pcl_size, plane_xz, 'xz')
+				# ======= project to XY, YZ, XZ plane =======
+				for j in range(pcl_size):
+					plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
+					plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
+					plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
+				self.toIMG(pcl_size, plane_xy, 'xy')
+				self.toIMG(pcl_size, plane_yz, 'yz')
+				self.toIMG(pcl_size, plane_xz, 'xz')
 			model_type = None
 			if self.use_3_channels:
 				model_type = self.classify_3()
@@ -149,9 +171,12 @@ class classify_all():
 			# Add typpe to object list
 			# ***************************************************************
 			obj_list.list[i].type = model_type
+			self.cache.store(i, model_type)
+			classified.add(i)
 			#cv2.imwrite( "Image" + str(self.index) + ".jpg", self.image)
 			#self.index = self.index + 1
 			#print "Save image"
+		self.scheduler.finish(obj_list, cached, classified, self.cache)
 		self.pub_obj.publish(obj_list)
 		self.drawRviz(obj_list)
 
@@ -181,6 +206,9 @@ class classify_all():
 	def resize_keep_ratio(self, img, width, height, fill_color=(0, 0, 0, 0)):
 		#======= Make sure image is smaller than background =======
 		h, w, channel = img.shape
+		if h == height and w == width:
+			# already letterboxed by camera_roi
+			return img
 		h_ratio = float(float(height)/float(h))
 		w_ratio = float(float(width)/float(w))
 		#if h_ratio <= 1 or w_ratio <= 1:
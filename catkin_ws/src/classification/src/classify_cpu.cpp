@@ -0,0 +1,581 @@
+/**********************************
+Classify CPU
+  GPU-free counterpart of classify_rot.py / classify_6_channels.py: runs
+  the dl_models caffenet on CpuNet, one batched forward pass per scan.
+  The channels of the net's input decide what is fed:
+    3: xy/yz/xz views of the cluster
+    6: views + letterboxed camera ROI (ObjectPose.img), as classify_6_channels
+  Views are taken from ObjectPose.views when the cluster node renders them
+  (~render_views), otherwise rendered here from pcl_points_local or
+  pcl_points. ~int8_table (written by calibrate_int8, next to the weights)
+  runs the net in INT8.
+  ~low_prototxt / ~low_weights add a low resolution tier (e.g. the 113x113
+  caffenet_113): clusters with fewer than ~low_max_points points or
+  beyond ~low_min_range are rendered at its size and go through it instead.
+  ~cascade_model (written by train_cascade) puts a decision tree on the
+  cluster geometry (ObjectPose.descriptor) in front of the nets: clusters
+  it labels with at least ~cascade_confidence skip the CNN.
+  ~roi_prototxt adds the 6 channel net of classify_all.py as an ensemble
+  with a 3 channel main net: clusters with a camera ROI are rendered once
+  into a 6 channel batch, the main net reads its first 3 channels while
+  the 6 channel net reads all of it on its own pool at the same time, and
+  the two outputs are fused (see fuse()).
+  ~image_topic crops the camera ROIs here from the frame nearest to the
+  scan (roi_extractor.h, with its ~camera_info_topic, ~max_frame_dt, ...)
+  for clusters that come without ObjectPose.img, so the list does not
+  have to go through camera_roi and carry the image data.
+Subscribe:
+  ~input_topic          (robotx_msgs/ObjectPoseList, default /obj_list)
+  ~image_topic          (sensor_msgs/Image, optional)
+Publish:
+  /obj_list/classify    (robotx_msgs/ObjectPoseList)
+  /obj_classify         (visualization_msgs/MarkerArray)
+***********************************/
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <cv_bridge/cv_bridge.h>
+#include <robotx_msgs/ObjectPoseList.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include <classification/cpu_net.h>
+#include <classification/geometric_cascade.h>
+#include <classification/roi_crop.h>
+#include <classification/roi_extractor.h>
+#include <velodyne_perception/cluster_descriptor.h>
+#include <velodyne_perception/multiview_renderer.h>
+
+using namespace std;
+
+class ClassifyCpu
+{
+public:
+  ClassifyCpu(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+
+private:
+  // one net and the renderer for its input size
+  struct Tier
+  {
+    explicit Tier(const shared_ptr<classification::TaskPool>& pool) : net(pool) {}
+    classification::CpuNet net;
+    velodyne_perception::MultiViewRenderer renderer;
+    vector<float> input;
+  };
+
+  bool loadTier(Tier& tier, const string& base, const string& prototxt, const string& weights,
+                const string& int8_table);
+  void callBack(const robotx_msgs::ObjectPoseListConstPtr& msg);
+  int cascade(const robotx_msgs::ObjectPose& obj) const;
+  bool useLowTier(const robotx_msgs::ObjectPose& obj) const;
+  void cropRois(const classification::RoiExtractor::Scan& scan, const robotx_msgs::ObjectPoseList& obj_list,
+                const vector<size_t>& index, int size);
+  bool hasRoi(const robotx_msgs::ObjectPoseList& obj_list, size_t k) const;
+  void classify(Tier& tier, robotx_msgs::ObjectPoseList& obj_list, const vector<size_t>& index, size_t with_roi);
+  string fuse(const float* p, int classes, const float* q, int roi_classes) const;
+  void fillInput(const Tier& tier, const robotx_msgs::ObjectPose& obj, const vector<uint8_t>& crop, float* input,
+                 bool roi) const;
+  void letterbox(const sensor_msgs::Image& img, int size, vector<uint8_t>& out) const;
+  void drawRviz(const robotx_msgs::ObjectPoseList& obj_list);
+
+  string node_name_;
+  double threshold_;
+  int low_max_points_;
+  double low_min_range_;
+  double cascade_confidence_;
+  vector<string> labels_;
+  classification::GeometricCascade cascade_;   // empty without ~cascade_model
+  shared_ptr<classification::TaskPool> pool_;
+  unique_ptr<Tier> main_;
+  unique_ptr<Tier> low_;    // NULL without ~low_prototxt
+  shared_ptr<classification::TaskPool> roi_pool_;
+  unique_ptr<Tier> roi_;    // 6 channel net of the ensemble, NULL without ~roi_prototxt
+  vector<string> roi_labels_;
+  vector<int> roi_shape_;   // roi label -> labels_ index of its shape, -1 if none
+  unique_ptr<classification::RoiExtractor> extractor_;   // NULL without ~image_topic
+  vector<vector<uint8_t> > crops_;   // per cluster of the scan, ROIs cropped by extractor_
+  ros::Subscriber sub_;
+  ros::Publisher pub_obj_;
+  ros::Publisher pub_marker_;
+};
+
+static vector<string> readLabels(const string& path)
+{
+  vector<string> labels;
+  ifstream file(path.c_str());
+  string line;
+  while (getline(file, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (!line.empty())
+      labels.push_back(line);
+  }
+  return labels;
+}
+
+ClassifyCpu::ClassifyCpu(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+  : node_name_(ros::this_node::getName())
+{
+  string model_dir, prototxt, weights, labels, int8_table, input_topic, image_topic;
+  string low_prototxt, low_weights, low_int8_table, cascade_model;
+  string roi_model_dir, roi_prototxt, roi_weights, roi_labels, roi_int8_table;
+  int threads, roi_threads;
+  private_nh.param<string>("model_dir", model_dir, "object_classification/caffenet_rot");
+  private_nh.param<string>("prototxt", prototxt, "caffenet.prototxt");
+  private_nh.param<string>("weights", weights, "caffenet_4.caffemodel");
+  private_nh.param<string>("labels", labels, "label.txt");
+  private_nh.param<string>("int8_table", int8_table, "");
+  private_nh.param<string>("low_prototxt", low_prototxt, "");
+  private_nh.param<string>("low_weights", low_weights, "");
+  private_nh.param<string>("low_int8_table", low_int8_table, "");
+  private_nh.param("low_max_points", low_max_points_, 20);
+  private_nh.param("low_min_range", low_min_range_, 30.0);
+  private_nh.param<string>("cascade_model", cascade_model, "");
+  private_nh.param("cascade_confidence", cascade_confidence_, 0.98);
+  private_nh.param<string>("roi_model_dir", roi_model_dir, "object_classification/caffenet_6_channels");
+  private_nh.param<string>("roi_prototxt", roi_prototxt, "");
+  private_nh.param<string>("roi_weights", roi_weights, "caffenet_6_channels.caffemodel");
+  private_nh.param<string>("roi_labels", roi_labels, "lab_list_6_channels.txt");
+  private_nh.param<string>("roi_int8_table", roi_int8_table, "");
+  private_nh.param("threads", threads, -1);
+  private_nh.param("roi_threads", roi_threads, -1);
+  private_nh.param<string>("input_topic", input_topic, "/obj_list");
+  private_nh.param<string>("image_topic", image_topic, "");
+  private_nh.param("threshold", threshold_, 0.9);
+  string base = ros::package::getPath("dl_models") + "/" + model_dir + "/";
+  ROS_INFO("[%s] model = %s%s", node_name_.c_str(), base.c_str(), weights.c_str());
+  ROS_INFO("[%s] Param [threshold] = %f", node_name_.c_str(), threshold_);
+  ROS_INFO("[%s] Param [int8_table] = %s", node_name_.c_str(), int8_table.c_str());
+
+  // the ensemble nets run side by side, by default on half of the cores each
+  if (!roi_prototxt.empty())
+  {
+    int cores = max(2, (int)thread::hardware_concurrency());
+    if (threads < 0)
+      threads = (cores + 1) / 2 - 1;
+    if (roi_threads < 0)
+      roi_threads = cores / 2 - 1;
+  }
+  pool_.reset(new classification::TaskPool(threads));
+
+  main_.reset(new Tier(pool_));
+  if (!loadTier(*main_, base, prototxt, weights, int8_table))
+    return;
+  if (!low_prototxt.empty())
+  {
+    ROS_INFO("[%s] low tier = %s%s, Param [low_max_points] = %d, [low_min_range] = %f", node_name_.c_str(),
+             base.c_str(), low_weights.c_str(), low_max_points_, low_min_range_);
+    low_.reset(new Tier(pool_));
+    if (!loadTier(*low_, base, low_prototxt, low_weights, low_int8_table))
+      return;
+    if (low_->net.inputChannels() != main_->net.inputChannels())
+    {
+      ROS_FATAL("[%s] the low tier has a different number of input channels", node_name_.c_str());
+      ros::shutdown();
+      return;
+    }
+  }
+
+  if (!cascade_model.empty())
+  {
+    string error;
+    if (!cascade_.load(base + cascade_model, &error))
+    {
+      ROS_FATAL("[%s] %s", node_name_.c_str(), error.c_str());
+      ros::shutdown();
+      return;
+    }
+    ROS_INFO("[%s] cascade = %s%s, %d leaves, Param [cascade_confidence] = %f", node_name_.c_str(), base.c_str(),
+             cascade_model.c_str(), cascade_.leaves(), cascade_confidence_);
+  }
+
+  labels_ = readLabels(base + labels);
+  if (!roi_prototxt.empty())
+  {
+    string roi_base = ros::package::getPath("dl_models") + "/" + roi_model_dir + "/";
+    ROS_INFO("[%s] ensemble = %s%s, Param [threads] = %d, [roi_threads] = %d", node_name_.c_str(),
+             roi_base.c_str(), roi_weights.c_str(), threads, roi_threads);
+    roi_pool_.reset(new classification::TaskPool(roi_threads));
+    roi_.reset(new Tier(roi_pool_));
+    if (!loadTier(*roi_, roi_base, roi_prototxt, roi_weights, roi_int8_table))
+      return;
+    if (main_->net.inputChannels() != 3 || roi_->net.inputChannels() != 6 ||
+        roi_->net.inputHeight() != main_->net.inputHeight())
+    {
+      ROS_FATAL("[%s] the ensemble needs a 3 channel main net and a 6 channel net of the same size",
+                node_name_.c_str());
+      ros::shutdown();
+      return;
+    }
+    // a 6 channel label counts for the main label it is or refines (totem_red -> totem)
+    roi_labels_ = readLabels(roi_base + roi_labels);
+    roi_shape_.assign(roi_labels_.size(), -1);
+    for (size_t r = 0; r < roi_labels_.size(); r++)
+      for (size_t c = 0; c < labels_.size(); c++)
+        if ((roi_labels_[r] == labels_[c] || roi_labels_[r].compare(0, labels_[c].size() + 1, labels_[c] + "_") == 0) &&
+            (roi_shape_[r] < 0 || labels_[c].size() > labels_[roi_shape_[r]].size()))
+          roi_shape_[r] = c;
+  }
+  ROS_INFO("[%s] %d channel input, %d labels, %s", node_name_.c_str(), main_->net.inputChannels(), (int)labels_.size(),
+           main_->net.isInt8() ? "INT8" : "FP32");
+
+  if (!image_topic.empty())
+  {
+    if (roi_ || main_->net.inputChannels() == 6 || (low_ && low_->net.inputChannels() == 6))
+      extractor_.reset(new classification::RoiExtractor(nh, private_nh, image_topic));
+    else
+      ROS_WARN("[%s] ~image_topic is ignored, no net takes a camera ROI", node_name_.c_str());
+  }
+
+  pub_obj_ = nh.advertise<robotx_msgs::ObjectPoseList>("/obj_list/classify", 1);
+  pub_marker_ = nh.advertise<visualization_msgs::MarkerArray>("/obj_classify", 1);
+  sub_ = nh.subscribe(input_topic, 1, &ClassifyCpu::callBack, this);
+}
+
+bool ClassifyCpu::loadTier(Tier& tier, const string& base, const string& prototxt, const string& weights,
+                           const string& int8_table)
+{
+  string error;
+  map<string, float> max_abs;
+  bool ok = tier.net.load(base + prototxt, base + weights, &error);
+  if (ok && !int8_table.empty())
+    ok = classification::readInt8Table(base + int8_table, max_abs, &error) && tier.net.setInt8(max_abs, &error);
+  if (ok && ((tier.net.inputChannels() != 3 && tier.net.inputChannels() != 6) ||
+             tier.net.inputHeight() != tier.net.inputWidth()))
+  {
+    ok = false;
+    error = prototxt + ": expected a square 3 or 6 channel input";
+  }
+  if (!ok)
+  {
+    ROS_FATAL("[%s] %s", node_name_.c_str(), error.c_str());
+    ros::shutdown();
+    return false;
+  }
+  tier.renderer = velodyne_perception::MultiViewRenderer::scaledTo(tier.net.inputHeight());
+  return true;
+}
+
+void ClassifyCpu::callBack(const robotx_msgs::ObjectPoseListConstPtr& msg)
+{
+  robotx_msgs::ObjectPoseList obj_list = *msg;
+  vector<size_t> main_index, low_index;
+  int decided = 0;
+  for (size_t k = 0; k < obj_list.list.size(); k++)
+  {
+    int label = cascade(obj_list.list[k]);
+    if (label >= 0)
+    {
+      obj_list.list[k].type = cascade_.labels()[label];
+      decided++;
+    }
+    else
+      (useLowTier(obj_list.list[k]) ? low_index : main_index).push_back(k);
+  }
+  if (!cascade_.empty() && !obj_list.list.empty())
+    ROS_INFO_THROTTLE(1, "[%s] cascade: %d of %d clusters labelled without the CNN", node_name_.c_str(), decided,
+                      (int)obj_list.list.size());
+  // camera ROIs from the nearest cached frame for the clusters without img
+  crops_.assign(obj_list.list.size(), vector<uint8_t>());
+  classification::RoiExtractor::Scan scan;
+  if (extractor_ && extractor_->prepare(obj_list.header, scan))
+  {
+    if (roi_ || main_->net.inputChannels() == 6)
+      cropRois(scan, obj_list, main_index, main_->renderer.size());
+    if (low_ && low_->net.inputChannels() == 6)
+      cropRois(scan, obj_list, low_index, low_->renderer.size());
+  }
+  // ensemble: the clusters with a camera ROI first, they also go through roi_
+  size_t with_roi = 0;
+  if (roi_)
+    with_roi = stable_partition(main_index.begin(), main_index.end(), [&](size_t k)
+    {
+      return hasRoi(obj_list, k);
+    }) - main_index.begin();
+  if (!main_index.empty())
+    classify(*main_, obj_list, main_index, with_roi);
+  if (!low_index.empty())
+    classify(*low_, obj_list, low_index, 0);
+  pub_obj_.publish(obj_list);
+  drawRviz(obj_list);
+}
+
+// label index of the cascade, -1 if the CNN has to decide
+int ClassifyCpu::cascade(const robotx_msgs::ObjectPose& obj) const
+{
+  if (cascade_.empty())
+    return -1;
+  if (obj.descriptor.size() == (size_t)velodyne_perception::kDescriptorSize)
+    return cascade_.classify(&obj.descriptor[0], cascade_confidence_);
+  // no descriptor published (~descriptor off or older cluster nodes): from
+  // the embedded points
+  const vector<geometry_msgs::Pose>& poses =
+      obj.pcl_points_local.poses.empty() ? obj.pcl_points.poses : obj.pcl_points_local.poses;
+  if (poses.empty())
+    return -1;
+  vector<double> xyz(3 * poses.size());
+  for (size_t i = 0; i < poses.size(); i++)
+  {
+    xyz[3 * i] = poses[i].position.x;
+    xyz[3 * i + 1] = poses[i].position.y;
+    xyz[3 * i + 2] = poses[i].position.z;
+  }
+  float descriptor[velodyne_perception::kDescriptorSize];
+  velodyne_perception::describeGeometry(&xyz[0], poses.size(), descriptor);
+  // the points are cut or padded to ~point_budget, but the cascade learnt
+  // the count and density of raw clouds; nodes that resample always fill
+  // point_count, so without it the points are the raw cluster
+  if (obj.point_count > 0)
+  {
+    const float range = descriptor[velodyne_perception::kRange];
+    descriptor[velodyne_perception::kPoints] = obj.point_count;
+    descriptor[velodyne_perception::kDensity] = obj.point_count * (range / 10) * (range / 10);
+  }
+  return cascade_.classify(descriptor, cascade_confidence_);
+}
+
+// sparse or distant clusters; never the ones that only carry rendered views
+bool ClassifyCpu::useLowTier(const robotx_msgs::ObjectPose& obj) const
+{
+  if (!low_)
+    return false;
+  const size_t embedded = max(obj.pcl_points_local.poses.size(), obj.pcl_points.poses.size());
+  if (embedded == 0)
+    return false;
+  // the raw cluster size: the published points are cut to ~point_budget
+  const size_t points = obj.point_count > 0 ? obj.point_count : embedded;
+  double range = hypot(obj.position.x, obj.position.y);
+  return (int)points < low_max_points_ || (low_min_range_ > 0 && range > low_min_range_);
+}
+
+// letterboxed ROIs of the clusters in index into crops_, size x size bgr8
+void ClassifyCpu::cropRois(const classification::RoiExtractor::Scan& scan,
+                           const robotx_msgs::ObjectPoseList& obj_list, const vector<size_t>& index, int size)
+{
+  pool_->parallelFor(index.size(), [&](size_t i)
+  {
+    const size_t k = index[i];
+    const robotx_msgs::ObjectPose& obj = obj_list.list[k];
+    if (obj.img.height > 0 && obj.img.width > 0)
+      return;
+    crops_[k].resize(3 * size * size);
+    if (!extractor_->crop(scan, obj, size, &crops_[k][0]))
+      crops_[k].clear();
+  });
+}
+
+bool ClassifyCpu::hasRoi(const robotx_msgs::ObjectPoseList& obj_list, size_t k) const
+{
+  return !crops_[k].empty() || (obj_list.list[k].img.height > 0 && obj_list.list[k].img.width > 0);
+}
+
+// one batched forward pass of the clusters in index; the first with_roi
+// of them also go through the 6 channel net of the ensemble
+void ClassifyCpu::classify(Tier& tier, robotx_msgs::ObjectPoseList& obj_list, const vector<size_t>& index,
+                           size_t with_roi)
+{
+  const size_t n = index.size();
+  ros::WallTime t_start = ros::WallTime::now();
+  // one buffer for both ensemble nets: every slice has room for the ROI
+  const size_t image = with_roi ? roi_->net.inputSize() : tier.net.inputSize();
+  tier.input.resize(n * image);
+  pool_->parallelFor(n, [&](size_t k)
+  {
+    fillInput(tier, obj_list.list[index[k]], crops_[index[k]], &tier.input[k * image],
+              tier.net.inputChannels() == 6 || k < with_roi);
+  });
+  ros::WallTime t_net = ros::WallTime::now();
+  const classification::Blob* roi_prob = NULL;
+  double roi_ms = 0;
+  thread roi_thread;
+  if (with_roi)
+    roi_thread = thread([&]()
+    {
+      ros::WallTime t = ros::WallTime::now();
+      roi_prob = &roi_->net.forward(&tier.input[0], with_roi);
+      roi_ms = (ros::WallTime::now() - t).toSec() * 1000;
+    });
+  const classification::Blob& prob = tier.net.forward(&tier.input[0], n, image);
+  double main_ms = (ros::WallTime::now() - t_net).toSec() * 1000;
+  if (with_roi)
+    roi_thread.join();
+  ros::WallTime t_end = ros::WallTime::now();
+
+  const int classes = prob.count(1);
+  for (size_t k = 0; k < n; k++)
+  {
+    const float* p = &prob.data[k * classes];
+    if (k < with_roi)
+    {
+      const int roi_classes = roi_prob->count(1);
+      obj_list.list[index[k]].type = fuse(p, classes, &roi_prob->data[k * roi_classes], roi_classes);
+      continue;
+    }
+    int best = max_element(p, p + classes) - p;
+    if (p[best] < threshold_ || best >= (int)labels_.size())
+      obj_list.list[index[k]].type = "None";
+    else
+      obj_list.list[index[k]].type = labels_[best];
+  }
+  double net_ms = (t_end - t_net).toSec() * 1000;
+  ROS_INFO_THROTTLE(1, "[%s] %dx%d: %d clusters, %.1f ms per cluster (input %.1f ms, net %.1f ms)",
+                    node_name_.c_str(), tier.renderer.size(), tier.renderer.size(), (int)n,
+                    (t_end - t_start).toSec() * 1000 / n, (t_net - t_start).toSec() * 1000, net_ms);
+  if (with_roi)
+    ROS_INFO_THROTTLE(1, "[%s] ensemble: %d with ROI, 3 channel net %.1f ms, 6 channel net %.1f ms, together %.1f ms",
+                      node_name_.c_str(), (int)with_roi, main_ms, roi_ms, net_ms);
+}
+
+// classify_all's two nets on one cluster: both vote on the shape (the 6
+// channel labels summed per shape, totem_red + totem_green -> totem), then
+// the 6 channel net names the finer label within the winning shape
+string ClassifyCpu::fuse(const float* p, int classes, const float* q, int roi_classes) const
+{
+  vector<float> shape(labels_.size(), 0);
+  for (int c = 0; c < classes && c < (int)labels_.size(); c++)
+    shape[c] += 0.5f * p[c];
+  for (int c = 0; c < roi_classes && c < (int)roi_shape_.size(); c++)
+    if (roi_shape_[c] >= 0)
+      shape[roi_shape_[c]] += 0.5f * q[c];
+  if (shape.empty())
+    return "None";
+  int best = max_element(shape.begin(), shape.end()) - shape.begin();
+  if (shape[best] < threshold_)
+    return "None";
+  int fine = -1;
+  for (int c = 0; c < roi_classes && c < (int)roi_shape_.size(); c++)
+    if (roi_shape_[c] == best && (fine < 0 || q[c] > q[fine]))
+      fine = c;
+  return fine >= 0 ? roi_labels_[fine] : labels_[best];
+}
+
+// one C x H x W slice of the batch, raw 0/255 like the Python transformer:
+// the views, then the letterboxed camera ROI if roi: crop when extractor_
+// made one, otherwise ObjectPose.img
+void ClassifyCpu::fillInput(const Tier& tier, const robotx_msgs::ObjectPose& obj, const vector<uint8_t>& crop,
+                            float* input, bool roi) const
+{
+  const velodyne_perception::MultiViewRenderer& renderer = tier.renderer;
+  vector<uint8_t> rendered;
+  const uint8_t* views = NULL;
+  if (obj.views.encoding == "bgr8" && obj.views.data.size() == renderer.imageBytes())
+    views = &obj.views.data[0];
+  else
+  {
+    // rotate by the bearing of the centroid unless the cluster node already did
+    bool local = !obj.pcl_points_local.poses.empty();
+    const vector<geometry_msgs::Pose>& poses = local ? obj.pcl_points_local.poses : obj.pcl_points.poses;
+    double yaw = local ? 0 : atan2(obj.position.y, obj.position.x);
+    double c = cos(yaw), s = sin(yaw);
+    vector<double> xyz(3 * poses.size());
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+      const geometry_msgs::Point& p = poses[i].position;
+      xyz[3 * i] = c * p.x + s * p.y;
+      xyz[3 * i + 1] = -s * p.x + c * p.y;
+      xyz[3 * i + 2] = p.z;
+    }
+    rendered.resize(renderer.imageBytes());
+    renderer.render(xyz.empty() ? NULL : &xyz[0], poses.size(), &rendered[0]);
+    views = &rendered[0];
+  }
+  const float zero[3] = {0, 0, 0};
+  renderer.toTensor(views, zero, input);
+
+  if (roi)
+  {
+    const size_t plane = (size_t)renderer.size() * renderer.size();
+    if (crop.size() == 3 * plane)
+    {
+      renderer.toTensor(&crop[0], zero, input + 3 * plane);
+      return;
+    }
+    vector<uint8_t> letterboxed;
+    letterbox(obj.img, renderer.size(), letterboxed);
+    renderer.toTensor(&letterboxed[0], zero, input + 3 * plane);
+  }
+}
+
+// resize_keep_ratio() of classify_6_channels.py: fit, centre, black border;
+// a size x size crop of camera_roi passes through unchanged
+void ClassifyCpu::letterbox(const sensor_msgs::Image& img, int size, vector<uint8_t>& out) const
+{
+  out.assign((size_t)size * size * 3, 0);
+  if (img.height == 0 || img.width == 0)
+    return;
+  classification::PixelRect rect = {0, 0, (int)img.width, (int)img.height};
+  if (img.encoding == "bgr8" && img.data.size() >= (size_t)img.step * img.height)
+  {
+    classification::letterboxCrop(&img.data[0], img.step, rect, size, &out[0]);
+    return;
+  }
+  cv_bridge::CvImagePtr cv_ptr;
+  try
+  {
+    cv_ptr = cv_bridge::toCvCopy(img, "bgr8");
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    ROS_WARN_THROTTLE(1, "[%s] cv_bridge: %s", node_name_.c_str(), e.what());
+    return;
+  }
+  classification::letterboxCrop(cv_ptr->image.data, cv_ptr->image.step, rect, size, &out[0]);
+}
+
+void ClassifyCpu::drawRviz(const robotx_msgs::ObjectPoseList& obj_list)
+{
+  visualization_msgs::MarkerArray marker_array;
+  marker_array.markers.resize(obj_list.list.size());
+  for (size_t i = 0; i < obj_list.list.size(); i++)
+  {
+    visualization_msgs::Marker& marker = marker_array.markers[i];
+    const string& type = obj_list.list[i].type;
+    marker.header.frame_id = obj_list.header.frame_id;
+    marker.header.stamp = ros::Time::now();
+    marker.id = i;
+    marker.type = visualization_msgs::Marker::CUBE;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.lifetime = ros::Duration(0.5);
+    marker.pose.position = obj_list.list[i].position;
+    marker.pose.orientation.w = 1.0;
+    marker.scale.x = 1;
+    marker.scale.y = 1;
+    marker.scale.z = 1;
+    marker.color.a = 0.5;
+    if (type == "buoy")
+      marker.color.b = 1;
+    else if (type == "totem")
+      marker.color.g = 1;
+    else if (type == "light_buoy")
+    {
+      marker.color.r = 1;
+      marker.color.g = 1;
+    }
+    else if (type == "dock" || type == "deliver")
+    {
+      marker.color.r = type == "dock" ? 1 : 0;
+      marker.color.g = 1;
+      marker.color.b = 1;
+      marker.scale.x = 6;
+      marker.scale.y = 6;
+    }
+  }
+  pub_marker_.publish(marker_array);
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "classify_cpu");
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  ClassifyCpu classify(nh, private_nh);
+  ros::spin();
+  return 0;
+}
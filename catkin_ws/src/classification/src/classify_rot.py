@@ -3,6 +3,8 @@ import numpy as np
 import cv2
 import roslib
 import rospy
+import message_filters
+from rospy.numpy_msg import numpy_msg
 import tf
 import struct
 import math
@@ -11,21 +13,40 @@ from sensor_msgs.msg import Image
 from sensor_msgs.msg import CameraInfo
 from geometry_msgs.msg import PoseArray, Point
 from visualization_msgs.msg import Marker, MarkerArray
-from robotx_msgs.msg import PCL_points, ObjectPose, ObjectPoseList
+from robotx_msgs.msg import PCL_points, ObjectPose, ObjectPoseList, ClusterTensor
 import rospkg
 from cv_bridge import CvBridge, CvBridgeError
+try:
+	import multiview_native	# velodyne_perception, built when Boost.Python / Boost.NumPy are installed
+except ImportError:
+	multiview_native = None
 import sys
 from os.path import expanduser
 caffe_root = expanduser("~")
 sys.path.insert(0, caffe_root + '/caffe/python')
 import caffe
 import os
+from classification_cache import ClassificationCache
+from classification_scheduler import ClassificationScheduler
 
 class classify_rot():
 	def __init__(self):
 		self.node_name = rospy.get_name()
 		rospy.loginfo("[%s] Initializing " %(self.node_name))
-		rospy.Subscriber('/obj_list', ObjectPoseList, self.call_back, queue_size = 1, buff_size = 2**24)
+		# batched: the cluster node renders every view into /cluster_tensor and
+		# the whole scan goes through the net in one forward pass
+		self.batched = rospy.get_param('~batched', False)
+		# labels of clusters tracked across scans are reused (see classification_cache.py)
+		self.cache = ClassificationCache()
+		# the rest is classified nearest / unclassified first within ~frame_budget
+		self.scheduler = ClassificationScheduler()
+		if self.batched:
+			sub_obj = message_filters.Subscriber('/obj_list', ObjectPoseList, queue_size = 1, buff_size = 2**24)
+			sub_tensor = message_filters.Subscriber('/cluster_tensor', numpy_msg(ClusterTensor), queue_size = 1, buff_size = 2**26)
+			ts = message_filters.TimeSynchronizer([sub_obj, sub_tensor], 10)
+			ts.registerCallback(self.batch_call_back)
+		else:
+			rospy.Subscriber('/obj_list', ObjectPoseList, self.call_back, queue_size = 1, buff_size = 2**24)
 		self.pub_obj = rospy.Publisher("/obj_list/classify", ObjectPoseList, queue_size = 1)
 		self.pub_marker = rospy.Publisher("/obj_classify", MarkerArray, queue_size = 1)
 		#rospy.Subscriber('/pcl_array', PoseArray, self.call_back)
@@ -70,11 +91,47 @@ class classify_rot():
 		self.net = caffe.Net(	self.model_def,        # defines the structure of the model
 								self.model_weights,    # contains the trained weights
 								caffe.TEST)
+		self.transformer = caffe.io.Transformer({'data': self.net.blobs['data'].data.shape})
+		self.transformer.set_transpose('data', (2, 0, 1))
+
+	def batch_call_back(self, obj_list, tensor):
+		cluster_num = obj_list.size
+		if tensor.n != cluster_num:
+			rospy.logwarn("[%s] %d views for %d clusters, skip" %(self.node_name, tensor.n, cluster_num))
+			return
+		cached = self.cache.begin(obj_list)
+		index = self.scheduler.plan(obj_list, cached, self.cache)
+		for i in range(cluster_num):
+			if cached[i] is not None:
+				obj_list.list[i].type = cached[i]
+		if len(index) > 0:
+			# only the clusters without a cached label that fit the budget go through the net
+			shape = (tensor.n, tensor.channels, tensor.height, tensor.width)
+			data = tensor.data.reshape(shape)[index]
+			caffe.set_device(0)
+			caffe.set_mode_gpu()
+			self.net.blobs['data'].reshape(*data.shape)
+			self.net.blobs['data'].data[...] = data
+			output = self.net.forward()
+			for k in range(len(index)):
+				i = index[k]
+				obj_list.list[i].type = self.label(output['prob'][k])
+				self.cache.store(i, obj_list.list[i].type)
+		self.scheduler.finish(obj_list, cached, set(index), self.cache)
+		self.pub_obj.publish(obj_list)
+		self.drawRviz(obj_list)
 
 	def call_back(self, msg):
 		obj_list = msg
 		cluster_num = obj_list.size
+		cached = self.cache.begin(obj_list)
 		for i in range(cluster_num):
+			if cached[i] is not None:
+				obj_list.list[i].type = cached[i]
+		classified = set()
+		for i in self.scheduler.plan(obj_list, cached, self.cache):
+			if not self.scheduler.has_time(len(classified)):
+				break
 			tf_points = PoseArray()
 			tf_points = obj_list.list[i].pcl_points
 			centroids = Point()
@@ -85,39 +142,58 @@ class classify_rot():
 			plane_xz = []
 			pcl_size = len(tf_points.poses)
 
-			# ======= Coordinate transform for better project performance ======
-			position = [0, 0, 0]
-			rad = math.atan2(centroids.y, centroids.x)
-			quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
-			transformer = tf.TransformerROS()
-			transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
-			for m in range(pcl_size):
-				new_x = tf_points.poses[m].position.x
-				new_y = tf_points.poses[m].position.y
-				new_z = tf_points.poses[m].position.z
-				orig_point = np.array([new_x, new_y, new_z, 1])
-				new_center = np.dot(transpose_matrix, orig_point)
-				tf_points.poses[m].position.x = new_center[0]
-				tf_points.poses[m].position.y = new_center[1]
-				tf_points.poses[m].position.z = new_center[2]
+			# ======= Views already rendered by the cluster node (~render_views) ======
+			if len(obj_list.list[i].views.data) > 0:
+				self.image = self.bridge.imgmsg_to_cv2(obj_list.list[i].views, "bgr8")
+			elif multiview_native is not None:
+				# ======= Same C++ renderer as the cluster node and classify_cpu ======
+				local = len(obj_list.list[i].pcl_points_local.poses) > 0
+				poses = obj_list.list[i].pcl_points_local.poses if local else tf_points.poses
+				points = np.array([[p.position.x, p.position.y, p.position.z] for p in poses], np.float64).reshape(-1, 3)
+				yaw = 0. if local else math.atan2(centroids.y, centroids.x)
+				self.image = multiview_native.render(points, yaw, int(self.height), self.boundary, self.point_size)
+			else:
+				# ======= Coordinate transform for better project performance ======
+				if len(obj_list.list[i].pcl_points_local.poses) > 0:
+					# already rotated by the cluster node (~local_frame)
+					tf_points = obj_list.list[i].pcl_points_local
+					pcl_size = len(tf_points.poses)
+				else:
+					position = [0, 0, 0]
+					rad = math.atan2(centroids.y, centroids.x)
+					quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
+					transformer = tf.TransformerROS()
+					transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
+					for m in range(pcl_size):
+						new_x = tf_points.poses[m].position.x
+						new_y = tf_points.poses[m].position.y
+						new_z = tf_points.poses[m].position.z
+						orig_point = np.array([new_x, new_y, new_z, 1])
+						new_center = np.dot(transpose_matrix, orig_point)
+						tf_points.poses[m].position.x = new_center[0]
+						tf_points.poses[m].position.y = new_center[1]
+						tf_points.poses[m].position.z = new_center[2]
 
-			# ======= project to XY, YZ, XZ plane =======
-			for j in range(pcl_size):
-				plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
-				plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
-				plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
-			self.toIMG(pcl_size, plane_xy, 'xy')
-			self.toIMG(pcl_size, plane_yz, 'yz')
-			self.toIMG(pcl_size, plane_xz, 'xz')
+				# ======= project to XY, YZ, XZ plane =======
+				for j in range(pcl_size):
+					plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
+					plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
+					plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
+				self.toIMG(pcl_size, plane_xy, 'xy')
+				self.toIMG(pcl_size, plane_yz, 'yz')
+				self.toIMG(pcl_size, plane_xz, 'xz')
 			model_type = self.classify()
 
 			# ***************************************************************
 			# Add to object list
 			# ***************************************************************
 			obj_list.list[i].type = model_type
+			self.cache.store(i, model_type)
+			classified.add(i)
 			#cv2.imwrite( "Image" + str(self.index) + ".jpg", self.image)
 			#self.index = self.index + 1
 			#print "Save image"
+		self.scheduler.finish(obj_list, cached, classified, self.cache)
 		self.pub_obj.publish(obj_list)
 		self.drawRviz(obj_list)
 
@@ -179,14 +255,14 @@ class classify_rot():
 		caffe.set_device(0)
 		caffe.set_mode_gpu()
 		t_start = time.clock()
-		transformer = caffe.io.Transformer({'data': self.net.blobs['data'].data.shape})
-		transformer.set_transpose('data', (2, 0, 1))
 		self.net.blobs['data'].reshape(1, 3, self.dim[0], self.dim[1])
-		self.net.blobs['data'].data[...] = transformer.preprocess('data', img)
+		self.net.blobs['data'].data[...] = self.transformer.preprocess('data', img)
 		output = self.net.forward()
-		output_prob = output['prob'][0]
-		output_max_class = output_prob.argmax()
 		#print "prediction time taken = ", time.clock() - t_start
+		return self.label(output['prob'][0])
+
+	def label(self, output_prob):
+		output_max_class = output_prob.argmax()
 		#print "Predict: ", self.labels[output_max_class]
 		#print output_prob[output_max_class]
 		if output_prob[output_max_class]<0.7:
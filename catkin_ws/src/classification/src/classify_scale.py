@@ -14,6 +14,10 @@ from visualization_msgs.msg import Marker, MarkerArray
 from robotx_msgs.msg import PCL_points, ObjectPose, ObjectPoseList
 import rospkg
 from cv_bridge import CvBridge, CvBridgeError
+try:
+	import multiview_native	# velodyne_perception, built when Boost.Python / Boost.NumPy are installed
+except ImportError:
+	multiview_native = None
 import sys
 import torch
 import torch.nn as nn
@@ -117,30 +121,37 @@ class classify():
 			plane_xz = []
 			pcl_size = len(tf_points.poses)
 
-			# ======= Coordinate transform for better project performance ======
-			position = [0, 0, 0]
-			rad = math.atan2(centroids.y, centroids.x)
-			quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
-			transformer = tf.TransformerROS()
-			transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
-			for m in range(pcl_size):
-				new_x = tf_points.poses[m].position.x
-				new_y = tf_points.poses[m].position.y
-				new_z = tf_points.poses[m].position.z
-				orig_point = np.array([new_x, new_y, new_z, 1])
-				new_center = np.dot(transpose_matrix, orig_point)
-				tf_points.poses[m].position.x = new_center[0]
-				tf_points.poses[m].position.y = new_center[1]
-				tf_points.poses[m].position.z = new_center[2]
+			if multiview_native is not None:
+				# ======= Same C++ renderer as the cluster node and classify_cpu ======
+				points = np.array([[p.position.x, p.position.y, p.position.z] for p in tf_points.poses], np.float64).reshape(-1, 3)
+				yaw = math.atan2(centroids.y, centroids.x)
+				self.image = multiview_native.render(points, yaw, int(self.height), self.boundary, self.point_size)
+				self.scale = list(multiview_native.scales(points, yaw, int(self.height), self.boundary))
+			else:
+				# ======= Coordinate transform for better project performance ======
+				position = [0, 0, 0]
+				rad = math.atan2(centroids.y, centroids.x)
+				quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
+				transformer = tf.TransformerROS()
+				transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
+				for m in range(pcl_size):
+					new_x = tf_points.poses[m].position.x
+					new_y = tf_points.poses[m].position.y
+					new_z = tf_points.poses[m].position.z
+					orig_point = np.array([new_x, new_y, new_z, 1])
+					new_center = np.dot(transpose_matrix, orig_point)
+					tf_points.poses[m].position.x = new_center[0]
+					tf_points.poses[m].position.y = new_center[1]
+					tf_points.poses[m].position.z = new_center[2]
 
-			# ======= project to XY, YZ, XZ plane =======
-			for j in range(pcl_size):
-				plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
-				plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
-				plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
-			self.toIMG(pcl_size, plane_xy, 'xy')
-			self.toIMG(pcl_size, plane_yz, 'yz')
-			self.toIMG(pcl_size, plane_xz, 'xz')
+				# ======= project to XY, YZ, XZ plane =======
+				for j in range(pcl_size):
+					plane_xy.append([tf_points.poses[j].position.x, tf_points.poses[j].position.y])
+					plane_yz.append([tf_points.poses[j].position.y, tf_points.poses[j].position.z])
+					plane_xz.append([tf_points.poses[j].position.x, tf_points.poses[j].position.z])
+				self.toIMG(pcl_size, plane_xy, 'xy')
+				self.toIMG(pcl_size, plane_yz, 'yz')
+				self.toIMG(pcl_size, plane_xz, 'xz')
 			model_type = self.classify()
 
 			# ***************************************************************
@@ -0,0 +1,600 @@
+/**********************************
+CPU Kernels
+  see cpu_kernels.h
+***********************************/
+#include <classification/cpu_kernels.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace classification
+{
+
+namespace
+{
+
+// register block of the GEMM micro-kernel, and the cache blocks around it
+const int kMr = 4;
+const int kNr = 8;
+const int kTileM = 64;
+const int kTileN = 128;
+const int kBlockK = 256;
+
+// acc (kMr x kNr) = ap (kc x kMr, packed) * bp (kc x kNr, packed)
+inline void microKernel(int kc, const float* ap, const float* bp, float* acc)
+{
+#ifdef __SSE2__
+  __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+  __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+  __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+  __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+  for (int k = 0; k < kc; k++, ap += kMr, bp += kNr)
+  {
+    __m128 b0 = _mm_loadu_ps(bp);
+    __m128 b1 = _mm_loadu_ps(bp + 4);
+    __m128 a = _mm_set1_ps(ap[0]);
+    c00 = _mm_add_ps(c00, _mm_mul_ps(a, b0));
+    c01 = _mm_add_ps(c01, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[1]);
+    c10 = _mm_add_ps(c10, _mm_mul_ps(a, b0));
+    c11 = _mm_add_ps(c11, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[2]);
+    c20 = _mm_add_ps(c20, _mm_mul_ps(a, b0));
+    c21 = _mm_add_ps(c21, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[3]);
+    c30 = _mm_add_ps(c30, _mm_mul_ps(a, b0));
+    c31 = _mm_add_ps(c31, _mm_mul_ps(a, b1));
+  }
+  _mm_storeu_ps(acc, c00);      _mm_storeu_ps(acc + 4, c01);
+  _mm_storeu_ps(acc + 8, c10);  _mm_storeu_ps(acc + 12, c11);
+  _mm_storeu_ps(acc + 16, c20); _mm_storeu_ps(acc + 20, c21);
+  _mm_storeu_ps(acc + 24, c30); _mm_storeu_ps(acc + 28, c31);
+#else
+  std::fill(acc, acc + kMr * kNr, 0.0f);
+  for (int k = 0; k < kc; k++, ap += kMr, bp += kNr)
+    for (int r = 0; r < kMr; r++)
+      for (int j = 0; j < kNr; j++)
+        acc[r * kNr + j] += ap[r] * bp[j];
+#endif
+}
+
+// one output tile [m0, m1) x [n0, n1) of gemm()
+void gemmTile(int N, int K, const float* A, const float* B, float* C,
+              int m0, int m1, int n0, int n1, float* bpack, float* apack)
+{
+  const int panels = (n1 - n0 + kNr - 1) / kNr;
+  float acc[kMr * kNr];
+  for (int kb = 0; kb < K; kb += kBlockK)
+  {
+    const int kc = std::min(kBlockK, K - kb);
+    // B block as kNr wide column panels, zero padded on the right
+    for (int p = 0; p < panels; p++)
+    {
+      float* dst = bpack + (size_t)p * kc * kNr;
+      const int c0 = n0 + p * kNr;
+      const int cols = std::min(kNr, n1 - c0);
+      for (int k = 0; k < kc; k++, dst += kNr)
+      {
+        const float* src = B + (size_t)(kb + k) * N + c0;
+        int j = 0;
+        for (; j < cols; j++)
+          dst[j] = src[j];
+        for (; j < kNr; j++)
+          dst[j] = 0;
+      }
+    }
+    for (int i = m0; i < m1; i += kMr)
+    {
+      const int rows = std::min(kMr, m1 - i);
+      for (int k = 0; k < kc; k++)
+        for (int r = 0; r < kMr; r++)
+          apack[k * kMr + r] = r < rows ? A[(size_t)(i + r) * K + kb + k] : 0.0f;
+      for (int p = 0; p < panels; p++)
+      {
+        microKernel(kc, apack, bpack + (size_t)p * kc * kNr, acc);
+        const int c0 = n0 + p * kNr;
+        const int cols = std::min(kNr, n1 - c0);
+        for (int r = 0; r < rows; r++)
+        {
+          float* c = C + (size_t)(i + r) * N + c0;
+          if (kb == 0)
+            for (int j = 0; j < cols; j++)
+              c[j] = acc[r * kNr + j];
+          else
+            for (int j = 0; j < cols; j++)
+              c[j] += acc[r * kNr + j];
+        }
+      }
+    }
+  }
+}
+
+// out[r] = dot(a + r*lda, b) for r < 4; rows past `rows` repeat row 0
+inline void dot4(const float* a, size_t lda, int rows, const float* b, int K, float* out)
+{
+  const float* a0 = a;
+  const float* a1 = rows > 1 ? a + lda : a;
+  const float* a2 = rows > 2 ? a + 2 * lda : a;
+  const float* a3 = rows > 3 ? a + 3 * lda : a;
+  int k = 0;
+#ifdef __SSE2__
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+  for (; k + 4 <= K; k += 4)
+  {
+    __m128 bv = _mm_loadu_ps(b + k);
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a0 + k), bv));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a1 + k), bv));
+    s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a2 + k), bv));
+    s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a3 + k), bv));
+  }
+  float t[16];
+  _mm_storeu_ps(t, s0);
+  _mm_storeu_ps(t + 4, s1);
+  _mm_storeu_ps(t + 8, s2);
+  _mm_storeu_ps(t + 12, s3);
+  for (int r = 0; r < 4; r++)
+    out[r] = t[4 * r] + t[4 * r + 1] + t[4 * r + 2] + t[4 * r + 3];
+#else
+  out[0] = out[1] = out[2] = out[3] = 0;
+#endif
+  for (; k < K; k++)
+  {
+    out[0] += a0[k] * b[k];
+    out[1] += a1[k] * b[k];
+    out[2] += a2[k] * b[k];
+    out[3] += a3[k] * b[k];
+  }
+}
+
+// ======= INT8 =======
+// acc (kMr x kNr) += ap (kc/2 pairs x kMr, two int16 per int32) * bp (kc/2 x kNr pairs)
+inline void microKernelS16(int pairs, const int32_t* ap, const int16_t* bp, int32_t* acc)
+{
+#ifdef __SSE2__
+  __m128i c00 = _mm_setzero_si128(), c01 = _mm_setzero_si128();
+  __m128i c10 = _mm_setzero_si128(), c11 = _mm_setzero_si128();
+  __m128i c20 = _mm_setzero_si128(), c21 = _mm_setzero_si128();
+  __m128i c30 = _mm_setzero_si128(), c31 = _mm_setzero_si128();
+  for (int p = 0; p < pairs; p++, ap += kMr, bp += 2 * kNr)
+  {
+    __m128i b0 = _mm_loadu_si128((const __m128i*)bp);
+    __m128i b1 = _mm_loadu_si128((const __m128i*)(bp + 8));
+    __m128i a = _mm_set1_epi32(ap[0]);
+    c00 = _mm_add_epi32(c00, _mm_madd_epi16(a, b0));
+    c01 = _mm_add_epi32(c01, _mm_madd_epi16(a, b1));
+    a = _mm_set1_epi32(ap[1]);
+    c10 = _mm_add_epi32(c10, _mm_madd_epi16(a, b0));
+    c11 = _mm_add_epi32(c11, _mm_madd_epi16(a, b1));
+    a = _mm_set1_epi32(ap[2]);
+    c20 = _mm_add_epi32(c20, _mm_madd_epi16(a, b0));
+    c21 = _mm_add_epi32(c21, _mm_madd_epi16(a, b1));
+    a = _mm_set1_epi32(ap[3]);
+    c30 = _mm_add_epi32(c30, _mm_madd_epi16(a, b0));
+    c31 = _mm_add_epi32(c31, _mm_madd_epi16(a, b1));
+  }
+  __m128i* out = (__m128i*)acc;
+  _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), c00));
+  _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), c01));
+  _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), c10));
+  _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), c11));
+  _mm_storeu_si128(out + 4, _mm_add_epi32(_mm_loadu_si128(out + 4), c20));
+  _mm_storeu_si128(out + 5, _mm_add_epi32(_mm_loadu_si128(out + 5), c21));
+  _mm_storeu_si128(out + 6, _mm_add_epi32(_mm_loadu_si128(out + 6), c30));
+  _mm_storeu_si128(out + 7, _mm_add_epi32(_mm_loadu_si128(out + 7), c31));
+#else
+  for (int p = 0; p < pairs; p++, ap += kMr, bp += 2 * kNr)
+    for (int r = 0; r < kMr; r++)
+    {
+      const int16_t* a = (const int16_t*)&ap[r];
+      for (int j = 0; j < kNr; j++)
+        acc[r * kNr + j] += a[0] * bp[2 * j] + a[1] * bp[2 * j + 1];
+    }
+#endif
+}
+
+// one output tile of gemmS16(), accumulated in acc (kTileM x kTileN)
+void gemmTileS16(int N, int K, const int16_t* A, const int16_t* B, int m0, int m1, int n0, int n1,
+                 int16_t* bpack, int32_t* apack, int32_t* acc)
+{
+  const int panels = (n1 - n0 + kNr - 1) / kNr;
+  std::fill(acc, acc + kTileM * kTileN, 0);
+  for (int kb = 0; kb < K; kb += kBlockK)
+  {
+    const int pairs = std::min(kBlockK, K - kb) / 2;
+    // B block as kNr wide column panels, k interleaved in pairs
+    for (int p = 0; p < panels; p++)
+    {
+      int16_t* dst = bpack + (size_t)p * pairs * 2 * kNr;
+      const int c0 = n0 + p * kNr;
+      const int cols = std::min(kNr, n1 - c0);
+      for (int k = 0; k < pairs; k++, dst += 2 * kNr)
+      {
+        const int16_t* r0 = B + (size_t)(kb + 2 * k) * N + c0;
+        const int16_t* r1 = r0 + N;
+        int j = 0;
+        for (; j < cols; j++)
+        {
+          dst[2 * j] = r0[j];
+          dst[2 * j + 1] = r1[j];
+        }
+        for (; j < kNr; j++)
+          dst[2 * j] = dst[2 * j + 1] = 0;
+      }
+    }
+    for (int i = m0; i < m1; i += kMr)
+    {
+      const int rows = std::min(kMr, m1 - i);
+      for (int k = 0; k < pairs; k++)
+        for (int r = 0; r < kMr; r++)
+        {
+          int16_t* pair = (int16_t*)&apack[k * kMr + r];
+          const int16_t* a = A + (size_t)(i + (r < rows ? r : 0)) * K + kb + 2 * k;
+          pair[0] = a[0];
+          pair[1] = a[1];
+        }
+      for (int p = 0; p < panels; p++)
+      {
+        int32_t block[kMr * kNr];
+        std::fill(block, block + kMr * kNr, 0);
+        microKernelS16(pairs, apack, bpack + (size_t)p * pairs * 2 * kNr, block);
+        const int cols = std::min(kNr, n1 - (n0 + p * kNr));
+        for (int r = 0; r < rows; r++)
+        {
+          int32_t* c = acc + (i - m0 + r) * kTileN + p * kNr;
+          for (int j = 0; j < cols; j++)
+            c[j] += block[r * kNr + j];
+        }
+      }
+    }
+  }
+}
+
+// out[r] = dot(a + r*lda, b) for r < 4 over int8; rows past `rows` repeat row 0
+inline void dot4S8(const int8_t* a, size_t lda, int rows, const int8_t* b, int K, int32_t* out)
+{
+  const int8_t* a0 = a;
+  const int8_t* a1 = rows > 1 ? a + lda : a;
+  const int8_t* a2 = rows > 2 ? a + 2 * lda : a;
+  const int8_t* a3 = rows > 3 ? a + 3 * lda : a;
+  int k = 0;
+  out[0] = out[1] = out[2] = out[3] = 0;
+#ifdef __SSE2__
+  __m128i s0 = _mm_setzero_si128(), s1 = _mm_setzero_si128();
+  __m128i s2 = _mm_setzero_si128(), s3 = _mm_setzero_si128();
+  for (; k + 16 <= K; k += 16)
+  {
+    // sign extend to int16: the byte in the high half, shifted back down
+    __m128i bv = _mm_loadu_si128((const __m128i*)(b + k));
+    __m128i b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(bv, bv), 8);
+    __m128i b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(bv, bv), 8);
+#define DOT4S8_ROW(s, row) \
+    { \
+      __m128i av = _mm_loadu_si128((const __m128i*)(row + k)); \
+      s = _mm_add_epi32(s, _mm_madd_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(av, av), 8), b_lo)); \
+      s = _mm_add_epi32(s, _mm_madd_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(av, av), 8), b_hi)); \
+    }
+    DOT4S8_ROW(s0, a0)
+    DOT4S8_ROW(s1, a1)
+    DOT4S8_ROW(s2, a2)
+    DOT4S8_ROW(s3, a3)
+#undef DOT4S8_ROW
+  }
+  int32_t t[16];
+  _mm_storeu_si128((__m128i*)t, s0);
+  _mm_storeu_si128((__m128i*)(t + 4), s1);
+  _mm_storeu_si128((__m128i*)(t + 8), s2);
+  _mm_storeu_si128((__m128i*)(t + 12), s3);
+  for (int r = 0; r < 4; r++)
+    out[r] = t[4 * r] + t[4 * r + 1] + t[4 * r + 2] + t[4 * r + 3];
+#endif
+  for (; k < K; k++)
+  {
+    out[0] += a0[k] * b[k];
+    out[1] += a1[k] * b[k];
+    out[2] += a2[k] * b[k];
+    out[3] += a3[k] * b[k];
+  }
+}
+
+// q = round(x / scale) clamped to +-127, nearest even like cvtps2dq
+template <typename Q>
+void quantizeTail(const float* x, size_t n, float inv, Q* q)
+{
+  for (size_t i = 0; i < n; i++)
+    q[i] = (Q)std::lrint(std::max(-127.0f, std::min(127.0f, x[i] * inv)));
+}
+
+#ifdef __SSE2__
+// 8 values as int16
+inline __m128i quantize8(const float* x, __m128 inv)
+{
+  const __m128 hi = _mm_set1_ps(127.0f), lo = _mm_set1_ps(-127.0f);
+  __m128 a = _mm_max_ps(lo, _mm_min_ps(hi, _mm_mul_ps(_mm_loadu_ps(x), inv)));
+  __m128 b = _mm_max_ps(lo, _mm_min_ps(hi, _mm_mul_ps(_mm_loadu_ps(x + 4), inv)));
+  return _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+}
+#endif
+
+} // namespace
+
+void gemm(int M, int N, int K, const float* A, const float* B, const float* bias,
+          float* C, TaskPool& pool)
+{
+  const int tiles_m = (M + kTileM - 1) / kTileM;
+  const int tiles_n = (N + kTileN - 1) / kTileN;
+  pool.parallelFor(tiles_m * tiles_n, [&](size_t t)
+  {
+    // packing buffers are per thread, tasks of one thread never overlap
+    static thread_local std::vector<float> bpack;
+    static thread_local std::vector<float> apack;
+    bpack.resize((size_t)kBlockK * kTileN);
+    apack.resize((size_t)kBlockK * kMr);
+    const int m0 = (t / tiles_n) * kTileM;
+    const int n0 = (t % tiles_n) * kTileN;
+    const int m1 = std::min(M, m0 + kTileM);
+    const int n1 = std::min(N, n0 + kTileN);
+    if (K == 0)
+    {
+      for (int i = m0; i < m1; i++)
+        std::fill(C + (size_t)i * N + n0, C + (size_t)i * N + n1, 0.0f);
+    }
+    else
+      gemmTile(N, K, A, B, C, m0, m1, n0, n1, &bpack[0], &apack[0]);
+    if (bias)
+      for (int i = m0; i < m1; i++)
+      {
+        float* c = C + (size_t)i * N;
+        for (int j = n0; j < n1; j++)
+          c[j] += bias[i];
+      }
+  });
+}
+
+void gemmTransB(int M, int N, int K, const float* A, const float* B, const float* bias,
+                float* C, TaskPool& pool)
+{
+  // each task streams 16 weight rows once for the whole batch
+  const int chunk = 16;
+  const int tasks = (N + chunk - 1) / chunk;
+  pool.parallelFor(tasks, [&](size_t t)
+  {
+    const int j1 = std::min(N, (int)(t + 1) * chunk);
+    for (int j = t * chunk; j < j1; j++)
+    {
+      const float* b = B + (size_t)j * K;
+      const float bj = bias ? bias[j] : 0.0f;
+      for (int i = 0; i < M; i += 4)
+      {
+        float out[4];
+        const int rows = std::min(4, M - i);
+        dot4(A + (size_t)i * K, K, rows, b, K, out);
+        for (int r = 0; r < rows; r++)
+          C[(size_t)(i + r) * N + j] = out[r] + bj;
+      }
+    }
+  });
+}
+
+void im2col(const float* im, int channels, int height, int width,
+            int kh, int kw, int ph, int pw, int sh, int sw, float* col)
+{
+  const int out_h = (height + 2 * ph - kh) / sh + 1;
+  const int out_w = (width + 2 * pw - kw) / sw + 1;
+  for (int c = 0; c < channels; c++)
+    for (int ki = 0; ki < kh; ki++)
+      for (int kj = 0; kj < kw; kj++)
+      {
+        const float* plane = im + (size_t)c * height * width;
+        for (int oh = 0; oh < out_h; oh++, col += out_w)
+        {
+          const int ih = oh * sh - ph + ki;
+          if (ih < 0 || ih >= height)
+          {
+            std::memset(col, 0, sizeof(float) * out_w);
+            continue;
+          }
+          const float* row = plane + (size_t)ih * width;
+          for (int ow = 0; ow < out_w; ow++)
+          {
+            const int iw = ow * sw - pw + kj;
+            col[ow] = (iw >= 0 && iw < width) ? row[iw] : 0.0f;
+          }
+        }
+      }
+}
+
+void maxPool(const float* in, int height, int width, int kh, int kw, int ph, int pw,
+             int sh, int sw, int out_h, int out_w, float* out)
+{
+  for (int oh = 0; oh < out_h; oh++)
+  {
+    const int h0 = std::max(oh * sh - ph, 0);
+    const int h1 = std::min(oh * sh - ph + kh, height);
+    for (int ow = 0; ow < out_w; ow++)
+    {
+      const int w0 = std::max(ow * sw - pw, 0);
+      const int w1 = std::min(ow * sw - pw + kw, width);
+      float m = -FLT_MAX;
+      for (int h = h0; h < h1; h++)
+        for (int w = w0; w < w1; w++)
+          m = std::max(m, in[h * width + w]);
+      out[oh * out_w + ow] = m;
+    }
+  }
+}
+
+void avePool(const float* in, int height, int width, int kh, int kw, int ph, int pw,
+             int sh, int sw, int out_h, int out_w, float* out)
+{
+  for (int oh = 0; oh < out_h; oh++)
+  {
+    int h0 = oh * sh - ph;
+    int h1 = std::min(h0 + kh, height + ph);
+    const int pool_h = h1 - h0;
+    h0 = std::max(h0, 0);
+    h1 = std::min(h1, height);
+    for (int ow = 0; ow < out_w; ow++)
+    {
+      int w0 = ow * sw - pw;
+      int w1 = std::min(w0 + kw, width + pw);
+      // Caffe divides by the window clipped to the padded image
+      const int pool_size = pool_h * (w1 - w0);
+      w0 = std::max(w0, 0);
+      w1 = std::min(w1, width);
+      float s = 0;
+      for (int h = h0; h < h1; h++)
+        for (int w = w0; w < w1; w++)
+          s += in[h * width + w];
+      out[oh * out_w + ow] = s / pool_size;
+    }
+  }
+}
+
+void lrnAcrossChannels(const float* in, int channels, int spatial, int size,
+                       float alpha, float beta, float k, float* out)
+{
+  const int pre = (size - 1) / 2;
+  const float alpha_over_size = alpha / size;
+  // running sum of squares over channels [c - pre, c + size - 1 - pre]
+  std::vector<float> sum(spatial, 0.0f);
+  for (int c = 0; c < std::min(size - pre, channels); c++)
+  {
+    const float* x = in + (size_t)c * spatial;
+    for (int i = 0; i < spatial; i++)
+      sum[i] += x[i] * x[i];
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    const float* x = in + (size_t)c * spatial;
+    float* y = out + (size_t)c * spatial;
+    for (int i = 0; i < spatial; i++)
+      y[i] = x[i] * std::pow(k + alpha_over_size * sum[i], -beta);
+    const int add = c + size - pre;
+    const int remove = c - pre;
+    if (add < channels)
+    {
+      const float* a = in + (size_t)add * spatial;
+      for (int i = 0; i < spatial; i++)
+        sum[i] += a[i] * a[i];
+    }
+    if (remove >= 0)
+    {
+      const float* r = in + (size_t)remove * spatial;
+      for (int i = 0; i < spatial; i++)
+        sum[i] -= r[i] * r[i];
+    }
+  }
+}
+
+void relu(float* data, size_t n, float negative_slope)
+{
+  for (size_t i = 0; i < n; i++)
+    if (data[i] < 0)
+      data[i] *= negative_slope;
+}
+
+void softmax(float* data, int channels, int spatial)
+{
+  for (int i = 0; i < spatial; i++)
+  {
+    float m = -FLT_MAX;
+    for (int c = 0; c < channels; c++)
+      m = std::max(m, data[(size_t)c * spatial + i]);
+    float s = 0;
+    for (int c = 0; c < channels; c++)
+    {
+      float& v = data[(size_t)c * spatial + i];
+      v = std::exp(v - m);
+      s += v;
+    }
+    for (int c = 0; c < channels; c++)
+      data[(size_t)c * spatial + i] /= s;
+  }
+}
+
+//========== INT8 ==========
+void quantize(const float* x, size_t n, float scale, int8_t* q)
+{
+  const float inv = scale > 0 ? 1.0f / scale : 0.0f;
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128 v = _mm_set1_ps(inv);
+  for (; i + 16 <= n; i += 16)
+    _mm_storeu_si128((__m128i*)(q + i), _mm_packs_epi16(quantize8(x + i, v), quantize8(x + i + 8, v)));
+#endif
+  quantizeTail(x + i, n - i, inv, q + i);
+}
+
+void quantize(const float* x, size_t n, float scale, int16_t* q)
+{
+  const float inv = scale > 0 ? 1.0f / scale : 0.0f;
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128 v = _mm_set1_ps(inv);
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i*)(q + i), quantize8(x + i, v));
+#endif
+  quantizeTail(x + i, n - i, inv, q + i);
+}
+
+void gemmS16(int M, int N, int K, const int16_t* A, const int16_t* B, const float* row_scale,
+             const float* bias, float* C, TaskPool& pool)
+{
+  const int tiles_m = (M + kTileM - 1) / kTileM;
+  const int tiles_n = (N + kTileN - 1) / kTileN;
+  pool.parallelFor(tiles_m * tiles_n, [&](size_t t)
+  {
+    static thread_local std::vector<int16_t> bpack;
+    static thread_local std::vector<int32_t> apack;
+    static thread_local std::vector<int32_t> acc;
+    bpack.resize((size_t)kBlockK * kTileN);
+    apack.resize((size_t)kBlockK / 2 * kMr);
+    acc.resize((size_t)kTileM * kTileN);
+    const int m0 = (t / tiles_n) * kTileM;
+    const int n0 = (t % tiles_n) * kTileN;
+    const int m1 = std::min(M, m0 + kTileM);
+    const int n1 = std::min(N, n0 + kTileN);
+    gemmTileS16(N, K, A, B, m0, m1, n0, n1, &bpack[0], &apack[0], &acc[0]);
+    for (int i = m0; i < m1; i++)
+    {
+      const int32_t* a = &acc[(i - m0) * kTileN];
+      float* c = C + (size_t)i * N;
+      const float b = bias ? bias[i] : 0.0f;
+      for (int j = n0; j < n1; j++)
+        c[j] = a[j - n0] * row_scale[i] + b;
+    }
+  });
+}
+
+void gemmTransBS8(int M, int N, int K, const int8_t* A, const int8_t* B, const float* col_scale,
+                  const float* bias, float* C, TaskPool& pool)
+{
+  const int chunk = 16;
+  const int tasks = (N + chunk - 1) / chunk;
+  pool.parallelFor(tasks, [&](size_t t)
+  {
+    const int j1 = std::min(N, (int)(t + 1) * chunk);
+    for (int j = t * chunk; j < j1; j++)
+    {
+      const int8_t* b = B + (size_t)j * K;
+      const float bj = bias ? bias[j] : 0.0f;
+      for (int i = 0; i < M; i += 4)
+      {
+        int32_t out[4];
+        const int rows = std::min(4, M - i);
+        dot4S8(A + (size_t)i * K, K, rows, b, K, out);
+        for (int r = 0; r < rows; r++)
+          C[(size_t)(i + r) * N + j] = out[r] * col_scale[j] + bj;
+      }
+    }
+  });
+}
+
+} // namespace classification
@@ -0,0 +1,656 @@
+/**********************************
+CPU Net
+  see cpu_net.h
+***********************************/
+#include <classification/cpu_net.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace classification
+{
+
+//========== Blob ==========
+size_t Blob::count() const
+{
+  return count(0);
+}
+
+size_t Blob::count(size_t axis) const
+{
+  size_t n = 1;
+  for (size_t i = axis; i < shape.size(); i++)
+    n *= shape[i];
+  return n;
+}
+
+void Blob::reshape(const std::vector<int>& new_shape)
+{
+  shape = new_shape;
+  data.resize(count());
+}
+
+namespace
+{
+
+// kernel_size / pad / stride may be given once, per axis, or as _h/_w
+int spatialParam(const TextMessage& p, const std::string& key, const std::string& axis, int fallback)
+{
+  if (p.has(key + "_" + axis))
+    return (int)p.getNumber(key + "_" + axis, fallback);
+  std::vector<std::string> all = p.getAll(key);
+  if (all.empty())
+    return fallback;
+  if (axis == "w" && all.size() > 1)
+    return std::atoi(all[1].c_str());
+  return std::atoi(all[0].c_str());
+}
+
+bool fail(std::string* error, const std::string& msg)
+{
+  if (error)
+    *error = msg;
+  return false;
+}
+
+} // namespace
+
+//========== CpuNet ==========
+CpuNet::CpuNet(int threads)
+  : batch_(0), int8_(false), pool_(new TaskPool(threads))
+{
+}
+
+CpuNet::CpuNet(const std::shared_ptr<TaskPool>& pool)
+  : batch_(0), int8_(false), pool_(pool)
+{
+}
+
+bool CpuNet::load(const std::string& prototxt, const std::string& caffemodel, std::string* error)
+{
+  layers_.clear();
+  blobs_.clear();
+  blob_index_.clear();
+  input_shape_.clear();
+  batch_ = 0;
+  int8_ = false;
+
+  TextMessage net;
+  if (!readTextProto(prototxt, net, error))
+    return false;
+  LayerBlobs weights;
+  if (!readCaffemodel(caffemodel, weights, error))
+    return false;
+
+  // deploy nets of the old style declare the input at the top level
+  if (net.has("input"))
+  {
+    Layer layer = Layer();
+    layer.type = INPUT;
+    layer.name = net.get("input");
+    layer.bottom = -1;
+    layer.top = blobIndex(layer.name);
+    const TextMessage* shape = net.message("input_shape");
+    std::vector<std::string> dims = shape ? shape->getAll("dim") : net.getAll("input_dim");
+    for (size_t i = 0; i < dims.size(); i++)
+      input_shape_.push_back(std::atoi(dims[i].c_str()));
+    layers_.push_back(layer);
+  }
+  std::vector<const TextMessage*> defs = net.messagesNamed("layer");
+  if (defs.empty())
+    return fail(error, prototxt + " has no `layer` entries (V1 `layers` nets are not supported)");
+  for (size_t i = 0; i < defs.size(); i++)
+    if (!addLayer(*defs[i], weights, error))
+      return false;
+  if (layers_[0].type != INPUT || input_shape_.size() != 4)
+    return fail(error, prototxt + " needs a 4-d input as its first layer");
+  reshape(1);
+
+  // weights against the shapes they are applied to
+  for (size_t i = 0; i < layers_.size(); i++)
+  {
+    const Layer& layer = layers_[i];
+    if (layer.type == INPUT)
+      continue;
+    const Blob& bottom = blobs_[layer.bottom];
+    size_t expected = 0;
+    if (layer.type == CONVOLUTION)
+    {
+      if (bottom.dim(1) % layer.group)
+        return fail(error, "layer " + layer.name + ": channels not divisible by group");
+      expected = (size_t)layer.num_output * (bottom.dim(1) / layer.group) * layer.kernel_h * layer.kernel_w;
+    }
+    else if (layer.type == INNER_PRODUCT)
+      expected = (size_t)layer.num_output * bottom.count(1);
+    else if (layer.type == LRN && layer.top == layer.bottom)
+      return fail(error, "layer " + layer.name + ": in-place LRN is not supported");
+    if (expected && layer.weights.count() != expected)
+    {
+      std::ostringstream ss;
+      ss << "layer " << layer.name << ": " << layer.weights.count() << " weights, expected " << expected;
+      return fail(error, ss.str());
+    }
+  }
+  return true;
+}
+
+int CpuNet::blobIndex(const std::string& name)
+{
+  std::map<std::string, int>::const_iterator it = blob_index_.find(name);
+  if (it != blob_index_.end())
+    return it->second;
+  blobs_.push_back(Blob());
+  blob_index_[name] = blobs_.size() - 1;
+  return blobs_.size() - 1;
+}
+
+const Blob* CpuNet::blob(const std::string& name) const
+{
+  std::map<std::string, int>::const_iterator it = blob_index_.find(name);
+  return it == blob_index_.end() ? NULL : &blobs_[it->second];
+}
+
+bool CpuNet::addLayer(const TextMessage& def, const LayerBlobs& weights, std::string* error)
+{
+  static const TextMessage kEmpty;
+  Layer layer = Layer();
+  layer.name = def.get("name");
+  const std::string type = def.get("type");
+  std::vector<std::string> bottoms = def.getAll("bottom");
+  std::vector<std::string> tops = def.getAll("top");
+  if (bottoms.size() > 1 || tops.size() != 1)
+    return fail(error, "layer " + layer.name + ": only single bottom/top layers are supported");
+  layer.bottom = bottoms.empty() ? -1 : blobIndex(bottoms[0]);
+  layer.top = blobIndex(tops[0]);
+
+  if (type == "Input")
+  {
+    layer.type = INPUT;
+    const TextMessage* p = def.message("input_param");
+    const TextMessage* shape = p ? p->message("shape") : NULL;
+    if (!shape)
+      return fail(error, "layer " + layer.name + ": Input without input_param.shape");
+    std::vector<std::string> dims = shape->getAll("dim");
+    input_shape_.clear();
+    for (size_t i = 0; i < dims.size(); i++)
+      input_shape_.push_back(std::atoi(dims[i].c_str()));
+  }
+  else if (type == "Convolution")
+  {
+    layer.type = CONVOLUTION;
+    const TextMessage* found = def.message("convolution_param");
+    const TextMessage& p = found ? *found : kEmpty;
+    layer.num_output = (int)p.getNumber("num_output", 0);
+    layer.kernel_h = spatialParam(p, "kernel_size", "h", 0);
+    layer.kernel_w = spatialParam(p, "kernel_size", "w", 0);
+    layer.pad_h = spatialParam(p, "pad", "h", 0);
+    layer.pad_w = spatialParam(p, "pad", "w", 0);
+    layer.stride_h = spatialParam(p, "stride", "h", 1);
+    layer.stride_w = spatialParam(p, "stride", "w", 1);
+    layer.group = (int)p.getNumber("group", 1);
+    layer.bias_term = p.get("bias_term", "true") == "true";
+    if (p.getNumber("dilation", 1) != 1)
+      return fail(error, "layer " + layer.name + ": dilated convolution is not supported");
+    if (layer.num_output <= 0 || layer.kernel_h <= 0 || layer.kernel_w <= 0 ||
+        layer.group <= 0 || layer.num_output % layer.group)
+      return fail(error, "layer " + layer.name + ": bad convolution_param");
+  }
+  else if (type == "ReLU")
+  {
+    layer.type = RELU;
+    const TextMessage* p = def.message("relu_param");
+    layer.negative_slope = p ? p->getNumber("negative_slope", 0) : 0;
+  }
+  else if (type == "Pooling")
+  {
+    layer.type = POOLING;
+    const TextMessage* found = def.message("pooling_param");
+    const TextMessage& p = found ? *found : kEmpty;
+    const std::string pool = p.get("pool", "MAX");
+    if (pool != "MAX" && pool != "AVE")
+      return fail(error, "layer " + layer.name + ": " + pool + " pooling is not supported");
+    layer.max_pool = pool == "MAX";
+    layer.global_pooling = p.get("global_pooling", "false") == "true";
+    layer.kernel_h = spatialParam(p, "kernel_size", "h", 0);
+    layer.kernel_w = spatialParam(p, "kernel_size", "w", 0);
+    layer.pad_h = spatialParam(p, "pad", "h", 0);
+    layer.pad_w = spatialParam(p, "pad", "w", 0);
+    layer.stride_h = spatialParam(p, "stride", "h", 1);
+    layer.stride_w = spatialParam(p, "stride", "w", 1);
+  }
+  else if (type == "LRN")
+  {
+    layer.type = LRN;
+    const TextMessage* found = def.message("lrn_param");
+    const TextMessage& p = found ? *found : kEmpty;
+    if (p.get("norm_region", "ACROSS_CHANNELS") != "ACROSS_CHANNELS")
+      return fail(error, "layer " + layer.name + ": only ACROSS_CHANNELS LRN is supported");
+    layer.local_size = (int)p.getNumber("local_size", 5);
+    layer.alpha = p.getNumber("alpha", 1);
+    layer.beta = p.getNumber("beta", 0.75);
+    layer.k = p.getNumber("k", 1);
+  }
+  else if (type == "InnerProduct")
+  {
+    layer.type = INNER_PRODUCT;
+    const TextMessage* found = def.message("inner_product_param");
+    const TextMessage& p = found ? *found : kEmpty;
+    layer.num_output = (int)p.getNumber("num_output", 0);
+    layer.bias_term = p.get("bias_term", "true") == "true";
+    if (p.get("transpose", "false") == "true" || p.getNumber("axis", 1) != 1)
+      return fail(error, "layer " + layer.name + ": transposed or non axis-1 InnerProduct is not supported");
+  }
+  else if (type == "Dropout")
+    layer.type = DROPOUT;   // identity at test time
+  else if (type == "Softmax")
+  {
+    layer.type = SOFTMAX;
+    const TextMessage* p = def.message("softmax_param");
+    if (p && p->getNumber("axis", 1) != 1)
+      return fail(error, "layer " + layer.name + ": Softmax only over axis 1");
+  }
+  else
+    return fail(error, "layer " + layer.name + ": type " + type + " is not supported");
+
+  if (layer.type != INPUT && layer.bottom < 0)
+    return fail(error, "layer " + layer.name + " has no bottom");
+  if ((layer.type == CONVOLUTION || layer.type == INNER_PRODUCT) && !setWeights(layer, weights, error))
+    return false;
+  layers_.push_back(layer);
+  return true;
+}
+
+bool CpuNet::setWeights(Layer& layer, const LayerBlobs& weights, std::string* error)
+{
+  LayerBlobs::const_iterator it = weights.find(layer.name);
+  size_t expected = layer.bias_term ? 2 : 1;
+  if (it == weights.end() || it->second.size() < expected)
+    return fail(error, "layer " + layer.name + ": no weights in the caffemodel");
+  const std::vector<BlobData>& blobs = it->second;
+  layer.weights.reshape(blobs[0].shape);
+  layer.weights.data = blobs[0].data;
+  if (layer.weights.data.size() != layer.weights.count() || (int)layer.weights.dim(0) != layer.num_output)
+    return fail(error, "layer " + layer.name + ": weight shape does not match num_output");
+  if (layer.bias_term)
+  {
+    layer.bias.reshape(std::vector<int>(1, layer.num_output));
+    if (blobs[1].data.size() != (size_t)layer.num_output)
+      return fail(error, "layer " + layer.name + ": bias size does not match num_output");
+    layer.bias.data = blobs[1].data;
+  }
+  return true;
+}
+
+// Propagate the shapes for a new batch size; checks the weights against
+// the bottoms the first time through
+void CpuNet::reshape(int batch)
+{
+  batch_ = batch;
+  size_t col_size = 0;
+  for (size_t i = 0; i < layers_.size(); i++)
+  {
+    const Layer& layer = layers_[i];
+    Blob& top = blobs_[layer.top];
+    if (layer.type == INPUT)
+    {
+      std::vector<int> shape = input_shape_;
+      shape[0] = batch;
+      top.reshape(shape);
+      continue;
+    }
+    const Blob& bottom = blobs_[layer.bottom];
+    std::vector<int> shape(4, 1);
+    shape[0] = batch;
+    switch (layer.type)
+    {
+      case CONVOLUTION:
+      {
+        shape[1] = layer.num_output;
+        shape[2] = (bottom.dim(2) + 2 * layer.pad_h - layer.kernel_h) / layer.stride_h + 1;
+        shape[3] = (bottom.dim(3) + 2 * layer.pad_w - layer.kernel_w) / layer.stride_w + 1;
+        col_size = std::max(col_size, (size_t)bottom.dim(1) * layer.kernel_h * layer.kernel_w * shape[2] * shape[3]);
+        break;
+      }
+      case POOLING:
+      {
+        int kh = layer.global_pooling ? bottom.dim(2) : layer.kernel_h;
+        int kw = layer.global_pooling ? bottom.dim(3) : layer.kernel_w;
+        shape[1] = bottom.dim(1);
+        // Caffe rounds pooled sizes up and drops a last window that starts in the padding
+        shape[2] = (int)std::ceil((float)(bottom.dim(2) + 2 * layer.pad_h - kh) / layer.stride_h) + 1;
+        shape[3] = (int)std::ceil((float)(bottom.dim(3) + 2 * layer.pad_w - kw) / layer.stride_w) + 1;
+        if (layer.pad_h && (shape[2] - 1) * layer.stride_h >= bottom.dim(2) + layer.pad_h)
+          shape[2]--;
+        if (layer.pad_w && (shape[3] - 1) * layer.stride_w >= bottom.dim(3) + layer.pad_w)
+          shape[3]--;
+        break;
+      }
+      case INNER_PRODUCT:
+        shape.resize(2);
+        shape[1] = layer.num_output;
+        break;
+      default:
+        shape = bottom.shape;
+        shape[0] = batch;
+    }
+    if (layer.top != layer.bottom)
+      top.reshape(shape);
+  }
+  col_.resize(col_size);
+}
+
+const Blob& CpuNet::forward(const float* input, int batch)
+{
+  return forward(input, batch, inputSize());
+}
+
+const Blob& CpuNet::forward(const float* input, int batch, size_t stride)
+{
+  if (batch != batch_)
+    reshape(batch);
+  Blob& data = blobs_[layers_[0].top];
+  const size_t image = inputSize();
+  if (stride == image)
+    std::memcpy(&data.data[0], input, sizeof(float) * data.count());
+  else
+    for (int i = 0; i < batch; i++)
+      std::memcpy(&data.data[i * image], input + i * stride, sizeof(float) * image);
+  for (size_t i = 1; i < layers_.size(); i++)
+    forwardLayer(layers_[i]);
+  return blobs_[layers_.back().top];
+}
+
+void CpuNet::forwardLayer(const Layer& layer)
+{
+  Blob& bottom = blobs_[layer.bottom];
+  Blob& top = blobs_[layer.top];
+  const int batch = bottom.dim(0);
+  switch (layer.type)
+  {
+    case CONVOLUTION:
+      if (int8_ && layer.quantized)
+        convolutionInt8(layer, bottom, top);
+      else
+        convolution(layer, bottom, top);
+      break;
+    case RELU:
+    {
+      if (&top != &bottom)
+        top.data = bottom.data;
+      const size_t n = top.count();
+      const size_t chunk = 1 << 16;
+      float* data = &top.data[0];
+      pool_->parallelFor((n + chunk - 1) / chunk, [&](size_t t)
+      {
+        relu(data + t * chunk, std::min(chunk, n - t * chunk), layer.negative_slope);
+      });
+      break;
+    }
+    case POOLING:
+    {
+      const int channels = bottom.dim(1);
+      const int h = bottom.dim(2), w = bottom.dim(3);
+      const int kh = layer.global_pooling ? h : layer.kernel_h;
+      const int kw = layer.global_pooling ? w : layer.kernel_w;
+      const int out_h = top.dim(2), out_w = top.dim(3);
+      pool_->parallelFor((size_t)batch * channels, [&](size_t c)
+      {
+        const float* in = &bottom.data[c * h * w];
+        float* out = &top.data[c * out_h * out_w];
+        if (layer.max_pool)
+          maxPool(in, h, w, kh, kw, layer.pad_h, layer.pad_w, layer.stride_h, layer.stride_w, out_h, out_w, out);
+        else
+          avePool(in, h, w, kh, kw, layer.pad_h, layer.pad_w, layer.stride_h, layer.stride_w, out_h, out_w, out);
+      });
+      break;
+    }
+    case LRN:
+    {
+      const size_t image = bottom.count(1);
+      const int spatial = bottom.count(2);
+      pool_->parallelFor(batch, [&](size_t b)
+      {
+        lrnAcrossChannels(&bottom.data[b * image], bottom.dim(1), spatial, layer.local_size,
+                          layer.alpha, layer.beta, layer.k, &top.data[b * image]);
+      });
+      break;
+    }
+    case INNER_PRODUCT:
+      if (int8_ && layer.quantized)
+      {
+        innerProductInt8(layer, bottom, top);
+        break;
+      }
+      gemmTransB(batch, layer.num_output, bottom.count(1), &bottom.data[0], &layer.weights.data[0],
+                 layer.bias_term ? &layer.bias.data[0] : NULL, &top.data[0], *pool_);
+      break;
+    case DROPOUT:
+      if (&top != &bottom)
+        top.data = bottom.data;
+      break;
+    case SOFTMAX:
+    {
+      if (&top != &bottom)
+        top.data = bottom.data;
+      const size_t image = top.count(1);
+      for (int b = 0; b < batch; b++)
+        softmax(&top.data[b * image], top.dim(1), top.count(2));
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void CpuNet::convolution(const Layer& layer, const Blob& bottom, Blob& top)
+{
+  const int channels = bottom.dim(1);
+  const int h = bottom.dim(2), w = bottom.dim(3);
+  const int out_c = top.dim(1);
+  const int out_hw = top.dim(2) * top.dim(3);
+  const int kernel = layer.kernel_h * layer.kernel_w;
+  const int group_in = channels / layer.group;
+  const int group_out = out_c / layer.group;
+  const int K = group_in * kernel;
+  for (int b = 0; b < bottom.dim(0); b++)
+  {
+    const float* im = &bottom.data[(size_t)b * channels * h * w];
+    float* col = &col_[0];
+    // rows of col are channel major, so group g is rows [g*K, (g+1)*K)
+    pool_->parallelFor(channels, [&](size_t c)
+    {
+      im2col(im + c * h * w, 1, h, w, layer.kernel_h, layer.kernel_w, layer.pad_h, layer.pad_w,
+             layer.stride_h, layer.stride_w, col + c * kernel * out_hw);
+    });
+    for (int g = 0; g < layer.group; g++)
+    {
+      gemm(group_out, out_hw, K,
+           &layer.weights.data[(size_t)g * group_out * K],
+           col + (size_t)g * K * out_hw,
+           layer.bias_term ? &layer.bias.data[g * group_out] : NULL,
+           &top.data[((size_t)b * out_c + g * group_out) * out_hw], *pool_);
+    }
+  }
+}
+
+//========== INT8 ==========
+std::vector<std::pair<std::string, std::string> > CpuNet::quantizableLayers() const
+{
+  std::vector<std::pair<std::string, std::string> > out;
+  for (size_t i = 0; i < layers_.size(); i++)
+  {
+    const Layer& layer = layers_[i];
+    if (layer.type != CONVOLUTION && layer.type != INNER_PRODUCT)
+      continue;
+    std::map<std::string, int>::const_iterator it = blob_index_.begin();
+    while (it != blob_index_.end() && it->second != layer.bottom)
+      ++it;
+    out.push_back(std::make_pair(layer.name, it == blob_index_.end() ? std::string() : it->first));
+  }
+  return out;
+}
+
+bool CpuNet::setInt8(const std::map<std::string, float>& max_abs, std::string* error)
+{
+  setFloat();
+  for (std::map<std::string, float>::const_iterator it = max_abs.begin(); it != max_abs.end(); ++it)
+  {
+    size_t i = 0;
+    while (i < layers_.size() && layers_[i].name != it->first)
+      i++;
+    if (i == layers_.size() || (layers_[i].type != CONVOLUTION && layers_[i].type != INNER_PRODUCT))
+      return fail(error, "int8 table: " + it->first + " is not a Convolution or InnerProduct layer");
+    if (!(it->second > 0))
+      return fail(error, "int8 table: " + it->first + " has no positive range");
+  }
+  for (size_t i = 0; i < layers_.size(); i++)
+  {
+    Layer& layer = layers_[i];
+    std::map<std::string, float>::const_iterator range = max_abs.find(layer.name);
+    if (range == max_abs.end())
+      continue;
+    const int rows = layer.num_output;
+    const int K = layer.weights.count(1);
+    layer.in_scale = range->second / 127;
+    layer.K_pad = K + (K & 1);
+    layer.out_scale.resize(rows);
+    if (layer.type == CONVOLUTION)
+      layer.weights_s16.assign((size_t)rows * layer.K_pad, 0);
+    else
+      layer.weights_s8.resize((size_t)rows * K);
+    for (int m = 0; m < rows; m++)
+    {
+      const float* w = &layer.weights.data[(size_t)m * K];
+      float w_max = 0;
+      for (int k = 0; k < K; k++)
+        w_max = std::max(w_max, std::fabs(w[k]));
+      const float w_scale = w_max > 0 ? w_max / 127 : 1;
+      if (layer.type == CONVOLUTION)
+        quantize(w, K, w_scale, &layer.weights_s16[(size_t)m * layer.K_pad]);
+      else
+        quantize(w, K, w_scale, &layer.weights_s8[(size_t)m * K]);
+      layer.out_scale[m] = layer.in_scale * w_scale;
+    }
+    layer.quantized = true;
+    int8_ = true;
+  }
+  return true;
+}
+
+void CpuNet::setFloat()
+{
+  int8_ = false;
+  for (size_t i = 0; i < layers_.size(); i++)
+  {
+    Layer& layer = layers_[i];
+    layer.quantized = false;
+    std::vector<int16_t>().swap(layer.weights_s16);
+    std::vector<int8_t>().swap(layer.weights_s8);
+    layer.out_scale.clear();
+  }
+}
+
+// convolution() with the im2col rounded to int16 (|q| <= 127), K padded
+// with a zero row per group so the GEMM can take k two at a time
+void CpuNet::convolutionInt8(const Layer& layer, const Blob& bottom, Blob& top)
+{
+  const int channels = bottom.dim(1);
+  const int h = bottom.dim(2), w = bottom.dim(3);
+  const int out_c = top.dim(1);
+  const int out_hw = top.dim(2) * top.dim(3);
+  const int kernel = layer.kernel_h * layer.kernel_w;
+  const int group_out = out_c / layer.group;
+  const int K = channels / layer.group * kernel;
+  const int K_pad = layer.K_pad;
+  col_s16_.resize(std::max(col_s16_.size(), (size_t)layer.group * K_pad * out_hw));
+  for (int b = 0; b < bottom.dim(0); b++)
+  {
+    const float* im = &bottom.data[(size_t)b * channels * h * w];
+    float* col = &col_[0];
+    int16_t* col_s16 = &col_s16_[0];
+    pool_->parallelFor(channels, [&](size_t c)
+    {
+      im2col(im + c * h * w, 1, h, w, layer.kernel_h, layer.kernel_w, layer.pad_h, layer.pad_w,
+             layer.stride_h, layer.stride_w, col + c * kernel * out_hw);
+    });
+    pool_->parallelFor((size_t)layer.group * K_pad, [&](size_t r)
+    {
+      const int g = r / K_pad, k = r % K_pad;
+      int16_t* dst = col_s16 + r * out_hw;
+      if (k < K)
+        quantize(col + ((size_t)g * K + k) * out_hw, out_hw, layer.in_scale, dst);
+      else
+        std::fill(dst, dst + out_hw, 0);
+    });
+    for (int g = 0; g < layer.group; g++)
+    {
+      gemmS16(group_out, out_hw, K_pad,
+              &layer.weights_s16[(size_t)g * group_out * K_pad],
+              col_s16 + (size_t)g * K_pad * out_hw,
+              &layer.out_scale[g * group_out],
+              layer.bias_term ? &layer.bias.data[g * group_out] : NULL,
+              &top.data[((size_t)b * out_c + g * group_out) * out_hw], *pool_);
+    }
+  }
+}
+
+void CpuNet::innerProductInt8(const Layer& layer, const Blob& bottom, Blob& top)
+{
+  const size_t n = bottom.count();
+  const size_t chunk = 1 << 16;
+  input_s8_.resize(n);
+  pool_->parallelFor((n + chunk - 1) / chunk, [&](size_t t)
+  {
+    quantize(&bottom.data[t * chunk], std::min(chunk, n - t * chunk), layer.in_scale, &input_s8_[t * chunk]);
+  });
+  gemmTransBS8(bottom.dim(0), layer.num_output, bottom.count(1), &input_s8_[0], &layer.weights_s8[0],
+               &layer.out_scale[0], layer.bias_term ? &layer.bias.data[0] : NULL, &top.data[0], *pool_);
+}
+
+bool readInt8Table(const std::string& path, std::map<std::string, float>& max_abs, std::string* error)
+{
+  std::ifstream file(path.c_str());
+  if (!file)
+    return fail(error, "cannot open " + path);
+  std::string line;
+  int line_no = 0;
+  while (std::getline(file, line))
+  {
+    line_no++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream ss(line);
+    std::string name;
+    float value;
+    if (!(ss >> name))
+      continue;
+    if (!(ss >> value))
+    {
+      std::ostringstream msg;
+      msg << path << ", line " << line_no << ": expected `layer_name max_abs`";
+      return fail(error, msg.str());
+    }
+    max_abs[name] = value;
+  }
+  return true;
+}
+
+bool writeInt8Table(const std::string& path, const std::map<std::string, float>& max_abs,
+                    const std::string& comment, std::string* error)
+{
+  std::ofstream file(path.c_str());
+  if (!file)
+    return fail(error, "cannot write " + path);
+  std::istringstream lines(comment);
+  std::string line;
+  while (std::getline(lines, line))
+    file << "# " << line << "\n";
+  for (std::map<std::string, float>::const_iterator it = max_abs.begin(); it != max_abs.end(); ++it)
+    file << it->first << " " << it->second << "\n";
+  return true;
+}
+
+} // namespace classification
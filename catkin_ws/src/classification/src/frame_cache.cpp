@@ -0,0 +1,114 @@
+/**********************************
+Frame Cache
+  See frame_cache.h
+***********************************/
+#include <classification/frame_cache.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace classification
+{
+
+FrameCache::FrameCache(size_t capacity)
+  : ring_(std::max<size_t>(1, capacity)), next_(0), count_(0)
+{
+}
+
+void FrameCache::insert(const sensor_msgs::ImageConstPtr& image)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  ring_[next_].image = image;
+  ring_[next_].frame.reset();
+  next_ = (next_ + 1) % ring_.size();
+  count_ = std::min(count_ + 1, ring_.size());
+}
+
+CameraFrameConstPtr FrameCache::nearest(const ros::Time& stamp, double max_dt, std::string* error)
+{
+  sensor_msgs::ImageConstPtr image;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int best = -1;
+    double best_dt = max_dt;
+    for (size_t i = 0; i < count_; i++)
+    {
+      double dt = std::fabs((ring_[i].image->header.stamp - stamp).toSec());
+      if (dt <= best_dt)
+      {
+        best = i;
+        best_dt = dt;
+      }
+    }
+    if (best < 0)
+    {
+      if (error)
+        *error = count_ ? "no camera frame within max_dt of the scan" : "no camera frame yet";
+      return CameraFrameConstPtr();
+    }
+    if (ring_[best].frame)
+      return ring_[best].frame;
+    image = ring_[best].image;
+  }
+
+  // ======= first use of the frame: convert outside the lock =======
+  CameraFrameConstPtr frame = convert(image, error);
+  if (frame)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count_; i++)
+      if (ring_[i].image == image && !ring_[i].frame)
+        ring_[i].frame = frame;
+  }
+  return frame;
+}
+
+size_t FrameCache::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return count_;
+}
+
+void FrameCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < ring_.size(); i++)
+    ring_[i] = Slot();
+  next_ = count_ = 0;
+}
+
+CameraFrameConstPtr FrameCache::convert(const sensor_msgs::ImageConstPtr& image, std::string* error)
+{
+  boost::shared_ptr<CameraFrame> frame(new CameraFrame);
+  frame->header = image->header;
+  frame->width = image->width;
+  frame->height = image->height;
+  if (image->encoding == "bgr8")
+  {
+    if (image->height == 0 || image->data.size() < (size_t)image->step * image->height)
+    {
+      if (error)
+        *error = "bgr8 frame smaller than step * height";
+      return CameraFrameConstPtr();
+    }
+    frame->image = image;
+    frame->pixels = &image->data[0];
+    frame->step = image->step;
+    return frame;
+  }
+  try
+  {
+    frame->converted = cv_bridge::toCvShare(image, "bgr8");
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    if (error)
+      *error = std::string("cv_bridge: ") + e.what();
+    return CameraFrameConstPtr();
+  }
+  frame->pixels = frame->converted->image.data;
+  frame->step = frame->converted->image.step;
+  return frame;
+}
+
+} // namespace classification
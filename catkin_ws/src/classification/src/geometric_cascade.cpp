@@ -0,0 +1,301 @@
+/**********************************
+Geometric Cascade
+  See geometric_cascade.h
+***********************************/
+#include <classification/geometric_cascade.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <velodyne_perception/cluster_descriptor.h>
+
+namespace classification
+{
+
+using velodyne_perception::kDescriptorNames;
+using velodyne_perception::kDescriptorSize;
+
+namespace
+{
+
+bool fail(std::string* error, const std::string& msg)
+{
+  if (error)
+    *error = msg;
+  return false;
+}
+
+double gini(const std::vector<int>& counts, int total)
+{
+  if (total == 0)
+    return 0;
+  double sum = 0;
+  for (size_t c = 0; c < counts.size(); c++)
+    sum += (double)counts[c] * counts[c];
+  return 1.0 - sum / ((double)total * total);
+}
+
+struct ByFeature
+{
+  explicit ByFeature(int f) : feature(f) {}
+  bool operator()(const GeometricCascade::Sample* a, const GeometricCascade::Sample* b) const
+  {
+    return a->descriptor[feature] < b->descriptor[feature];
+  }
+  int feature;
+};
+
+} // namespace
+
+GeometricCascade::GeometricCascade()
+{
+}
+
+//========== Training ==========
+void GeometricCascade::train(const std::vector<Sample>& samples, const std::vector<std::string>& labels,
+                             int max_depth, int min_leaf)
+{
+  nodes_.clear();
+  labels_ = labels;
+  std::vector<const Sample*> all;
+  for (size_t i = 0; i < samples.size(); i++)
+    if (samples[i].label >= 0 && samples[i].label < (int)labels.size() &&
+        samples[i].descriptor.size() == (size_t)kDescriptorSize)
+      all.push_back(&samples[i]);
+  grow(all, 0, max_depth, std::max(1, min_leaf));
+}
+
+int GeometricCascade::grow(std::vector<const Sample*>& samples, int depth, int max_depth, int min_leaf)
+{
+  const int n = samples.size();
+  const int classes = labels_.size();
+  std::vector<int> counts(classes, 0);
+  for (int i = 0; i < n; i++)
+    counts[samples[i]->label]++;
+  int majority = std::max_element(counts.begin(), counts.end()) - counts.begin();
+
+  const int index = nodes_.size();
+  Node leaf;
+  leaf.feature = -1;
+  leaf.threshold = 0;
+  leaf.left = leaf.right = -1;
+  leaf.label = n > 0 ? majority : -1;
+  leaf.confidence = (counts[majority] + 1.0f) / (n + classes);
+  leaf.samples = n;
+  nodes_.push_back(leaf);
+  if (depth >= max_depth || n < 2 * min_leaf || counts[majority] == n)
+    return index;
+
+  // ======= best split over every feature and threshold =======
+  const double parent = gini(counts, n);
+  double best_gain = 1e-9;
+  int best_feature = -1;
+  float best_threshold = 0;
+  for (int f = 0; f < kDescriptorSize; f++)
+  {
+    std::sort(samples.begin(), samples.end(), ByFeature(f));
+    std::vector<int> left(classes, 0), right = counts;
+    for (int i = 0; i + 1 < n; i++)
+    {
+      left[samples[i]->label]++;
+      right[samples[i]->label]--;
+      const float a = samples[i]->descriptor[f], b = samples[i + 1]->descriptor[f];
+      if (a == b || i + 1 < min_leaf || n - i - 1 < min_leaf)
+        continue;
+      double gain = parent - ((i + 1) * gini(left, i + 1) + (n - i - 1) * gini(right, n - i - 1)) / n;
+      if (gain > best_gain)
+      {
+        best_gain = gain;
+        best_feature = f;
+        best_threshold = 0.5f * (a + b);
+      }
+    }
+  }
+  if (best_feature < 0)
+    return index;
+
+  std::vector<const Sample*> left, right;
+  for (int i = 0; i < n; i++)
+    (samples[i]->descriptor[best_feature] < best_threshold ? left : right).push_back(samples[i]);
+  nodes_[index].feature = best_feature;
+  nodes_[index].threshold = best_threshold;
+  int l = grow(left, depth + 1, max_depth, min_leaf);
+  int r = grow(right, depth + 1, max_depth, min_leaf);
+  nodes_[index].left = l;
+  nodes_[index].right = r;
+  return index;
+}
+
+//========== Inference ==========
+int GeometricCascade::classify(const float* descriptor, float min_confidence, float* confidence) const
+{
+  if (nodes_.empty())
+    return -1;
+  int node = 0;
+  while (nodes_[node].feature >= 0)
+    node = descriptor[nodes_[node].feature] < nodes_[node].threshold ? nodes_[node].left : nodes_[node].right;
+  const Node& leaf = nodes_[node];
+  if (confidence)
+    *confidence = leaf.confidence;
+  return leaf.confidence >= min_confidence ? leaf.label : -1;
+}
+
+int GeometricCascade::leaves() const
+{
+  int n = 0;
+  for (size_t i = 0; i < nodes_.size(); i++)
+    n += nodes_[i].feature < 0;
+  return n;
+}
+
+int GeometricCascade::depth() const
+{
+  return nodes_.empty() ? 0 : depth(0);
+}
+
+int GeometricCascade::depth(int node) const
+{
+  if (nodes_[node].feature < 0)
+    return 0;
+  return 1 + std::max(depth(nodes_[node].left), depth(nodes_[node].right));
+}
+
+//========== Model file ==========
+bool GeometricCascade::load(const std::string& path, std::string* error)
+{
+  nodes_.clear();
+  labels_.clear();
+  std::ifstream file(path.c_str());
+  if (!file)
+    return fail(error, "cannot open " + path);
+  std::vector<std::vector<std::string> > lines;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream ss(line.substr(0, line.find('#')));
+    std::vector<std::string> tokens;
+    std::string token;
+    while (ss >> token)
+      tokens.push_back(token);
+    if (!tokens.empty())
+      lines.push_back(tokens);
+  }
+  if (lines.empty() || lines[0][0] != "labels" || lines[0].size() < 2)
+    return fail(error, path + ": expected `labels name ...` first");
+  labels_.assign(lines[0].begin() + 1, lines[0].end());
+  size_t next = 1;
+  std::string msg;
+  if (parse(lines, next, &msg) < 0 || next != lines.size())
+  {
+    nodes_.clear();
+    return fail(error, path + ": " + (msg.empty() ? "trailing nodes after the tree" : msg));
+  }
+  return true;
+}
+
+int GeometricCascade::parse(const std::vector<std::vector<std::string> >& lines, size_t& line, std::string* error)
+{
+  if (line >= lines.size())
+  {
+    fail(error, "the tree ends early");
+    return -1;
+  }
+  const std::vector<std::string>& t = lines[line++];
+  Node node;
+  node.feature = -1;
+  node.threshold = 0;
+  node.left = node.right = -1;
+  node.label = -1;
+  node.confidence = 0;
+  node.samples = 0;
+  if (t[0] == "split" && t.size() == 3)
+  {
+    node.feature = velodyne_perception::descriptorFeature(t[1].c_str());
+    if (node.feature < 0)
+    {
+      fail(error, "unknown feature " + t[1]);
+      return -1;
+    }
+    node.threshold = atof(t[2].c_str());
+  }
+  else if (t[0] == "leaf" && t.size() == 4)
+  {
+    if (t[1] != "-")
+    {
+      node.label = std::find(labels_.begin(), labels_.end(), t[1]) - labels_.begin();
+      if (node.label == (int)labels_.size())
+      {
+        fail(error, "unknown label " + t[1]);
+        return -1;
+      }
+    }
+    node.confidence = atof(t[2].c_str());
+    node.samples = atoi(t[3].c_str());
+  }
+  else
+  {
+    std::ostringstream msg;
+    msg << "node " << line << ": expected `split feature threshold` or `leaf label confidence samples`";
+    fail(error, msg.str());
+    return -1;
+  }
+  const int index = nodes_.size();
+  nodes_.push_back(node);
+  if (node.feature >= 0)
+  {
+    int l = parse(lines, line, error);
+    if (l < 0)
+      return -1;
+    int r = parse(lines, line, error);
+    if (r < 0)
+      return -1;
+    nodes_[index].left = l;
+    nodes_[index].right = r;
+  }
+  return index;
+}
+
+bool GeometricCascade::save(const std::string& path, const std::string& comment, std::string* error) const
+{
+  if (nodes_.empty())
+    return fail(error, "no tree to save");
+  std::ofstream file(path.c_str());
+  if (!file)
+    return fail(error, "cannot write " + path);
+  std::istringstream lines(comment);
+  std::string line;
+  while (std::getline(lines, line))
+    file << "# " << line << "\n";
+  file << "labels";
+  for (size_t c = 0; c < labels_.size(); c++)
+    file << " " << labels_[c];
+  file << "\n";
+  std::string tree;
+  write(0, 0, tree);
+  file << tree;
+  return true;
+}
+
+void GeometricCascade::write(int index, int indent, std::string& out) const
+{
+  const Node& node = nodes_[index];
+  std::ostringstream line;
+  // every digit of a float, so the thresholds reload to the same tree
+  line.precision(std::numeric_limits<float>::max_digits10);
+  line << std::string(2 * indent, ' ');
+  if (node.feature >= 0)
+    line << "split " << kDescriptorNames[node.feature] << " " << node.threshold << "\n";
+  else
+    line << "leaf " << (node.label >= 0 ? labels_[node.label] : "-") << " " << node.confidence << " "
+         << node.samples << "\n";
+  out += line.str();
+  if (node.feature >= 0)
+  {
+    write(node.left, indent + 1, out);
+    write(node.right, indent + 1, out);
+  }
+}
+
+} // namespace classification
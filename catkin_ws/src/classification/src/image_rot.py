@@ -14,6 +14,10 @@ from visualization_msgs.msg import Marker, MarkerArray
 from robotx_msgs.msg import PCL_points, ObjectPose, ObjectPoseList
 import rospkg
 from cv_bridge import CvBridge, CvBridgeError
+try:
+	import multiview_native	# velodyne_perception, built when Boost.Python / Boost.NumPy are installed
+except ImportError:
+	multiview_native = None
 
 
 class pcl2img():
@@ -43,30 +47,37 @@ class pcl2img():
 			plane_xz = []
 			pcl_size = len(tf_points.list[i].poses)
 
-			# ======= Coordinate transform for better project performance ======
-			position = [0, 0, 0]
-			rad = math.atan2(tf_points.centroids[i].y, tf_points.centroids[i].x)
-			quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
-			transformer = tf.TransformerROS()
-			transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
-			for m in range(pcl_size):
-				new_x = tf_points.list[i].poses[m].position.x
-				new_y = tf_points.list[i].poses[m].position.y
-				new_z = tf_points.list[i].poses[m].position.z
-				orig_point = np.array([new_x, new_y, new_z, 1])
-				new_center = np.dot(transpose_matrix, orig_point)
-				tf_points.list[i].poses[m].position.x = new_center[0]
-				tf_points.list[i].poses[m].position.y = new_center[1]
-				tf_points.list[i].poses[m].position.z = new_center[2]
+			if multiview_native is not None:
+				# ======= Same C++ renderer as the cluster node and classify_cpu ======
+				points = np.array([[p.position.x, p.position.y, p.position.z] for p in tf_points.list[i].poses], np.float64).reshape(-1, 3)
+				yaw = math.atan2(tf_points.centroids[i].y, tf_points.centroids[i].x)
+				self.image = multiview_native.render(points, yaw, int(self.height), self.boundary, self.point_size)
+				self.scale = list(multiview_native.scales(points, yaw, int(self.height), self.boundary))
+			else:
+				# ======= Coordinate transform for better project performance ======
+				position = [0, 0, 0]
+				rad = math.atan2(tf_points.centroids[i].y, tf_points.centroids[i].x)
+				quaternion = tf.transformations.quaternion_from_euler(0., 0., -rad)
+				transformer = tf.TransformerROS()
+				transpose_matrix = transformer.fromTranslationRotation(position, quaternion)
+				for m in range(pcl_size):
+					new_x = tf_points.list[i].poses[m].position.x
+					new_y = tf_points.list[i].poses[m].position.y
+					new_z = tf_points.list[i].poses[m].position.z
+					orig_point = np.array([new_x, new_y, new_z, 1])
+					new_center = np.dot(transpose_matrix, orig_point)
+					tf_points.list[i].poses[m].position.x = new_center[0]
+					tf_points.list[i].poses[m].position.y = new_center[1]
+					tf_points.list[i].poses[m].position.z = new_center[2]
 
-			# ======= project to XY, YZ, XZ plane =======
-			for j in range(pcl_size):
-				plane_xy.append([tf_points.list[i].poses[j].position.x, tf_points.list[i].poses[j].position.y])
-				plane_yz.append([tf_points.list[i].poses[j].position.y, tf_points.list[i].poses[j].position.z])
-				plane_xz.append([tf_points.list[i].poses[j].position.x, tf_points.list[i].poses[j].position.z])
-			self.toIMG(pcl_size, plane_xy, 'xy')
-			self.toIMG(pcl_size, plane_yz, 'yz')
-			self.toIMG(pcl_size, plane_xz, 'xz')
+				# ======= project to XY, YZ, XZ plane =======
+				for j in range(pcl_size):
+					plane_xy.append([tf_points.list[i].poses[j].position.x, tf_points.list[i].poses[j].position.y])
+					plane_yz.append([tf_points.list[i].poses[j].position.y, tf_points.list[i].poses[j].position.z])
+					plane_xz.append([tf_points.list[i].poses[j].position.x, tf_points.list[i].poses[j].position.z])
+				self.toIMG(pcl_size, plane_xy, 'xy')
+				self.toIMG(pcl_size, plane_yz, 'yz')
+				self.toIMG(pcl_size, plane_xz, 'xz')
 			#cv2.imwrite( "Image.jpg", self.image)
 			scale = '_' + str(self.scale[0]) + '_' + str(self.scale[1]) + '_' + str(self.scale[2])
 			cv2.imwrite( "img" + str(self.index) + scale + ".jpg", self.image)
@@ -0,0 +1,143 @@
+/**********************************
+ROI Crop
+  See roi_crop.h
+***********************************/
+#include <classification/roi_crop.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace classification
+{
+
+namespace
+{
+
+// vertical weights in 1/128 so a row blend fits in 16 bits, horizontal
+// ones in 1/2048 like cv::resize (the full blend fits in 32)
+const int kRowBits = 7;
+const int kOne = 1 << kRowBits;
+const int kColBits = 11;
+
+// source index and weight (in 1 << bits) of the next pixel for every output
+// pixel, cv::resize INTER_LINEAR centres: (d + 0.5) * src / dst - 0.5
+void linearTaps(int src, int dst, int bits, std::vector<int>& index, std::vector<int>& weight)
+{
+  index.resize(dst);
+  weight.resize(dst);
+  const double scale = (double)src / dst;
+  for (int d = 0; d < dst; d++)
+  {
+    double f = std::max(0.0, (d + 0.5) * scale - 0.5);
+    int i = std::min((int)f, src - 1);
+    index[d] = i;
+    weight[d] = i + 1 < src ? (int)std::floor((f - i) * (1 << bits) + 0.5) : 0;
+  }
+}
+
+// out[i] = a[i] * (kOne - w) + b[i] * w, kept in 1/128
+void blendRows(const uint8_t* a, const uint8_t* b, int w, int n, uint16_t* out)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i wa = _mm_set1_epi16(kOne - w);
+  const __m128i wb = _mm_set1_epi16(w);
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+    _mm_storeu_si128((__m128i*)(out + i), lo);
+    _mm_storeu_si128((__m128i*)(out + i + 8), hi);
+  }
+#endif
+  for (; i < n; i++)
+    out[i] = a[i] * (kOne - w) + b[i] * w;
+}
+
+} // namespace
+
+bool projectBox(const double P[12], const double corners[8][3], int image_width, int image_height,
+                double min_depth, double padding, PixelRect& rect)
+{
+  double u_min = 1e9, v_min = 1e9, u_max = -1e9, v_max = -1e9;
+  bool in_front = false;
+  for (int k = 0; k < 8; k++)
+  {
+    const double x = corners[k][0], y = corners[k][1];
+    double z = corners[k][2];
+    in_front |= z >= min_depth;
+    z = std::max(z, min_depth);
+    const double u = P[0] * x + P[1] * y + P[2] * z + P[3];
+    const double v = P[4] * x + P[5] * y + P[6] * z + P[7];
+    const double w = P[8] * x + P[9] * y + P[10] * z + P[11];
+    if (w <= 0)
+      continue;
+    u_min = std::min(u_min, u / w);
+    u_max = std::max(u_max, u / w);
+    v_min = std::min(v_min, v / w);
+    v_max = std::max(v_max, v / w);
+  }
+  if (!in_front || u_max < u_min)
+    return false;
+  const double pad_u = padding * (u_max - u_min), pad_v = padding * (v_max - v_min);
+  int x0 = std::max(0, (int)std::floor(u_min - pad_u));
+  int y0 = std::max(0, (int)std::floor(v_min - pad_v));
+  int x1 = std::min(image_width, (int)std::ceil(u_max + pad_u));
+  int y1 = std::min(image_height, (int)std::ceil(v_max + pad_v));
+  if (x1 <= x0 || y1 <= y0)
+    return false;
+  rect.x = x0;
+  rect.y = y0;
+  rect.width = x1 - x0;
+  rect.height = y1 - y0;
+  return true;
+}
+
+void letterboxCrop(const uint8_t* image, int step, const PixelRect& rect, int size, uint8_t* out)
+{
+  std::memset(out, 0, (size_t)size * size * 3);
+  if (rect.width <= 0 || rect.height <= 0)
+    return;
+  const double ratio = std::min((double)size / rect.height, (double)size / rect.width);
+  const int w = std::min(size, (int)(ratio * rect.width));
+  const int h = std::min(size, (int)(ratio * rect.height));
+  if (w <= 0 || h <= 0)
+    return;
+  const int off_x = (size - w) / 2, off_y = (size - h) / 2;
+
+  std::vector<int> x0, wx, y0, wy;
+  linearTaps(rect.width, w, kColBits, x0, wx);
+  linearTaps(rect.height, h, kRowBits, y0, wy);
+  std::vector<uint16_t> row(3 * rect.width);
+  const uint8_t* origin = image + (size_t)rect.y * step + 3 * rect.x;
+  for (int y = 0; y < h; y++)
+  {
+    // ======= vertical: blend the two source rows over the crop width =======
+    const uint8_t* r0 = origin + (size_t)y0[y] * step;
+    const uint8_t* r1 = wy[y] ? r0 + step : r0;
+    blendRows(r0, r1, wy[y], 3 * rect.width, &row[0]);
+
+    // ======= horizontal =======
+    uint8_t* dst = out + ((size_t)(off_y + y) * size + off_x) * 3;
+    for (int x = 0; x < w; x++)
+    {
+      const uint16_t* a = &row[3 * x0[x]];
+      const uint16_t* b = wx[x] ? a + 3 : a;
+      const int fa = (1 << kColBits) - wx[x], fb = wx[x];
+      for (int c = 0; c < 3; c++)
+        dst[3 * x + c] = (a[c] * fa + b[c] * fb + (1 << (kRowBits + kColBits - 1))) >> (kRowBits + kColBits);
+    }
+  }
+}
+
+} // namespace classification
@@ -0,0 +1,158 @@
+/**********************************
+ROI Extractor
+  See roi_extractor.h
+***********************************/
+#include <classification/roi_extractor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <pcl/point_types.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <classification/roi_crop.h>
+
+namespace classification
+{
+
+namespace
+{
+
+int cacheSize(ros::NodeHandle& private_nh)
+{
+  int cache_size;
+  private_nh.param("cache_size", cache_size, 8);
+  return std::max(1, cache_size);
+}
+
+} // namespace
+
+RoiExtractor::RoiExtractor(ros::NodeHandle& nh, ros::NodeHandle& private_nh, const std::string& image_topic)
+  : node_name_(ros::this_node::getName()), cache_(cacheSize(private_nh))
+{
+  std::string camera_info_topic;
+  private_nh.param<std::string>("camera_info_topic", camera_info_topic, "/camera/camera_info");
+  private_nh.param("padding", padding_, 0.1);
+  private_nh.param("min_depth", min_depth_, 0.5);
+  private_nh.param("min_pixels", min_pixels_, 4);
+  private_nh.param("max_frame_dt", max_frame_dt_, 0.1);
+  ROS_INFO("[%s] Param [image_topic] = %s, [camera_info_topic] = %s", node_name_.c_str(), image_topic.c_str(),
+           camera_info_topic.c_str());
+  ROS_INFO("[%s] Param [padding] = %f, [max_frame_dt] = %f", node_name_.c_str(), padding_, max_frame_dt_);
+  sub_image_ = nh.subscribe(image_topic, 2, &RoiExtractor::imageCallback, this);
+  sub_info_ = nh.subscribe(camera_info_topic, 1, &RoiExtractor::infoCallback, this);
+}
+
+void RoiExtractor::imageCallback(const sensor_msgs::ImageConstPtr& image)
+{
+  cache_.insert(image);
+}
+
+void RoiExtractor::infoCallback(const sensor_msgs::CameraInfoConstPtr& info)
+{
+  info_ = info;
+}
+
+bool RoiExtractor::prepare(const std_msgs::Header& header, Scan& scan)
+{
+  if (!info_)
+  {
+    ROS_WARN_THROTTLE(5, "[%s] no camera info yet", node_name_.c_str());
+    return false;
+  }
+  std::string error;
+  scan.frame = cache_.nearest(header.stamp, max_frame_dt_, &error);
+  if (!scan.frame)
+  {
+    ROS_WARN_THROTTLE(5, "[%s] %s", node_name_.c_str(), error.c_str());
+    return false;
+  }
+  const std::string& camera_frame = info_->header.frame_id.empty() ? scan.frame->header.frame_id
+                                                                    : info_->header.frame_id;
+  try
+  {
+    listener_.lookupTransform(camera_frame, header.frame_id, ros::Time(0), scan.transform);
+  }
+  catch (tf::TransformException& ex)
+  {
+    ROS_WARN_THROTTLE(5, "[%s] %s", node_name_.c_str(), ex.what());
+    return false;
+  }
+  std::copy(info_->P.begin(), info_->P.end(), scan.P);
+  return true;
+}
+
+bool RoiExtractor::crop(const Scan& scan, const robotx_msgs::ObjectPose& obj, int size, uint8_t* out) const
+{
+  double corners[8][3];
+  if (!scan.frame || !clusterBox(obj, corners))
+    return false;
+  for (int c = 0; c < 8; c++)
+  {
+    tf::Vector3 p = scan.transform * tf::Vector3(corners[c][0], corners[c][1], corners[c][2]);
+    corners[c][0] = p.x();
+    corners[c][1] = p.y();
+    corners[c][2] = p.z();
+  }
+  PixelRect rect;
+  if (!projectBox(scan.P, corners, scan.frame->width, scan.frame->height, min_depth_, padding_, rect) ||
+      rect.width < min_pixels_ || rect.height < min_pixels_)
+    return false;
+  letterboxCrop(scan.frame->pixels, scan.frame->step, rect, size, out);
+  return true;
+}
+
+// 8 corners of the cluster box in the frame of the list
+bool RoiExtractor::clusterBox(const robotx_msgs::ObjectPose& obj, double corners[8][3])
+{
+  double lo[3], hi[3];
+  double yaw = 0;
+  if (!obj.pcl_points_local.poses.empty())
+  {
+    lo[0] = obj.local_min.x, lo[1] = obj.local_min.y, lo[2] = obj.local_min.z;
+    hi[0] = obj.local_max.x, hi[1] = obj.local_max.y, hi[2] = obj.local_max.z;
+    yaw = obj.local_yaw;
+  }
+  else
+  {
+    std::vector<geometry_msgs::Point> points;
+    if (!obj.pcl_points.poses.empty())
+      for (size_t i = 0; i < obj.pcl_points.poses.size(); i++)
+        points.push_back(obj.pcl_points.poses[i].position);
+    else if (obj.cloud.width * obj.cloud.height > 0)
+    {
+      pcl::PointCloud<pcl::PointXYZ> cloud;
+      pcl::fromROSMsg(obj.cloud, cloud);
+      points.resize(cloud.points.size());
+      for (size_t i = 0; i < cloud.points.size(); i++)
+      {
+        points[i].x = cloud.points[i].x;
+        points[i].y = cloud.points[i].y;
+        points[i].z = cloud.points[i].z;
+      }
+    }
+    if (points.empty())
+      return false;
+    lo[0] = hi[0] = points[0].x;
+    lo[1] = hi[1] = points[0].y;
+    lo[2] = hi[2] = points[0].z;
+    for (size_t i = 1; i < points.size(); i++)
+    {
+      lo[0] = std::min(lo[0], points[i].x), hi[0] = std::max(hi[0], points[i].x);
+      lo[1] = std::min(lo[1], points[i].y), hi[1] = std::max(hi[1], points[i].y);
+      lo[2] = std::min(lo[2], points[i].z), hi[2] = std::max(hi[2], points[i].z);
+    }
+  }
+  const double c = std::cos(yaw), s = std::sin(yaw);
+  for (int k = 0; k < 8; k++)
+  {
+    double x = k & 1 ? hi[0] : lo[0];
+    double y = k & 2 ? hi[1] : lo[1];
+    corners[k][0] = c * x - s * y;
+    corners[k][1] = s * x + c * y;
+    corners[k][2] = k & 4 ? hi[2] : lo[2];
+  }
+  return true;
+}
+
+} // namespace classification
@@ -0,0 +1,160 @@
+/**********************************
+Train Cascade
+  Trains the geometric cascade of classify_cpu (~cascade_model) on
+  labelled clusters and reports how many clusters of a held-out set it
+  would decide without the CNN, and how accurately.
+
+  train_cascade labels.txt train_list held_out_list out_model [max_depth=6] [min_leaf=20] [confidence=0.98]
+
+  The lists have one "cluster.pcd label" per line like benchmark_tiers
+  (sensor frame, label index into labels.txt, paths relative to the list).
+  The descriptor is computed from the raw cluster, as the cluster nodes do.
+***********************************/
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+
+#include <classification/geometric_cascade.h>
+#include <velodyne_perception/cluster_descriptor.h>
+
+using namespace std;
+using classification::GeometricCascade;
+
+bool readLabels(const string& path, vector<string>& labels)
+{
+  ifstream file(path.c_str());
+  if (!file)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  string line;
+  while (getline(file, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (!line.empty())
+      labels.push_back(line);
+  }
+  return !labels.empty();
+}
+
+bool readList(const string& path, int classes, vector<GeometricCascade::Sample>& out)
+{
+  ifstream file(path.c_str());
+  if (!file)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  string dir = path.find('/') == string::npos ? "" : path.substr(0, path.rfind('/') + 1);
+  string line;
+  while (getline(file, line))
+  {
+    istringstream ss(line);
+    string pcd;
+    int label;
+    if (!(ss >> pcd) || pcd[0] == '#')
+      continue;
+    if (!(ss >> label) || label < 0 || label >= classes)
+    {
+      fprintf(stderr, "%s: no valid label for %s\n", path.c_str(), pcd.c_str());
+      return false;
+    }
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    if (pcl::io::loadPCDFile<pcl::PointXYZ>(pcd[0] == '/' ? pcd : dir + pcd, cloud) != 0)
+      return false;
+    if (cloud.points.empty())
+      continue;
+    GeometricCascade::Sample sample;
+    velodyne_perception::describeGeometry(cloud, sample.descriptor);
+    sample.label = label;
+    out.push_back(sample);
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 5)
+  {
+    fprintf(stderr, "usage: %s labels.txt train_list held_out_list out_model [max_depth=6] [min_leaf=20] [confidence=0.98]\n", argv[0]);
+    return 1;
+  }
+  const int max_depth = argc > 5 ? atoi(argv[5]) : 6;
+  const int min_leaf = argc > 6 ? atoi(argv[6]) : 20;
+  const float confidence = argc > 7 ? atof(argv[7]) : 0.98f;
+  vector<string> labels;
+  vector<GeometricCascade::Sample> train, held_out;
+  if (!readLabels(argv[1], labels))
+  {
+    fprintf(stderr, "no labels in %s\n", argv[1]);
+    return 1;
+  }
+  if (!readList(argv[2], labels.size(), train) || !readList(argv[3], labels.size(), held_out))
+    return 1;
+  if (train.empty() || held_out.empty())
+  {
+    fprintf(stderr, "empty training or held-out list\n");
+    return 1;
+  }
+
+  GeometricCascade cascade;
+  cascade.train(train, labels, max_depth, min_leaf);
+
+  // ======= held-out: decided by the cascade vs left to the CNN =======
+  const int classes = labels.size();
+  vector<int> total(classes, 0), decided(classes, 0), correct(classes, 0);
+  for (size_t i = 0; i < held_out.size(); i++)
+  {
+    const GeometricCascade::Sample& s = held_out[i];
+    int label = cascade.classify(&s.descriptor[0], confidence);
+    total[s.label]++;
+    if (label >= 0)
+    {
+      decided[s.label]++;
+      correct[s.label] += label == s.label;
+    }
+  }
+  int all_decided = 0, all_correct = 0;
+  for (int c = 0; c < classes; c++)
+  {
+    all_decided += decided[c];
+    all_correct += correct[c];
+  }
+
+  ostringstream report;
+  char line[256];
+  report << "train_cascade " << argv[2] << ", " << train.size() << " clusters, max_depth " << max_depth
+         << ", min_leaf " << min_leaf << "\n";
+  report << cascade.leaves() << " leaves, depth " << cascade.depth() << "\n";
+  report << held_out.size() << " held-out clusters at confidence " << confidence << ":\n";
+  snprintf(line, sizeof(line), "  decided %.1f%% (%d), accuracy %.2f%%, the rest go to the CNN\n",
+           100.0 * all_decided / held_out.size(), all_decided, all_decided ? 100.0 * all_correct / all_decided : 0.0);
+  report << line;
+  for (int c = 0; c < classes; c++)
+  {
+    if (!total[c])
+      continue;
+    snprintf(line, sizeof(line), "  %-12s %5d clusters, decided %5.1f%%, accuracy %6.2f%%\n", labels[c].c_str(),
+             total[c], 100.0 * decided[c] / total[c], decided[c] ? 100.0 * correct[c] / decided[c] : 0.0);
+    report << line;
+  }
+  string text = report.str();
+  text.erase(text.size() - 1);
+  printf("%s\n", text.c_str());
+
+  string error;
+  if (!cascade.save(argv[4], text, &error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("wrote %s\n", argv[4]);
+  return 0;
+}
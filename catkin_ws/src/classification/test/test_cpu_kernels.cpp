@@ -0,0 +1,275 @@
+/**********************************
+CPU Kernel Tests
+  Every kernel of cpu_kernels.h against a naive loop, on shapes that are
+  not multiples of the register / cache blocks so the tails are covered.
+***********************************/
+#include <classification/cpu_kernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace classification;
+
+namespace
+{
+
+std::vector<float> randomFloats(size_t n, unsigned int seed)
+{
+  std::vector<float> v(n);
+  srand(seed);
+  for (size_t i = 0; i < n; i++)
+    v[i] = rand() / (float)RAND_MAX * 2 - 1;
+  return v;
+}
+
+template <typename Q>
+std::vector<Q> randomInts(size_t n, int limit, unsigned int seed)
+{
+  std::vector<Q> v(n);
+  srand(seed);
+  for (size_t i = 0; i < n; i++)
+    v[i] = (Q)(rand() % (2 * limit + 1) - limit);
+  return v;
+}
+
+// C = A * B (+ bias per row), or A * B^T (+ bias per column)
+std::vector<double> naiveGemm(int M, int N, int K, const float* A, const float* B, const float* bias,
+                              bool trans_b)
+{
+  std::vector<double> C((size_t)M * N);
+  for (int i = 0; i < M; i++)
+    for (int j = 0; j < N; j++)
+    {
+      double s = 0;
+      for (int k = 0; k < K; k++)
+        s += (double)A[(size_t)i * K + k] * (trans_b ? B[(size_t)j * K + k] : B[(size_t)k * N + j]);
+      if (bias)
+        s += trans_b ? bias[j] : bias[i];
+      C[(size_t)i * N + j] = s;
+    }
+  return C;
+}
+
+struct Shape
+{
+  int M, N, K;
+};
+
+} // namespace
+
+//========== Float ==========
+TEST(CpuKernels, GemmMatchesNaive)
+{
+  TaskPool pool(3);
+  // 1 element, below one micro tile, and past a tile / K block with tails
+  const Shape shapes[] = {{1, 1, 1}, {3, 7, 5}, {4, 8, 256}, {5, 13, 257}, {67, 131, 300}, {130, 9, 11}};
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+  {
+    const Shape& sh = shapes[s];
+    std::vector<float> A = randomFloats((size_t)sh.M * sh.K, 1 + s);
+    std::vector<float> B = randomFloats((size_t)sh.K * sh.N, 100 + s);
+    std::vector<float> bias = randomFloats(sh.M, 200 + s);
+    for (int with_bias = 0; with_bias < 2; with_bias++)
+    {
+      std::vector<float> C((size_t)sh.M * sh.N, 1e9f);
+      gemm(sh.M, sh.N, sh.K, &A[0], &B[0], with_bias ? &bias[0] : NULL, &C[0], pool);
+      std::vector<double> ref = naiveGemm(sh.M, sh.N, sh.K, &A[0], &B[0], with_bias ? &bias[0] : NULL, false);
+      for (size_t i = 0; i < C.size(); i++)
+        ASSERT_NEAR(ref[i], C[i], 1e-4 * std::sqrt((double)sh.K) + 1e-5)
+            << "M " << sh.M << " N " << sh.N << " K " << sh.K << " at " << i;
+    }
+  }
+}
+
+TEST(CpuKernels, GemmWithoutKClearsOutput)
+{
+  TaskPool pool(0);
+  std::vector<float> C(6, 5.0f);
+  const float bias[2] = {1, -1};
+  gemm(2, 3, 0, NULL, NULL, bias, &C[0], pool);
+  for (int i = 0; i < 6; i++)
+    EXPECT_EQ(i < 3 ? 1.0f : -1.0f, C[i]);
+}
+
+TEST(CpuKernels, GemmTransBMatchesNaive)
+{
+  TaskPool pool(3);
+  // rows past a multiple of 4, K with and without a SIMD tail
+  const Shape shapes[] = {{1, 1, 1}, {1, 17, 3}, {5, 16, 19}, {6, 33, 64}, {10, 40, 4097}};
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+  {
+    const Shape& sh = shapes[s];
+    std::vector<float> A = randomFloats((size_t)sh.M * sh.K, 1 + s);
+    std::vector<float> B = randomFloats((size_t)sh.N * sh.K, 100 + s);
+    std::vector<float> bias = randomFloats(sh.N, 200 + s);
+    std::vector<float> C((size_t)sh.M * sh.N);
+    gemmTransB(sh.M, sh.N, sh.K, &A[0], &B[0], &bias[0], &C[0], pool);
+    std::vector<double> ref = naiveGemm(sh.M, sh.N, sh.K, &A[0], &B[0], &bias[0], true);
+    for (size_t i = 0; i < C.size(); i++)
+      ASSERT_NEAR(ref[i], C[i], 1e-4 * std::sqrt((double)sh.K) + 1e-5)
+          << "M " << sh.M << " N " << sh.N << " K " << sh.K << " at " << i;
+  }
+}
+
+TEST(CpuKernels, Im2colMatchesNaive)
+{
+  const int channels = 2, height = 5, width = 6, kh = 3, kw = 2, ph = 1, pw = 1, sh = 2, sw = 1;
+  const int out_h = (height + 2 * ph - kh) / sh + 1;
+  const int out_w = (width + 2 * pw - kw) / sw + 1;
+  std::vector<float> im = randomFloats((size_t)channels * height * width, 7);
+  std::vector<float> col((size_t)channels * kh * kw * out_h * out_w, 1e9f);
+  im2col(&im[0], channels, height, width, kh, kw, ph, pw, sh, sw, &col[0]);
+  size_t i = 0;
+  for (int c = 0; c < channels; c++)
+    for (int ki = 0; ki < kh; ki++)
+      for (int kj = 0; kj < kw; kj++)
+        for (int oh = 0; oh < out_h; oh++)
+          for (int ow = 0; ow < out_w; ow++, i++)
+          {
+            const int y = oh * sh - ph + ki, x = ow * sw - pw + kj;
+            const bool inside = y >= 0 && y < height && x >= 0 && x < width;
+            ASSERT_EQ(inside ? im[(c * height + y) * width + x] : 0.0f, col[i]);
+          }
+}
+
+TEST(CpuKernels, SoftmaxSumsToOne)
+{
+  std::vector<float> x = randomFloats(3 * 5, 9);
+  x[0] = 80;  // exp() overflows without the max subtracted
+  softmax(&x[0], 3, 5);
+  for (int i = 0; i < 5; i++)
+  {
+    const float s = x[i] + x[5 + i] + x[10 + i];
+    EXPECT_NEAR(1.0f, s, 1e-6);
+  }
+  EXPECT_NEAR(1.0f, x[0], 1e-6);
+}
+
+//========== INT8 ==========
+TEST(CpuKernels, QuantizeRoundsHalfToEvenAndSaturates)
+{
+  // more than one SIMD block and a tail, with the edge cases in both
+  const float scale = 0.5f;
+  const float edges[] = {0.25f, 0.75f, -0.25f, -0.75f, 1.25f, 63.5f, 63.25f, -63.75f, 1000, -1000,
+                         63.75f, 0, -0.0f};
+  std::vector<float> x;
+  for (int rep = 0; rep < 3; rep++)
+    x.insert(x.end(), edges, edges + sizeof(edges) / sizeof(edges[0]));
+  std::vector<int8_t> q8(x.size());
+  std::vector<int16_t> q16(x.size());
+  quantize(&x[0], x.size(), scale, &q8[0]);
+  quantize(&x[0], x.size(), scale, &q16[0]);
+  for (size_t i = 0; i < x.size(); i++)
+  {
+    // x / scale: 0.5 -> 0, 1.5 -> 2, -0.5 -> 0, -1.5 -> -2, 2.5 -> 2, 127 -> 127,
+    // 126.5 -> 126, -127.5 -> -127 (clamped), 2000 -> 127, -2000 -> -127
+    double v = std::max(-127.0, std::min(127.0, x[i] / (double)scale));
+    const int expected = (int)std::nearbyint(v);
+    ASSERT_EQ(expected, q8[i]) << "x " << x[i];
+    ASSERT_EQ(expected, q16[i]) << "x " << x[i];
+  }
+  EXPECT_EQ(0, q8[0]);
+  EXPECT_EQ(2, q8[4]);
+  EXPECT_EQ(127, q8[8]);
+  EXPECT_EQ(-127, q8[9]);
+}
+
+TEST(CpuKernels, QuantizeWithoutScaleIsZero)
+{
+  std::vector<float> x = randomFloats(21, 3);
+  std::vector<int8_t> q(x.size(), 1);
+  quantize(&x[0], x.size(), 0.0f, &q[0]);
+  for (size_t i = 0; i < q.size(); i++)
+    EXPECT_EQ(0, q[i]);
+}
+
+TEST(CpuKernels, GemmS16MatchesNaive)
+{
+  TaskPool pool(3);
+  // K is even (CpuNet pads it); 258 / 514 cross the 256 K block
+  const Shape shapes[] = {{1, 1, 2}, {3, 7, 6}, {5, 9, 258}, {67, 131, 514}, {64, 128, 256}};
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+  {
+    const Shape& sh = shapes[s];
+    // the full int8 range, so the int32 sums are as large as they get
+    std::vector<int16_t> A = randomInts<int16_t>((size_t)sh.M * sh.K, 127, 1 + s);
+    std::vector<int16_t> B = randomInts<int16_t>((size_t)sh.K * sh.N, 127, 100 + s);
+    A[0] = B[0] = -127;
+    std::vector<float> row_scale = randomFloats(sh.M, 200 + s);
+    std::vector<float> bias = randomFloats(sh.M, 300 + s);
+    std::vector<float> C((size_t)sh.M * sh.N, 1e9f);
+    gemmS16(sh.M, sh.N, sh.K, &A[0], &B[0], &row_scale[0], &bias[0], &C[0], pool);
+    for (int i = 0; i < sh.M; i++)
+      for (int j = 0; j < sh.N; j++)
+      {
+        int64_t acc = 0;
+        for (int k = 0; k < sh.K; k++)
+          acc += A[(size_t)i * sh.K + k] * B[(size_t)k * sh.N + j];
+        const double expected = acc * (double)row_scale[i] + bias[i];
+        ASSERT_NEAR(expected, C[(size_t)i * sh.N + j], 1e-6 * std::fabs(expected) + 1e-4)
+            << "M " << sh.M << " N " << sh.N << " K " << sh.K << " at " << i << ", " << j;
+      }
+  }
+}
+
+TEST(CpuKernels, GemmTransBS8MatchesNaive)
+{
+  TaskPool pool(3);
+  // K below, at and past the 16 byte SIMD step
+  const Shape shapes[] = {{1, 1, 1}, {2, 5, 15}, {5, 17, 16}, {6, 33, 17}, {9, 20, 300}};
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+  {
+    const Shape& sh = shapes[s];
+    std::vector<int8_t> A = randomInts<int8_t>((size_t)sh.M * sh.K, 127, 1 + s);
+    std::vector<int8_t> B = randomInts<int8_t>((size_t)sh.N * sh.K, 127, 100 + s);
+    A[0] = B[0] = -127;
+    std::vector<float> col_scale = randomFloats(sh.N, 200 + s);
+    std::vector<float> bias = randomFloats(sh.N, 300 + s);
+    std::vector<float> C((size_t)sh.M * sh.N, 1e9f);
+    gemmTransBS8(sh.M, sh.N, sh.K, &A[0], &B[0], &col_scale[0], &bias[0], &C[0], pool);
+    for (int i = 0; i < sh.M; i++)
+      for (int j = 0; j < sh.N; j++)
+      {
+        int64_t acc = 0;
+        for (int k = 0; k < sh.K; k++)
+          acc += A[(size_t)i * sh.K + k] * B[(size_t)j * sh.K + k];
+        const double expected = acc * (double)col_scale[j] + bias[j];
+        ASSERT_NEAR(expected, C[(size_t)i * sh.N + j], 1e-6 * std::fabs(expected) + 1e-4)
+            << "M " << sh.M << " N " << sh.N << " K " << sh.K << " at " << i << ", " << j;
+      }
+  }
+}
+
+// quantize -> int GEMM -> rescale against the float GEMM it stands for
+TEST(CpuKernels, RequantizedGemmTracksFloat)
+{
+  TaskPool pool(2);
+  const int M = 6, N = 10, K = 64;
+  std::vector<float> A = randomFloats((size_t)M * K, 11);
+  std::vector<float> B = randomFloats((size_t)K * N, 12);
+  std::vector<int16_t> qa(A.size()), qb(B.size());
+  std::vector<float> row_scale(M);
+  for (int i = 0; i < M; i++)
+  {
+    float w_max = 0;
+    for (int k = 0; k < K; k++)
+      w_max = std::max(w_max, std::fabs(A[(size_t)i * K + k]));
+    quantize(&A[(size_t)i * K], K, w_max / 127, &qa[(size_t)i * K]);
+    row_scale[i] = w_max / 127 * (1.0f / 127);
+  }
+  quantize(&B[0], B.size(), 1.0f / 127, &qb[0]);
+  std::vector<float> C((size_t)M * N);
+  gemmS16(M, N, K, &qa[0], &qb[0], &row_scale[0], NULL, &C[0], pool);
+  std::vector<double> ref = naiveGemm(M, N, K, &A[0], &B[0], NULL, false);
+  for (size_t i = 0; i < C.size(); i++)
+    EXPECT_NEAR(ref[i], C[i], 0.05);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
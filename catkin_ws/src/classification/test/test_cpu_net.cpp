@@ -0,0 +1,430 @@
+/**********************************
+CPU Net Tests
+  The two protobuf readers of caffe_model.h on hand-written input, and a
+  small conv / relu / pool / inner product / softmax net through CpuNet
+  in float and INT8 mode against a naive forward pass.
+***********************************/
+#include <classification/cpu_net.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+using namespace classification;
+
+namespace
+{
+
+// ======= protobuf wire format, just what a caffemodel needs =======
+std::string varint(uint64_t v)
+{
+  std::string out;
+  while (v >= 0x80)
+  {
+    out += (char)((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out += (char)v;
+  return out;
+}
+
+std::string tag(int field, int wire)
+{
+  return varint((uint64_t)field << 3 | wire);
+}
+
+std::string lengthDelimited(int field, const std::string& payload)
+{
+  return tag(field, 2) + varint(payload.size()) + payload;
+}
+
+std::string varintField(int field, uint64_t v)
+{
+  return tag(field, 0) + varint(v);
+}
+
+std::string packedFloats(int field, const std::vector<float>& v)
+{
+  return lengthDelimited(field, std::string((const char*)&v[0], v.size() * sizeof(float)));
+}
+
+// BlobProto with shape { dim: ... } and packed data
+std::string blob(const std::vector<int>& shape, const std::vector<float>& data)
+{
+  std::string dims;
+  for (size_t i = 0; i < shape.size(); i++)
+    dims += varint(shape[i]);
+  return lengthDelimited(7, lengthDelimited(1, dims)) + packedFloats(5, data);
+}
+
+// LayerParameter { name = 1, blobs = 7 } as NetParameter.layer (100)
+std::string layer(const std::string& name, const std::vector<std::string>& blobs)
+{
+  std::string body = lengthDelimited(1, name);
+  // a field the reader skips: type = 2
+  body += lengthDelimited(2, "Whatever");
+  for (size_t i = 0; i < blobs.size(); i++)
+    body += lengthDelimited(7, blobs[i]);
+  return lengthDelimited(100, body);
+}
+
+std::vector<float> randomFloats(size_t n, unsigned int seed, float amplitude = 1)
+{
+  std::vector<float> v(n);
+  srand(seed);
+  for (size_t i = 0; i < n; i++)
+    v[i] = (rand() / (float)RAND_MAX * 2 - 1) * amplitude;
+  return v;
+}
+
+class TempDir
+{
+public:
+  TempDir()
+  {
+    char path[] = "/tmp/cpu_net_testXXXXXX";
+    path_ = mkdtemp(path);
+  }
+  ~TempDir()
+  {
+    for (size_t i = 0; i < files_.size(); i++)
+      unlink(files_[i].c_str());
+    rmdir(path_.c_str());
+  }
+  std::string write(const std::string& name, const std::string& contents)
+  {
+    const std::string file = path_ + "/" + name;
+    std::ofstream(file.c_str(), std::ios::binary) << contents;
+    files_.push_back(file);
+    return file;
+  }
+
+private:
+  std::string path_;
+  std::vector<std::string> files_;
+};
+
+} // namespace
+
+//========== Text format ==========
+TEST(CaffeModel, ParsesTextFormat)
+{
+  const std::string text =
+      "# deploy net\n"
+      "name: \"tiny\"\n"
+      "input: 'data'\n"
+      "input_dim: 1 input_dim: 3\n"
+      "layer {\n"
+      "  name: \"conv\" type: \"Convolution\"  # trailing comment\n"
+      "  convolution_param < num_output: 8 kernel_size: [3, 5] weight_filler { type: \"xavier\" } >\n"
+      "  pooling_param { pool: MAX }\n"
+      "}\n"
+      "layer { name: \"a \\\"quoted\\\" name\" }\n";
+  TextMessage net;
+  std::string error;
+  ASSERT_TRUE(parseTextProto(text, net, &error)) << error;
+  EXPECT_EQ("tiny", net.get("name"));
+  EXPECT_EQ("data", net.get("input"));
+  EXPECT_EQ((std::vector<std::string>{"1", "3"}), net.getAll("input_dim"));
+  EXPECT_EQ(1, net.getNumber("input_dim", 0));
+  std::vector<const TextMessage*> layers = net.messagesNamed("layer");
+  ASSERT_EQ(2u, layers.size());
+  EXPECT_EQ("Convolution", layers[0]->get("type"));
+  const TextMessage* conv = layers[0]->message("convolution_param");
+  ASSERT_TRUE(conv != NULL);
+  EXPECT_EQ(8, conv->getNumber("num_output", 0));
+  std::vector<std::string> kernel = conv->getAll("kernel_size");
+  ASSERT_EQ(2u, kernel.size());
+  EXPECT_EQ("3", kernel[0]);
+  EXPECT_EQ("5", kernel[1]);
+  EXPECT_EQ("xavier", conv->message("weight_filler")->get("type"));
+  EXPECT_EQ("MAX", layers[0]->message("pooling_param")->get("pool"));
+  EXPECT_EQ("a \"quoted\" name", layers[1]->get("name"));
+  EXPECT_TRUE(layers[1]->message("convolution_param") == NULL);
+  EXPECT_EQ("fallback", layers[1]->get("type", "fallback"));
+}
+
+TEST(CaffeModel, RejectsBrokenTextFormat)
+{
+  TextMessage net;
+  std::string error;
+  EXPECT_FALSE(parseTextProto("layer {\n  name: \"conv\"\n", net, &error));
+  EXPECT_NE(std::string::npos, error.find("unexpected end of file")) << error;
+  EXPECT_FALSE(parseTextProto("name: \"a\"\n}\n", net, &error));
+  EXPECT_NE(std::string::npos, error.find("line 2")) << error;
+  EXPECT_FALSE(parseTextProto("name:", net, &error));
+  EXPECT_NE(std::string::npos, error.find("missing value")) << error;
+  EXPECT_FALSE(parseTextProto("name: ?", net, &error));
+}
+
+//========== Wire format ==========
+TEST(CaffeModel, ReadsLayerAndV1Blobs)
+{
+  std::string model;
+  // a NetParameter field before the layers: name = 1
+  model += lengthDelimited(1, "tiny");
+  std::vector<std::string> conv_blobs;
+  conv_blobs.push_back(blob(std::vector<int>{2, 1, 1, 3}, std::vector<float>{1, 2, 3, 4, 5, 6}));
+  conv_blobs.push_back(blob(std::vector<int>{2}, std::vector<float>{-1, -2}));
+  model += layer("conv", conv_blobs);
+  // V1 layers (2): name = 4, blobs = 6; legacy num/channels/height/width,
+  // unpacked data, and double_data for the bias
+  std::string weights = varintField(1, 1) + varintField(2, 1) + varintField(3, 2) + varintField(4, 2);
+  for (int i = 0; i < 4; i++)
+  {
+    float f = 0.5f * i;
+    weights += tag(5, 5) + std::string((const char*)&f, 4);
+  }
+  const double bias[2] = {0.25, -0.75};
+  std::string bias_blob = lengthDelimited(8, std::string((const char*)bias, sizeof(bias)));
+  model += lengthDelimited(2, lengthDelimited(4, "ip") + varintField(5, 14) + lengthDelimited(6, weights) +
+                              lengthDelimited(6, bias_blob));
+  // a layer without blobs is left out
+  model += layer("relu", std::vector<std::string>());
+
+  TempDir dir;
+  LayerBlobs blobs;
+  std::string error;
+  ASSERT_TRUE(readCaffemodel(dir.write("tiny.caffemodel", model), blobs, &error)) << error;
+  ASSERT_EQ(2u, blobs.size());
+  ASSERT_EQ(2u, blobs["conv"].size());
+  EXPECT_EQ((std::vector<int>{2, 1, 1, 3}), blobs["conv"][0].shape);
+  EXPECT_EQ((std::vector<float>{1, 2, 3, 4, 5, 6}), blobs["conv"][0].data);
+  EXPECT_EQ((std::vector<float>{-1, -2}), blobs["conv"][1].data);
+  ASSERT_EQ(2u, blobs["ip"].size());
+  EXPECT_EQ((std::vector<int>{1, 1, 2, 2}), blobs["ip"][0].shape);
+  EXPECT_EQ((std::vector<float>{0, 0.5f, 1, 1.5f}), blobs["ip"][0].data);
+  EXPECT_EQ((std::vector<float>{0.25f, -0.75f}), blobs["ip"][1].data);
+}
+
+TEST(CaffeModel, RejectsBrokenWireFormat)
+{
+  std::vector<std::string> blobs(1, blob(std::vector<int>{4}, std::vector<float>{1, 2, 3, 4}));
+  const std::string model = layer("conv", blobs);
+  TempDir dir;
+  LayerBlobs out;
+  std::string error;
+  // cut inside the blob data: its length runs past the end
+  EXPECT_FALSE(readCaffemodel(dir.write("cut.caffemodel", model.substr(0, model.size() - 3)), out, &error));
+  EXPECT_NE(std::string::npos, error.find("not a valid caffemodel")) << error;
+  // a varint that never ends
+  EXPECT_FALSE(readCaffemodel(dir.write("varint.caffemodel", std::string(3, (char)0x80)), out, &error));
+  // wire type 3 (groups) is not used by Caffe
+  EXPECT_FALSE(readCaffemodel(dir.write("group.caffemodel", tag(9, 3)), out, &error));
+  EXPECT_FALSE(readCaffemodel("/nonexistent/net.caffemodel", out, &error));
+  EXPECT_NE(std::string::npos, error.find("cannot open")) << error;
+}
+
+//========== CpuNet ==========
+namespace
+{
+
+const char* kTinyNet =
+    "name: \"tiny\"\n"
+    "layer { name: \"data\" type: \"Input\" top: \"data\"\n"
+    "  input_param { shape { dim: 1 dim: 3 dim: 5 dim: 5 } } }\n"
+    "layer { name: \"conv1\" type: \"Convolution\" bottom: \"data\" top: \"conv1\"\n"
+    "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 stride: 1 } }\n"
+    "layer { name: \"relu1\" type: \"ReLU\" bottom: \"conv1\" top: \"conv1\" }\n"
+    "layer { name: \"pool1\" type: \"Pooling\" bottom: \"conv1\" top: \"pool1\"\n"
+    "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } }\n"
+    "layer { name: \"ip1\" type: \"InnerProduct\" bottom: \"pool1\" top: \"ip1\"\n"
+    "  inner_product_param { num_output: 3 } }\n"
+    "layer { name: \"prob\" type: \"Softmax\" bottom: \"ip1\" top: \"prob\" }\n";
+
+// conv1 K = 3 * 3 * 3 = 27 is odd, so INT8 mode pads it to 28
+const int kIn = 3, kSize = 5, kConv = 4, kPooled = 3, kClasses = 3;
+
+std::vector<float> naiveForward(const std::vector<float>& image, const std::vector<float>& conv_w,
+                                const std::vector<float>& conv_b, const std::vector<float>& ip_w,
+                                const std::vector<float>& ip_b)
+{
+  std::vector<float> conv(kConv * kSize * kSize);
+  for (int o = 0; o < kConv; o++)
+    for (int y = 0; y < kSize; y++)
+      for (int x = 0; x < kSize; x++)
+      {
+        double s = conv_b[o];
+        for (int c = 0; c < kIn; c++)
+          for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+            {
+              const int yy = y - 1 + i, xx = x - 1 + j;
+              if (yy >= 0 && yy < kSize && xx >= 0 && xx < kSize)
+                s += conv_w[((o * kIn + c) * 3 + i) * 3 + j] * image[(c * kSize + yy) * kSize + xx];
+            }
+        conv[(o * kSize + y) * kSize + x] = std::max(0.0, s);
+      }
+  // 2x2 / 2 windows over 5x5: the last row / column window is clipped
+  std::vector<float> pool(kConv * kPooled * kPooled);
+  for (int o = 0; o < kConv; o++)
+    for (int y = 0; y < kPooled; y++)
+      for (int x = 0; x < kPooled; x++)
+      {
+        float m = -FLT_MAX;
+        for (int i = 2 * y; i < std::min(2 * y + 2, kSize); i++)
+          for (int j = 2 * x; j < std::min(2 * x + 2, kSize); j++)
+            m = std::max(m, conv[(o * kSize + i) * kSize + j]);
+        pool[(o * kPooled + y) * kPooled + x] = m;
+      }
+  std::vector<float> prob(kClasses);
+  double total = 0;
+  std::vector<double> logits(kClasses);
+  for (int n = 0; n < kClasses; n++)
+  {
+    double s = ip_b[n];
+    for (size_t k = 0; k < pool.size(); k++)
+      s += ip_w[n * pool.size() + k] * pool[k];
+    logits[n] = s;
+  }
+  const double m = *std::max_element(logits.begin(), logits.end());
+  for (int n = 0; n < kClasses; n++)
+    total += std::exp(logits[n] - m);
+  for (int n = 0; n < kClasses; n++)
+    prob[n] = std::exp(logits[n] - m) / total;
+  return prob;
+}
+
+} // namespace
+
+class TinyNet : public testing::Test
+{
+protected:
+  void SetUp()
+  {
+    conv_w = randomFloats(kConv * kIn * 9, 1, 0.5f);
+    conv_b = randomFloats(kConv, 2, 0.1f);
+    ip_w = randomFloats(kClasses * kConv * kPooled * kPooled, 3, 0.5f);
+    ip_b = randomFloats(kClasses, 4, 0.1f);
+    std::vector<std::string> conv_blobs, ip_blobs;
+    conv_blobs.push_back(blob(std::vector<int>{kConv, kIn, 3, 3}, conv_w));
+    conv_blobs.push_back(blob(std::vector<int>{kConv}, conv_b));
+    ip_blobs.push_back(blob(std::vector<int>{kClasses, kConv * kPooled * kPooled}, ip_w));
+    ip_blobs.push_back(blob(std::vector<int>{kClasses}, ip_b));
+    prototxt = dir.write("tiny.prototxt", kTinyNet);
+    caffemodel = dir.write("tiny.caffemodel", layer("conv1", conv_blobs) + layer("ip1", ip_blobs));
+  }
+
+  TempDir dir;
+  std::string prototxt, caffemodel;
+  std::vector<float> conv_w, conv_b, ip_w, ip_b;
+};
+
+TEST_F(TinyNet, FloatForwardMatchesNaive)
+{
+  CpuNet net(2);
+  std::string error;
+  ASSERT_TRUE(net.load(prototxt, caffemodel, &error)) << error;
+  EXPECT_EQ(3, net.inputChannels());
+  EXPECT_EQ(5, net.inputHeight());
+  const int batch = 3;
+  std::vector<float> input = randomFloats(batch * net.inputSize(), 5);
+  const Blob& prob = net.forward(&input[0], batch);
+  ASSERT_EQ((std::vector<int>{batch, kClasses}), prob.shape);
+  for (int b = 0; b < batch; b++)
+  {
+    std::vector<float> image(input.begin() + b * net.inputSize(), input.begin() + (b + 1) * net.inputSize());
+    std::vector<float> ref = naiveForward(image, conv_w, conv_b, ip_w, ip_b);
+    for (int n = 0; n < kClasses; n++)
+      EXPECT_NEAR(ref[n], prob.data[b * kClasses + n], 1e-5) << "image " << b << " class " << n;
+  }
+  ASSERT_TRUE(net.blob("pool1") != NULL);
+  EXPECT_EQ((std::vector<int>{batch, kConv, kPooled, kPooled}), net.blob("pool1")->shape);
+}
+
+TEST_F(TinyNet, Int8ForwardTracksFloat)
+{
+  CpuNet net(2);
+  std::string error;
+  ASSERT_TRUE(net.load(prototxt, caffemodel, &error)) << error;
+  std::vector<std::pair<std::string, std::string> > layers = net.quantizableLayers();
+  ASSERT_EQ(2u, layers.size());
+  EXPECT_EQ("conv1", layers[0].first);
+  EXPECT_EQ("data", layers[0].second);
+  EXPECT_EQ("pool1", layers[1].second);
+
+  const int batch = 4;
+  std::vector<float> input = randomFloats(batch * net.inputSize(), 6);
+  const std::vector<float> reference = net.forward(&input[0], batch).data;
+  // ranges as calibrate_int8 measures them
+  std::map<std::string, float> max_abs;
+  max_abs["conv1"] = 1.0f;
+  max_abs["ip1"] = *std::max_element(net.blob("pool1")->data.begin(), net.blob("pool1")->data.end());
+  ASSERT_TRUE(net.setInt8(max_abs, &error)) << error;
+  EXPECT_TRUE(net.isInt8());
+  const Blob& prob = net.forward(&input[0], batch);
+  for (size_t i = 0; i < reference.size(); i++)
+    EXPECT_NEAR(reference[i], prob.data[i], 0.02) << "output " << i;
+
+  // inputs past the calibrated range saturate at +-127 instead of
+  // wrapping: the same as the input clipped to the range
+  std::vector<float> loud(input), clipped(input);
+  for (size_t i = 0; i < loud.size(); i++)
+  {
+    loud[i] *= 50;
+    clipped[i] = std::max(-1.0f, std::min(1.0f, loud[i]));
+  }
+  const std::vector<float> saturated = net.forward(&loud[0], batch).data;
+  net.forward(&clipped[0], batch);
+  for (size_t i = 0; i < saturated.size(); i++)
+    EXPECT_EQ(prob.data[i], saturated[i]) << "output " << i;
+
+  net.setFloat();
+  EXPECT_FALSE(net.isInt8());
+  const Blob& back = net.forward(&input[0], batch);
+  for (size_t i = 0; i < reference.size(); i++)
+    EXPECT_EQ(reference[i], back.data[i]);
+}
+
+TEST_F(TinyNet, RejectsBadInt8Tables)
+{
+  CpuNet net(0);
+  std::string error;
+  ASSERT_TRUE(net.load(prototxt, caffemodel, &error)) << error;
+  std::map<std::string, float> max_abs;
+  max_abs["relu1"] = 1;
+  EXPECT_FALSE(net.setInt8(max_abs, &error));
+  max_abs.clear();
+  max_abs["conv1"] = 0;
+  EXPECT_FALSE(net.setInt8(max_abs, &error));
+  EXPECT_FALSE(net.isInt8());
+
+  max_abs.clear();
+  max_abs["conv1"] = 2.5f;
+  max_abs["ip1"] = 0.125f;
+  const std::string table = dir.write("tiny.int8", "");
+  ASSERT_TRUE(writeInt8Table(table, max_abs, "tiny net\ntwo layers", &error)) << error;
+  std::map<std::string, float> read;
+  ASSERT_TRUE(readInt8Table(table, read, &error)) << error;
+  EXPECT_EQ(max_abs, read);
+  EXPECT_FALSE(readInt8Table(dir.write("bad.int8", "conv1\n"), read, &error));
+}
+
+TEST_F(TinyNet, RejectsMismatchedWeights)
+{
+  std::vector<std::string> conv_blobs;
+  conv_blobs.push_back(blob(std::vector<int>{kConv, kIn, 2, 2}, randomFloats(kConv * kIn * 4, 1)));
+  conv_blobs.push_back(blob(std::vector<int>{kConv}, conv_b));
+  std::vector<std::string> ip_blobs;
+  ip_blobs.push_back(blob(std::vector<int>{kClasses, kConv * kPooled * kPooled}, ip_w));
+  ip_blobs.push_back(blob(std::vector<int>{kClasses}, ip_b));
+  const std::string bad = dir.write("bad.caffemodel", layer("conv1", conv_blobs) + layer("ip1", ip_blobs));
+  CpuNet net(0);
+  std::string error;
+  EXPECT_FALSE(net.load(prototxt, bad, &error));
+  EXPECT_NE(std::string::npos, error.find("conv1: 48 weights, expected 108")) << error;
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+/**********************************
+Geometric Cascade Tests
+  A trained tree classifies its training samples, and save() -> load()
+  gives back the same tree, thresholds and leaves to the last bit, even
+  for splits on large feature values such as the density.
+***********************************/
+#include <classification/geometric_cascade.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <velodyne_perception/cluster_descriptor.h>
+
+using namespace classification;
+using velodyne_perception::kDescriptorSize;
+
+namespace
+{
+
+float uniform(float lo, float hi)
+{
+  return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// label 1 (dock) above the density boundary, 0 (buoy) below, 2 (totem)
+// for tall clusters; the other features are noise
+std::vector<GeometricCascade::Sample> randomSamples(size_t n, float boundary)
+{
+  const int height = velodyne_perception::descriptorFeature("extent_z");
+  const int density = velodyne_perception::descriptorFeature("density");
+  std::vector<GeometricCascade::Sample> samples(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    GeometricCascade::Sample& s = samples[i];
+    s.descriptor.resize(kDescriptorSize);
+    for (int f = 0; f < kDescriptorSize; f++)
+      s.descriptor[f] = uniform(0, 10);
+    s.descriptor[density] = boundary + uniform(-50, 50);
+    s.descriptor[height] = uniform(0, 4);
+    s.label = s.descriptor[height] > 3 ? 2 : s.descriptor[density] > boundary ? 1 : 0;
+  }
+  return samples;
+}
+
+std::vector<std::string> labelNames()
+{
+  std::vector<std::string> labels;
+  labels.push_back("buoy");
+  labels.push_back("dock");
+  labels.push_back("totem");
+  return labels;
+}
+
+std::string tempPath()
+{
+  char path[] = "/tmp/cascade_testXXXXXX";
+  const int fd = mkstemp(path);
+  close(fd);
+  return path;
+}
+
+} // namespace
+
+//========== Training ==========
+TEST(GeometricCascade, LearnsTheTrainingSamples)
+{
+  srand(1);
+  const std::vector<GeometricCascade::Sample> samples = randomSamples(200, 1234654.5f);
+  GeometricCascade cascade;
+  cascade.train(samples, labelNames(), 8, 1);
+  ASSERT_FALSE(cascade.empty());
+  EXPECT_GE(cascade.depth(), 2);
+  for (size_t i = 0; i < samples.size(); i++)
+    EXPECT_EQ(samples[i].label, cascade.classify(&samples[i].descriptor[0], 0)) << i;
+  // a pure leaf of a few samples is still below a high confidence
+  float confidence = 0;
+  cascade.classify(&samples[0].descriptor[0], 0, &confidence);
+  EXPECT_GT(confidence, 0.0f);
+  EXPECT_LT(confidence, 1.0f);
+  EXPECT_EQ(-1, cascade.classify(&samples[0].descriptor[0], 1.0f));
+}
+
+//========== Model file ==========
+TEST(GeometricCascade, SaveLoadRoundTrip)
+{
+  srand(2);
+  const std::vector<GeometricCascade::Sample> samples = randomSamples(200, 1234654.5f);
+  GeometricCascade trained;
+  trained.train(samples, labelNames(), 8, 1);
+  const std::string path = tempPath();
+  std::string error;
+  ASSERT_TRUE(trained.save(path, "round trip\nof a density split", &error)) << error;
+  GeometricCascade loaded;
+  ASSERT_TRUE(loaded.load(path, &error)) << error;
+  unlink(path.c_str());
+
+  EXPECT_EQ(trained.labels(), loaded.labels());
+  EXPECT_EQ(trained.leaves(), loaded.leaves());
+  EXPECT_EQ(trained.depth(), loaded.depth());
+  // the training samples and fresh ones end in the same leaves
+  std::vector<GeometricCascade::Sample> all = samples;
+  const std::vector<GeometricCascade::Sample> fresh = randomSamples(1000, 1234654.5f);
+  all.insert(all.end(), fresh.begin(), fresh.end());
+  for (size_t i = 0; i < all.size(); i++)
+  {
+    SCOPED_TRACE(i);
+    float a = -1, b = -2;
+    EXPECT_EQ(trained.classify(&all[i].descriptor[0], 0, &a), loaded.classify(&all[i].descriptor[0], 0, &b));
+    EXPECT_EQ(a, b);
+    if (i < samples.size())
+    {
+      EXPECT_EQ(samples[i].label, loaded.classify(&all[i].descriptor[0], 0));
+    }
+  }
+}
+
+TEST(GeometricCascade, RejectsBadModels)
+{
+  const std::string path = tempPath();
+  std::string error;
+  GeometricCascade cascade;
+  EXPECT_FALSE(cascade.save(path, "", &error));
+
+  const char* const models[] = {
+    "",
+    "split density 1\n",
+    "labels buoy\nsplit unknown_feature 1\n  leaf buoy 0.9 10\n  leaf buoy 0.9 10\n",
+    "labels buoy\nsplit density 1\n  leaf buoy 0.9 10\n",
+    "labels buoy\nleaf dock 0.9 10\n",
+    "labels buoy\nleaf buoy 0.9 10\nleaf buoy 0.9 10\n",
+  };
+  for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+  {
+    SCOPED_TRACE(i);
+    FILE* file = fopen(path.c_str(), "w");
+    fputs(models[i], file);
+    fclose(file);
+    error.clear();
+    EXPECT_FALSE(cascade.load(path, &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_TRUE(cascade.empty());
+  }
+  unlink(path.c_str());
+  EXPECT_FALSE(cascade.load(path, &error));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
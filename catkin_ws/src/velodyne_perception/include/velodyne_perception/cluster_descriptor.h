@@ -0,0 +1,64 @@
+/**********************************
+Cluster Descriptor
+  Geometry of one cluster as a fixed-length float vector, published in
+  ObjectPose.descriptor and read by the geometric cascade of classify_cpu.
+  Extents and the height profile are taken in the bearing-aligned local
+  frame (x from the sensor to the centroid), like the classifier views;
+  the PCA spreads do not depend on the frame.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_CLUSTER_DESCRIPTOR_H
+#define VELODYNE_PERCEPTION_CLUSTER_DESCRIPTOR_H
+
+#include <vector>
+#include <stddef.h>
+#include <pcl/point_cloud.h>
+
+namespace velodyne_perception
+{
+
+// Order of the values in ObjectPose.descriptor
+enum DescriptorFeature
+{
+  kPoints = 0,     // raw point count
+  kRange,          // horizontal distance of the centroid, m
+  kExtentX,        // local frame extents, m
+  kExtentY,
+  kExtentZ,
+  kHeight0,        // fraction of the points in each quarter of the z extent,
+  kHeight1,        // bottom to top
+  kHeight2,
+  kHeight3,
+  kSigma1,         // square roots of the covariance eigenvalues, largest first
+  kSigma2,
+  kSigma3,
+  kDensity,        // points scaled to a range of 10 m (count * (range / 10)^2)
+  kDescriptorSize
+};
+
+// Names used by the cascade model files
+extern const char* const kDescriptorNames[kDescriptorSize];
+
+// Index of a feature name, -1 if unknown
+int descriptorFeature(const char* name);
+
+// xyz holds n points, 3 doubles each, in the sensor frame;
+// descriptor must hold kDescriptorSize floats (all 0 for n == 0)
+void describeGeometry(const double* xyz, size_t n, float* descriptor);
+
+template <typename PointT>
+void describeGeometry(const pcl::PointCloud<PointT>& cloud, std::vector<float>& descriptor)
+{
+  std::vector<double> xyz(3 * cloud.points.size());
+  for (size_t i = 0; i < cloud.points.size(); i++)
+  {
+    xyz[3 * i] = cloud.points[i].x;
+    xyz[3 * i + 1] = cloud.points[i].y;
+    xyz[3 * i + 2] = cloud.points[i].z;
+  }
+  descriptor.resize(kDescriptorSize);
+  describeGeometry(xyz.empty() ? NULL : &xyz[0], cloud.points.size(), &descriptor[0]);
+}
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,163 @@
+/**********************************
+Point Cloud Clustering Pipeline
+  Stages shared by the cluster and labeling nodes, templated on point type.
+  The hot path runs on ClusterPoint (16 bytes for XYZ); colour is only
+  attached when the /cluster_result debug cloud is built.
+Compile definitions (set by CLUSTER_POINT_TYPE in CMakeLists.txt):
+  CLUSTER_POINT_XYZ     pcl::PointXYZ   (default)
+  CLUSTER_POINT_XYZI    pcl::PointXYZI
+  CLUSTER_POINT_XYZL    pcl::PointXYZL
+***********************************/
+#ifndef VELODYNE_PERCEPTION_CLUSTER_PIPELINE_H
+#define VELODYNE_PERCEPTION_CLUSTER_PIPELINE_H
+
+#include <vector>
+#include <stdint.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/filters/radius_outlier_removal.h>
+#include <pcl/segmentation/extract_clusters.h>
+
+namespace velodyne_perception
+{
+
+#if defined(CLUSTER_POINT_XYZI)
+typedef pcl::PointXYZI ClusterPoint;
+#elif defined(CLUSTER_POINT_XYZL)
+typedef pcl::PointXYZL ClusterPoint;
+#else
+typedef pcl::PointXYZ ClusterPoint;
+#endif
+typedef pcl::PointCloud<ClusterPoint> ClusterCloud;
+
+// Axis aligned region in the sensor frame, e.g. the WAM-V hull
+struct RegionXY
+{
+  float x_min;
+  float x_max;
+  float y_min;
+  float y_max;
+};
+
+// Drop every point inside the region (replaces ExtractIndices + setNegative)
+template <typename PointT>
+void removeRegion(const pcl::PointCloud<PointT>& in, pcl::PointCloud<PointT>& out, const RegionXY& region)
+{
+  pcl::PointCloud<PointT> kept;
+  kept.points.reserve(in.points.size());
+  for (size_t i = 0; i < in.points.size(); i++)
+  {
+    const PointT& p = in.points[i];
+    if (p.y <= region.y_max && p.y >= region.y_min && p.x >= region.x_min && p.x <= region.x_max)
+      continue;
+    kept.points.push_back(p);
+  }
+  kept.width = kept.points.size();
+  kept.height = 1;
+  kept.is_dense = in.is_dense;
+  // swap() exchanges these too, so they go into kept (in may be out)
+  kept.header = in.header;
+  kept.sensor_origin_ = in.sensor_origin_;
+  kept.sensor_orientation_ = in.sensor_orientation_;
+  out.swap(kept);
+}
+
+template <typename PointT>
+void removeRadiusOutlier(typename pcl::PointCloud<PointT>::Ptr& cloud, double radius, int min_neighbors)
+{
+  typename pcl::PointCloud<PointT>::Ptr filtered (new pcl::PointCloud<PointT>);
+  pcl::RadiusOutlierRemoval<PointT> outrem;
+  outrem.setInputCloud(cloud);
+  outrem.setRadiusSearch(radius);
+  outrem.setMinNeighborsInRadius(min_neighbors);
+  outrem.filter(*filtered);
+  cloud = filtered;
+}
+
+template <typename PointT>
+void extractClusters(const typename pcl::PointCloud<PointT>::Ptr& cloud, double tolerance,
+                     int min_size, int max_size, std::vector<pcl::PointIndices>& cluster_indices)
+{
+  cluster_indices.clear();
+  if (cloud->points.empty())
+    return;
+  typename pcl::search::KdTree<PointT>::Ptr tree (new pcl::search::KdTree<PointT>);
+  tree->setInputCloud(cloud);
+
+  pcl::EuclideanClusterExtraction<PointT> ec;
+  ec.setClusterTolerance(tolerance);// unit: meter
+  ec.setMinClusterSize(min_size);
+  ec.setMaxClusterSize(max_size);
+  ec.setSearchMethod(tree);
+  ec.setInputCloud(cloud);
+  ec.extract(cluster_indices);
+}
+
+// Write the indexed points into out.points[offset ...], one solid colour.
+// out must already be sized; clusters with disjoint offsets can be written
+// from different threads.
+template <typename PointT>
+void copyColored(const pcl::PointCloud<PointT>& cloud, const std::vector<int>& indices,
+                 uint8_t r, uint8_t g, uint8_t b, pcl::PointCloud<pcl::PointXYZRGB>& out, size_t offset)
+{
+  for (size_t i = 0; i < indices.size(); i++)
+  {
+    const PointT& p = cloud.points[indices[i]];
+    pcl::PointXYZRGB& q = out.points[offset + i];
+    q.x = p.x;
+    q.y = p.y;
+    q.z = p.z;
+    q.r = r;
+    q.g = g;
+    q.b = b;
+  }
+}
+
+// Copy the indexed points into a coloured debug cloud, one solid colour
+template <typename PointT>
+void appendColored(const pcl::PointCloud<PointT>& cloud, const std::vector<int>& indices,
+                   uint8_t r, uint8_t g, uint8_t b, pcl::PointCloud<pcl::PointXYZRGB>& out)
+{
+  size_t offset = out.points.size();
+  out.points.resize(offset + indices.size());
+  copyColored(cloud, indices, r, g, b, out, offset);
+  out.width = out.points.size();
+  out.height = 1;
+}
+
+// Same as appendColored, but magenta on the port side and green on starboard
+template <typename PointT>
+void appendColoredBySide(const pcl::PointCloud<PointT>& cloud, const std::vector<int>& indices,
+                         pcl::PointCloud<pcl::PointXYZRGB>& out)
+{
+  size_t offset = out.points.size();
+  out.points.resize(offset + indices.size());
+  for (size_t i = 0; i < indices.size(); i++)
+  {
+    const PointT& p = cloud.points[indices[i]];
+    pcl::PointXYZRGB& q = out.points[offset + i];
+    q.x = p.x;
+    q.y = p.y;
+    q.z = p.z;
+    if (p.y > 0)
+    {
+      q.r = 255;
+      q.g = 0;
+      q.b = 255;
+    }
+    else
+    {
+      q.r = 0;
+      q.g = 255;
+      q.b = 0;
+    }
+  }
+  out.width = out.points.size();
+  out.height = 1;
+}
+
+} // namespace velodyne_perception
+
+#endif
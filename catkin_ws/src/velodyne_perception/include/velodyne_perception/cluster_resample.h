@@ -0,0 +1,255 @@
+/**********************************
+Cluster Resampling
+  Brings a cluster cloud to a fixed point budget so ObjectPose.cloud and
+  the classifier inputs have a bounded, predictable size.
+  - larger clusters (docks, shoreline) are thinned with farthest point
+    sampling; a voxel grid lets each iteration skip cells that are already
+    closer to the sample set than to the new sample
+  - smaller clusters are padded with jittered copies of their own points
+***********************************/
+#ifndef VELODYNE_PERCEPTION_CLUSTER_RESAMPLE_H
+#define VELODYNE_PERCEPTION_CLUSTER_RESAMPLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+#include <pcl/point_cloud.h>
+
+namespace velodyne_perception
+{
+
+// xorshift32, cheap enough to call per point and safe to keep one per task
+struct FastRand
+{
+  uint32_t state;
+
+  explicit FastRand(uint32_t seed) : state(seed ? seed : 0x9e3779b9u) {}
+
+  uint32_t next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // uniform in [-a, a]
+  float symmetric(float a)
+  {
+    return a * ((next() >> 8) * (2.0f / 16777216.0f) - 1.0f);
+  }
+};
+
+namespace detail
+{
+
+struct FpsCell
+{
+  uint32_t begin;
+  uint32_t end;
+  float lo[3];
+  float hi[3];
+  float max_dist;   // largest squared distance to the sample set inside the cell
+  uint32_t arg;     // where it is
+};
+
+inline float boxDist2(const FpsCell& c, const float* s)
+{
+  float d = 0;
+  for (int a = 0; a < 3; a++)
+  {
+    float e = 0;
+    if (s[a] < c.lo[a])
+      e = c.lo[a] - s[a];
+    else if (s[a] > c.hi[a])
+      e = s[a] - c.hi[a];
+    d += e * e;
+  }
+  return d;
+}
+
+template <typename PointT>
+void finishCloud(const pcl::PointCloud<PointT>& in, pcl::PointCloud<PointT>& out)
+{
+  out.header = in.header;
+  out.width = out.points.size();
+  out.height = 1;
+  out.is_dense = in.is_dense;
+}
+
+} // namespace detail
+
+// Keep `budget` points of `in`, each one as far as possible from the ones
+// already kept. The first sample is in.points[0]. If `in` has no more than
+// `budget` points it is copied unchanged.
+template <typename PointT>
+void farthestPointSample(const pcl::PointCloud<PointT>& in, size_t budget, pcl::PointCloud<PointT>& out)
+{
+  const size_t n = in.points.size();
+  out.points.clear();
+  if (n <= budget)
+  {
+    out.points = in.points;
+    detail::finishCloud(in, out);
+    return;
+  }
+  if (budget == 0)
+  {
+    detail::finishCloud(in, out);
+    return;
+  }
+
+  float lo[3] = {in.points[0].x, in.points[0].y, in.points[0].z};
+  float hi[3] = {lo[0], lo[1], lo[2]};
+  for (size_t i = 1; i < n; i++)
+  {
+    const PointT& p = in.points[i];
+    lo[0] = std::min(lo[0], p.x); hi[0] = std::max(hi[0], p.x);
+    lo[1] = std::min(lo[1], p.y); hi[1] = std::max(hi[1], p.y);
+    lo[2] = std::min(lo[2], p.z); hi[2] = std::max(hi[2], p.z);
+  }
+
+  // about 32 points per cell for a solid cluster, more for a flat one
+  float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+  int cells_long = std::max(1, (int)std::ceil(std::pow(n / 32.0, 1.0 / 3.0)));
+  float leaf = extent > 0 ? extent / cells_long : 1.0f;
+  int dim[3];
+  for (int a = 0; a < 3; a++)
+    dim[a] = std::min(cells_long, (int)((hi[a] - lo[a]) / leaf)) + 1;
+  const size_t num_cells = (size_t)dim[0] * dim[1] * dim[2];
+
+  // counting sort by cell, so every cell is one contiguous run of xyz
+  std::vector<uint32_t> cell_of(n);
+  std::vector<uint32_t> start(num_cells + 1, 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    const PointT& p = in.points[i];
+    int ix = std::min(dim[0] - 1, (int)((p.x - lo[0]) / leaf));
+    int iy = std::min(dim[1] - 1, (int)((p.y - lo[1]) / leaf));
+    int iz = std::min(dim[2] - 1, (int)((p.z - lo[2]) / leaf));
+    cell_of[i] = ((uint32_t)ix * dim[1] + iy) * dim[2] + iz;
+    start[cell_of[i] + 1]++;
+  }
+  for (size_t c = 0; c < num_cells; c++)
+    start[c + 1] += start[c];
+
+  std::vector<uint32_t> order(n);
+  std::vector<float> xyz(3 * n);
+  std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+  for (size_t i = 0; i < n; i++)
+  {
+    uint32_t j = fill[cell_of[i]]++;
+    order[j] = i;
+    xyz[3 * j] = in.points[i].x;
+    xyz[3 * j + 1] = in.points[i].y;
+    xyz[3 * j + 2] = in.points[i].z;
+  }
+
+  std::vector<detail::FpsCell> cells;
+  for (size_t c = 0; c < num_cells; c++)
+  {
+    if (start[c] == start[c + 1])
+      continue;
+    detail::FpsCell cell;
+    cell.begin = start[c];
+    cell.end = start[c + 1];
+    for (int a = 0; a < 3; a++)
+    {
+      cell.lo[a] = xyz[3 * cell.begin + a];
+      cell.hi[a] = cell.lo[a];
+    }
+    for (uint32_t j = cell.begin + 1; j < cell.end; j++)
+      for (int a = 0; a < 3; a++)
+      {
+        cell.lo[a] = std::min(cell.lo[a], xyz[3 * j + a]);
+        cell.hi[a] = std::max(cell.hi[a], xyz[3 * j + a]);
+      }
+    cell.max_dist = std::numeric_limits<float>::max();
+    cell.arg = cell.begin;
+    cells.push_back(cell);
+  }
+
+  std::vector<float> dist(n, std::numeric_limits<float>::max());
+  out.points.reserve(budget);
+  uint32_t cur = 0;
+  for (size_t j = 0; j < n; j++)
+    if (order[j] == 0)
+      cur = j;
+  out.points.push_back(in.points[order[cur]]);
+
+  for (size_t k = 1; k < budget; k++)
+  {
+    const float s[3] = {xyz[3 * cur], xyz[3 * cur + 1], xyz[3 * cur + 2]};
+    float best = -1;
+    uint32_t best_arg = cur;
+    for (size_t c = 0; c < cells.size(); c++)
+    {
+      detail::FpsCell& cell = cells[c];
+      // nothing in here can get closer to s than it already is to the set
+      if (cell.max_dist > detail::boxDist2(cell, s))
+      {
+        float max_dist = -1;
+        uint32_t arg = cell.begin;
+        for (uint32_t j = cell.begin; j < cell.end; j++)
+        {
+          float dx = xyz[3 * j] - s[0];
+          float dy = xyz[3 * j + 1] - s[1];
+          float dz = xyz[3 * j + 2] - s[2];
+          float d = std::min(dist[j], dx * dx + dy * dy + dz * dz);
+          dist[j] = d;
+          if (d > max_dist)
+          {
+            max_dist = d;
+            arg = j;
+          }
+        }
+        cell.max_dist = max_dist;
+        cell.arg = arg;
+      }
+      if (cell.max_dist > best)
+      {
+        best = cell.max_dist;
+        best_arg = cell.arg;
+      }
+    }
+    cur = best_arg;
+    out.points.push_back(in.points[order[cur]]);
+  }
+  detail::finishCloud(in, out);
+}
+
+// Pad `cloud` up to `budget` points. Every source point gets the same
+// number of copies (+-1), each displaced by up to `jitter` metres per axis.
+template <typename PointT>
+void jitterUpsample(pcl::PointCloud<PointT>& cloud, size_t budget, float jitter, FastRand& rng)
+{
+  const size_t n = cloud.points.size();
+  if (n == 0 || n >= budget)
+    return;
+  cloud.points.resize(budget);
+  for (size_t i = n; i < budget; i++)
+  {
+    PointT p = cloud.points[(i - n) % n];
+    p.x += rng.symmetric(jitter);
+    p.y += rng.symmetric(jitter);
+    p.z += rng.symmetric(jitter);
+    cloud.points[i] = p;
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+}
+
+// Exactly `budget` points out (unless `in` is empty)
+template <typename PointT>
+void resampleToBudget(const pcl::PointCloud<PointT>& in, size_t budget, float jitter,
+                      FastRand& rng, pcl::PointCloud<PointT>& out)
+{
+  farthestPointSample(in, budget, out);
+  jitterUpsample(out, budget, jitter, rng);
+}
+
+} // namespace velodyne_perception
+
+#endif
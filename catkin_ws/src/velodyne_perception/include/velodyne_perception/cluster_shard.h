@@ -0,0 +1,138 @@
+/**********************************
+Cluster Shard
+  Labelled cluster clouds packed into a few large files instead of one
+  .pcd per sample. A shard is
+    header    64 bytes, patched when the shard is finished
+    samples   per sample: float x[m], y[m], z[m], uint32 label[m], where m
+              is the point count rounded up to 4 so every array is 16 byte
+              aligned
+    index     per sample: uint64 offset, uint32 points, int32 label
+  in host (little endian) byte order. ShardWriter appends through one
+  buffered stream and starts the next shard (prefix-00000.shard,
+  prefix-00001.shard, ...) every samples_per_shard samples; a shard is
+  written under a .tmp name and renamed once complete. ShardReader maps a
+  shard read-only and hands out pointers into it.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_CLUSTER_SHARD_H
+#define VELODYNE_PERCEPTION_CLUSTER_SHARD_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <pcl/point_cloud.h>
+
+namespace velodyne_perception
+{
+
+struct ShardHeader
+{
+  char magic[8];            // "CLSHARD\0"
+  uint32_t version;
+  uint32_t header_bytes;
+  uint64_t samples;
+  uint64_t points;          // over all samples
+  uint64_t index_offset;
+  uint64_t reserved[3];
+};
+
+struct ShardIndexEntry
+{
+  uint64_t offset;
+  uint32_t points;
+  int32_t label;            // sample label, -1 if none
+};
+
+// most common point label, -1 for an empty sample
+int majorityLabel(const uint32_t* labels, size_t n);
+
+class ShardWriter
+{
+public:
+  ShardWriter();
+  ~ShardWriter();
+
+  bool open(const std::string& prefix, size_t samples_per_shard = 4096, std::string* error = NULL);
+  // label -1 takes the most common point label
+  bool append(const float* xyz, const uint32_t* labels, size_t n, int label = -1, std::string* error = NULL);
+  // any cloud whose points have a label field (PointXYZL, the labelers' PointCloudLabel)
+  template <typename PointT>
+  bool append(const pcl::PointCloud<PointT>& cloud, int label = -1, std::string* error = NULL)
+  {
+    xyz_.resize(3 * cloud.points.size());
+    point_labels_.resize(cloud.points.size());
+    for (size_t i = 0; i < cloud.points.size(); i++)
+    {
+      xyz_[3 * i] = cloud.points[i].x;
+      xyz_[3 * i + 1] = cloud.points[i].y;
+      xyz_[3 * i + 2] = cloud.points[i].z;
+      point_labels_[i] = cloud.points[i].label;
+    }
+    return append(xyz_.empty() ? NULL : &xyz_[0], point_labels_.empty() ? NULL : &point_labels_[0],
+                  cloud.points.size(), label, error);
+  }
+  // finish the open shard
+  bool close(std::string* error = NULL);
+
+  size_t samples() const { return total_samples_; }
+  const std::vector<std::string>& shards() const { return shards_; }   // finished ones
+
+private:
+  bool startShard(std::string* error);
+  bool finishShard(std::string* error);
+  bool write(const void* data, size_t bytes, std::string* error);
+
+  std::string prefix_;
+  size_t samples_per_shard_;
+  FILE* file_;
+  std::string path_;
+  std::vector<char> buffer_;
+  uint64_t offset_;
+  uint64_t points_;
+  std::vector<ShardIndexEntry> index_;
+  size_t total_samples_;
+  std::vector<std::string> shards_;
+  std::vector<float> xyz_;              // scratch of the template append
+  std::vector<uint32_t> point_labels_;
+  std::vector<float> soa_;
+};
+
+class ShardReader
+{
+public:
+  struct Sample
+  {
+    const float* x;
+    const float* y;
+    const float* z;
+    const uint32_t* labels;
+    uint32_t points;
+    int32_t label;
+  };
+
+  ShardReader();
+  ~ShardReader();
+
+  bool open(const std::string& path, std::string* error = NULL);
+  void close();
+
+  size_t size() const { return header_ ? header_->samples : 0; }
+  uint64_t points() const { return header_ ? header_->points : 0; }
+  Sample sample(size_t i) const;
+  const std::string& path() const { return path_; }
+
+private:
+  ShardReader(const ShardReader&);
+  ShardReader& operator=(const ShardReader&);
+
+  std::string path_;
+  const char* data_;
+  size_t bytes_;
+  const ShardHeader* header_;
+  const ShardIndexEntry* index_;
+};
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,151 @@
+/**********************************
+Dataset Loader
+  Multi-view training batches straight from the labelled clouds written
+  by auto_labeling / add_point, rendered by MultiViewRenderer on a
+  TaskPool with per-sample augmentation, so training sees the views the
+  nodes render at runtime and is not bound by image generation.
+  The clouds are read once; a producer thread then keeps up to
+  `prefetch` batches ahead of the consumer:
+    while (const DatasetLoader::Batch* batch = loader.next())
+    {
+      train(batch->images, batch->labels, batch->count);
+      loader.release(batch);
+    }
+  A batch is count x 3 x size x size floats (mean subtracted, the caffe /
+  torch layout) plus int32 labels, in page-aligned buffers that stay
+  allocated for the life of the loader; with lock_memory they are also
+  locked in RAM, so a CUDA consumer can register them once
+  (cudaHostRegister) and copy them asynchronously.
+  A source is a directory of .pcd / .shard files (cluster_shard.h), one
+  .shard, or a list of "cloud.pcd [label]" / "clouds.shard [label]" lines
+  (paths relative to the list). A cloud or shard sample given a label is
+  one sample, a saved cluster. Without one it is a labelled scene and is
+  cut into its objects like the cluster nodes cut a scan: the points of
+  each `label` (0, unlabelled, is dropped) are split into Euclidean
+  clusters of cluster_tolerance, and every cluster of at least min_points
+  points is a sample of that label, its views turned to its own bearing.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_DATASET_LOADER_H
+#define VELODYNE_PERCEPTION_DATASET_LOADER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <velodyne_perception/multiview_renderer.h>
+#include <velodyne_perception/task_pool.h>
+
+namespace velodyne_perception
+{
+
+struct LoaderConfig
+{
+  int size;                 // rendered views, size x size
+  int batch;                // samples per batch
+  int threads;              // render workers, -1 = one per core
+  int prefetch;             // batches rendered ahead of the consumer
+  bool shuffle;             // new order every epoch
+  bool loop;                // false: next() returns NULL after one epoch
+  bool lock_memory;         // mlock the batch buffers
+  uint32_t seed;
+  float mean[3];            // per channel, subtracted from the 0/255 views
+
+  // objects of the labelled scenes, the defaults of the cluster nodes
+  float cluster_tolerance;  // m, 0 = one sample per label
+  int min_points;           // smaller clusters are dropped
+
+  // augmentation, drawn again for every sample in every epoch
+  double rotation;          // rad, added to the bearing, uniform in [-rotation, rotation]
+  float jitter;             // m per axis, uniform in [-jitter, jitter]
+  float dropout;            // drops a fraction uniform in [0, dropout] of the points
+
+  // 227 views, batches of 32, no augmentation
+  LoaderConfig();
+};
+
+class DatasetLoader
+{
+public:
+  struct Batch
+  {
+    const float* images;    // count x 3 x size x size
+    const int32_t* labels;  // count
+    int count;              // < batch only for the last batch of a one-pass loader
+    uint64_t index;         // batches handed out before this one
+  };
+
+  DatasetLoader();
+  ~DatasetLoader();
+
+  // Read the clouds of source and start rendering
+  bool open(const std::string& source, const LoaderConfig& config, std::string* error = NULL);
+
+  // The next batch in order, blocking until it is rendered; NULL after the
+  // last one of a one-pass loader. Hold at most prefetch batches at a time:
+  // with all of them held it returns NULL at once and sets error, which
+  // stays empty at the end of the data.
+  const Batch* next(std::string* error = NULL);
+  // Hand a batch back to be refilled
+  void release(const Batch* batch);
+
+  size_t samples() const { return clouds_.size(); }
+  const std::vector<int>& labels() const { return labels_; }   // per sample
+  const LoaderConfig& config() const { return config_; }
+  // times next() had to wait for the renderer, i.e. the consumer was faster
+  uint64_t stalls() const;
+
+private:
+  enum SlotState
+  {
+    kFree,
+    kFilling,
+    kReady,
+    kHeld
+  };
+  struct Slot
+  {
+    Batch batch;
+    float* images;
+    int32_t* labels;
+    SlotState state;
+  };
+
+  static bool fail(std::string* error, const std::string& msg);
+  bool readSource(const std::string& source, std::vector<std::string>& paths, std::vector<int>& labels,
+                  std::string* error) const;
+  bool readCloud(const std::string& path, int label, std::vector<std::vector<float> >& clouds,
+                 std::vector<int>& labels, std::string* error) const;
+  bool readShard(const std::string& path, int label, std::string* error);
+  void splitObjects(const std::vector<float>& xyz, const std::vector<uint32_t>& point_labels,
+                    std::vector<std::vector<float> >& clouds, std::vector<int>& labels) const;
+  static bool isShard(const std::string& path);
+  void producerLoop();
+  void renderSample(size_t sample, uint64_t epoch, float* chw) const;
+  void close();
+
+  LoaderConfig config_;
+  MultiViewRenderer renderer_;
+  std::unique_ptr<TaskPool> pool_;
+  std::vector<std::vector<float> > clouds_;   // xyz per sample
+  std::vector<int> labels_;
+
+  std::vector<Slot> slots_;
+  size_t image_floats_;     // per sample
+  std::thread producer_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  bool stop_;
+  bool done_;               // the producer has filled the last batch
+  size_t next_slot_;        // slot next() hands out next
+  uint64_t handed_out_;
+  uint64_t produced_;       // batches filled so far
+  uint64_t stalls_;
+};
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,184 @@
+/**********************************
+Dataset Writer
+  Saves the labelled clouds of auto_labeling / manual_label / add_point
+  off the ROS callback thread. write() queues the cloud and returns; a few
+  worker threads encode and save it (binary compressed .pcd, binary .ply
+  when asked for one). The queue is bounded: when the disk falls behind,
+  write() blocks until a slot frees up instead of buffering without limit,
+  and stats() reports how often and for how long that happened. flush()
+  (and the destructor) returns once every queued cloud is on disk, so
+  calling it after ros::spin() returns loses nothing.
+  The cloud must not be modified after it is handed to write().
+***********************************/
+#ifndef VELODYNE_PERCEPTION_DATASET_WRITER_H
+#define VELODYNE_PERCEPTION_DATASET_WRITER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <ros/ros.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <pcl/point_cloud.h>
+
+namespace velodyne_perception
+{
+
+struct DatasetWriterStats
+{
+  uint64_t queued;          // clouds accepted by write()
+  uint64_t written;         // saved (every requested file)
+  uint64_t failed;          // at least one file could not be saved
+  uint64_t blocked;         // write() calls that waited for a free slot
+  double blocked_sec;       // time they waited in total
+  size_t max_depth;         // most clouds waiting at once
+
+  DatasetWriterStats() : queued(0), written(0), failed(0), blocked(0), blocked_sec(0), max_depth(0) {}
+};
+
+template <typename PointT>
+class DatasetWriter
+{
+public:
+  typedef typename pcl::PointCloud<PointT>::ConstPtr CloudConstPtr;
+
+  // compress = false keeps the ASCII .pcd / .ply of savePCDFile / savePLYFile
+  explicit DatasetWriter(int threads = 2, size_t capacity = 16, bool compress = true)
+    : capacity_(std::max<size_t>(1, capacity)), compress_(compress), stop_(false), busy_(0)
+  {
+    for (int i = 0; i < std::max(1, threads); i++)
+      workers_.push_back(std::thread(&DatasetWriter::workerLoop, this));
+  }
+
+  ~DatasetWriter()
+  {
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    not_empty_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++)
+      workers_[i].join();
+  }
+
+  // Queue cloud for pcd_path (and ply_path unless empty)
+  void write(const CloudConstPtr& cloud, const std::string& pcd_path, const std::string& ply_path = "")
+  {
+    Job job;
+    job.cloud = cloud;
+    job.pcd_path = pcd_path;
+    job.ply_path = ply_path;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= capacity_)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      not_full_.wait(lock, [this]() { return queue_.size() < capacity_; });
+      stats_.blocked++;
+      stats_.blocked_sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    queue_.push_back(job);
+    stats_.queued++;
+    stats_.max_depth = std::max(stats_.max_depth, queue_.size());
+    not_empty_.notify_one();
+  }
+
+  // Block until every queued cloud is saved
+  void flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return queue_.empty() && busy_ == 0; });
+  }
+
+  DatasetWriterStats stats() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + busy_;
+  }
+
+private:
+  struct Job
+  {
+    CloudConstPtr cloud;
+    std::string pcd_path;
+    std::string ply_path;
+  };
+
+  void workerLoop()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      not_empty_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      Job job = queue_.front();
+      queue_.pop_front();
+      busy_++;
+      not_full_.notify_one();
+      lock.unlock();
+
+      bool ok = save(job);
+
+      lock.lock();
+      busy_--;
+      if (ok)
+        stats_.written++;
+      else
+        stats_.failed++;
+      if (queue_.empty() && busy_ == 0)
+        idle_.notify_all();
+    }
+  }
+
+  bool save(const Job& job) const
+  {
+    bool ok = true;
+    try
+    {
+      if (!job.pcd_path.empty())
+        ok &= (compress_ ? pcl::io::savePCDFileBinaryCompressed(job.pcd_path, *job.cloud)
+                         : pcl::io::savePCDFileASCII(job.pcd_path, *job.cloud)) == 0;
+      if (!job.ply_path.empty())
+        ok &= (compress_ ? pcl::io::savePLYFileBinary(job.ply_path, *job.cloud)
+                         : pcl::io::savePLYFileASCII(job.ply_path, *job.cloud)) == 0;
+    }
+    catch (std::exception& ex)
+    {
+      ROS_ERROR("[dataset_writer] %s", ex.what());
+      ok = false;
+    }
+    if (!ok)
+      ROS_ERROR("[dataset_writer] cannot save %s", job.pcd_path.empty() ? job.ply_path.c_str() : job.pcd_path.c_str());
+    return ok;
+  }
+
+  const size_t capacity_;
+  const bool compress_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::condition_variable idle_;
+  std::deque<Job> queue_;
+  bool stop_;
+  size_t busy_;             // jobs taken by a worker, not finished yet
+  DatasetWriterStats stats_;
+};
+
+} // namespace velodyne_perception
+
+#endif
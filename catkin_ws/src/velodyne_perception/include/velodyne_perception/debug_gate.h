@@ -0,0 +1,35 @@
+/**********************************
+Debug Output Gate
+  Secondary outputs (/cluster_result, /pcl_points, RViz markers) are only
+  built when someone subscribes to them, and optionally only every n-th
+  frame (param ~debug_decimation).
+***********************************/
+#ifndef VELODYNE_PERCEPTION_DEBUG_GATE_H
+#define VELODYNE_PERCEPTION_DEBUG_GATE_H
+
+#include <ros/ros.h>
+
+namespace velodyne_perception
+{
+
+struct DebugGate
+{
+  int decimation;
+  unsigned int frame;
+
+  DebugGate() : decimation(1), frame(0) {}
+
+  // call once per processed scan
+  void nextFrame() { frame++; }
+
+  bool wants(const ros::Publisher& pub) const
+  {
+    if (pub.getNumSubscribers() == 0)
+      return false;
+    return decimation <= 1 || frame % decimation == 0;
+  }
+};
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,123 @@
+/**********************************
+LiDAR Simulator
+  Synthetic labelled Velodyne scans without Gazebo: the objects of the
+  labeling scenes as a few analytic primitives (spheres, vertical
+  cylinders, yawed boxes), placed with the rules of auto_label(), and a
+  ring / azimuth beam model cast against them. Water returns nothing,
+  like the preprocessed clouds the labelers see. Only the beams whose
+  azimuth and elevation can reach an object are cast, so a scan costs
+  little more than its returns.
+  World frame: water at z = 0, the sensor at (0, 0, height). Scans are in
+  the sensor frame.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_LIDAR_SIM_H
+#define VELODYNE_PERCEPTION_LIDAR_SIM_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <velodyne_perception/cluster_resample.h>
+
+namespace velodyne_perception
+{
+
+struct BeamModel
+{
+  int rings;
+  double min_elevation;     // deg, lowest ring
+  double max_elevation;     // deg, highest ring
+  double azimuth_resolution;  // deg
+  double min_range;         // m
+  double max_range;         // m
+  double range_noise;       // m, standard deviation
+  double dropout;           // probability a return is lost
+  double height;            // m above the water
+
+  // VLP-16 at 10 Hz on the WAM-V
+  BeamModel();
+};
+
+// Label ids are the class_dic of the labelers
+enum SimObjectKind
+{
+  kSimTotem = 0,
+  kSimLightBuoy,
+  kSimDock,
+  kSimBuoy,
+  kSimObjectKinds
+};
+
+extern const char* const kSimObjectNames[kSimObjectKinds];   // "totem", "light_buoy", "dock", "buoy"
+extern const uint32_t kSimObjectLabels[kSimObjectKinds];     // 1, 2, 3, 4
+
+struct SimPrimitive
+{
+  enum Type
+  {
+    kSphere,                // center, size[0] radius
+    kCylinder,              // vertical, center of the base, size[0] radius, size[1] height
+    kBox                    // center, size half extents, rotated by yaw
+  };
+  Type type;
+  double center[3];
+  double size[3];
+  double yaw;
+};
+
+struct SimObject
+{
+  SimObjectKind kind;
+  uint32_t label;
+  double x;                 // world frame
+  double y;
+  double yaw;
+  std::vector<SimPrimitive> parts;  // world frame
+  double radius;            // horizontal bound around (x, y)
+  double bottom;
+  double top;
+};
+
+// One object of the catalogue at (x, y), turned by yaw
+SimObject makeSimObject(SimObjectKind kind, double x, double y, double yaw);
+
+// auto_label(): integer positions in (-range, range), at least wamv_range
+// from the boat and collision from each other
+struct PlacementRules
+{
+  int range;
+  double collision;
+  double wamv_range;
+
+  // the values of auto_labeling (40, 8, 5)
+  PlacementRules();
+};
+
+// One object per kind, random positions and yaw; false if the rules could
+// not be met (too many objects for the range)
+bool placeSimObjects(const std::vector<SimObjectKind>& kinds, const PlacementRules& rules, FastRand& rng,
+                     std::vector<SimObject>& objects);
+
+class LidarSimulator
+{
+public:
+  explicit LidarSimulator(const BeamModel& beams = BeamModel());
+
+  const BeamModel& beams() const { return beams_; }
+
+  // Cast one scan; xyz gets 3 floats and labels one label per return, and
+  // hits, if given, the index in objects of the object each return is on.
+  // rng draws the azimuth phase, the noise and the dropout.
+  void scan(const std::vector<SimObject>& objects, FastRand& rng, std::vector<float>& xyz,
+            std::vector<uint32_t>& labels, std::vector<uint32_t>* hits = NULL) const;
+
+private:
+  BeamModel beams_;
+  std::vector<double> ring_elevation_;   // rad
+  std::vector<double> ring_cos_;
+  std::vector<double> ring_sin_;
+  int azimuths_;
+};
+
+} // namespace velodyne_perception
+
+#endif
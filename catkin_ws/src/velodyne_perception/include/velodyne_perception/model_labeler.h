@@ -0,0 +1,102 @@
+/**********************************
+Model Labeler
+  Labels every point of a scan after the Gazebo models of the labeling
+  scenes: the label of the model whose centre is nearest in x / y (the
+  loop of auto_labeling / manual_label / add_point), compared by squared
+  distance four points at a time with SSE2. A model with a footprint (an
+  oriented box from its pose and size) only takes the points inside it,
+  so the water clutter between the models is no longer given the label
+  of whichever model happens to be closest.
+  Large scans are cut into blocks labelled on a TaskPool; the colour of
+  each point comes from the kLabelColor table of point_cloud_label.h.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_MODEL_LABELER_H
+#define VELODYNE_PERCEPTION_MODEL_LABELER_H
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+#include <velodyne_perception/point_cloud_label.h>
+#include <velodyne_perception/task_pool.h>
+
+namespace velodyne_perception
+{
+
+struct LabelModel
+{
+  float x;                  // centre, in the frame of the scan
+  float y;
+  uint32_t label;
+  // footprint: half extents along the model's own x / y axes, turned by
+  // yaw; 0 for none (the model takes every point it is nearest to)
+  float yaw;
+  float half_length;
+  float half_width;
+
+  LabelModel();
+  LabelModel(float x, float y, uint32_t label);
+};
+
+// Footprint of half extents (half_length, half_width) turned by yaw
+LabelModel footprintModel(float x, float y, uint32_t label, float yaw, float half_length, float half_width);
+
+// index[i] = the model the point (x[i], y[i]) belongs to: the nearest of
+// the models that take it, -1 if none does (it lies outside every
+// footprint). Ties go to the first model.
+void nearestModel(const float* x, const float* y, size_t n, const LabelModel* models, size_t num_models,
+                  int32_t* index);
+
+// Points labelled per block, on the pool when there is more than one
+const size_t kLabelBlock = 4096;
+
+// out gets the x, y, z of in and the label / colour of its model;
+// unclaimed is the label of points outside every footprint
+template <typename InT, typename OutT>
+void labelByModels(const pcl::PointCloud<InT>& in, const std::vector<LabelModel>& models,
+                   pcl::PointCloud<OutT>& out, TaskPool* pool = NULL, uint32_t unclaimed = 0)
+{
+  const size_t n = in.points.size();
+  out.points.resize(n);
+  out.width = in.width;
+  out.height = in.height;
+  out.is_dense = in.is_dense;
+  if (n == 0)
+    return;
+  const size_t blocks = (n + kLabelBlock - 1) / kLabelBlock;
+  const LabelModel* m = models.empty() ? NULL : &models[0];
+  auto block = [&](size_t b)
+  {
+    const size_t first = b * kLabelBlock;
+    const size_t count = std::min(kLabelBlock, n - first);
+    // x / y gathered into planes for the kernel
+    std::vector<float> x(count), y(count);
+    std::vector<int32_t> index(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      x[i] = in.points[first + i].x;
+      y[i] = in.points[first + i].y;
+    }
+    nearestModel(&x[0], &y[0], count, m, models.size(), &index[0]);
+    for (size_t i = 0; i < count; i++)
+    {
+      const InT& p = in.points[first + i];
+      OutT& q = out.points[first + i];
+      q.x = p.x;
+      q.y = p.y;
+      q.z = p.z;
+      setLabel(q, index[i] < 0 ? unclaimed : m[index[i]].label);
+    }
+  };
+  if (pool == NULL || blocks == 1)
+  {
+    for (size_t b = 0; b < blocks; b++)
+      block(b);
+  }
+  else
+    pool->parallelFor(blocks, block);
+}
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,96 @@
+/**********************************
+Multi-view Renderer
+  C++ version of toIMG() in the classification nodes. Projects a cluster
+  to the xy, yz and xz planes and paints every point as a square stamp of
+  side 2*point_size+1 into one 227x227 3-channel image:
+    channel 0 = xz, channel 1 = yz, channel 2 = xy   (255 where hit)
+  Each plane is scaled so its longer side spans size-2*boundary pixels and
+  its shorter side is centred, exactly like the Python code.
+  Dense clusters are rasterized as a centre mask followed by a separable
+  SSE2 max filter, so a dock with thousands of points costs about the same
+  as a plane full of stamps; sparse clusters are stamped directly.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_MULTIVIEW_RENDERER_H
+#define VELODYNE_PERCEPTION_MULTIVIEW_RENDERER_H
+
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+#include <pcl/point_cloud.h>
+#include <sensor_msgs/Image.h>
+
+namespace velodyne_perception
+{
+
+class MultiViewRenderer
+{
+public:
+  explicit MultiViewRenderer(int size = 227, int boundary = 50, int point_size = 4);
+
+  // A renderer for another input size with the proportions of the 227
+  // default (boundary 50, point_size 4), e.g. 113 -> boundary 25, point_size 2
+  static MultiViewRenderer scaledTo(int size);
+
+  int size() const { return size_; }
+  int boundary() const { return boundary_; }
+  int pointSize() const { return point_size_; }
+  size_t imageBytes() const { return (size_t)size_ * size_ * 3; }
+
+  // xyz holds n points, 3 doubles each, already in the cluster frame.
+  // image must hold imageBytes(), row-major HWC; it is cleared first.
+  void render(const double* xyz, size_t n, uint8_t* image) const;
+
+  // Pixels per metre of the xy, yz and xz planes render() would use (the
+  // self.scale of classify_scale.py), 0 for a plane with no extent
+  void scales(const double* xyz, size_t n, double* scale) const;
+
+  // Rotate the cloud by -yaw about z (the classifiers use the bearing of the
+  // centroid, atan2(c.y, c.x)) and render it.
+  template <typename PointT>
+  void render(const pcl::PointCloud<PointT>& cloud, double yaw, uint8_t* image) const
+  {
+    std::vector<double> xyz(3 * cloud.points.size());
+    double c = std::cos(yaw);
+    double s = std::sin(yaw);
+    for (size_t i = 0; i < cloud.points.size(); i++)
+    {
+      const PointT& p = cloud.points[i];
+      xyz[3 * i] = c * p.x + s * p.y;
+      xyz[3 * i + 1] = -s * p.x + c * p.y;
+      xyz[3 * i + 2] = p.z;
+    }
+    render(xyz.empty() ? NULL : &xyz[0], cloud.points.size(), image);
+  }
+
+  // Same, straight into a bgr8 sensor_msgs/Image
+  template <typename PointT>
+  void render(const pcl::PointCloud<PointT>& cloud, double yaw, sensor_msgs::Image& msg) const
+  {
+    msg.height = size_;
+    msg.width = size_;
+    msg.encoding = "bgr8";
+    msg.is_bigendian = 0;
+    msg.step = size_ * 3;
+    msg.data.resize(imageBytes());
+    render(cloud, yaw, &msg.data[0]);
+  }
+
+  // One HWC image into a CHW float slice of imageBytes() values:
+  // chw[c][y][x] = image[y][x][c] - mean[c], the layout caffe's data blob
+  // expects after Transformer.set_transpose('data', (2, 0, 1))
+  void toTensor(const uint8_t* image, const float* mean, float* chw) const;
+
+private:
+  // one plane: coordinates a (rows) and b (cols) of every point; mask and
+  // dilated are scratch planes of (size + 2*point_size) rows of stride bytes
+  void renderPlane(const double* xyz, size_t n, int a, int b, int channel,
+                   size_t stride, uint8_t* mask, uint8_t* dilated, uint8_t* image) const;
+
+  int size_;
+  int boundary_;
+  int point_size_;
+};
+
+} // namespace velodyne_perception
+
+#endif
@@ -0,0 +1,59 @@
+/**********************************
+Point Cloud Label
+  The point type of the labelled dataset (x, y, z, rgb, label), the same
+  fields as the PointCloudLabel of auto_labeling / manual_label /
+  add_point, so clouds written with either read back identically. The
+  colour of a point follows its label: 1 green, 2 yellow, 3 white,
+  4 to 6 blue, anything else black.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_POINT_CLOUD_LABEL_H
+#define VELODYNE_PERCEPTION_POINT_CLOUD_LABEL_H
+
+#include <stdint.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+namespace velodyne_perception
+{
+
+struct EIGEN_ALIGN16 PointCloudLabel   // enforce SSE padding for correct memory alignment
+{
+  PCL_ADD_POINT4D;                  // preferred way of adding a XYZ+padding
+  PCL_ADD_RGB;
+  uint32_t label;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW   // make sure our new allocators are aligned
+};
+
+const int kLabelColors = 7;
+// r, g, b per label
+const uint8_t kLabelColor[kLabelColors][3] = {
+  {0, 0, 0},
+  {0, 255, 0},
+  {255, 255, 0},
+  {255, 255, 255},
+  {0, 0, 255},
+  {0, 0, 255},
+  {0, 0, 255}
+};
+
+template <typename PointT>
+inline void setLabel(PointT& p, uint32_t label)
+{
+  const uint8_t* c = kLabelColor[label < (uint32_t)kLabelColors ? label : 0];
+  p.label = label;
+  p.r = c[0];
+  p.g = c[1];
+  p.b = c[2];
+}
+
+} // namespace velodyne_perception
+
+POINT_CLOUD_REGISTER_POINT_STRUCT (velodyne_perception::PointCloudLabel,
+                                   (float, x, x)
+                                   (float, y, y)
+                                   (float, z, z)
+                                   (float, rgb, rgb)
+                                   (uint32_t, label, label)
+)
+
+#endif
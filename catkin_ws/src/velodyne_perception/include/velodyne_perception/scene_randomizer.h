@@ -0,0 +1,87 @@
+/**********************************
+Scene Randomizer
+  Moves the Gazebo models of a labeling scene without blocking the scan
+  callback, and tells which scan is the first one of the settled scene:
+    randomize(models)   SetModelState for every model, on a thread
+    settled(stamp)      false until the moved models have kept still
+                        (/gazebo/model_states) for ~settle_time, then true
+                        for scans stamped after that
+  so the labelers label as soon as the simulator allows instead of
+  sleeping a fixed time per sample, and the next scene can be moving
+  while the current sample is labelled and saved. A scene that never
+  settles (waves) is taken anyway after ~settle_timeout.
+Params (private):
+  ~settle_speed         (m/s, default 0.1)
+  ~settle_tolerance     (m from the requested position, default 1.0)
+  ~settle_time          (s, default 0.5)
+  ~settle_timeout       (s, default 5)
+***********************************/
+#ifndef VELODYNE_PERCEPTION_SCENE_RANDOMIZER_H
+#define VELODYNE_PERCEPTION_SCENE_RANDOMIZER_H
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ros/ros.h>
+#include <gazebo_msgs/ModelStates.h>
+
+namespace velodyne_perception
+{
+
+struct SceneModel
+{
+  std::string name;
+  double x;                 // world frame
+  double y;
+  double z;
+};
+
+class SceneRandomizer
+{
+public:
+  enum State
+  {
+    kIdle,                  // nothing requested yet
+    kMoving,                // SetModelState calls in flight
+    kSettling,              // waiting for the models to keep still
+    kSettled
+  };
+
+  SceneRandomizer(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+  ~SceneRandomizer();
+
+  // Start moving the models of the next scene; returns at once
+  void randomize(const std::vector<SceneModel>& models);
+  // Whether a scan stamped stamp shows the settled scene
+  bool settled(const ros::Time& stamp);
+  State state() const;
+
+  // scenes given up on after ~settle_timeout
+  unsigned int timeouts() const;
+
+private:
+  void moveModels(std::vector<SceneModel> models);
+  void statesCallback(const gazebo_msgs::ModelStatesConstPtr& msg);
+
+  std::string node_name_;
+  double settle_speed_;
+  double settle_tolerance_;
+  ros::Duration settle_time_;
+  ros::Duration settle_timeout_;
+  ros::ServiceClient client_;
+  ros::Subscriber sub_states_;
+  std::thread mover_;
+
+  mutable std::mutex mutex_;
+  State state_;
+  std::vector<SceneModel> targets_;
+  ros::Time moved_at_;      // last SetModelState returned
+  ros::Time still_since_;   // zero while a model moves
+  ros::Time settled_at_;    // scans from here on show the scene
+  unsigned int timeouts_;
+};
+
+} // namespace velodyne_perception
+
+#endif
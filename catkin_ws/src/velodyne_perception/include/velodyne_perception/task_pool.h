@@ -0,0 +1,169 @@
+/**********************************
+Task Pool
+  Fixed set of worker threads, one task deque per worker. Idle workers
+  steal from the back of the other deques, so uneven clusters (one dock,
+  many buoys) still keep every core busy.
+  parallelFor() blocks until all indices are done; the calling thread
+  works on the tasks too, so a pool of size 0 runs everything inline.
+***********************************/
+#ifndef VELODYNE_PERCEPTION_TASK_POOL_H
+#define VELODYNE_PERCEPTION_TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace velodyne_perception
+{
+
+class TaskPool
+{
+public:
+  // num_threads < 0 uses one worker per hardware thread (minus the caller)
+  explicit TaskPool(int num_threads = -1)
+    : stop_(false), queued_(0)
+  {
+    if (num_threads < 0)
+    {
+      int hw = std::thread::hardware_concurrency();
+      num_threads = hw > 1 ? hw - 1 : 0;
+    }
+    // slot 0 belongs to the calling thread
+    for (int i = 0; i <= num_threads; i++)
+      queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    for (int i = 1; i <= num_threads; i++)
+      threads_.push_back(std::thread(&TaskPool::workerLoop, this, i));
+  }
+
+  ~TaskPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++)
+      threads_[i].join();
+  }
+
+  size_t size() const { return threads_.size(); }
+
+  // Run fn(i) for every i in [0, n). Indices are dealt round-robin to the
+  // worker deques; order of completion is unspecified, so fn must only
+  // write to the slot it owns.
+  template <typename Fn>
+  void parallelFor(size_t n, Fn fn)
+  {
+    if (n == 0)
+      return;
+    if (threads_.empty() || n == 1)
+    {
+      for (size_t i = 0; i < n; i++)
+        fn(i);
+      return;
+    }
+
+    std::atomic<size_t> remaining(n);
+    std::mutex done_mutex;
+    std::condition_variable done;
+    for (size_t i = 0; i < n; i++)
+    {
+      Queue& q = *queues_[i % queues_.size()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back([&fn, &remaining, &done_mutex, &done, i]()
+      {
+        fn(i);
+        // decrement under the lock so the caller cannot return while we
+        // still touch done_mutex
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (--remaining == 0)
+          done.notify_all();
+      });
+    }
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      queued_ += n;
+    }
+    wake_.notify_all();
+
+    // help out until our queue and everybody else's are drained
+    std::function<void()> task;
+    while (remaining.load() > 0 && findTask(0, task))
+    {
+      task();
+      task = std::function<void()>();
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    while (remaining.load() > 0)
+      done.wait(lock);
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque< std::function<void()> > tasks;
+  };
+
+  // own deque from the front, everybody else's from the back
+  bool findTask(size_t id, std::function<void()>& task)
+  {
+    for (size_t k = 0; k < queues_.size(); k++)
+    {
+      size_t victim = (id + k) % queues_.size();
+      Queue& q = *queues_[victim];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty())
+        continue;
+      if (k == 0)
+      {
+        task = q.tasks.front();
+        q.tasks.pop_front();
+      }
+      else
+      {
+        task = q.tasks.back();
+        q.tasks.pop_back();
+      }
+      std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+      queued_--;
+      return true;
+    }
+    return false;
+  }
+
+  void workerLoop(size_t id)
+  {
+    std::function<void()> task;
+    while (true)
+    {
+      if (findTask(id, task))
+      {
+        task();
+        task = std::function<void()>();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      while (!stop_ && queued_ <= 0)
+        wake_.wait(lock);
+      if (stop_)
+        return;
+    }
+  }
+
+  std::vector< std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  long queued_;  // may dip below zero while parallelFor is still queueing
+};
+
+} // namespace velodyne_perception
+
+#endif
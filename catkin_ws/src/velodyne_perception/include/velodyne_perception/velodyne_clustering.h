@@ -0,0 +1,157 @@
+/**********************************
+Velodyne Clustering
+  One implementation of the filter -> cluster -> describe -> publish
+  pipeline behind cluster, cluster_with_odom, cluster_no_preprocess and
+  pcl_cluster. The executables only pick a ClusteringConfig; every field
+  can also be overridden from the private namespace (see load()).
+Subscribe:
+  <input_topic>         (sensor_msgs/PointCloud2)
+  /odometry/filtered    (nav_msgs/Odometry, use_odom only)
+Publish:
+  /obstacle_list        (robotx_msgs/ObstaclePoseList)
+  /obj_list             (robotx_msgs/ObjectPoseList)
+  /obstacle_marker      (visualization_msgs/MarkerArray)
+  /obstacle_marker_line (visualization_msgs/MarkerArray)
+  /cluster_result       (sensor_msgs/PointCloud2)
+  /pcl_points           (robotx_msgs/PCL_points)
+  /cluster_tensor       (robotx_msgs/ClusterTensor, views of every cluster
+                         in obj_list order, one NCHW float blob per scan)
+***********************************/
+#ifndef VELODYNE_PERCEPTION_VELODYNE_CLUSTERING_H
+#define VELODYNE_PERCEPTION_VELODYNE_CLUSTERING_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <nav_msgs/Odometry.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/synchronizer.h>
+#include <message_filters/sync_policies/approximate_time.h>
+#include <robotx_msgs/ObstaclePoseList.h>
+#include <robotx_msgs/ObjectPoseList.h>
+#include <robotx_msgs/PCL_points.h>
+#include <robotx_msgs/ClusterTensor.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include <velodyne_perception/cluster_pipeline.h>
+#include <velodyne_perception/debug_gate.h>
+#include <velodyne_perception/multiview_renderer.h>
+#include <velodyne_perception/task_pool.h>
+
+namespace velodyne_perception
+{
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> PointCloudXYZRGB;
+
+struct ClusteringConfig
+{
+  std::string name;               // log prefix
+  std::string input_topic;
+  bool use_odom;                  // sync with /odometry/filtered, fill varianceX/Y
+  int queue_size;                 // of /obstacle_list and /obj_list
+
+  // filter
+  bool remove_wamv;
+  RegionXY wamv;
+  double outlier_radius;          // <= 0 skips radius outlier removal
+  int outlier_min_neighbors;
+
+  // cluster
+  double cluster_tolerance;       // unit: meter
+  int min_cluster_size;
+  int max_cluster_size;
+
+  // describe
+  bool embed_points;              // fill ObjectPose.pcl_points
+  bool set_position_local;        // ObjectPose.position_local = centroid
+  int point_budget;               // 0 keeps every raw point
+  bool render_views;              // fill ObjectPose.views with the xy/yz/xz image
+  std::vector<float> tensor_mean; // per channel, subtracted in /cluster_tensor
+  bool local_frame;               // fill ObjectPose.local_yaw/local_min/local_max/pcl_points_local
+  bool descriptor;                // fill ObjectPose.descriptor (cluster_descriptor.h)
+
+  // publish
+  bool visual;                    // RViz markers
+  bool marker_scale_from_extent;  // otherwise unit cubes
+  int debug_decimation;
+  int threads;                    // task pool workers, -1 = one per core
+
+  // defaults are the plain cluster node
+  ClusteringConfig();
+
+  // override any field from the (private) parameter server
+  void load(const ros::NodeHandle& private_nh);
+};
+
+// Everything built for one scan
+struct ClusterFrame
+{
+  std_msgs::Header header;
+  std::vector<pcl::PointIndices> cluster_indices;
+  robotx_msgs::ObstaclePoseList ob_list;
+  robotx_msgs::ObjectPoseList obj_list;
+  robotx_msgs::PCL_points pcl_points;
+  PointCloudXYZRGB::Ptr result;
+  bool build_result;
+  bool build_points;
+  robotx_msgs::ClusterTensor tensor;
+  bool build_tensor;
+};
+
+class ClusteringPipeline
+{
+public:
+  // nh resolves the topics
+  ClusteringPipeline(ros::NodeHandle& nh, const ClusteringConfig& config);
+
+  const ClusteringConfig& config() const { return config_; }
+
+  // ======= stages, usable on their own =======
+  void filter(const ClusterCloud& in, ClusterCloud::Ptr& out) const;
+  void cluster(const ClusterCloud::Ptr& cloud, ClusterFrame& frame) const;
+  void describe(const ClusterCloud::Ptr& cloud, ClusterFrame& frame);
+  void publish(ClusterFrame& frame);
+
+  // all four on one scan
+  void process(const sensor_msgs::PointCloud2& input, const nav_msgs::Odometry* odom);
+
+private:
+  typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::PointCloud2, nav_msgs::Odometry> SyncPolicy;
+
+  void cloudCallback(const sensor_msgs::PointCloud2ConstPtr& input);
+  void syncCallback(const sensor_msgs::PointCloud2ConstPtr& input, const nav_msgs::OdometryConstPtr& odom);
+  void describeCluster(const ClusterCloud& cloud, size_t k, size_t result_offset, ClusterFrame& frame) const;
+  void drawRviz(const robotx_msgs::ObstaclePoseList& ob_list);
+  void drawRviz_line(const robotx_msgs::ObstaclePoseList& ob_list);
+
+  ClusteringConfig config_;
+  DebugGate debug_gate_;
+  std::unique_ptr<TaskPool> task_pool_;
+  MultiViewRenderer renderer_;
+
+  ClusterCloud::Ptr cloud_in_;
+  ClusterCloud::Ptr cloud_filtered_;
+  PointCloudXYZRGB::Ptr result_;
+  visualization_msgs::MarkerArray marker_array_;
+  visualization_msgs::MarkerArray marker_array_line_;
+
+  ros::Subscriber sub_;
+  boost::shared_ptr< message_filters::Subscriber<sensor_msgs::PointCloud2> > pcl_sub_;
+  boost::shared_ptr< message_filters::Subscriber<nav_msgs::Odometry> > odom_sub_;
+  boost::shared_ptr< message_filters::Synchronizer<SyncPolicy> > sync_;
+
+  ros::Publisher pub_obstacle_;
+  ros::Publisher pub_object_;
+  ros::Publisher pub_marker_;
+  ros::Publisher pub_marker_line_;
+  ros::Publisher pub_result_;
+  ros::Publisher pub_points_;
+  ros::Publisher pub_tensor_;
+};
+
+} // namespace velodyne_perception
+
+#endif
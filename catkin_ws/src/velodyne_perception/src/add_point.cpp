@@ -65,42 +65,29 @@ Publish:
 #include <tf_conversions/tf_eigen.h>
 #include <tf2/LinearMath/Quaternion.h>
 
+#include <velodyne_perception/cluster_pipeline.h>
+#include <velodyne_perception/cluster_resample.h>
+#include <velodyne_perception/debug_gate.h>
+#include <velodyne_perception/dataset_writer.h>
+#include <velodyne_perception/model_labeler.h>
+#include <velodyne_perception/scene_randomizer.h>
+
 using namespace Eigen;
 using namespace message_filters;
+using velodyne_perception::ClusterPoint;
+using velodyne_perception::ClusterCloud;
 //define point cloud type
 
-typedef uint32_t uint32;
-struct PointCloudLabel
-{
-  PCL_ADD_POINT4D;                  // preferred way of adding a XYZ+padding
-  PCL_ADD_RGB;
-  uint32 label;
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW   // make sure our new allocators are aligned
-} EIGEN_ALIGN16;                    // enforce SSE padding for correct memory alignment
-
-POINT_CLOUD_REGISTER_POINT_STRUCT (PointCloudLabel,           // here we assume a XYZ + "test" (as fields)
-                                   (float, x, x)
-                                   (float, y, y)
-                                   (float, z, z)
-                                   (float, rgb, rgb)
-                                   (uint32, label, label)
-)
-
-typedef pcl::PointCloud<pcl::PointXYZ> PointCloudXYZ;
+// x, y, z, rgb, label, coloured after the label (point_cloud_label.h)
+using velodyne_perception::PointCloudLabel;
+
 typedef pcl::PointCloud<pcl::PointXYZRGB> PointCloudXYZRGB;
 typedef pcl::PointCloud<PointCloudLabel> PointLabel;
 
 //typedef boost::shared_ptr <robotx_msgs::BoolStamped const> BoolStampedConstPtr;
 //declare point cloud
-PointCloudXYZ::Ptr cloud_inXYZ (new PointCloudXYZ);
-PointCloudXYZRGB::Ptr cloud_in (new PointCloudXYZRGB); 
-PointCloudXYZRGB::Ptr cloud_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr plane_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_h (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_f (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_plane (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_scene(new PointCloudXYZRGB);
-//PointCloudXYZRGB::Ptr wall (new PointCloudXYZRGB);
+ClusterCloud::Ptr cloud_in (new ClusterCloud);
+ClusterCloud::Ptr cloud_filtered (new ClusterCloud);
 PointCloudXYZRGB::Ptr result (new PointCloudXYZRGB);
 PointLabel::Ptr label_cloud (new PointLabel);
 
@@ -114,7 +101,6 @@ ros::Publisher pub_marker_line;
 ros::Publisher pub_obstacle;
 ros::Publisher pub_object;
 ros::Publisher pub_points;
-ros::ServiceClient client;
 ros::ServiceClient get_client;
 
 //declare global variable
@@ -130,6 +116,9 @@ float feature_sampling_space = 0.1;
 visualization_msgs::MarkerArray marker_array;
 visualization_msgs::MarkerArray marker_array_line;
 ros::Time pcl_t;
+velodyne_perception::DebugGate debug_gate;
+int point_budget = 2048;
+velodyne_perception::FastRand rng(time(NULL));
 
 int MODEL_NUM = 1;
 std::string model_id[1] = {"dock"};
@@ -139,19 +128,25 @@ float new_pos_arr[1][2];
 float new_pos_arr_tf[1][2];
 float pos_arr[1][2];
 float pos_arr_tf[1][2];
-bool first = true;
+float new_yaw_tf[1];
+float yaw_tf[1];
+// half length / half width of the model footprints, m
+float footprint_size[1][2] = {{4.0, 2.0}};
+bool use_footprints = false;
 int pcd_count = 186;
 
 //declare function
 void cloud_cb(const sensor_msgs::PointCloud2ConstPtr&); //point cloud subscriber call back function
 void cluster_pointcloud(void); //point cloud clustering
-void set_gazebo_world(std::string model_name, int x, int y, float z);
 void get_model_state(std::string model_name);
 void auto_label(void);
 void drawRviz(robotx_msgs::ObstaclePoseList); //draw marker in Rviz
 void drawRviz_line(robotx_msgs::ObstaclePoseList); //draw marker line list in Rviz
 
 tf::TransformListener* lr;
+velodyne_perception::DatasetWriter<PointCloudLabel>* dataset_writer;
+velodyne_perception::TaskPool* label_pool;
+velodyne_perception::SceneRandomizer* randomizer;
 int gazebo_world_counter = 0;
 int move_x = 0;
 tf::StampedTransform tf_transform;
@@ -163,25 +158,7 @@ void callback(const sensor_msgs::PointCloud2ConstPtr& input)
     //covert from ros type to pcl type
     pcl_frame_id.data = input->header.frame_id;
     pcl_t = input->header.stamp;
-    pcl::fromROSMsg (*input, *cloud_inXYZ);
-    copyPointCloud(*cloud_inXYZ, *cloud_in);
-
-    //set color for point cloud
-    for (size_t i = 0; i < cloud_in->points.size(); i++){
-      if (cloud_in->points[i].y > 0)
-      {
-      	cloud_in->points[i].r = 255;
-      	cloud_in->points[i].g = 0;
-      	cloud_in->points[i].b = 255;
-      }
-      else
-      {
-      	cloud_in->points[i].r = 0;
-      	cloud_in->points[i].g = 255;
-      	cloud_in->points[i].b = 0;
-      }
-      
-    }
+    pcl::fromROSMsg (*input, *cloud_in);
     clock_t t_start = clock();
 
     std::string source_frame="/velodyne";
@@ -213,34 +190,12 @@ void get_model_state(std::string model_name)
   get_client.call(getmodelstate);
 }
 
-void set_gazebo_world(std::string model_name, int x, int y, float z)
-{
-	gazebo_msgs::ModelState modelstate;
-    modelstate.model_name = (std::string) model_name;
-    modelstate.pose.position.x = x;
-    modelstate.pose.position.y = y;
-    modelstate.pose.position.z = z;
-    /*if (model_name == "wamv")
-    {
-    	tf2::Quaternion quat;
-    	quat.setRPY(0, 0, 3.14);
-    	modelstate.pose.orientation.x = quat[0];
-    	modelstate.pose.orientation.y = quat[1];
-    	modelstate.pose.orientation.z = quat[2];
-    	modelstate.pose.orientation.w = quat[3];
-    }*/
-    
-    gazebo_msgs::SetModelState setmodelstate;
-    setmodelstate.request.model_state = modelstate;
-    client.call(setmodelstate);
-}
-
 void auto_label()
 {
 	int RAND_RANGE = 35;
 	float COLLISION_DIS = 5;
 	float WAMV_RANGE = 8;
-	srand(time(NULL));
+	std::vector<velodyne_perception::SceneModel> scene(MODEL_NUM + 1);
 	for(int i = 0; i < MODEL_NUM; i++)
 	{
 		bool model_collision = true;
@@ -265,31 +220,49 @@ void auto_label()
 				if (dis < COLLISION_DIS){model_collision = true;}
 			}
 		}
-		set_gazebo_world(model_id[i], x, y, z_height[i]);
+		scene[i].name = model_id[i];
+		scene[i].x = x;
+		scene[i].y = y;
+		scene[i].z = z_height[i];
 		tf::Quaternion quat = tf_transform.getRotation();
   		tf::Matrix3x3 tf_rot(quat);
   		tf::Vector3 pos(x, y, 0);
   		tf::Vector3 tf_pos = tf_rot * pos;
   		new_pos_arr_tf[i][0] = tf_pos[0];
   		new_pos_arr_tf[i][1] = tf_pos[1];
+  		// the models are set unturned, only the sensor is
+  		new_yaw_tf[i] = tf::getYaw(quat);
 	}
-	set_gazebo_world("wamv", 0, 0, -0.0823);
+	scene[MODEL_NUM].name = "wamv";
+	scene[MODEL_NUM].x = 0;
+	scene[MODEL_NUM].y = 0;
+	scene[MODEL_NUM].z = -0.0823;
+	// returns at once, the models move and settle while this scan is labelled
+	randomizer->randomize(scene);
 }
 
 //void cloud_cb(const sensor_msgs::PointCloud2ConstPtr& input)
 void cluster_pointcloud()
 {
+  //========== Scene ==========
+  // only the first scan of a settled scene is labelled
+  if (randomizer->state() == velodyne_perception::SceneRandomizer::kIdle)
+  {
+    auto_label();
+    lock = false;
+    return;
+  }
+  if (!randomizer->settled(pcl_t))
+  {
+    lock = false;
+    return;
+  }
+
   //std::cout<< "start processing point clouds" << std::endl;
   copyPointCloud(*cloud_in, *cloud_filtered);  
 
   //========== Outlier remove ==========
-  pcl::RadiusOutlierRemoval<pcl::PointXYZRGB> outrem;
-  // build the filter
-  outrem.setInputCloud(cloud_filtered);
-  outrem.setRadiusSearch(6);
-  outrem.setMinNeighborsInRadius (2);
-  // apply filter
-  outrem.filter (*cloud_filtered);
+  velodyne_perception::removeRadiusOutlier<ClusterPoint>(cloud_filtered, 6, 2);
 
   //========== Auto Labeling ==========
   for (int i = 0; i < MODEL_NUM; i++)
@@ -298,81 +271,21 @@ void cluster_pointcloud()
   	{
   		pos_arr_tf[i][j] = new_pos_arr_tf[i][j];
   	}
+  	yaw_tf[i] = new_yaw_tf[i];
   }
   auto_label();
 
-  ros::Duration(3).sleep();
-  if (first)
-  {
-  	first = false;
-  	lock = false;
-  	return;
-  }
-
-  label_cloud->points.resize(cloud_filtered->points.size());
-  label_cloud->width = cloud_filtered->width;
-  label_cloud->height = cloud_filtered->height;
-  
-  for(size_t idx = 0; idx < cloud_filtered->points.size(); ++idx)
+  std::vector<velodyne_perception::LabelModel> models(MODEL_NUM);
+  for (int i = 0; i < MODEL_NUM; i++)
   {
-  	float x = cloud_filtered->points[idx].x;
-  	float y = cloud_filtered->points[idx].y;
-  	float z = cloud_filtered->points[idx].z;
-  	float min_dis = 100000000;
-  	int min_idx;
-  	for(int i = 0; i < MODEL_NUM; i++)
-  	{
-  		
-  		float dis = sqrt(pow((x-pos_arr_tf[i][0]), 2) + pow((y-pos_arr_tf[i][1]), 2));
-  		//float dis = sqrt(pow((x+pos_arr[i][1]), 2) + pow((y-pos_arr[i][0]), 2));
-  		if(min_dis > dis)
-  		{
-  			min_dis = dis;
-  			min_idx = i;
-  		}
-  	}
-  	
-  	label_cloud->points[idx].x = x;
-  	label_cloud->points[idx].y = y;
-  	label_cloud->points[idx].z = z;
-  	label_cloud->points[idx].label = class_dic[min_idx];
-  	if (label_cloud->points[idx].label == 1)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 0;
-  	}
-  	else if (label_cloud->points[idx].label == 2)
-  	{
-  		label_cloud->points[idx].r = 255;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 0;
-  	}
-  	else if (label_cloud->points[idx].label == 3)
-  	{
-  		label_cloud->points[idx].r = 255;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 4)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 5)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 6)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
+  	if (use_footprints)
+  		models[i] = velodyne_perception::footprintModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i], yaw_tf[i],
+  		                                                footprint_size[i][0], footprint_size[i][1]);
+  	else
+  		models[i] = velodyne_perception::LabelModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i]);
   }
+  // points outside every footprint get label 0
+  velodyne_perception::labelByModels(*cloud_filtered, models, *label_cloud, label_pool);
 
   
 
@@ -382,61 +295,39 @@ void cluster_pointcloud()
   //========== Point Cloud Clusterlabeling ==========
   // Declare variable
   int num_cluster = 0;
+  debug_gate.nextFrame();
+  bool build_result = debug_gate.wants(pub_result);
 
-  // Creating the KdTree object for the search method of the extraction
-  pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB>);
-  tree->setInputCloud (cloud_filtered);
-
-  // Create cluster object
   std::vector<pcl::PointIndices> cluster_indices;
-  pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> ec;
-  ec.setClusterTolerance (3.7);// unit: meter
-  ec.setMinClusterSize (5);
-  ec.setMaxClusterSize (100000);
-  ec.setSearchMethod (tree);
-  ec.setInputCloud (cloud_filtered);
-  ec.extract (cluster_indices);
+  velodyne_perception::extractClusters<ClusterPoint>(cloud_filtered, 3.7, 5, 100000, cluster_indices);
 
   for (std::vector<pcl::PointIndices>::const_iterator it = cluster_indices.begin (); it != cluster_indices.end (); ++it)
   {
     Eigen::Vector4f centroid;
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);
+    ClusterCloud::Ptr cloud_cluster (new ClusterCloud);
     PointLabel::Ptr cloud_label (new PointLabel);
 
     for (std::vector<int>::const_iterator pit = it->indices.begin (); pit != it->indices.end (); ++pit)
     {
       cloud_cluster->points.push_back (cloud_filtered->points[*pit]);
-      result->points.push_back(cloud_filtered->points[*pit]);
     }
-    int n_times = ceil(2048./cloud_cluster->points.size());
-    int pcd_size = cloud_cluster->points.size() + cloud_cluster->points.size()*n_times;
+    if (build_result)
+      velodyne_perception::appendColoredBySide(*cloud_filtered, it->indices, *result);
+    // FPS down to / jittered copies up to a fixed point budget
+    ClusterCloud::Ptr cloud_sampled (new ClusterCloud);
+    velodyne_perception::resampleToBudget(*cloud_cluster, point_budget, 0.03, rng, *cloud_sampled);
+    int pcd_size = cloud_sampled->points.size();
     cloud_label->points.resize(pcd_size);
     cloud_label->width = pcd_size;
     cloud_label->height = 1;
-    int pcd_idx = 0;
-    for (size_t i = 0; i < cloud_cluster->points.size(); i++){
-        cloud_label->points[pcd_idx].x = cloud_cluster->points[i].x;
-        cloud_label->points[pcd_idx].y = cloud_cluster->points[i].y;
-        cloud_label->points[pcd_idx].z = cloud_cluster->points[i].z;
-        cloud_label->points[pcd_idx].r = 0;
-        cloud_label->points[pcd_idx].g = 255;
-        cloud_label->points[pcd_idx].b = 0;
-        cloud_label->points[pcd_idx].label = 5;
-        pcd_idx++;
-        for (int j = 0; j < n_times; j++)
-        {
-          float dx = (rand()%601)/10000. - 0.03;
-          float dy = (rand()%601)/10000. - 0.03;
-          float dz = (rand()%601)/10000. - 0.03;
-          cloud_label->points[pcd_idx].x = cloud_cluster->points[i].x + dx;
-          cloud_label->points[pcd_idx].y = cloud_cluster->points[i].y + dy;
-          cloud_label->points[pcd_idx].z = cloud_cluster->points[i].z + dz;
-          cloud_label->points[pcd_idx].r = 0;
-          cloud_label->points[pcd_idx].g = 255;
-          cloud_label->points[pcd_idx].b = 0;
-          cloud_label->points[pcd_idx].label = 5;
-          pcd_idx++;
-        }
+    for (size_t i = 0; i < cloud_sampled->points.size(); i++){
+        cloud_label->points[i].x = cloud_sampled->points[i].x;
+        cloud_label->points[i].y = cloud_sampled->points[i].y;
+        cloud_label->points[i].z = cloud_sampled->points[i].z;
+        cloud_label->points[i].r = 0;
+        cloud_label->points[i].g = 255;
+        cloud_label->points[i].b = 0;
+        cloud_label->points[i].label = 5;
     }
     num_cluster++;
     std::ostringstream oss_pcd, oss_ply;
@@ -446,12 +337,12 @@ void cluster_pointcloud()
     std::string file_name_ply = oss_ply.str();
     if (cloud_label->points.size()!=0)
     {
-      pcl::io::savePCDFile(file_name_pcd, *cloud_label);
+      dataset_writer->write(cloud_label, file_name_pcd, file_name_ply);
       std::cout << "Save PDC file: " << pcd_count << ".pcd" << std::endl;
-      pcl::io::savePLYFile (file_name_ply, *cloud_label);
       std::cout << "Save PLY file: " << pcd_count << ".ply" << std::endl;
       pcd_count++;
-      cloud_label->clear();
+      // the writer owns the queued cloud now
+      cloud_label.reset(new PointLabel);
     }
     //pcl::compute3DCentroid(*cloud_cluster, centroid);
     pcl::toROSMsg(*cloud_cluster, ros_cluster);
@@ -463,11 +354,13 @@ void cluster_pointcloud()
     ros::shutdown();
   }
 
-  result->header.frame_id = cloud_in->header.frame_id;
-  pcl::toROSMsg(*result, ros_out);
-  ros_out.header.stamp = pcl_t;
-  //ros_out.header.stamp = ros::Time::now();
-  pub_result.publish(ros_out);
+  if (build_result){
+    result->header.frame_id = cloud_in->header.frame_id;
+    pcl::toROSMsg(*result, ros_out);
+    ros_out.header.stamp = pcl_t;
+    //ros_out.header.stamp = ros::Time::now();
+    pub_result.publish(ros_out);
+  }
   result->clear();
 
   lock = false;
@@ -613,11 +506,31 @@ int main (int argc, char** argv)
   ros::init (argc, argv, "auto_label");
   ros::NodeHandle nh("~");
   visual = nh.param("visual", true);
+  debug_gate.decimation = nh.param("debug_decimation", 1);
+  point_budget = nh.param("point_budget", 2048);
   ROS_INFO("[pcl_cluster] Param [visual] = %d",  visual);
-  client = nh.serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state");
   get_client = nh.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state");
   tf::TransformListener listener(ros::Duration(1.0));
   lr = &listener;
+  // .pcd / .ply are encoded and saved off the callback thread
+  int writer_threads = nh.param("writer_threads", 2);
+  int writer_queue = nh.param("writer_queue", 16);
+  bool compress = nh.param("compress", true);
+  ROS_INFO("[pcl_cluster] Param [writer_threads] = %d, [writer_queue] = %d, [compress] = %d",
+           writer_threads, writer_queue, compress);
+  velodyne_perception::DatasetWriter<PointCloudLabel> writer(writer_threads, writer_queue, compress);
+  dataset_writer = &writer;
+  // nearest-model labeling, on all cores for large scans
+  use_footprints = nh.param("footprints", false);
+  int label_threads = nh.param("label_threads", -1);
+  ROS_INFO("[pcl_cluster] Param [footprints] = %d, [label_threads] = %d", use_footprints, label_threads);
+  velodyne_perception::TaskPool pool(label_threads);
+  label_pool = &pool;
+  // moves the models and waits for them without blocking the callback
+  srand(time(NULL));
+  ros::NodeHandle node;
+  velodyne_perception::SceneRandomizer scene_randomizer(node, nh);
+  randomizer = &scene_randomizer;
   if (visual)
     std::cout<< "Start to clustering" << std::endl;
   ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2> ("/pcl_preprocessing/velodyne_points_preprocess", 1, callback);
@@ -629,4 +542,11 @@ int main (int argc, char** argv)
   pub_result = nh.advertise<sensor_msgs::PointCloud2> ("/cluster_result", 1);
   pub_points = nh.advertise<robotx_msgs::PCL_points> ("/pcl_points", 1);
   ros::spin ();
+  // ros::shutdown() or Ctrl-C: save what is still queued
+  writer.flush();
+  velodyne_perception::DatasetWriterStats stats = writer.stats();
+  ROS_INFO("[pcl_cluster] Saved %lu of %lu clouds (%lu failed), labeling waited for the disk %lu times, %.2f s",
+           (unsigned long)stats.written, (unsigned long)stats.queued, (unsigned long)stats.failed,
+           (unsigned long)stats.blocked, stats.blocked_sec);
+  ROS_INFO("[pcl_cluster] %u scenes labelled before they settled", scene_randomizer.timeouts());
 }
\ No newline at end of file
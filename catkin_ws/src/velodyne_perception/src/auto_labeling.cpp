@@ -64,42 +64,27 @@ Publish:
 #include <tf_conversions/tf_eigen.h>
 #include <tf2/LinearMath/Quaternion.h>
 
+#include <velodyne_perception/cluster_pipeline.h>
+#include <velodyne_perception/dataset_writer.h>
+#include <velodyne_perception/model_labeler.h>
+#include <velodyne_perception/scene_randomizer.h>
+
 using namespace Eigen;
 using namespace message_filters;
+using velodyne_perception::ClusterPoint;
+using velodyne_perception::ClusterCloud;
 //define point cloud type
 
-typedef uint32_t uint32;
-struct PointCloudLabel
-{
-  PCL_ADD_POINT4D;                  // preferred way of adding a XYZ+padding
-  PCL_ADD_RGB;
-  uint32 label;
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW   // make sure our new allocators are aligned
-} EIGEN_ALIGN16;                    // enforce SSE padding for correct memory alignment
-
-POINT_CLOUD_REGISTER_POINT_STRUCT (PointCloudLabel,           // here we assume a XYZ + "test" (as fields)
-                                   (float, x, x)
-                                   (float, y, y)
-                                   (float, z, z)
-                                   (float, rgb, rgb)
-                                   (uint32, label, label)
-)
-
-typedef pcl::PointCloud<pcl::PointXYZ> PointCloudXYZ;
+// x, y, z, rgb, label, coloured after the label (point_cloud_label.h)
+using velodyne_perception::PointCloudLabel;
+
 typedef pcl::PointCloud<pcl::PointXYZRGB> PointCloudXYZRGB;
 typedef pcl::PointCloud<PointCloudLabel> PointLabel;
 
 //typedef boost::shared_ptr <robotx_msgs::BoolStamped const> BoolStampedConstPtr;
 //declare point cloud
-PointCloudXYZ::Ptr cloud_inXYZ (new PointCloudXYZ);
-PointCloudXYZRGB::Ptr cloud_in (new PointCloudXYZRGB); 
-PointCloudXYZRGB::Ptr cloud_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr plane_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_h (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_f (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_plane (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_scene(new PointCloudXYZRGB);
-//PointCloudXYZRGB::Ptr wall (new PointCloudXYZRGB);
+ClusterCloud::Ptr cloud_in (new ClusterCloud);
+ClusterCloud::Ptr cloud_filtered (new ClusterCloud);
 PointCloudXYZRGB::Ptr result (new PointCloudXYZRGB);
 PointLabel::Ptr label_cloud (new PointLabel);
 
@@ -113,7 +98,6 @@ ros::Publisher pub_marker_line;
 ros::Publisher pub_obstacle;
 ros::Publisher pub_object;
 ros::Publisher pub_points;
-ros::ServiceClient client;
 ros::ServiceClient get_client;
 
 //declare global variable
@@ -138,19 +122,25 @@ float new_pos_arr[4][2];
 float new_pos_arr_tf[4][2];
 float pos_arr[4][2];
 float pos_arr_tf[4][2];
-bool first = true;
+float new_yaw_tf[4];
+float yaw_tf[4];
+// half length / half width of the model footprints, m
+float footprint_size[4][2] = {{4.0, 2.0}, {4.0, 2.0}, {1.0, 1.0}, {0.75, 0.75}};
+bool use_footprints = false;
 int pcd_count = 601;
 
 //declare function
 void cloud_cb(const sensor_msgs::PointCloud2ConstPtr&); //point cloud subscriber call back function
 void cluster_pointcloud(void); //point cloud clustering
-void set_gazebo_world(std::string model_name, int x, int y, float z);
 void get_model_state(std::string model_name);
 void auto_label(void);
 void drawRviz(robotx_msgs::ObstaclePoseList); //draw marker in Rviz
 void drawRviz_line(robotx_msgs::ObstaclePoseList); //draw marker line list in Rviz
 
 tf::TransformListener* lr;
+velodyne_perception::DatasetWriter<PointCloudLabel>* dataset_writer;
+velodyne_perception::TaskPool* label_pool;
+velodyne_perception::SceneRandomizer* randomizer;
 int gazebo_world_counter = 0;
 int move_x = 0;
 tf::StampedTransform tf_transform;
@@ -162,25 +152,7 @@ void callback(const sensor_msgs::PointCloud2ConstPtr& input)
     //covert from ros type to pcl type
     pcl_frame_id.data = input->header.frame_id;
     pcl_t = input->header.stamp;
-    pcl::fromROSMsg (*input, *cloud_inXYZ);
-    copyPointCloud(*cloud_inXYZ, *cloud_in);
-
-    //set color for point cloud
-    for (size_t i = 0; i < cloud_in->points.size(); i++){
-      if (cloud_in->points[i].y > 0)
-      {
-      	cloud_in->points[i].r = 255;
-      	cloud_in->points[i].g = 0;
-      	cloud_in->points[i].b = 255;
-      }
-      else
-      {
-      	cloud_in->points[i].r = 0;
-      	cloud_in->points[i].g = 255;
-      	cloud_in->points[i].b = 0;
-      }
-      
-    }
+    pcl::fromROSMsg (*input, *cloud_in);
     clock_t t_start = clock();
 
     std::string source_frame="/velodyne";
@@ -212,34 +184,12 @@ void get_model_state(std::string model_name)
   get_client.call(getmodelstate);
 }
 
-void set_gazebo_world(std::string model_name, int x, int y, float z)
-{
-	gazebo_msgs::ModelState modelstate;
-    modelstate.model_name = (std::string) model_name;
-    modelstate.pose.position.x = x;
-    modelstate.pose.position.y = y;
-    modelstate.pose.position.z = z;
-    /*if (model_name == "wamv")
-    {
-    	tf2::Quaternion quat;
-    	quat.setRPY(0, 0, 3.14);
-    	modelstate.pose.orientation.x = quat[0];
-    	modelstate.pose.orientation.y = quat[1];
-    	modelstate.pose.orientation.z = quat[2];
-    	modelstate.pose.orientation.w = quat[3];
-    }*/
-    
-    gazebo_msgs::SetModelState setmodelstate;
-    setmodelstate.request.model_state = modelstate;
-    client.call(setmodelstate);
-}
-
 void auto_label()
 {
 	int RAND_RANGE = 40;
 	float COLLISION_DIS = 8;
 	float WAMV_RANGE = 5;
-	srand(time(NULL));
+	std::vector<velodyne_perception::SceneModel> scene(MODEL_NUM + 1);
 	for(int i = 0; i < MODEL_NUM; i++)
 	{
 		bool model_collision = true;
@@ -264,7 +214,10 @@ void auto_label()
 				if (dis < COLLISION_DIS){model_collision = true;}
 			}
 		}
-		set_gazebo_world(model_id[i], x, y, z_height[i]);
+		scene[i].name = model_id[i];
+		scene[i].x = x;
+		scene[i].y = y;
+		scene[i].z = z_height[i];
 		tf::Quaternion quat = tf_transform.getRotation();
   		tf::Matrix3x3 tf_rot(quat);
   		tf::Vector3 pos(x, y, 0);
@@ -275,26 +228,41 @@ void auto_label()
   		//std::cout << std::endl;
   		new_pos_arr_tf[i][0] = tf_pos[0];
   		new_pos_arr_tf[i][1] = tf_pos[1];
+  		// the models are set unturned, only the sensor is
+  		new_yaw_tf[i] = tf::getYaw(quat);
   		//double roll, pitch, yaw;
   		//tf_rot.getRPY(roll, pitch, yaw); //get RPY and assign to roll, pitch ,yaw
 	}
-	set_gazebo_world("wamv", 0, 0, -0.0823);
+	scene[MODEL_NUM].name = "wamv";
+	scene[MODEL_NUM].x = 0;
+	scene[MODEL_NUM].y = 0;
+	scene[MODEL_NUM].z = -0.0823;
+	// returns at once, the models move and settle while this scan is labelled
+	randomizer->randomize(scene);
 }
 
 //void cloud_cb(const sensor_msgs::PointCloud2ConstPtr& input)
 void cluster_pointcloud()
 {
+  //========== Scene ==========
+  // only the first scan of a settled scene is labelled
+  if (randomizer->state() == velodyne_perception::SceneRandomizer::kIdle)
+  {
+    auto_label();
+    lock = false;
+    return;
+  }
+  if (!randomizer->settled(pcl_t))
+  {
+    lock = false;
+    return;
+  }
+
   //std::cout<< "start processing point clouds" << std::endl;
   copyPointCloud(*cloud_in, *cloud_filtered);  
 
   //========== Outlier remove ==========
-  pcl::RadiusOutlierRemoval<pcl::PointXYZRGB> outrem;
-  // build the filter
-  outrem.setInputCloud(cloud_filtered);
-  outrem.setRadiusSearch(2.2);
-  outrem.setMinNeighborsInRadius (2);
-  // apply filter
-  outrem.filter (*cloud_filtered);
+  velodyne_perception::removeRadiusOutlier<ClusterPoint>(cloud_filtered, 2.2, 2);
 
   //========== Auto Labeling ==========
   for (int i = 0; i < MODEL_NUM; i++)
@@ -303,6 +271,7 @@ void cluster_pointcloud()
   	{
   		pos_arr_tf[i][j] = new_pos_arr_tf[i][j];
   	}
+  	yaw_tf[i] = new_yaw_tf[i];
   }
   auto_label();
   //for(int i = 0; i < MODEL_NUM; i++)
@@ -315,88 +284,28 @@ void cluster_pointcloud()
   //ros_out.header.stamp = ros::Time::now();
   //pub_result.publish(ros_out);
 
-  ros::Duration(5).sleep();
-  if (first)
-  {
-  	first = false;
-  	lock = false;
-  	return;
-  }
-
-  label_cloud->points.resize(cloud_filtered->points.size());
-  label_cloud->width = cloud_filtered->width;
-  label_cloud->height = cloud_filtered->height;
-  
-  for(size_t idx = 0; idx < cloud_filtered->points.size(); ++idx)
+  std::vector<velodyne_perception::LabelModel> models(MODEL_NUM);
+  for (int i = 0; i < MODEL_NUM; i++)
   {
-  	float x = cloud_filtered->points[idx].x;
-  	float y = cloud_filtered->points[idx].y;
-  	float z = cloud_filtered->points[idx].z;
-  	float min_dis = 100000000;
-  	int min_idx;
-  	for(int i = 0; i < MODEL_NUM; i++)
-  	{
-  		
-  		float dis = sqrt(pow((x-pos_arr_tf[i][0]), 2) + pow((y-pos_arr_tf[i][1]), 2));
-  		//float dis = sqrt(pow((x+pos_arr[i][1]), 2) + pow((y-pos_arr[i][0]), 2));
-  		if(min_dis > dis)
-  		{
-  			min_dis = dis;
-  			min_idx = i;
-  		}
-  	}
-  	
-  	label_cloud->points[idx].x = x;
-  	label_cloud->points[idx].y = y;
-  	label_cloud->points[idx].z = z;
-  	label_cloud->points[idx].label = class_dic[min_idx];
-  	if (label_cloud->points[idx].label == 1)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 0;
-  	}
-  	else if (label_cloud->points[idx].label == 2)
-  	{
-  		label_cloud->points[idx].r = 255;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 0;
-  	}
-  	else if (label_cloud->points[idx].label == 3)
-  	{
-  		label_cloud->points[idx].r = 255;
-  		label_cloud->points[idx].g = 255;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 4)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 5)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
-  	else if (label_cloud->points[idx].label == 6)
-  	{
-  		label_cloud->points[idx].r = 0;
-  		label_cloud->points[idx].g = 0;
-  		label_cloud->points[idx].b = 255;
-  	}
+  	if (use_footprints)
+  		models[i] = velodyne_perception::footprintModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i], yaw_tf[i],
+  		                                                footprint_size[i][0], footprint_size[i][1]);
+  	else
+  		models[i] = velodyne_perception::LabelModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i]);
   }
+  // points outside every footprint get label 0
+  velodyne_perception::labelByModels(*cloud_filtered, models, *label_cloud, label_pool);
 
   std::ostringstream oss;
   oss << "/media/arg_ws3/5E703E3A703E18EB/pcd/gazebo_a_" << pcd_count << ".pcd";
   std::string file_name = oss.str();
   if (label_cloud->points.size()!=0)
   {
-  	pcl::io::savePCDFile(file_name, *label_cloud);
+  	dataset_writer->write(label_cloud, file_name);
   	std::cout << "Save PDC file: " << pcd_count << ".pcd" << std::endl;
   	pcd_count++;
-  	label_cloud->clear();
+  	// the writer owns the queued cloud now
+  	label_cloud.reset(new PointLabel);
   }
 
   if (pcd_count > 800)
@@ -705,10 +614,28 @@ int main (int argc, char** argv)
   ros::NodeHandle nh("~");
   visual = nh.param("visual", true);
   ROS_INFO("[pcl_cluster] Param [visual] = %d",  visual);
-  client = nh.serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state");
   get_client = nh.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state");
   tf::TransformListener listener(ros::Duration(1.0));
   lr = &listener;
+  // .pcd / .ply are encoded and saved off the callback thread
+  int writer_threads = nh.param("writer_threads", 2);
+  int writer_queue = nh.param("writer_queue", 16);
+  bool compress = nh.param("compress", true);
+  ROS_INFO("[pcl_cluster] Param [writer_threads] = %d, [writer_queue] = %d, [compress] = %d",
+           writer_threads, writer_queue, compress);
+  velodyne_perception::DatasetWriter<PointCloudLabel> writer(writer_threads, writer_queue, compress);
+  dataset_writer = &writer;
+  // nearest-model labeling, on all cores for large scans
+  use_footprints = nh.param("footprints", false);
+  int label_threads = nh.param("label_threads", -1);
+  ROS_INFO("[pcl_cluster] Param [footprints] = %d, [label_threads] = %d", use_footprints, label_threads);
+  velodyne_perception::TaskPool pool(label_threads);
+  label_pool = &pool;
+  // moves the models and waits for them without blocking the callback
+  srand(time(NULL));
+  ros::NodeHandle node;
+  velodyne_perception::SceneRandomizer scene_randomizer(node, nh);
+  randomizer = &scene_randomizer;
   if (visual)
     std::cout<< "Start to clustering" << std::endl;
   ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2> ("/pcl_preprocessing/velodyne_points_preprocess", 1, callback);
@@ -720,4 +647,11 @@ int main (int argc, char** argv)
   pub_result = nh.advertise<sensor_msgs::PointCloud2> ("/cluster_result", 1);
   pub_points = nh.advertise<robotx_msgs::PCL_points> ("/pcl_points", 1);
   ros::spin ();
+  // ros::shutdown() or Ctrl-C: save what is still queued
+  writer.flush();
+  velodyne_perception::DatasetWriterStats stats = writer.stats();
+  ROS_INFO("[pcl_cluster] Saved %lu of %lu clouds (%lu failed), labeling waited for the disk %lu times, %.2f s",
+           (unsigned long)stats.written, (unsigned long)stats.queued, (unsigned long)stats.failed,
+           (unsigned long)stats.blocked, stats.blocked_sec);
+  ROS_INFO("[pcl_cluster] %u scenes labelled before they settled", scene_randomizer.timeouts());
 }
\ No newline at end of file
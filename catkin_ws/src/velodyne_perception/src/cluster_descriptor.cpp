@@ -0,0 +1,82 @@
+/**********************************
+Cluster Descriptor
+  See cluster_descriptor.h
+***********************************/
+#include <velodyne_perception/cluster_descriptor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <Eigen/Eigenvalues>
+
+namespace velodyne_perception
+{
+
+const char* const kDescriptorNames[kDescriptorSize] = {
+  "points", "range", "extent_x", "extent_y", "extent_z",
+  "height_0", "height_1", "height_2", "height_3",
+  "sigma_1", "sigma_2", "sigma_3", "density"
+};
+
+int descriptorFeature(const char* name)
+{
+  for (int f = 0; f < kDescriptorSize; f++)
+    if (std::strcmp(name, kDescriptorNames[f]) == 0)
+      return f;
+  return -1;
+}
+
+void describeGeometry(const double* xyz, size_t n, float* descriptor)
+{
+  std::fill(descriptor, descriptor + kDescriptorSize, 0.0f);
+  if (n == 0)
+    return;
+
+  Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+  for (size_t i = 0; i < n; i++)
+    mean += Eigen::Vector3d(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+  mean /= n;
+  const double range = std::sqrt(mean[0] * mean[0] + mean[1] * mean[1]);
+  const double yaw = std::atan2(mean[1], mean[0]);
+  const double c = std::cos(yaw), s = std::sin(yaw);
+
+  // ======= local frame extents and covariance =======
+  Eigen::Vector3d lo = Eigen::Vector3d::Constant(1e9), hi = Eigen::Vector3d::Constant(-1e9);
+  Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+  for (size_t i = 0; i < n; i++)
+  {
+    const double* p = xyz + 3 * i;
+    Eigen::Vector3d local(c * p[0] + s * p[1], -s * p[0] + c * p[1], p[2]);
+    lo = lo.cwiseMin(local);
+    hi = hi.cwiseMax(local);
+    Eigen::Vector3d d(p[0] - mean[0], p[1] - mean[1], p[2] - mean[2]);
+    cov += d * d.transpose();
+  }
+  cov /= n;
+  const Eigen::Vector3d extent = hi - lo;
+
+  // ======= height profile =======
+  int slices[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < n; i++)
+  {
+    int b = extent[2] > 0 ? (int)(4 * (xyz[3 * i + 2] - lo[2]) / extent[2]) : 0;
+    slices[std::min(3, std::max(0, b))]++;
+  }
+
+  // ======= PCA, eigenvalues come out ascending =======
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov, Eigen::EigenvaluesOnly);
+  const Eigen::Vector3d& ev = solver.eigenvalues();
+
+  descriptor[kPoints] = n;
+  descriptor[kRange] = range;
+  descriptor[kExtentX] = extent[0];
+  descriptor[kExtentY] = extent[1];
+  descriptor[kExtentZ] = extent[2];
+  for (int b = 0; b < 4; b++)
+    descriptor[kHeight0 + b] = (float)slices[b] / n;
+  for (int k = 0; k < 3; k++)
+    descriptor[kSigma1 + k] = std::sqrt(std::max(0.0, ev[2 - k]));
+  descriptor[kDensity] = n * (range / 10) * (range / 10);
+}
+
+} // namespace velodyne_perception
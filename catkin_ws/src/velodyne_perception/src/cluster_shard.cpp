@@ -0,0 +1,270 @@
+/**********************************
+Cluster Shard
+  See cluster_shard.h
+***********************************/
+#include <velodyne_perception/cluster_shard.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace velodyne_perception
+{
+
+namespace
+{
+
+const char kMagic[8] = {'C', 'L', 'S', 'H', 'A', 'R', 'D', '\0'};
+const uint32_t kVersion = 1;
+const size_t kStreamBuffer = 1 << 20;
+
+static_assert(sizeof(ShardHeader) == 64, "ShardHeader is part of the file format");
+static_assert(sizeof(ShardIndexEntry) == 16, "ShardIndexEntry is part of the file format");
+
+bool fail(std::string* error, const std::string& msg)
+{
+  if (error)
+    *error = msg;
+  return false;
+}
+
+size_t padded(size_t n)
+{
+  return (n + 3) & ~(size_t)3;
+}
+
+} // namespace
+
+int majorityLabel(const uint32_t* labels, size_t n)
+{
+  std::map<uint32_t, size_t> votes;
+  for (size_t i = 0; i < n; i++)
+    votes[labels[i]]++;
+  int label = -1;
+  size_t best = 0;
+  for (std::map<uint32_t, size_t>::const_iterator it = votes.begin(); it != votes.end(); ++it)
+    if (it->second > best)
+    {
+      best = it->second;
+      label = it->first;
+    }
+  return label;
+}
+
+//========== Writer ==========
+ShardWriter::ShardWriter()
+  : samples_per_shard_(0), file_(NULL), offset_(0), points_(0), total_samples_(0)
+{
+}
+
+ShardWriter::~ShardWriter()
+{
+  close();
+}
+
+bool ShardWriter::open(const std::string& prefix, size_t samples_per_shard, std::string* error)
+{
+  if (!close(error))
+    return false;
+  if (samples_per_shard == 0)
+    return fail(error, "samples_per_shard must be positive");
+  prefix_ = prefix;
+  samples_per_shard_ = samples_per_shard;
+  total_samples_ = 0;
+  shards_.clear();
+  return true;
+}
+
+bool ShardWriter::append(const float* xyz, const uint32_t* labels, size_t n, int label, std::string* error)
+{
+  if (prefix_.empty())
+    return fail(error, "shard writer is not open");
+  if (n > 0xffffffffu)
+    return fail(error, "sample too large for a shard");
+  if (!file_ && !startShard(error))
+    return false;
+
+  // x, y, z and labels, each padded to a multiple of 4 entries
+  const size_t m = padded(n);
+  soa_.assign(4 * m, 0.0f);
+  for (size_t i = 0; i < n; i++)
+  {
+    soa_[i] = xyz[3 * i];
+    soa_[m + i] = xyz[3 * i + 1];
+    soa_[2 * m + i] = xyz[3 * i + 2];
+  }
+  if (n > 0)
+    std::memcpy(&soa_[3 * m], labels, n * sizeof(uint32_t));
+
+  ShardIndexEntry entry;
+  entry.offset = offset_;
+  entry.points = n;
+  entry.label = label >= 0 ? label : majorityLabel(labels, n);
+  if (!soa_.empty() && !write(&soa_[0], soa_.size() * sizeof(float), error))
+    return false;
+  index_.push_back(entry);
+  points_ += n;
+  total_samples_++;
+  if (index_.size() >= samples_per_shard_)
+    return finishShard(error);
+  return true;
+}
+
+bool ShardWriter::close(std::string* error)
+{
+  bool ok = true;
+  if (file_)
+    ok = finishShard(error);
+  prefix_.clear();
+  return ok;
+}
+
+bool ShardWriter::startShard(std::string* error)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "-%05u.shard", (unsigned)shards_.size());
+  path_ = prefix_ + name;
+  const std::string tmp = path_ + ".tmp";
+  file_ = fopen(tmp.c_str(), "wb");
+  if (!file_)
+    return fail(error, "cannot write " + tmp + ": " + std::strerror(errno));
+  buffer_.resize(kStreamBuffer);
+  setvbuf(file_, &buffer_[0], _IOFBF, buffer_.size());
+  offset_ = 0;
+  points_ = 0;
+  index_.clear();
+  // placeholder, rewritten by finishShard
+  ShardHeader header;
+  std::memset(&header, 0, sizeof(header));
+  return write(&header, sizeof(header), error);
+}
+
+bool ShardWriter::finishShard(std::string* error)
+{
+  ShardHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.header_bytes = sizeof(header);
+  header.samples = index_.size();
+  header.points = points_;
+  header.index_offset = offset_;
+  const std::string tmp = path_ + ".tmp";
+  bool ok = index_.empty() || write(&index_[0], index_.size() * sizeof(ShardIndexEntry), error);
+  if (ok && (fseek(file_, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file_) != 1))
+    ok = fail(error, "cannot write " + tmp + ": " + std::strerror(errno));
+  if (fclose(file_) != 0 && ok)
+    ok = fail(error, "cannot write " + tmp + ": " + std::strerror(errno));
+  file_ = NULL;
+  index_.clear();
+  if (ok && rename(tmp.c_str(), path_.c_str()) != 0)
+    ok = fail(error, "cannot rename " + tmp + ": " + std::strerror(errno));
+  if (!ok)
+  {
+    unlink(tmp.c_str());
+    return false;
+  }
+  shards_.push_back(path_);
+  return true;
+}
+
+bool ShardWriter::write(const void* data, size_t bytes, std::string* error)
+{
+  if (fwrite(data, 1, bytes, file_) != bytes)
+    return fail(error, "cannot write " + path_ + ".tmp: " + std::strerror(errno));
+  offset_ += bytes;
+  return true;
+}
+
+//========== Reader ==========
+ShardReader::ShardReader()
+  : data_(NULL), bytes_(0), header_(NULL), index_(NULL)
+{
+}
+
+ShardReader::~ShardReader()
+{
+  close();
+}
+
+bool ShardReader::open(const std::string& path, std::string* error)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return fail(error, "cannot open " + path + ": " + std::strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShardHeader))
+  {
+    ::close(fd);
+    return fail(error, path + ": not a shard");
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return fail(error, "cannot map " + path + ": " + std::strerror(errno));
+  // samples are read in shuffled order
+  madvise(data, st.st_size, MADV_RANDOM);
+  data_ = (const char*)data;
+  bytes_ = st.st_size;
+  path_ = path;
+
+  const ShardHeader* header = (const ShardHeader*)data_;
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion ||
+      header->header_bytes != sizeof(ShardHeader))
+  {
+    close();
+    return fail(error, path + ": not a shard or an unsupported version");
+  }
+  if (header->index_offset < sizeof(ShardHeader) || header->index_offset > bytes_ ||
+      header->samples > (bytes_ - header->index_offset) / sizeof(ShardIndexEntry))
+  {
+    close();
+    return fail(error, path + ": truncated index");
+  }
+  const ShardIndexEntry* index = (const ShardIndexEntry*)(data_ + header->index_offset);
+  for (uint64_t i = 0; i < header->samples; i++)
+    // the sample ends before the index, written so a huge offset cannot wrap
+    if (index[i].offset < sizeof(ShardHeader) || index[i].offset % 16 != 0 ||
+        index[i].offset > header->index_offset ||
+        16 * padded(index[i].points) > header->index_offset - index[i].offset)
+    {
+      close();
+      return fail(error, path + ": corrupt index");
+    }
+  header_ = header;
+  index_ = index;
+  return true;
+}
+
+void ShardReader::close()
+{
+  if (data_)
+    munmap((void*)data_, bytes_);
+  data_ = NULL;
+  bytes_ = 0;
+  header_ = NULL;
+  index_ = NULL;
+}
+
+ShardReader::Sample ShardReader::sample(size_t i) const
+{
+  const ShardIndexEntry& entry = index_[i];
+  const size_t m = padded(entry.points);
+  const float* soa = (const float*)(data_ + entry.offset);
+  Sample s;
+  s.x = soa;
+  s.y = soa + m;
+  s.z = soa + 2 * m;
+  s.labels = (const uint32_t*)(soa + 3 * m);
+  s.points = entry.points;
+  s.label = entry.label;
+  return s;
+}
+
+} // namespace velodyne_perception
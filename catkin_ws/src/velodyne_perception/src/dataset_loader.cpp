@@ -0,0 +1,580 @@
+/**********************************
+Dataset Loader
+  See dataset_loader.h
+***********************************/
+#include <velodyne_perception/dataset_loader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pcl/conversions.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+
+#include <velodyne_perception/cluster_resample.h>
+#include <velodyne_perception/cluster_shard.h>
+
+namespace velodyne_perception
+{
+
+LoaderConfig::LoaderConfig()
+  : size(227),
+    batch(32),
+    threads(-1),
+    prefetch(4),
+    shuffle(true),
+    loop(true),
+    lock_memory(false),
+    seed(1),
+    cluster_tolerance(2.2f),
+    min_points(3),
+    rotation(0),
+    jitter(0),
+    dropout(0)
+{
+  mean[0] = mean[1] = mean[2] = 0;
+}
+
+DatasetLoader::DatasetLoader()
+  : image_floats_(0), stop_(false), done_(false), next_slot_(0), handed_out_(0), produced_(0), stalls_(0)
+{
+}
+
+DatasetLoader::~DatasetLoader()
+{
+  close();
+}
+
+bool DatasetLoader::fail(std::string* error, const std::string& msg)
+{
+  if (error)
+    *error = msg;
+  return false;
+}
+
+//========== Samples ==========
+bool DatasetLoader::open(const std::string& source, const LoaderConfig& config, std::string* error)
+{
+  close();
+  config_ = config;
+  if (config_.size <= 0 || config_.batch <= 0)
+    return fail(error, "size and batch must be positive");
+  config_.prefetch = std::max(1, config_.prefetch);
+  renderer_ = MultiViewRenderer::scaledTo(config_.size);
+  pool_.reset(new TaskPool(config_.threads));
+
+  std::vector<std::string> paths;
+  std::vector<int> labels;
+  if (!readSource(source, paths, labels, error))
+    return false;
+  if (paths.empty())
+    return fail(error, source + ": no clouds");
+
+  // ======= every cloud once: .pcd files in parallel, then the shards =======
+  std::vector<std::string> pcds, shards;
+  std::vector<int> pcd_labels, shard_labels;
+  for (size_t k = 0; k < paths.size(); k++)
+  {
+    const bool shard = isShard(paths[k]);
+    (shard ? shards : pcds).push_back(paths[k]);
+    (shard ? shard_labels : pcd_labels).push_back(labels[k]);
+  }
+  clouds_.clear();
+  labels_.clear();
+  std::vector<std::vector<std::vector<float> > > pcd_clouds(pcds.size());
+  std::vector<std::vector<int> > pcd_samples(pcds.size());
+  std::vector<std::string> errors(pcds.size());
+  pool_->parallelFor(pcds.size(), [&](size_t k)
+  {
+    readCloud(pcds[k], pcd_labels[k], pcd_clouds[k], pcd_samples[k], &errors[k]);
+  });
+  for (size_t k = 0; k < pcds.size(); k++)
+  {
+    if (!errors[k].empty())
+      return fail(error, errors[k]);
+    for (size_t i = 0; i < pcd_clouds[k].size(); i++)
+    {
+      clouds_.push_back(std::vector<float>());
+      clouds_.back().swap(pcd_clouds[k][i]);
+      labels_.push_back(pcd_samples[k][i]);
+    }
+  }
+  for (size_t k = 0; k < shards.size(); k++)
+    if (!readShard(shards[k], shard_labels[k], error))
+      return false;
+  // empty clouds cannot be rendered
+  size_t kept = 0;
+  for (size_t k = 0; k < clouds_.size(); k++)
+    if (!clouds_[k].empty())
+    {
+      clouds_[kept].swap(clouds_[k]);
+      labels_[kept++] = labels_[k];
+    }
+  clouds_.resize(kept);
+  labels_.resize(kept);
+  if (clouds_.empty())
+    return fail(error, source + ": no labelled object in any cloud");
+
+  // ======= batch buffers, page aligned =======
+  image_floats_ = renderer_.imageBytes();
+  slots_.resize(config_.prefetch);
+  for (size_t s = 0; s < slots_.size(); s++)
+  {
+    Slot& slot = slots_[s];
+    slot.images = NULL;
+    slot.labels = NULL;
+    slot.state = kFree;
+    void* images = NULL;
+    void* labels_mem = NULL;
+    const size_t image_bytes = config_.batch * image_floats_ * sizeof(float);
+    if (posix_memalign(&images, 4096, image_bytes) != 0 ||
+        posix_memalign(&labels_mem, 4096, config_.batch * sizeof(int32_t)) != 0)
+    {
+      free(images);
+      close();
+      return fail(error, "cannot allocate the batch buffers");
+    }
+    slot.images = (float*)images;
+    slot.labels = (int32_t*)labels_mem;
+    if (config_.lock_memory && mlock(images, image_bytes) != 0)
+    {
+      close();
+      return fail(error, "mlock of the batch buffers failed, raise the locked memory limit (ulimit -l)");
+    }
+    slot.batch.images = slot.images;
+    slot.batch.labels = slot.labels;
+    slot.batch.count = 0;
+    slot.batch.index = 0;
+  }
+
+  stop_ = false;
+  done_ = false;
+  next_slot_ = 0;
+  handed_out_ = produced_ = stalls_ = 0;
+  producer_ = std::thread(&DatasetLoader::producerLoop, this);
+  return true;
+}
+
+bool DatasetLoader::readSource(const std::string& source, std::vector<std::string>& paths,
+                               std::vector<int>& labels, std::string* error) const
+{
+  struct stat st;
+  if (stat(source.c_str(), &st) != 0)
+    return fail(error, "cannot open " + source);
+
+  // a directory of clouds, labels from the points
+  if (S_ISDIR(st.st_mode))
+  {
+    DIR* dir = opendir(source.c_str());
+    if (!dir)
+      return fail(error, "cannot open " + source);
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if ((name.size() > 4 && name.compare(name.size() - 4, 4, ".pcd") == 0) || isShard(name))
+        names.push_back(name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      paths.push_back(source + "/" + names[i]);
+      labels.push_back(-1);
+    }
+    return true;
+  }
+
+  if (isShard(source))
+  {
+    paths.push_back(source);
+    labels.push_back(-1);
+    return true;
+  }
+
+  // a list of "cloud.pcd [label]"
+  std::ifstream file(source.c_str());
+  if (!file)
+    return fail(error, "cannot open " + source);
+  std::string dir = source.find('/') == std::string::npos ? "" : source.substr(0, source.rfind('/') + 1);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream ss(line);
+    std::string pcd;
+    int label = -1;
+    if (!(ss >> pcd) || pcd[0] == '#')
+      continue;
+    if (ss >> label && label < 0)
+      return fail(error, source + ": negative label for " + pcd);
+    paths.push_back(pcd[0] == '/' ? pcd : dir + pcd);
+    labels.push_back(label);
+  }
+  return true;
+}
+
+bool DatasetLoader::readCloud(const std::string& path, int label, std::vector<std::vector<float> >& clouds,
+                              std::vector<int>& labels, std::string* error) const
+{
+  pcl::PCLPointCloud2 blob;
+  if (pcl::io::loadPCDFile(path, blob) != 0)
+    return fail(error, "cannot read " + path);
+  bool has_label = false;
+  for (size_t f = 0; f < blob.fields.size(); f++)
+    has_label |= blob.fields[f].name == "label";
+  if (label < 0 && !has_label)
+    return fail(error, path + ": no label in the list and no label field in the cloud");
+
+  std::vector<float> xyz;
+  std::vector<uint32_t> point_labels;
+  if (has_label)
+  {
+    pcl::PointCloud<pcl::PointXYZL> cloud;
+    pcl::fromPCLPointCloud2(blob, cloud);
+    xyz.reserve(3 * cloud.points.size());
+    point_labels.reserve(cloud.points.size());
+    for (size_t i = 0; i < cloud.points.size(); i++)
+    {
+      const pcl::PointXYZL& p = cloud.points[i];
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+        continue;
+      xyz.push_back(p.x);
+      xyz.push_back(p.y);
+      xyz.push_back(p.z);
+      point_labels.push_back(p.label);
+    }
+  }
+  else
+  {
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    pcl::fromPCLPointCloud2(blob, cloud);
+    xyz.reserve(3 * cloud.points.size());
+    for (size_t i = 0; i < cloud.points.size(); i++)
+    {
+      const pcl::PointXYZ& p = cloud.points[i];
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+        continue;
+      xyz.push_back(p.x);
+      xyz.push_back(p.y);
+      xyz.push_back(p.z);
+    }
+  }
+  // a saved cluster is one sample, a labelled scene one per object
+  if (label >= 0)
+  {
+    clouds.push_back(std::vector<float>());
+    clouds.back().swap(xyz);
+    labels.push_back(label);
+  }
+  else
+    splitObjects(xyz, point_labels, clouds, labels);
+  return true;
+}
+
+// every sample of a shard, label overrides the ones stored in it
+bool DatasetLoader::readShard(const std::string& path, int label, std::string* error)
+{
+  ShardReader shard;
+  if (!shard.open(path, error))
+    return false;
+  std::vector<float> xyz;
+  std::vector<uint32_t> point_labels;
+  for (size_t i = 0; i < shard.size(); i++)
+  {
+    const ShardReader::Sample sample = shard.sample(i);
+    if (sample.points == 0)
+      continue;
+    xyz.resize(3 * sample.points);
+    for (uint32_t p = 0; p < sample.points; p++)
+    {
+      xyz[3 * p] = sample.x[p];
+      xyz[3 * p + 1] = sample.y[p];
+      xyz[3 * p + 2] = sample.z[p];
+    }
+    if (label >= 0)
+    {
+      clouds_.push_back(xyz);
+      labels_.push_back(label);
+      continue;
+    }
+    point_labels.assign(sample.labels, sample.labels + sample.points);
+    splitObjects(xyz, point_labels, clouds_, labels_);
+  }
+  return true;
+}
+
+namespace
+{
+
+// cell of a point in a grid of size cell, packed into 63 bits
+inline int64_t cellKey(const float* p, float cell, int dx = 0, int dy = 0, int dz = 0)
+{
+  const int64_t x = (int64_t)std::floor(p[0] / cell) + dx;
+  const int64_t y = (int64_t)std::floor(p[1] / cell) + dy;
+  const int64_t z = (int64_t)std::floor(p[2] / cell) + dz;
+  return ((x & 0x1fffff) << 42) | ((y & 0x1fffff) << 21) | (z & 0x1fffff);
+}
+
+} // namespace
+
+// the objects of a labelled scene: per label > 0, Euclidean clusters of
+// cluster_tolerance (points of one cluster are chained by neighbours
+// closer than that, as in pcl::EuclideanClusterExtraction)
+void DatasetLoader::splitObjects(const std::vector<float>& xyz, const std::vector<uint32_t>& point_labels,
+                                 std::vector<std::vector<float> >& clouds, std::vector<int>& labels) const
+{
+  std::map<uint32_t, std::vector<size_t> > by_label;
+  for (size_t i = 0; i < point_labels.size(); i++)
+    if (point_labels[i] != 0)
+      by_label[point_labels[i]].push_back(i);
+
+  const float tolerance = config_.cluster_tolerance;
+  const size_t min_points = std::max(1, config_.min_points);
+  for (std::map<uint32_t, std::vector<size_t> >::const_iterator it = by_label.begin(); it != by_label.end(); ++it)
+  {
+    const std::vector<size_t>& points = it->second;
+    std::vector<std::vector<size_t> > clusters;
+    if (tolerance <= 0)
+      clusters.push_back(points);
+    else
+    {
+      // ======= neighbours from the 27 cells around a point =======
+      std::map<int64_t, std::vector<size_t> > grid;
+      for (size_t k = 0; k < points.size(); k++)
+        grid[cellKey(&xyz[3 * points[k]], tolerance)].push_back(k);
+      std::vector<char> seen(points.size(), 0);
+      for (size_t seed = 0; seed < points.size(); seed++)
+      {
+        if (seen[seed])
+          continue;
+        clusters.push_back(std::vector<size_t>());
+        std::vector<size_t> queue(1, seed);
+        seen[seed] = 1;
+        for (size_t q = 0; q < queue.size(); q++)
+        {
+          const float* p = &xyz[3 * points[queue[q]]];
+          for (int dx = -1; dx <= 1; dx++)
+            for (int dy = -1; dy <= 1; dy++)
+              for (int dz = -1; dz <= 1; dz++)
+              {
+                std::map<int64_t, std::vector<size_t> >::const_iterator cell =
+                    grid.find(cellKey(p, tolerance, dx, dy, dz));
+                if (cell == grid.end())
+                  continue;
+                for (size_t c = 0; c < cell->second.size(); c++)
+                {
+                  const size_t k = cell->second[c];
+                  if (seen[k])
+                    continue;
+                  const float* o = &xyz[3 * points[k]];
+                  const float ex = o[0] - p[0], ey = o[1] - p[1], ez = o[2] - p[2];
+                  if (ex * ex + ey * ey + ez * ez > tolerance * tolerance)
+                    continue;
+                  seen[k] = 1;
+                  queue.push_back(k);
+                }
+              }
+        }
+        for (size_t q = 0; q < queue.size(); q++)
+          clusters.back().push_back(points[queue[q]]);
+      }
+    }
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+      if (clusters[c].size() < min_points)
+        continue;
+      clouds.push_back(std::vector<float>(3 * clusters[c].size()));
+      std::vector<float>& cloud = clouds.back();
+      for (size_t k = 0; k < clusters[c].size(); k++)
+        std::copy(&xyz[3 * clusters[c][k]], &xyz[3 * clusters[c][k]] + 3, &cloud[3 * k]);
+      labels.push_back(it->first);
+    }
+  }
+}
+
+bool DatasetLoader::isShard(const std::string& path)
+{
+  return path.size() > 6 && path.compare(path.size() - 6, 6, ".shard") == 0;
+}
+
+//========== Batches ==========
+void DatasetLoader::producerLoop()
+{
+  const size_t n = clouds_.size();
+  std::vector<size_t> order(n);
+  FastRand shuffle_rng(config_.seed);
+  uint64_t epochs = 0;    // started so far
+  size_t pos = n;         // in order; n starts the next epoch
+  std::vector<std::pair<size_t, uint64_t> > picks;   // sample, its epoch
+  for (uint64_t b = 0;; b++)
+  {
+    // ======= the samples of batch b =======
+    picks.clear();
+    while ((int)picks.size() < config_.batch)
+    {
+      if (pos == n)
+      {
+        if (!config_.loop && epochs == 1)
+          break;
+        for (size_t i = 0; i < n; i++)
+          order[i] = i;
+        if (config_.shuffle)
+          for (size_t i = n - 1; i > 0; i--)
+            std::swap(order[i], order[shuffle_rng.next() % (i + 1)]);
+        pos = 0;
+        epochs++;
+      }
+      picks.push_back(std::make_pair(order[pos++], epochs - 1));
+    }
+    if (picks.empty())
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+      changed_.notify_all();
+      return;
+    }
+
+    // ======= render into the slot once the consumer gave it back =======
+    Slot& slot = slots_[b % slots_.size()];
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [&]() { return stop_ || slot.state == kFree; });
+      if (stop_)
+        return;
+      slot.state = kFilling;
+    }
+    pool_->parallelFor(picks.size(), [&](size_t k)
+    {
+      renderSample(picks[k].first, picks[k].second, slot.images + k * image_floats_);
+      slot.labels[k] = labels_[picks[k].first];
+    });
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.batch.count = picks.size();
+      slot.batch.index = b;
+      slot.state = kReady;
+      produced_ = b + 1;
+      changed_.notify_all();
+    }
+  }
+}
+
+// one augmented sample, views rotated by the bearing of its centroid like
+// the classifiers; the random numbers only depend on seed, sample and epoch
+void DatasetLoader::renderSample(size_t sample, uint64_t epoch, float* chw) const
+{
+  const std::vector<float>& cloud = clouds_[sample];
+  const size_t n = cloud.size() / 3;
+  FastRand rng(config_.seed * 2654435761u ^ (uint32_t)(epoch * clouds_.size() + sample + 1) * 40503u);
+  rng.next();
+
+  double cx = 0, cy = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    cx += cloud[3 * i];
+    cy += cloud[3 * i + 1];
+  }
+  double yaw = std::atan2(cy, cx);
+  if (config_.rotation > 0)
+    yaw += config_.rotation * rng.symmetric(1.0f);
+  const float drop = config_.dropout > 0 ? 0.5f * (rng.symmetric(config_.dropout) + config_.dropout) : 0;
+  const double c = std::cos(yaw), s = std::sin(yaw);
+
+  std::vector<double> xyz;
+  xyz.reserve(3 * n);
+  for (size_t i = 0; i < n; i++)
+  {
+    // keep at least one point of a fully dropped cloud
+    if (drop > 0 && 0.5f * (rng.symmetric(1.0f) + 1.0f) < drop && !(i + 1 == n && xyz.empty()))
+      continue;
+    double x = cloud[3 * i], y = cloud[3 * i + 1], z = cloud[3 * i + 2];
+    if (config_.jitter > 0)
+    {
+      x += rng.symmetric(config_.jitter);
+      y += rng.symmetric(config_.jitter);
+      z += rng.symmetric(config_.jitter);
+    }
+    xyz.push_back(c * x + s * y);
+    xyz.push_back(-s * x + c * y);
+    xyz.push_back(z);
+  }
+  std::vector<uint8_t> image(renderer_.imageBytes());
+  renderer_.render(xyz.empty() ? NULL : &xyz[0], xyz.size() / 3, &image[0]);
+  renderer_.toTensor(&image[0], config_.mean, chw);
+}
+
+const DatasetLoader::Batch* DatasetLoader::next(std::string* error)
+{
+  if (error)
+    error->clear();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (slots_.empty())
+    return NULL;
+  Slot& slot = slots_[next_slot_];
+  // the consumer still holds every slot: nothing can be rendered into it
+  if (slot.state == kHeld)
+  {
+    std::ostringstream oss;
+    oss << "all " << slots_.size() << " prefetch batches are still held; release one before next()";
+    fail(error, oss.str());
+    return NULL;
+  }
+  const uint64_t h = handed_out_;
+  if (!(slot.state == kReady && slot.batch.index == h))
+    stalls_++;
+  changed_.wait(lock, [&]()
+  {
+    return stop_ || (slot.state == kReady && slot.batch.index == h) || (done_ && produced_ <= h);
+  });
+  if (slot.state != kReady || slot.batch.index != h)
+    return NULL;
+  slot.state = kHeld;
+  next_slot_ = (next_slot_ + 1) % slots_.size();
+  handed_out_++;
+  return &slot.batch;
+}
+
+void DatasetLoader::release(const Batch* batch)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t s = 0; s < slots_.size(); s++)
+    if (&slots_[s].batch == batch && slots_[s].state == kHeld)
+    {
+      slots_[s].state = kFree;
+      changed_.notify_all();
+      return;
+    }
+}
+
+uint64_t DatasetLoader::stalls() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stalls_;
+}
+
+void DatasetLoader::close()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    changed_.notify_all();
+  }
+  if (producer_.joinable())
+    producer_.join();
+  for (size_t s = 0; s < slots_.size(); s++)
+  {
+    if (slots_[s].images && config_.lock_memory)
+      munlock(slots_[s].images, config_.batch * image_floats_ * sizeof(float));
+    free(slots_[s].images);
+    free(slots_[s].labels);
+  }
+  slots_.clear();
+}
+
+} // namespace velodyne_perception
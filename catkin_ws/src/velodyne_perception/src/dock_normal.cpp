@@ -28,16 +28,18 @@ PlacardExtraction
 #include "robotx_msgs/PlacardPose.h"
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <velodyne_perception/debug_gate.h>
 
 using namespace std;
 class PlacardExtraction{
 public:
     PlacardExtraction(ros::NodeHandle&);
     void cb_obj_list(const robotx_msgs::ObjectPoseListConstPtr&);
-    void cal_normal_avg(pcl::PointCloud<pcl::PointXYZINormal> );
+    void cal_normal_avg(const pcl::PointCloud<pcl::PointXYZINormal>&);
 private:
     string node_name;
     bool visual;
+    velodyne_perception::DebugGate debug_gate;
 
     ros::NodeHandle nh;
     ros::Subscriber sub_ob_list;
@@ -51,6 +53,7 @@ PlacardExtraction::PlacardExtraction(ros::NodeHandle& n){
 
     //Initial param
     visual = nh.param("visual", true);
+    debug_gate.decimation = nh.param("debug_decimation", 1);
 
 	ROS_INFO("[%s] Initializing ", node_name.c_str());
 	ROS_INFO("[%s] Param [visual] = %d", node_name.c_str(), visual);
@@ -120,7 +123,11 @@ void PlacardExtraction::cb_obj_list(const robotx_msgs::ObjectPoseListConstPtr& m
     //cout << "Normal Estimation time taken = " << (t_end - t_start)/(double)(CLOCKS_PER_SEC)  << endl;
 
 }
-void PlacardExtraction::cal_normal_avg(pcl::PointCloud<pcl::PointXYZINormal> cloud_with_normals){
+void PlacardExtraction::cal_normal_avg(const pcl::PointCloud<pcl::PointXYZINormal>& cloud_with_normals){
+    // Normal markers are only built when RViz listens
+    debug_gate.nextFrame();
+    bool draw = visual && debug_gate.wants(pub_marker);
+
 	/*
 	***************************************************************
 		Visualize normal
@@ -159,7 +166,7 @@ void PlacardExtraction::cal_normal_avg(pcl::PointCloud<pcl::PointXYZINormal> clo
             counts ++;
 
             //Visualize all normals
-            if (visual){
+            if (draw){
                 
                 geometry_msgs::Point p_st, p_ed;
                 p_st.x = cloud_with_normals.points[i].x;
@@ -180,7 +187,8 @@ void PlacardExtraction::cal_normal_avg(pcl::PointCloud<pcl::PointXYZINormal> clo
             
         }
     }
-    marker_array.markers.push_back(marker_1);
+    if (draw)
+        marker_array.markers.push_back(marker_1);
     if(counts !=0){
         double avg_x, avg_y, avg_z, avg_normal_x, avg_normal_y, avg_normal_z;
         avg_x = sum_x / counts;
@@ -189,7 +197,7 @@ void PlacardExtraction::cal_normal_avg(pcl::PointCloud<pcl::PointXYZINormal> clo
         avg_normal_x = sum_normal_x / counts;
         avg_normal_y = sum_normal_y / counts;
         avg_normal_z = sum_normal_z / counts;
-        if (visual){
+        if (draw){
 
             marker_2.color.r = 0.0f;
             marker_2.color.g = 0.0f;
@@ -0,0 +1,327 @@
+/**********************************
+LiDAR Simulator
+  See lidar_sim.h
+***********************************/
+#include <velodyne_perception/lidar_sim.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace velodyne_perception
+{
+
+const char* const kSimObjectNames[kSimObjectKinds] = {"totem", "light_buoy", "dock", "buoy"};
+const uint32_t kSimObjectLabels[kSimObjectKinds] = {1, 2, 3, 4};
+
+namespace
+{
+
+const double kDeg = M_PI / 180.0;
+
+SimPrimitive primitive(SimPrimitive::Type type, double cx, double cy, double cz, double sx, double sy, double sz)
+{
+  SimPrimitive p;
+  p.type = type;
+  p.center[0] = cx;
+  p.center[1] = cy;
+  p.center[2] = cz;
+  p.size[0] = sx;
+  p.size[1] = sy;
+  p.size[2] = sz;
+  p.yaw = 0;
+  return p;
+}
+
+// uniform in (0, 1)
+double uniform(FastRand& rng)
+{
+  return ((rng.next() >> 8) + 0.5) * (1.0 / 16777216.0);
+}
+
+double gaussian(FastRand& rng)
+{
+  return std::sqrt(-2.0 * std::log(uniform(rng))) * std::cos(2.0 * M_PI * uniform(rng));
+}
+
+// nearest t in (0, t_max) where o + t * d meets the primitive, or t_max
+double intersect(const SimPrimitive& p, const double* o, const double* d, double t_max)
+{
+  const double ox = o[0] - p.center[0], oy = o[1] - p.center[1], oz = o[2] - p.center[2];
+  if (p.type == SimPrimitive::kSphere)
+  {
+    const double b = ox * d[0] + oy * d[1] + oz * d[2];
+    const double c = ox * ox + oy * oy + oz * oz - p.size[0] * p.size[0];
+    const double disc = b * b - c;
+    if (disc < 0)
+      return t_max;
+    const double t = -b - std::sqrt(disc);
+    return t > 0 && t < t_max ? t : t_max;
+  }
+  if (p.type == SimPrimitive::kCylinder)
+  {
+    const double r2 = p.size[0] * p.size[0];
+    const double a = d[0] * d[0] + d[1] * d[1];
+    double best = t_max;
+    if (a > 1e-12)
+    {
+      const double b = ox * d[0] + oy * d[1];
+      const double c = ox * ox + oy * oy - r2;
+      const double disc = b * b - a * c;
+      if (disc >= 0)
+      {
+        const double t = (-b - std::sqrt(disc)) / a;
+        const double z = oz + t * d[2];
+        if (t > 0 && t < best && z >= 0 && z <= p.size[1])
+          best = t;
+      }
+    }
+    // the top, seen from above
+    if (d[2] < 0 && oz > p.size[1])
+    {
+      const double t = (p.size[1] - oz) / d[2];
+      const double x = ox + t * d[0], y = oy + t * d[1];
+      if (t < best && x * x + y * y <= r2)
+        best = t;
+    }
+    return best;
+  }
+  // box: slabs in its own frame
+  const double c = std::cos(p.yaw), s = std::sin(p.yaw);
+  const double lo[3] = {c * ox + s * oy, -s * ox + c * oy, oz};
+  const double ld[3] = {c * d[0] + s * d[1], -s * d[0] + c * d[1], d[2]};
+  double t0 = 0, t1 = t_max;
+  for (int a = 0; a < 3; a++)
+  {
+    if (std::fabs(ld[a]) < 1e-12)
+    {
+      if (std::fabs(lo[a]) > p.size[a])
+        return t_max;
+      continue;
+    }
+    double ta = (-p.size[a] - lo[a]) / ld[a];
+    double tb = (p.size[a] - lo[a]) / ld[a];
+    if (ta > tb)
+      std::swap(ta, tb);
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+    if (t0 > t1)
+      return t_max;
+  }
+  return t0 > 0 ? t0 : t_max;
+}
+
+} // namespace
+
+BeamModel::BeamModel()
+  : rings(16),
+    min_elevation(-15),
+    max_elevation(15),
+    azimuth_resolution(0.2),
+    min_range(1.0),
+    max_range(100),
+    range_noise(0.03),
+    dropout(0.02),
+    height(1.5)
+{
+}
+
+PlacementRules::PlacementRules()
+  : range(40), collision(8), wamv_range(5)
+{
+}
+
+//========== Scene ==========
+SimObject makeSimObject(SimObjectKind kind, double x, double y, double yaw)
+{
+  SimObject obj;
+  obj.kind = kind;
+  obj.label = kSimObjectLabels[kind];
+  obj.x = x;
+  obj.y = y;
+  obj.yaw = yaw;
+  // parts relative to (x, y) before yaw, z above the water
+  if (kind == kSimTotem)
+    obj.parts.push_back(primitive(SimPrimitive::kCylinder, 0, 0, 0, 0.2, 1.0, 0));
+  else if (kind == kSimLightBuoy)
+  {
+    obj.parts.push_back(primitive(SimPrimitive::kCylinder, 0, 0, 0, 0.55, 0.35, 0));
+    obj.parts.push_back(primitive(SimPrimitive::kBox, 0, 0, 0.95, 0.25, 0.25, 0.6));
+  }
+  else if (kind == kSimDock)
+  {
+    // floating platform with three placards along its back edge
+    obj.parts.push_back(primitive(SimPrimitive::kBox, 0, 0, 0.15, 3.0, 1.2, 0.15));
+    for (int i = -1; i <= 1; i++)
+      obj.parts.push_back(primitive(SimPrimitive::kBox, 2.0 * i, 1.1, 0.9, 0.3, 0.03, 0.3));
+  }
+  else
+    obj.parts.push_back(primitive(SimPrimitive::kSphere, 0, 0, 0.15, 0.25, 0, 0));
+
+  const double c = std::cos(yaw), s = std::sin(yaw);
+  obj.radius = 0;
+  obj.bottom = 1e9;
+  obj.top = -1e9;
+  for (size_t i = 0; i < obj.parts.size(); i++)
+  {
+    SimPrimitive& p = obj.parts[i];
+    const double px = p.center[0], py = p.center[1];
+    p.center[0] = x + c * px - s * py;
+    p.center[1] = y + s * px + c * py;
+    p.yaw = yaw;
+    double reach, bottom, top;
+    if (p.type == SimPrimitive::kSphere)
+    {
+      reach = p.size[0];
+      bottom = p.center[2] - p.size[0];
+      top = p.center[2] + p.size[0];
+    }
+    else if (p.type == SimPrimitive::kCylinder)
+    {
+      reach = p.size[0];
+      bottom = p.center[2];
+      top = p.center[2] + p.size[1];
+    }
+    else
+    {
+      reach = std::sqrt(p.size[0] * p.size[0] + p.size[1] * p.size[1]);
+      bottom = p.center[2] - p.size[2];
+      top = p.center[2] + p.size[2];
+    }
+    obj.radius = std::max(obj.radius, std::sqrt(px * px + py * py) + reach);
+    obj.bottom = std::min(obj.bottom, std::max(0.0, bottom));
+    obj.top = std::max(obj.top, top);
+  }
+  return obj;
+}
+
+bool placeSimObjects(const std::vector<SimObjectKind>& kinds, const PlacementRules& rules, FastRand& rng,
+                     std::vector<SimObject>& objects)
+{
+  objects.clear();
+  const int range = std::max(1, rules.range);
+  for (size_t i = 0; i < kinds.size(); i++)
+  {
+    bool placed = false;
+    for (int attempt = 0; attempt < 10000 && !placed; attempt++)
+    {
+      //To get both positive and negetive value
+      const int x = (int)(rng.next() % range) * 2 + 1 - range;
+      const int y = (int)(rng.next() % range) * 2 + 1 - range;
+      placed = std::hypot(x, y) >= rules.wamv_range;
+      for (size_t j = 0; j < objects.size() && placed; j++)
+        placed = std::hypot(x - objects[j].x, y - objects[j].y) >= rules.collision;
+      if (placed)
+        objects.push_back(makeSimObject(kinds[i], x, y, M_PI * rng.symmetric(1.0f)));
+    }
+    if (!placed)
+      return false;
+  }
+  return true;
+}
+
+//========== Scan ==========
+LidarSimulator::LidarSimulator(const BeamModel& beams)
+  : beams_(beams)
+{
+  beams_.rings = std::max(1, beams_.rings);
+  for (int r = 0; r < beams_.rings; r++)
+  {
+    const double e = beams_.rings == 1 ? beams_.min_elevation
+                                       : beams_.min_elevation + (beams_.max_elevation - beams_.min_elevation) * r /
+                                                                    (beams_.rings - 1);
+    ring_elevation_.push_back(e * kDeg);
+    ring_cos_.push_back(std::cos(e * kDeg));
+    ring_sin_.push_back(std::sin(e * kDeg));
+  }
+  azimuths_ = std::max(1, (int)std::floor(360.0 / beams_.azimuth_resolution + 0.5));
+}
+
+void LidarSimulator::scan(const std::vector<SimObject>& objects, FastRand& rng, std::vector<float>& xyz,
+                          std::vector<uint32_t>& labels, std::vector<uint32_t>* hits) const
+{
+  xyz.clear();
+  labels.clear();
+  if (hits)
+    hits->clear();
+  const double step = 2.0 * M_PI / azimuths_;
+  const double phase = step * uniform(rng);
+  const double h = beams_.height;
+
+  // ======= the beams that can reach an object: (azimuth, object) =======
+  std::vector<std::pair<int, int> > beams;
+  std::vector<double> elev_lo(objects.size()), elev_hi(objects.size());
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    const SimObject& obj = objects[i];
+    const double dist = std::hypot(obj.x, obj.y);
+    if (dist - obj.radius > beams_.max_range)
+      continue;
+    int k_lo = 0, k_hi = azimuths_ - 1;
+    const double near = std::max(dist - obj.radius, 0.01), far = dist + obj.radius;
+    if (dist > obj.radius)
+    {
+      const double center = std::atan2(obj.y, obj.x);
+      const double half = std::asin(obj.radius / dist);
+      k_lo = (int)std::ceil((center - half - phase) / step);
+      k_hi = (int)std::floor((center + half - phase) / step);
+    }
+    elev_lo[i] = std::min(std::atan2(obj.bottom - h, near), std::atan2(obj.bottom - h, far));
+    elev_hi[i] = std::max(std::atan2(obj.top - h, near), std::atan2(obj.top - h, far));
+    for (int k = k_lo; k <= k_hi; k++)
+      beams.push_back(std::make_pair(((k % azimuths_) + azimuths_) % azimuths_, (int)i));
+  }
+  std::sort(beams.begin(), beams.end());
+
+  // ======= cast them, nearest hit per beam =======
+  const double origin[3] = {0, 0, h};
+  for (size_t b = 0; b < beams.size();)
+  {
+    const int k = beams[b].first;
+    size_t end = b;
+    while (end < beams.size() && beams[end].first == k)
+      end++;
+    const double theta = phase + k * step;
+    const double ct = std::cos(theta), st = std::sin(theta);
+    for (int r = 0; r < beams_.rings; r++)
+    {
+      const double e = ring_elevation_[r];
+      const double d[3] = {ring_cos_[r] * ct, ring_cos_[r] * st, ring_sin_[r]};
+      // the water stops a downward beam
+      double t_max = d[2] < 0 ? std::min(beams_.max_range, -h / d[2]) : beams_.max_range;
+      double t = t_max;
+      int hit = -1;
+      for (size_t j = b; j < end; j++)
+      {
+        const int i = beams[j].second;
+        if (e < elev_lo[i] || e > elev_hi[i])
+          continue;
+        const SimObject& obj = objects[i];
+        for (size_t p = 0; p < obj.parts.size(); p++)
+        {
+          const double tp = intersect(obj.parts[p], origin, d, t);
+          if (tp < t)
+          {
+            t = tp;
+            hit = i;
+          }
+        }
+      }
+      if (hit < 0 || t < beams_.min_range)
+        continue;
+      if (beams_.dropout > 0 && uniform(rng) < beams_.dropout)
+        continue;
+      if (beams_.range_noise > 0)
+        t += beams_.range_noise * gaussian(rng);
+      xyz.push_back(t * d[0]);
+      xyz.push_back(t * d[1]);
+      xyz.push_back(t * d[2]);
+      labels.push_back(objects[hit].label);
+      if (hits)
+        hits->push_back(hit);
+    }
+    b = end;
+  }
+}
+
+} // namespace velodyne_perception
@@ -64,42 +64,26 @@ Publish:
 #include <tf_conversions/tf_eigen.h>
 #include <tf2/LinearMath/Quaternion.h>
 
+#include <velodyne_perception/cluster_pipeline.h>
+#include <velodyne_perception/dataset_writer.h>
+#include <velodyne_perception/model_labeler.h>
+
 using namespace Eigen;
 using namespace message_filters;
+using velodyne_perception::ClusterPoint;
+using velodyne_perception::ClusterCloud;
 //define point cloud type
 
-typedef uint32_t uint32;
-struct PointCloudLabel
-{
-  PCL_ADD_POINT4D;                  // preferred way of adding a XYZ+padding
-  PCL_ADD_RGB;
-  uint32 label;
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW   // make sure our new allocators are aligned
-} EIGEN_ALIGN16;                    // enforce SSE padding for correct memory alignment
-
-POINT_CLOUD_REGISTER_POINT_STRUCT (PointCloudLabel,           // here we assume a XYZ + "test" (as fields)
-                                   (float, x, x)
-                                   (float, y, y)
-                                   (float, z, z)
-                                   (float, rgb, rgb)
-                                   (uint32, label, label)
-)
-
-typedef pcl::PointCloud<pcl::PointXYZ> PointCloudXYZ;
+// x, y, z, rgb, label, coloured after the label (point_cloud_label.h)
+using velodyne_perception::PointCloudLabel;
+
 typedef pcl::PointCloud<pcl::PointXYZRGB> PointCloudXYZRGB;
 typedef pcl::PointCloud<PointCloudLabel> PointLabel;
 
 //typedef boost::shared_ptr <robotx_msgs::BoolStamped const> BoolStampedConstPtr;
 //declare point cloud
-PointCloudXYZ::Ptr cloud_inXYZ (new PointCloudXYZ);
-PointCloudXYZRGB::Ptr cloud_in (new PointCloudXYZRGB); 
-PointCloudXYZRGB::Ptr cloud_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr plane_filtered (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_h (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_f (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_plane (new PointCloudXYZRGB);
-PointCloudXYZRGB::Ptr cloud_scene(new PointCloudXYZRGB);
-//PointCloudXYZRGB::Ptr wall (new PointCloudXYZRGB);
+ClusterCloud::Ptr cloud_in (new ClusterCloud);
+ClusterCloud::Ptr cloud_filtered (new ClusterCloud);
 PointCloudXYZRGB::Ptr result (new PointCloudXYZRGB);
 PointLabel::Ptr label_cloud (new PointLabel);
 
@@ -138,6 +122,11 @@ float new_pos_arr[2][2];
 float new_pos_arr_tf[2][2];
 float pos_arr[2][2];
 float pos_arr_tf[2][2];
+float new_yaw_tf[2];
+float yaw_tf[2];
+// half length / half width of the model footprints, m
+float footprint_size[2][2] = {{4.0, 2.0}, {4.0, 2.0}};
+bool use_footprints = false;
 bool first = true;
 int pcd_count = 601;
 
@@ -151,6 +140,8 @@ void drawRviz(robotx_msgs::ObstaclePoseList); //draw marker in Rviz
 void drawRviz_line(robotx_msgs::ObstaclePoseList); //draw marker line list in Rviz
 
 tf::TransformListener* lr;
+velodyne_perception::DatasetWriter<PointCloudLabel>* dataset_writer;
+velodyne_perception::TaskPool* label_pool;
 int gazebo_world_counter = 0;
 int move_x = 0;
 tf::StampedTransform tf_transform;
@@ -162,25 +153,7 @@ void callback(const sensor_msgs::PointCloud2ConstPtr& input)
     //covert from ros type to pcl type
     pcl_frame_id.data = input->header.frame_id;
     pcl_t = input->header.stamp;
-    pcl::fromROSMsg (*input, *cloud_inXYZ);
-    copyPointCloud(*cloud_inXYZ, *cloud_in);
-
-    //set color for point cloud
-    for (size_t i = 0; i < cloud_in->points.size(); i++){
-      if (cloud_in->points[i].y > 0)
-      {
-        cloud_in->points[i].r = 255;
-        cloud_in->points[i].g = 0;
-        cloud_in->points[i].b = 255;
-      }
-      else
-      {
-        cloud_in->points[i].r = 0;
-        cloud_in->points[i].g = 255;
-        cloud_in->points[i].b = 0;
-      }
-      
-    }
+    pcl::fromROSMsg (*input, *cloud_in);
     clock_t t_start = clock();
 
     std::string source_frame="/velodyne";
@@ -254,6 +227,8 @@ void auto_label()
     tf::Vector3 tf_pos = tf_rot * pos;
     new_pos_arr_tf[i][0] = tf_pos[0];
     new_pos_arr_tf[i][1] = tf_pos[1];
+    new_yaw_tf[i] = tf::getYaw(quat * tf::Quaternion(p.orientation.x, p.orientation.y, p.orientation.z,
+                                                     p.orientation.w));
   }
   set_gazebo_world("wamv", 0, 0, -0.0823);
 }
@@ -265,13 +240,7 @@ void cluster_pointcloud()
   copyPointCloud(*cloud_in, *cloud_filtered);  
 
   //========== Outlier remove ==========
-  pcl::RadiusOutlierRemoval<pcl::PointXYZRGB> outrem;
-  // build the filter
-  outrem.setInputCloud(cloud_filtered);
-  outrem.setRadiusSearch(2.2);
-  outrem.setMinNeighborsInRadius (2);
-  // apply filter
-  outrem.filter (*cloud_filtered);
+  velodyne_perception::removeRadiusOutlier<ClusterPoint>(cloud_filtered, 2.2, 2);
 
   //========== Auto Labeling ==========
   for (int i = 0; i < MODEL_NUM; i++)
@@ -280,6 +249,7 @@ void cluster_pointcloud()
     {
       pos_arr_tf[i][j] = new_pos_arr_tf[i][j];
     }
+    yaw_tf[i] = new_yaw_tf[i];
   }
   auto_label();
   //for(int i = 0; i < MODEL_NUM; i++)
@@ -300,80 +270,28 @@ void cluster_pointcloud()
     return;
   }
 
-  label_cloud->points.resize(cloud_filtered->points.size());
-  label_cloud->width = cloud_filtered->width;
-  label_cloud->height = cloud_filtered->height;
-  
-  for(size_t idx = 0; idx < cloud_filtered->points.size(); ++idx)
+  std::vector<velodyne_perception::LabelModel> models(MODEL_NUM);
+  for (int i = 0; i < MODEL_NUM; i++)
   {
-    float x = cloud_filtered->points[idx].x;
-    float y = cloud_filtered->points[idx].y;
-    float z = cloud_filtered->points[idx].z;
-    float min_dis = 100000000;
-    int min_idx;
-    for(int i = 0; i < MODEL_NUM; i++)
-    {
-      
-      float dis = sqrt(pow((x-pos_arr_tf[i][0]), 2) + pow((y-pos_arr_tf[i][1]), 2));
-      //float dis = sqrt(pow((x+pos_arr[i][1]), 2) + pow((y-pos_arr[i][0]), 2));
-      if(min_dis > dis)
-      {
-        min_dis = dis;
-        min_idx = i;
-      }
-    }
-    
-    label_cloud->points[idx].x = x;
-    label_cloud->points[idx].y = y;
-    label_cloud->points[idx].z = z;
-    label_cloud->points[idx].label = class_dic[min_idx];
-    if (label_cloud->points[idx].label == 1)
-    {
-      label_cloud->points[idx].r = 0;
-      label_cloud->points[idx].g = 255;
-      label_cloud->points[idx].b = 0;
-    }
-    else if (label_cloud->points[idx].label == 2)
-    {
-      label_cloud->points[idx].r = 255;
-      label_cloud->points[idx].g = 255;
-      label_cloud->points[idx].b = 0;
-    }
-    else if (label_cloud->points[idx].label == 3)
-    {
-      label_cloud->points[idx].r = 255;
-      label_cloud->points[idx].g = 255;
-      label_cloud->points[idx].b = 255;
-    }
-    else if (label_cloud->points[idx].label == 4)
-    {
-      label_cloud->points[idx].r = 0;
-      label_cloud->points[idx].g = 0;
-      label_cloud->points[idx].b = 255;
-    }
-    else if (label_cloud->points[idx].label == 5)
-    {
-      label_cloud->points[idx].r = 0;
-      label_cloud->points[idx].g = 0;
-      label_cloud->points[idx].b = 255;
-    }
-    else if (label_cloud->points[idx].label == 6)
-    {
-      label_cloud->points[idx].r = 0;
-      label_cloud->points[idx].g = 0;
-      label_cloud->points[idx].b = 255;
-    }
+    if (use_footprints)
+      models[i] = velodyne_perception::footprintModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i], yaw_tf[i],
+                                                      footprint_size[i][0], footprint_size[i][1]);
+    else
+      models[i] = velodyne_perception::LabelModel(pos_arr_tf[i][0], pos_arr_tf[i][1], class_dic[i]);
   }
+  // points outside every footprint get label 0
+  velodyne_perception::labelByModels(*cloud_filtered, models, *label_cloud, label_pool);
 
   std::ostringstream oss;
   oss << "/media/arg_ws3/5E703E3A703E18EB/pcd/gazebo_a_" << pcd_count << ".pcd";
   std::string file_name = oss.str();
   if (label_cloud->points.size()!=0)
   {
-    pcl::io::savePCDFile(file_name, *label_cloud);
+    dataset_writer->write(label_cloud, file_name);
     std::cout << "Save PDC file: " << pcd_count << ".pcd" << std::endl;
     pcd_count++;
-    label_cloud->clear();
+    // the writer owns the queued cloud now
+    label_cloud.reset(new PointLabel);
   }
 
   if (pcd_count > 800)
@@ -686,6 +604,20 @@ int main (int argc, char** argv)
   get_client = nh.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state");
   tf::TransformListener listener(ros::Duration(1.0));
   lr = &listener;
+  // .pcd / .ply are encoded and saved off the callback thread
+  int writer_threads = nh.param("writer_threads", 2);
+  int writer_queue = nh.param("writer_queue", 16);
+  bool compress = nh.param("compress", true);
+  ROS_INFO("[pcl_cluster] Param [writer_threads] = %d, [writer_queue] = %d, [compress] = %d",
+           writer_threads, writer_queue, compress);
+  velodyne_perception::DatasetWriter<PointCloudLabel> writer(writer_threads, writer_queue, compress);
+  dataset_writer = &writer;
+  // nearest-model labeling, on all cores for large scans
+  use_footprints = nh.param("footprints", false);
+  int label_threads = nh.param("label_threads", -1);
+  ROS_INFO("[pcl_cluster] Param [footprints] = %d, [label_threads] = %d", use_footprints, label_threads);
+  velodyne_perception::TaskPool pool(label_threads);
+  label_pool = &pool;
   if (visual)
     std::cout<< "Start to clustering" << std::endl;
   ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2> ("/pcl_preprocessing/velodyne_points_preprocess", 1, callback);
@@ -697,4 +629,10 @@ int main (int argc, char** argv)
   pub_result = nh.advertise<sensor_msgs::PointCloud2> ("/cluster_result", 1);
   pub_points = nh.advertise<robotx_msgs::PCL_points> ("/pcl_points", 1);
   ros::spin ();
+  // ros::shutdown() or Ctrl-C: save what is still queued
+  writer.flush();
+  velodyne_perception::DatasetWriterStats stats = writer.stats();
+  ROS_INFO("[pcl_cluster] Saved %lu of %lu clouds (%lu failed), labeling waited for the disk %lu times, %.2f s",
+           (unsigned long)stats.written, (unsigned long)stats.queued, (unsigned long)stats.failed,
+           (unsigned long)stats.blocked, stats.blocked_sec);
 }
\ No newline at end of file
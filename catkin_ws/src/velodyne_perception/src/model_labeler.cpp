@@ -0,0 +1,102 @@
+/**********************************
+Model Labeler
+  See model_labeler.h
+***********************************/
+#include <velodyne_perception/model_labeler.h>
+
+#include <cmath>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace velodyne_perception
+{
+
+LabelModel::LabelModel()
+  : x(0), y(0), label(0), yaw(0), half_length(0), half_width(0)
+{
+}
+
+LabelModel::LabelModel(float x, float y, uint32_t label)
+  : x(x), y(y), label(label), yaw(0), half_length(0), half_width(0)
+{
+}
+
+LabelModel footprintModel(float x, float y, uint32_t label, float yaw, float half_length, float half_width)
+{
+  LabelModel m(x, y, label);
+  m.yaw = yaw;
+  m.half_length = half_length;
+  m.half_width = half_width;
+  return m;
+}
+
+void nearestModel(const float* x, const float* y, size_t n, const LabelModel* models, size_t num_models,
+                  int32_t* index)
+{
+  // the footprint axes, once per call rather than per point
+  std::vector<float> cos_yaw(num_models), sin_yaw(num_models);
+  std::vector<char> footprint(num_models);
+  for (size_t j = 0; j < num_models; j++)
+  {
+    cos_yaw[j] = std::cos(models[j].yaw);
+    sin_yaw[j] = std::sin(models[j].yaw);
+    footprint[j] = models[j].half_length > 0 && models[j].half_width > 0;
+  }
+  const float inf = std::numeric_limits<float>::infinity();
+
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 px = _mm_loadu_ps(x + i);
+    const __m128 py = _mm_loadu_ps(y + i);
+    __m128 best = _mm_set1_ps(inf);
+    __m128i best_index = _mm_set1_epi32(-1);
+    for (size_t j = 0; j < num_models; j++)
+    {
+      const LabelModel& m = models[j];
+      const __m128 dx = _mm_sub_ps(px, _mm_set1_ps(m.x));
+      const __m128 dy = _mm_sub_ps(py, _mm_set1_ps(m.y));
+      const __m128 d = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+      __m128 take = _mm_cmplt_ps(d, best);
+      if (footprint[j])
+      {
+        const __m128 c = _mm_set1_ps(cos_yaw[j]), s = _mm_set1_ps(sin_yaw[j]);
+        const __m128 u = _mm_add_ps(_mm_mul_ps(c, dx), _mm_mul_ps(s, dy));
+        const __m128 v = _mm_sub_ps(_mm_mul_ps(c, dy), _mm_mul_ps(s, dx));
+        const __m128 inside = _mm_and_ps(_mm_cmple_ps(_mm_and_ps(u, abs_mask), _mm_set1_ps(m.half_length)),
+                                         _mm_cmple_ps(_mm_and_ps(v, abs_mask), _mm_set1_ps(m.half_width)));
+        take = _mm_and_ps(take, inside);
+      }
+      best = _mm_or_ps(_mm_and_ps(take, d), _mm_andnot_ps(take, best));
+      const __m128i take_i = _mm_castps_si128(take);
+      best_index = _mm_or_si128(_mm_and_si128(take_i, _mm_set1_epi32((int)j)), _mm_andnot_si128(take_i, best_index));
+    }
+    _mm_storeu_si128((__m128i*)(index + i), best_index);
+  }
+#endif
+  for (; i < n; i++)
+  {
+    float best = inf;
+    int32_t best_index = -1;
+    for (size_t j = 0; j < num_models; j++)
+    {
+      const LabelModel& m = models[j];
+      const float dx = x[i] - m.x, dy = y[i] - m.y;
+      const float d = dx * dx + dy * dy;
+      if (!(d < best))
+        continue;
+      if (footprint[j] && (std::fabs(cos_yaw[j] * dx + sin_yaw[j] * dy) > m.half_length ||
+                           std::fabs(cos_yaw[j] * dy - sin_yaw[j] * dx) > m.half_width))
+        continue;
+      best = d;
+      best_index = j;
+    }
+    index[i] = best_index;
+  }
+}
+
+} // namespace velodyne_perception
@@ -0,0 +1,454 @@
+/**********************************
+multiview_native
+  Python extension (Boost.Python / Boost.NumPy) over the C++ kernels of the cluster nodes
+  and classify_cpu, so the Python classifiers and the training scripts
+  render, describe and resample clusters exactly like the runtime does:
+    render(points, yaw=0, size=227, boundary=-1, point_size=-1)
+                                 -> uint8 (size, size, 3), toIMG() of the classifiers
+    scales(points, yaw=0, size=227, boundary=-1)
+                                 -> (xy, yz, xz) pixels per metre
+    to_tensor(image, mean=(0, 0, 0))
+                                 -> float32 (3, size, size), caffe's data layout
+    rotate(points, yaw)          -> float64 (n, 3), by -yaw about z
+    bounds(points)               -> (min xyz, max xyz)
+    describe(points)             -> float32 (DESCRIPTOR_SIZE,), names in DESCRIPTOR_NAMES
+    resample(points, budget, jitter=0.03, seed=1)
+                                 -> float32 (budget, 3), the ~point_budget of the cluster nodes
+    farthest_point_sample(points, budget)
+                                 -> float32 (min(n, budget), 3)
+    Loader(source, size=227, batch=32, ...)
+                                 iterates (images, labels) batches of
+                                 DatasetLoader: float32 (count, 3, size, size)
+                                 and int32 (count,) views of its buffers; the
+                                 buffer is refilled once both are released
+  points is an (n, 3) array. C-contiguous float64 arrays are read in place
+  through the buffer protocol, anything else is converted once. yaw is
+  the bearing of the centroid for clusters in the sensor frame,
+  atan2(y, x), and 0 for pcl_points_local. boundary and point_size
+  default to the 227 proportions scaled to size (50 and 4 at 227).
+  The GIL is released while a kernel runs.
+***********************************/
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <pcl/point_types.h>
+
+#include <velodyne_perception/cluster_descriptor.h>
+#include <velodyne_perception/cluster_resample.h>
+#include <velodyne_perception/dataset_loader.h>
+#include <velodyne_perception/multiview_renderer.h>
+
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+using velodyne_perception::DatasetLoader;
+using velodyne_perception::LoaderConfig;
+using velodyne_perception::MultiViewRenderer;
+
+namespace
+{
+
+// releases the GIL for the life of the scope
+class ReleaseGil
+{
+public:
+  ReleaseGil() : state_(PyEval_SaveThread()) {}
+  ~ReleaseGil() { PyEval_RestoreThread(state_); }
+
+private:
+  PyThreadState* state_;
+};
+
+// a C-contiguous array of T: obj itself when it already is one, a copy otherwise
+template <typename T>
+np::ndarray contiguous(const bp::object& obj)
+{
+  return np::from_object(obj, np::dtype::get_builtin<T>(), np::ndarray::CARRAY_RO);
+}
+
+template <typename T>
+np::ndarray empty(const bp::tuple& shape)
+{
+  return np::empty(shape, np::dtype::get_builtin<T>());
+}
+
+np::ndarray toPoints(const bp::object& obj, size_t& n)
+{
+  np::ndarray points = contiguous<double>(obj);
+  if (points.get_nd() != 2 || points.shape(1) != 3)
+    throw std::invalid_argument("points must be an (n, 3) array");
+  n = points.shape(0);
+  return points;
+}
+
+const double* data(const np::ndarray& points)
+{
+  return reinterpret_cast<const double*>(points.get_data());
+}
+
+std::vector<float> toMean(const bp::object& obj)
+{
+  if (bp::len(obj) != 3)
+    throw std::invalid_argument("mean must have 3 values");
+  std::vector<float> mean(3);
+  for (int c = 0; c < 3; c++)
+    mean[c] = bp::extract<float>(obj[c]);
+  return mean;
+}
+
+MultiViewRenderer makeRenderer(int size, int boundary, int point_size)
+{
+  if (size <= 0)
+    throw std::invalid_argument("size must be positive");
+  const MultiViewRenderer scaled = MultiViewRenderer::scaledTo(size);
+  boundary = boundary < 0 ? scaled.boundary() : boundary;
+  point_size = point_size < 0 ? scaled.pointSize() : point_size;
+  if (2 * boundary >= size)
+    throw std::invalid_argument("boundary must be less than size / 2");
+  return MultiViewRenderer(size, boundary, point_size);
+}
+
+// the same rotation as MultiViewRenderer::render(cloud, yaw, ...)
+void rotateInto(const double* xyz, size_t n, double yaw, double* out)
+{
+  const double c = std::cos(yaw), s = std::sin(yaw);
+  for (size_t i = 0; i < n; i++)
+  {
+    const double x = xyz[3 * i], y = xyz[3 * i + 1];
+    out[3 * i] = c * x + s * y;
+    out[3 * i + 1] = -s * x + c * y;
+    out[3 * i + 2] = xyz[3 * i + 2];
+  }
+}
+
+// the points in the frame of the views: in place when yaw is 0
+const double* localPoints(const double* xyz, size_t n, double yaw, std::vector<double>& rotated)
+{
+  if (n == 0)
+    return NULL;
+  if (yaw == 0)
+    return xyz;
+  rotated.resize(3 * n);
+  rotateInto(xyz, n, yaw, &rotated[0]);
+  return &rotated[0];
+}
+
+pcl::PointCloud<pcl::PointXYZ> toCloud(const bp::object& obj)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  const double* xyz = data(points);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.points.resize(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    cloud.points[i].x = xyz[3 * i];
+    cloud.points[i].y = xyz[3 * i + 1];
+    cloud.points[i].z = xyz[3 * i + 2];
+  }
+  cloud.width = n;
+  cloud.height = 1;
+  return cloud;
+}
+
+np::ndarray fromCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  np::ndarray out = empty<float>(bp::make_tuple(cloud.points.size(), 3));
+  float* xyz = reinterpret_cast<float*>(out.get_data());
+  for (size_t i = 0; i < cloud.points.size(); i++)
+  {
+    xyz[3 * i] = cloud.points[i].x;
+    xyz[3 * i + 1] = cloud.points[i].y;
+    xyz[3 * i + 2] = cloud.points[i].z;
+  }
+  return out;
+}
+
+//========== Views ==========
+np::ndarray render(const bp::object& obj, double yaw, int size, int boundary, int point_size)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  const MultiViewRenderer renderer = makeRenderer(size, boundary, point_size);
+  np::ndarray image = empty<uint8_t>(bp::make_tuple(size, size, 3));
+  uint8_t* out = reinterpret_cast<uint8_t*>(image.get_data());
+  {
+    ReleaseGil release;
+    std::vector<double> rotated;
+    renderer.render(localPoints(data(points), n, yaw, rotated), n, out);
+  }
+  return image;
+}
+
+bp::tuple scales(const bp::object& obj, double yaw, int size, int boundary)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  const MultiViewRenderer renderer = makeRenderer(size, boundary, -1);
+  double scale[3];
+  {
+    ReleaseGil release;
+    std::vector<double> rotated;
+    renderer.scales(localPoints(data(points), n, yaw, rotated), n, scale);
+  }
+  return bp::make_tuple(scale[0], scale[1], scale[2]);
+}
+
+np::ndarray toTensor(const bp::object& obj, const bp::object& mean_obj)
+{
+  const np::ndarray image = contiguous<uint8_t>(obj);
+  if (image.get_nd() != 3 || image.shape(2) != 3 || image.shape(0) != image.shape(1) || image.shape(0) == 0)
+    throw std::invalid_argument("image must be a square (size, size, 3) array");
+  const std::vector<float> mean = toMean(mean_obj);
+  const int size = image.shape(0);
+  const MultiViewRenderer renderer(size);
+  np::ndarray chw = empty<float>(bp::make_tuple(3, size, size));
+  float* out = reinterpret_cast<float*>(chw.get_data());
+  const uint8_t* hwc = reinterpret_cast<const uint8_t*>(image.get_data());
+  {
+    ReleaseGil release;
+    renderer.toTensor(hwc, &mean[0], out);
+  }
+  return chw;
+}
+
+//========== Geometry ==========
+np::ndarray rotate(const bp::object& obj, double yaw)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  np::ndarray out = empty<double>(bp::make_tuple(n, 3));
+  if (n > 0)
+    rotateInto(data(points), n, yaw, reinterpret_cast<double*>(out.get_data()));
+  return out;
+}
+
+bp::tuple bounds(const bp::object& obj)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  if (n == 0)
+    throw std::invalid_argument("bounds of an empty cloud");
+  const double* xyz = data(points);
+  np::ndarray lo = empty<double>(bp::make_tuple(3)), hi = empty<double>(bp::make_tuple(3));
+  double* l = reinterpret_cast<double*>(lo.get_data());
+  double* h = reinterpret_cast<double*>(hi.get_data());
+  for (int a = 0; a < 3; a++)
+    l[a] = h[a] = xyz[a];
+  for (size_t i = 1; i < n; i++)
+    for (int a = 0; a < 3; a++)
+    {
+      l[a] = std::min(l[a], xyz[3 * i + a]);
+      h[a] = std::max(h[a], xyz[3 * i + a]);
+    }
+  return bp::make_tuple(lo, hi);
+}
+
+np::ndarray describe(const bp::object& obj)
+{
+  size_t n;
+  const np::ndarray points = toPoints(obj, n);
+  np::ndarray descriptor = empty<float>(bp::make_tuple((int)velodyne_perception::kDescriptorSize));
+  float* out = reinterpret_cast<float*>(descriptor.get_data());
+  const double* xyz = n ? data(points) : NULL;
+  {
+    ReleaseGil release;
+    velodyne_perception::describeGeometry(xyz, n, out);
+  }
+  return descriptor;
+}
+
+np::ndarray resample(const bp::object& obj, size_t budget, float jitter, uint32_t seed)
+{
+  pcl::PointCloud<pcl::PointXYZ> cloud = toCloud(obj), out;
+  {
+    ReleaseGil release;
+    velodyne_perception::FastRand rng(seed);
+    velodyne_perception::resampleToBudget(cloud, budget, jitter, rng, out);
+  }
+  return fromCloud(out);
+}
+
+np::ndarray farthestPointSample(const bp::object& obj, size_t budget)
+{
+  pcl::PointCloud<pcl::PointXYZ> cloud = toCloud(obj), out;
+  {
+    ReleaseGil release;
+    velodyne_perception::farthestPointSample(cloud, budget, out);
+  }
+  return fromCloud(out);
+}
+
+//========== Dataset ==========
+// owns a held batch until the last array viewing it is gone
+struct HeldBatch
+{
+  std::shared_ptr<DatasetLoader> loader;
+  const DatasetLoader::Batch* batch;
+};
+
+void releaseBatch(PyObject* capsule)
+{
+  HeldBatch* held = static_cast<HeldBatch*>(PyCapsule_GetPointer(capsule, NULL));
+  held->loader->release(held->batch);
+  delete held;
+}
+
+class Loader
+{
+public:
+  Loader(const std::string& source, const LoaderConfig& config) : loader_(new DatasetLoader)
+  {
+    std::string error;
+    bool ok;
+    {
+      ReleaseGil release;
+      ok = loader_->open(source, config, &error);
+    }
+    if (!ok)
+      throw std::runtime_error(error);
+  }
+
+  bp::tuple next()
+  {
+    const DatasetLoader::Batch* batch;
+    std::string error;
+    {
+      ReleaseGil release;
+      batch = loader_->next(&error);
+    }
+    // every batch still referenced, not the end of the data
+    if (!batch && !error.empty())
+      throw std::runtime_error(error);
+    if (!batch)
+    {
+      PyErr_SetNone(PyExc_StopIteration);
+      bp::throw_error_already_set();
+    }
+    HeldBatch* held = new HeldBatch;
+    held->loader = loader_;
+    held->batch = batch;
+    const bp::object owner(bp::handle<>(PyCapsule_New(held, NULL, &releaseBatch)));
+    const Py_intptr_t size = loader_->config().size;
+    // const data: read-only views of the loader's buffers
+    const np::ndarray images =
+        np::from_data(static_cast<const void*>(batch->images), np::dtype::get_builtin<float>(),
+                      bp::make_tuple(batch->count, 3, size, size),
+                      bp::make_tuple(3 * size * size * sizeof(float), size * size * sizeof(float), size * sizeof(float),
+                                     sizeof(float)),
+                      owner);
+    const np::ndarray labels = np::from_data(static_cast<const void*>(batch->labels), np::dtype::get_builtin<int32_t>(),
+                                             bp::make_tuple(batch->count), bp::make_tuple(sizeof(int32_t)), owner);
+    return bp::make_tuple(images, labels);
+  }
+
+  const DatasetLoader& loader() const { return *loader_; }
+
+private:
+  std::shared_ptr<DatasetLoader> loader_;
+};
+
+Loader* makeLoader(const std::string& source, int size, int batch, int threads, int prefetch, bool shuffle,
+                   bool loop, bool lock_memory, uint32_t seed, const bp::object& mean, float cluster_tolerance,
+                   int min_points, double rotation, float jitter, float dropout)
+{
+  LoaderConfig config;
+  config.size = size;
+  config.batch = batch;
+  config.threads = threads;
+  // the loop variables of a for loop hold the last batch while the next
+  // one is fetched, so one slot is always taken
+  config.prefetch = std::max(2, prefetch);
+  config.shuffle = shuffle;
+  config.loop = loop;
+  config.lock_memory = lock_memory;
+  config.seed = seed;
+  const std::vector<float> m = toMean(mean);
+  std::copy(m.begin(), m.end(), config.mean);
+  config.cluster_tolerance = cluster_tolerance;
+  config.min_points = min_points;
+  config.rotation = rotation;
+  config.jitter = jitter;
+  config.dropout = dropout;
+  return new Loader(source, config);
+}
+
+bp::object self(const bp::object& loader)
+{
+  return loader;
+}
+
+size_t samples(const Loader& loader)
+{
+  return loader.loader().samples();
+}
+
+bp::list labels(const Loader& loader)
+{
+  bp::list out;
+  const std::vector<int>& labels = loader.loader().labels();
+  for (size_t i = 0; i < labels.size(); i++)
+    out.append(labels[i]);
+  return out;
+}
+
+uint64_t stalls(const Loader& loader)
+{
+  return loader.loader().stalls();
+}
+
+} // namespace
+
+BOOST_PYTHON_MODULE(multiview_native)
+{
+  np::initialize();
+  bp::scope().attr("__doc__") = "Multi-view rendering, cluster descriptors and resampling of velodyne_perception";
+  const bp::tuple zero_mean = bp::make_tuple(0.0, 0.0, 0.0);
+
+  bp::def("render", &render,
+          (bp::arg("points"), bp::arg("yaw") = 0.0, bp::arg("size") = 227, bp::arg("boundary") = -1,
+           bp::arg("point_size") = -1),
+          "Render the xy / yz / xz views of an (n, 3) cluster into a (size, size, 3) image");
+  bp::def("scales", &scales,
+          (bp::arg("points"), bp::arg("yaw") = 0.0, bp::arg("size") = 227, bp::arg("boundary") = -1),
+          "Pixels per metre of the xy, yz and xz views render() would draw");
+  bp::def("to_tensor", &toTensor, (bp::arg("image"), bp::arg("mean") = zero_mean),
+          "A (size, size, 3) image as a (3, size, size) float32 array minus mean");
+  bp::def("rotate", &rotate, (bp::arg("points"), bp::arg("yaw")), "Rotate (n, 3) points by -yaw about z");
+  bp::def("bounds", &bounds, (bp::arg("points")), "Per axis minimum and maximum of (n, 3) points");
+  bp::def("describe", &describe, (bp::arg("points")), "Geometric descriptor of a cluster in the sensor frame");
+  bp::def("resample", &resample,
+          (bp::arg("points"), bp::arg("budget"), bp::arg("jitter") = 0.03f, bp::arg("seed") = 1u),
+          "Farthest point sampling / jittered padding to exactly budget points");
+  bp::def("farthest_point_sample", &farthestPointSample, (bp::arg("points"), bp::arg("budget")),
+          "Keep at most budget points, each farthest from the kept ones");
+
+  bp::class_<Loader, boost::noncopyable>("Loader",
+                                         "Prefetching multi-view batches of a directory or list of labelled .pcd clouds",
+                                         bp::no_init)
+      .def("__init__", bp::make_constructor(&makeLoader, bp::default_call_policies(),
+                                            (bp::arg("source"), bp::arg("size") = 227, bp::arg("batch") = 32,
+                                             bp::arg("threads") = -1, bp::arg("prefetch") = 4, bp::arg("shuffle") = true,
+                                             bp::arg("loop") = true, bp::arg("lock_memory") = false,
+                                             bp::arg("seed") = 1u, bp::arg("mean") = zero_mean,
+                                             bp::arg("cluster_tolerance") = 2.2f, bp::arg("min_points") = 3,
+                                             bp::arg("rotation") = 0.0, bp::arg("jitter") = 0.0f,
+                                             bp::arg("dropout") = 0.0f)))
+      .def("__iter__", &self)
+      .def("__next__", &Loader::next)
+      .def("next", &Loader::next)
+      .add_property("samples", &samples)
+      .add_property("labels", &labels)
+      .add_property("stalls", &stalls);
+
+  bp::list names;
+  for (int f = 0; f < velodyne_perception::kDescriptorSize; f++)
+    names.append(velodyne_perception::kDescriptorNames[f]);
+  bp::scope().attr("DESCRIPTOR_NAMES") = names;
+  bp::scope().attr("DESCRIPTOR_SIZE") = (int)velodyne_perception::kDescriptorSize;
+}
@@ -0,0 +1,224 @@
+/**********************************
+Multi-view Renderer
+  see multiview_renderer.h
+***********************************/
+#include <velodyne_perception/multiview_renderer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace velodyne_perception
+{
+
+namespace
+{
+
+// Python 2 round(): half away from zero. All inputs here are >= 0, so a
+// truncating cast is floor() without the libm call.
+inline int roundHalfUp(double v)
+{
+  return (int)(v + 0.5);
+}
+
+// out[i] = max(out[i], in[i]) for n bytes, n a multiple of 16
+inline void maxInto(uint8_t* out, const uint8_t* in, size_t n)
+{
+#ifdef __SSE2__
+  for (size_t i = 0; i < n; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(out + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(in + i));
+    _mm_storeu_si128((__m128i*)(out + i), _mm_max_epu8(a, b));
+  }
+#else
+  for (size_t i = 0; i < n; i++)
+    out[i] = std::max(out[i], in[i]);
+#endif
+}
+
+} // namespace
+
+MultiViewRenderer::MultiViewRenderer(int size, int boundary, int point_size)
+  : size_(size), boundary_(boundary), point_size_(point_size)
+{
+}
+
+MultiViewRenderer MultiViewRenderer::scaledTo(int size)
+{
+  return MultiViewRenderer(size, roundHalfUp(50.0 * size / 227), std::max(1, roundHalfUp(4.0 * size / 227)));
+}
+
+void MultiViewRenderer::render(const double* xyz, size_t n, uint8_t* image) const
+{
+  std::memset(image, 0, imageBytes());
+  if (n == 0)
+    return;
+  // Scratch planes with a point_size margin on every side and 16 byte
+  // aligned rows, so the shifted loads of the dilation never go out of
+  // bounds. Local, because the cluster pipeline renders from several threads.
+  const int r = point_size_;
+  const size_t stride = ((((size_ + 15) & ~15) + 2 * r) + 15) & ~15;
+  const size_t rows = size_ + 2 * r;
+  // mask is all zero between planes; dilated is fully written before read
+  std::vector<uint8_t> mask(rows * stride, 0);
+  std::unique_ptr<uint8_t[]> dilated(new uint8_t[rows * stride]);
+  renderPlane(xyz, n, 0, 1, 2, stride, &mask[0], dilated.get(), image);  // xy
+  renderPlane(xyz, n, 1, 2, 1, stride, &mask[0], dilated.get(), image);  // yz
+  renderPlane(xyz, n, 0, 2, 0, stride, &mask[0], dilated.get(), image);  // xz
+}
+
+void MultiViewRenderer::scales(const double* xyz, size_t n, double* scale) const
+{
+  const int planes[3][2] = {{0, 1}, {1, 2}, {0, 2}};
+  for (int p = 0; p < 3; p++)
+  {
+    scale[p] = 0;
+    if (n == 0)
+      continue;
+    const int a = planes[p][0], b = planes[p][1];
+    double min_m = xyz[a], max_m = xyz[a];
+    double min_n = xyz[b], max_n = xyz[b];
+    for (size_t i = 1; i < n; i++)
+    {
+      min_m = std::min(min_m, xyz[3 * i + a]);
+      max_m = std::max(max_m, xyz[3 * i + a]);
+      min_n = std::min(min_n, xyz[3 * i + b]);
+      max_n = std::max(max_n, xyz[3 * i + b]);
+    }
+    double max_size = std::max(max_m - min_m, max_n - min_n);
+    if (max_size > 0)
+      scale[p] = (size_ - boundary_ * 2) / max_size;
+  }
+}
+
+void MultiViewRenderer::toTensor(const uint8_t* image, const float* mean, float* chw) const
+{
+  const size_t plane = (size_t)size_ * size_;
+  float* c0 = chw;
+  float* c1 = chw + plane;
+  float* c2 = chw + 2 * plane;
+  for (size_t i = 0; i < plane; i++, image += 3)
+  {
+    c0[i] = image[0] - mean[0];
+    c1[i] = image[1] - mean[1];
+    c2[i] = image[2] - mean[2];
+  }
+}
+
+void MultiViewRenderer::renderPlane(const double* xyz, size_t n, int a, int b, int channel,
+                                    size_t stride, uint8_t* mask, uint8_t* dilated, uint8_t* image) const
+{
+  double min_m = xyz[a], max_m = xyz[a];
+  double min_n = xyz[b], max_n = xyz[b];
+  for (size_t i = 1; i < n; i++)
+  {
+    min_m = std::min(min_m, xyz[3 * i + a]);
+    max_m = std::max(max_m, xyz[3 * i + a]);
+    min_n = std::min(min_n, xyz[3 * i + b]);
+    max_n = std::max(max_n, xyz[3 * i + b]);
+  }
+
+  double m_size = max_m - min_m;
+  double n_size = max_n - min_n;
+  bool shift_n = m_size > n_size;
+  double max_size = shift_n ? m_size : n_size;
+  double min_size = shift_n ? n_size : m_size;
+  double span = size_ - boundary_ * 2;
+  // a single point (or a line seen end-on) lands on the boundary
+  double scale = max_size > 0 ? span / max_size : 0;
+  int shift_size = roundHalfUp((span - min_size * scale) / 2);
+  int shift_m_px = shift_n ? boundary_ : boundary_ + shift_size;
+  int shift_n_px = shift_n ? boundary_ + shift_size : boundary_;
+
+  const int r = point_size_;
+  const int window = 2 * r + 1;
+
+  // A handful of points (a far buoy) is cheaper to stamp directly than to
+  // dilate a whole plane: compare n*window^2 byte stores with roughly
+  // (window + 4) 16-byte passes over the span of the plane.
+  const size_t area = (size_t)(span + 2 * r) * (span + 2 * r);
+  if (n * window * window * 16 < area * (window + 4))
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      int row = roundHalfUp((xyz[3 * i + a] - min_m) * scale) + shift_m_px;
+      int col = roundHalfUp((xyz[3 * i + b] - min_n) * scale) + shift_n_px;
+      int r0 = std::max(0, row - r), r1 = std::min(size_ - 1, row + r);
+      int c0 = std::max(0, col - r), c1 = std::min(size_ - 1, col + r);
+      for (int y = r0; y <= r1; y++)
+      {
+        uint8_t* px = image + ((size_t)y * size_ + c0) * 3 + channel;
+        for (int x = c0; x <= c1; x++, px += 3)
+          *px = 255;
+      }
+    }
+    return;
+  }
+
+  // 1. mark the stamp centres; overlapping points cost one byte store
+  int row_lo = size_, row_hi = -1, col_lo = size_, col_hi = -1;
+  for (size_t i = 0; i < n; i++)
+  {
+    int row = roundHalfUp((xyz[3 * i + a] - min_m) * scale) + shift_m_px;
+    int col = roundHalfUp((xyz[3 * i + b] - min_n) * scale) + shift_n_px;
+    if (row < -r || row >= size_ + r || col < -r || col >= size_ + r)
+      continue;
+    mask[(size_t)(row + r) * stride + (col + r)] = 255;
+    row_lo = std::min(row_lo, row);
+    row_hi = std::max(row_hi, row);
+    col_lo = std::min(col_lo, col);
+    col_hi = std::max(col_hi, col);
+  }
+  if (row_hi < 0)
+    return;
+
+  // 2. separable max filter of width 2r+1, columns first, then rows, only
+  //    over the bounding box of the stamps. Each pass is a handful of whole
+  //    row vector maxes (window doubling: 1, 2, 4, ... then the remainder),
+  //    so the cost depends on the image area, not on the number of points.
+  //    In padded coordinates output pixel (y, x) covers mask rows y..y+2r
+  //    and mask columns x..x+2r.
+  const int y0 = std::max(0, row_lo - r), y1 = std::min(size_ - 1, row_hi + r);
+  const int x0 = std::max(0, col_lo - r) & ~15;
+  const int x1 = std::min(size_ - 1, col_hi + r);
+  const size_t width = ((x1 - x0 + 1) + 15) & ~15;
+  const size_t padded = (width + 2 * r + 15) & ~15;  // stays inside stride
+
+  // vertical: dilated row y = max of mask rows y .. y+2r
+  for (int y = y0; y <= y1; y++)
+  {
+    uint8_t* out = dilated + (size_t)y * stride + x0;
+    const uint8_t* in = mask + (size_t)y * stride + x0;
+    std::memcpy(out, in, padded);
+    for (int k = 1; k < window; k++)
+      maxInto(out, in + (size_t)k * stride, padded);
+  }
+  // horizontal, in place: after the step with shift s the window is 2s wide
+  for (int y = y0; y <= y1; y++)
+  {
+    uint8_t* row = dilated + (size_t)y * stride + x0;
+    int covered = 1;
+    while (covered * 2 <= window)
+    {
+      maxInto(row, row + covered, padded);
+      covered *= 2;
+    }
+    if (covered < window)
+    {
+      // overlapping windows: [x, x+covered) and [x+window-covered, x+window)
+      maxInto(row, row + (window - covered), width);
+    }
+    uint8_t* px = image + ((size_t)y * size_ + x0) * 3 + channel;
+    for (int x = x0; x <= x1; x++, px += 3)
+      *px = row[x - x0];
+  }
+  // hand the mask back clean
+  for (int y = y0; y <= y1 + 2 * r; y++)
+    std::memset(mask + (size_t)y * stride + x0, 0, padded);
+}
+
+} // namespace velodyne_perception
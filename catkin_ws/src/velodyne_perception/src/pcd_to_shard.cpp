@@ -0,0 +1,154 @@
+/**********************************
+pcd_to_shard
+  Packs labelled .pcd files (auto_labeling, manual_label, add_point) into
+  cluster shards (cluster_shard.h):
+    rosrun velodyne_perception pcd_to_shard [-n samples_per_shard] [-l label]
+                                            <output prefix> <cloud.pcd | directory> ...
+  Directories are searched for *.pcd, in name order. The points keep their
+  `label` field; -l sets the sample label (and the point labels of clouds
+  without that field), otherwise the sample takes the most common point
+  label. NaN points are dropped.
+***********************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pcl/conversions.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+
+#include <velodyne_perception/cluster_shard.h>
+
+using velodyne_perception::ShardWriter;
+
+namespace
+{
+
+void usage()
+{
+  std::cerr << "usage: pcd_to_shard [-n samples_per_shard] [-l label] <output prefix> <cloud.pcd | directory> ..."
+            << std::endl;
+}
+
+void listClouds(const std::string& path, std::vector<std::string>& clouds)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+  {
+    clouds.push_back(path);
+    return;
+  }
+  std::vector<std::string> names;
+  if (DIR* dir = opendir(path.c_str()))
+  {
+    while (struct dirent* entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".pcd") == 0)
+        names.push_back(name);
+    }
+    closedir(dir);
+  }
+  std::sort(names.begin(), names.end());
+  for (size_t i = 0; i < names.size(); i++)
+    clouds.push_back(path + "/" + names[i]);
+}
+
+bool readCloud(const std::string& path, int label, std::vector<float>& xyz, std::vector<uint32_t>& labels)
+{
+  pcl::PCLPointCloud2 blob;
+  if (pcl::io::loadPCDFile(path, blob) != 0)
+    return false;
+  bool has_label = false;
+  for (size_t f = 0; f < blob.fields.size(); f++)
+    has_label |= blob.fields[f].name == "label";
+  if (!has_label && label < 0)
+  {
+    std::cerr << path << ": no label field, pass -l" << std::endl;
+    return false;
+  }
+  pcl::PointCloud<pcl::PointXYZL> cloud;
+  pcl::fromPCLPointCloud2(blob, cloud);
+  xyz.clear();
+  labels.clear();
+  for (size_t i = 0; i < cloud.points.size(); i++)
+  {
+    const pcl::PointXYZL& p = cloud.points[i];
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+      continue;
+    xyz.push_back(p.x);
+    xyz.push_back(p.y);
+    xyz.push_back(p.z);
+    labels.push_back(has_label ? p.label : label);
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  size_t samples_per_shard = 4096;
+  int label = -1;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:l:h")) != -1)
+  {
+    if (opt == 'n')
+      samples_per_shard = std::strtoul(optarg, NULL, 10);
+    else if (opt == 'l')
+      label = std::atoi(optarg);
+    else
+    {
+      usage();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind < 2)
+  {
+    usage();
+    return 1;
+  }
+
+  std::vector<std::string> clouds;
+  for (int a = optind + 1; a < argc; a++)
+    listClouds(argv[a], clouds);
+
+  ShardWriter writer;
+  std::string error;
+  if (!writer.open(argv[optind], samples_per_shard, &error))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  std::vector<float> xyz;
+  std::vector<uint32_t> labels;
+  size_t skipped = 0;
+  for (size_t i = 0; i < clouds.size(); i++)
+  {
+    if (!readCloud(clouds[i], label, xyz, labels) || labels.empty())
+    {
+      std::cerr << "Skip " << clouds[i] << std::endl;
+      skipped++;
+      continue;
+    }
+    if (!writer.append(&xyz[0], &labels[0], labels.size(), label, &error))
+    {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  }
+  if (!writer.close(&error))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  for (size_t s = 0; s < writer.shards().size(); s++)
+    std::cout << "Save shard: " << writer.shards()[s] << std::endl;
+  std::cout << writer.samples() << " samples, " << skipped << " skipped" << std::endl;
+  return 0;
+}
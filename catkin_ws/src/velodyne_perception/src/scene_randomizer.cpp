@@ -0,0 +1,128 @@
+/**********************************
+Scene Randomizer
+  See scene_randomizer.h
+***********************************/
+#include <velodyne_perception/scene_randomizer.h>
+
+#include <cmath>
+#include <gazebo_msgs/SetModelState.h>
+
+namespace velodyne_perception
+{
+
+SceneRandomizer::SceneRandomizer(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+  : node_name_(ros::this_node::getName()), state_(kIdle), timeouts_(0)
+{
+  double settle_time, settle_timeout;
+  private_nh.param("settle_speed", settle_speed_, 0.1);
+  private_nh.param("settle_tolerance", settle_tolerance_, 1.0);
+  private_nh.param("settle_time", settle_time, 0.5);
+  private_nh.param("settle_timeout", settle_timeout, 5.0);
+  settle_time_ = ros::Duration(settle_time);
+  settle_timeout_ = ros::Duration(settle_timeout);
+  ROS_INFO("[%s] Param [settle_speed] = %f, [settle_tolerance] = %f", node_name_.c_str(), settle_speed_,
+           settle_tolerance_);
+  ROS_INFO("[%s] Param [settle_time] = %f, [settle_timeout] = %f", node_name_.c_str(), settle_time,
+           settle_timeout);
+  // one connection for every SetModelState of the run
+  client_ = nh.serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state", true);
+  sub_states_ = nh.subscribe("/gazebo/model_states", 1, &SceneRandomizer::statesCallback, this);
+}
+
+SceneRandomizer::~SceneRandomizer()
+{
+  if (mover_.joinable())
+    mover_.join();
+}
+
+void SceneRandomizer::randomize(const std::vector<SceneModel>& models)
+{
+  // the previous scene has long been moved once it settled
+  if (mover_.joinable())
+    mover_.join();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_ = kMoving;
+    targets_ = models;
+    still_since_ = ros::Time();
+  }
+  mover_ = std::thread(&SceneRandomizer::moveModels, this, models);
+}
+
+void SceneRandomizer::moveModels(std::vector<SceneModel> models)
+{
+  for (size_t i = 0; i < models.size(); i++)
+  {
+    gazebo_msgs::SetModelState set;
+    set.request.model_state.model_name = models[i].name;
+    set.request.model_state.pose.position.x = models[i].x;
+    set.request.model_state.pose.position.y = models[i].y;
+    set.request.model_state.pose.position.z = models[i].z;
+    set.request.model_state.pose.orientation.w = 1;
+    if (!client_.call(set) || !set.response.success)
+      ROS_WARN("[%s] cannot move %s", node_name_.c_str(), models[i].name.c_str());
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  moved_at_ = ros::Time::now();
+  state_ = kSettling;
+}
+
+void SceneRandomizer::statesCallback(const gazebo_msgs::ModelStatesConstPtr& msg)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ != kSettling)
+    return;
+  bool still = true;
+  for (size_t t = 0; t < targets_.size() && still; t++)
+    for (size_t m = 0; m < msg->name.size(); m++)
+      if (msg->name[m] == targets_[t].name)
+      {
+        const geometry_msgs::Point& p = msg->pose[m].position;
+        const geometry_msgs::Vector3& v = msg->twist[m].linear;
+        still = std::hypot(p.x - targets_[t].x, p.y - targets_[t].y) < settle_tolerance_ &&
+                std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z) < settle_speed_;
+        break;
+      }
+  if (!still)
+    still_since_ = ros::Time();
+  else if (still_since_.isZero())
+    still_since_ = ros::Time::now();
+}
+
+bool SceneRandomizer::settled(const ros::Time& stamp)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ == kSettling)
+  {
+    const ros::Time now = ros::Time::now();
+    if (!still_since_.isZero() && now - still_since_ >= settle_time_)
+    {
+      state_ = kSettled;
+      settled_at_ = still_since_;
+    }
+    else if (now - moved_at_ >= settle_timeout_)
+    {
+      ROS_WARN("[%s] scene did not settle within %.1f s, labeling it anyway", node_name_.c_str(),
+               settle_timeout_.toSec());
+      state_ = kSettled;
+      settled_at_ = now;
+      timeouts_++;
+    }
+  }
+  // a scan taken while the models still moved is not labelled
+  return state_ == kSettled && stamp >= settled_at_;
+}
+
+SceneRandomizer::State SceneRandomizer::state() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return state_;
+}
+
+unsigned int SceneRandomizer::timeouts() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return timeouts_;
+}
+
+} // namespace velodyne_perception
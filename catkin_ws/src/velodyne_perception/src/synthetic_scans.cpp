@@ -0,0 +1,269 @@
+/**********************************
+synthetic_scans
+  Labelled training scans without Gazebo (lidar_sim.h): every scan places
+  the objects like auto_label() and ray-casts the beam model against them
+  on all cores.
+    rosrun velodyne_perception synthetic_scans [options] <output prefix>
+  Every placed object with returns becomes one sample, its returns
+  labelled with its class, like the per-object clouds the classifiers
+  train on. Output is cluster shards (prefix-NNNNN.shard) or, with --pcd,
+  binary compressed prefix_N.pcd files in the PointCloudLabel layout of
+  the labelers.
+Options:
+  -n scans              (default 1000)
+  -s seed               (default 1)
+  -j threads            (default -1, one per core)
+  --objects list        (comma separated totem, light_buoy, dock, buoy;
+                         default dock,dock,light_buoy,buoy as auto_labeling)
+  --range, --collision, --wamv-range
+                        placement rules (default 40, 8, 5; add_point uses
+                        35, 5, 8)
+  --rings, --min-elevation, --max-elevation, --azimuth-resolution,
+  --max-range, --noise, --dropout, --height
+                        beam model (default a VLP-16 at 1.5 m)
+  --pcd                 write .pcd files instead of shards
+***********************************/
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+#include <velodyne_perception/cluster_shard.h>
+#include <velodyne_perception/dataset_writer.h>
+#include <velodyne_perception/lidar_sim.h>
+#include <velodyne_perception/point_cloud_label.h>
+#include <velodyne_perception/task_pool.h>
+
+using namespace velodyne_perception;
+
+namespace
+{
+
+const size_t kChunk = 256;
+
+void usage()
+{
+  std::cerr << "usage: synthetic_scans [-n scans] [-s seed] [-j threads] [--objects list] [--range m]"
+            << " [--collision m] [--wamv-range m] [--rings n] [--min-elevation deg] [--max-elevation deg]"
+            << " [--azimuth-resolution deg] [--max-range m] [--noise m] [--dropout p] [--height m] [--pcd]"
+            << " <output prefix>" << std::endl;
+}
+
+bool parseObjects(const std::string& list, std::vector<SimObjectKind>& kinds)
+{
+  kinds.clear();
+  std::istringstream ss(list);
+  std::string name;
+  while (std::getline(ss, name, ','))
+  {
+    int kind = -1;
+    for (int k = 0; k < kSimObjectKinds; k++)
+      if (name == kSimObjectNames[k])
+        kind = k;
+    if (kind < 0)
+    {
+      std::cerr << "unknown object " << name << std::endl;
+      return false;
+    }
+    kinds.push_back((SimObjectKind)kind);
+  }
+  return !kinds.empty();
+}
+
+struct Scan
+{
+  std::vector<float> xyz;
+  std::vector<uint32_t> labels;
+  std::vector<uint32_t> hits;       // object of each return
+  std::vector<uint32_t> objects;    // label of each placed object
+  bool placed;
+};
+
+// the returns of one object, in scan order
+void objectSample(const Scan& scan, uint32_t object, std::vector<float>& xyz, std::vector<uint32_t>& labels)
+{
+  xyz.clear();
+  labels.clear();
+  for (size_t p = 0; p < scan.hits.size(); p++)
+  {
+    if (scan.hits[p] != object)
+      continue;
+    xyz.insert(xyz.end(), &scan.xyz[3 * p], &scan.xyz[3 * p] + 3);
+    labels.push_back(scan.labels[p]);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  size_t scans = 1000;
+  uint32_t seed = 1;
+  int threads = -1;
+  bool pcd = false;
+  std::vector<SimObjectKind> kinds;
+  parseObjects("dock,dock,light_buoy,buoy", kinds);
+  PlacementRules rules;
+  BeamModel beams;
+
+  enum
+  {
+    kObjects = 256, kRange, kCollision, kWamvRange, kRings, kMinElevation, kMaxElevation, kAzimuth,
+    kMaxRange, kNoise, kDropout, kHeight, kPcd
+  };
+  const struct option options[] = {
+    {"objects", required_argument, NULL, kObjects},
+    {"range", required_argument, NULL, kRange},
+    {"collision", required_argument, NULL, kCollision},
+    {"wamv-range", required_argument, NULL, kWamvRange},
+    {"rings", required_argument, NULL, kRings},
+    {"min-elevation", required_argument, NULL, kMinElevation},
+    {"max-elevation", required_argument, NULL, kMaxElevation},
+    {"azimuth-resolution", required_argument, NULL, kAzimuth},
+    {"max-range", required_argument, NULL, kMaxRange},
+    {"noise", required_argument, NULL, kNoise},
+    {"dropout", required_argument, NULL, kDropout},
+    {"height", required_argument, NULL, kHeight},
+    {"pcd", no_argument, NULL, kPcd},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:s:j:h", options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': scans = std::strtoul(optarg, NULL, 10); break;
+      case 's': seed = std::strtoul(optarg, NULL, 10); break;
+      case 'j': threads = std::atoi(optarg); break;
+      case kObjects:
+        if (!parseObjects(optarg, kinds))
+          return 1;
+        break;
+      case kRange: rules.range = std::atoi(optarg); break;
+      case kCollision: rules.collision = std::atof(optarg); break;
+      case kWamvRange: rules.wamv_range = std::atof(optarg); break;
+      case kRings: beams.rings = std::atoi(optarg); break;
+      case kMinElevation: beams.min_elevation = std::atof(optarg); break;
+      case kMaxElevation: beams.max_elevation = std::atof(optarg); break;
+      case kAzimuth: beams.azimuth_resolution = std::atof(optarg); break;
+      case kMaxRange: beams.max_range = std::atof(optarg); break;
+      case kNoise: beams.range_noise = std::atof(optarg); break;
+      case kDropout: beams.dropout = std::atof(optarg); break;
+      case kHeight: beams.height = std::atof(optarg); break;
+      case kPcd: pcd = true; break;
+      default:
+        usage();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind != 1 || beams.azimuth_resolution <= 0)
+  {
+    usage();
+    return 1;
+  }
+  const std::string prefix = argv[optind];
+
+  const LidarSimulator sim(beams);
+  TaskPool pool(threads);
+  ShardWriter shards;
+  DatasetWriter<PointCloudLabel> pcds(2, 64, true);
+  std::string error;
+  if (!pcd && !shards.open(prefix, 4096, &error))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  // ======= chunks of scans in parallel, written in order =======
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<Scan> chunk(kChunk);
+  std::vector<float> xyz;
+  std::vector<uint32_t> labels;
+  size_t written = 0, empty = 0, unplaced = 0, points = 0, samples = 0;
+  for (size_t first = 0; first < scans; first += kChunk)
+  {
+    const size_t n = std::min(kChunk, scans - first);
+    pool.parallelFor(n, [&](size_t i)
+    {
+      // a scan only depends on the seed and its index
+      FastRand rng(seed * 2654435761u ^ (uint32_t)(first + i + 1) * 40503u);
+      rng.next();
+      std::vector<SimObject> objects;
+      Scan& scan = chunk[i];
+      scan.placed = placeSimObjects(kinds, rules, rng, objects);
+      scan.objects.clear();
+      if (!scan.placed)
+        return;
+      for (size_t o = 0; o < objects.size(); o++)
+        scan.objects.push_back(objects[o].label);
+      sim.scan(objects, rng, scan.xyz, scan.labels, &scan.hits);
+    });
+    for (size_t i = 0; i < n; i++)
+    {
+      const Scan& scan = chunk[i];
+      if (!scan.placed)
+      {
+        unplaced++;
+        continue;
+      }
+      if (scan.labels.empty())
+      {
+        empty++;
+        continue;
+      }
+      points += scan.labels.size();
+      for (uint32_t o = 0; o < scan.objects.size(); o++)
+      {
+        objectSample(scan, o, xyz, labels);
+        if (labels.empty())
+          continue;
+        if (!pcd)
+        {
+          if (!shards.append(&xyz[0], &labels[0], labels.size(), scan.objects[o], &error))
+          {
+            std::cerr << error << std::endl;
+            return 1;
+          }
+        }
+        else
+        {
+          pcl::PointCloud<PointCloudLabel>::Ptr cloud(new pcl::PointCloud<PointCloudLabel>);
+          cloud->points.resize(labels.size());
+          cloud->width = cloud->points.size();
+          cloud->height = 1;
+          for (size_t p = 0; p < labels.size(); p++)
+          {
+            PointCloudLabel& q = cloud->points[p];
+            q.x = xyz[3 * p];
+            q.y = xyz[3 * p + 1];
+            q.z = xyz[3 * p + 2];
+            setLabel(q, labels[p]);
+          }
+          std::ostringstream oss;
+          oss << prefix << "_" << samples << ".pcd";
+          pcds.write(cloud, oss.str());
+        }
+        samples++;
+      }
+      written++;
+    }
+  }
+  pcds.flush();
+  if (!shards.close(&error))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t s = 0; s < shards.shards().size(); s++)
+    std::cout << "Save shard: " << shards.shards()[s] << std::endl;
+  std::cout << written << " scans, " << samples << " objects, " << points << " points, " << empty << " without returns, " << unplaced
+            << " not placeable, " << (sec > 0 ? scans / sec : 0) << " scans/s" << std::endl;
+  if (pcd && pcds.stats().failed > 0)
+    return 1;
+  return unplaced == scans ? 1 : 0;
+}
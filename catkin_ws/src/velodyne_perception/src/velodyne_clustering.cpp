@@ -0,0 +1,515 @@
+/**********************************
+Velodyne Clustering
+  Shared pipeline of the cluster nodes, see velodyne_clustering.h
+***********************************/
+#include <velodyne_perception/velodyne_clustering.h>
+
+#include <boost/bind.hpp>
+#include <Eigen/Geometry>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/common/centroid.h>
+#include <pcl/common/common.h>
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/PoseArray.h>
+#include <velodyne_perception/cluster_descriptor.h>
+#include <velodyne_perception/cluster_resample.h>
+
+namespace velodyne_perception
+{
+
+ClusteringConfig::ClusteringConfig()
+  : name("cluster"),
+    input_topic("/velodyne_points"),
+    use_odom(false),
+    queue_size(1),
+    remove_wamv(true),
+    outlier_radius(0),
+    outlier_min_neighbors(2),
+    cluster_tolerance(2.2),
+    min_cluster_size(3),
+    max_cluster_size(100000),
+    embed_points(false),
+    set_position_local(false),
+    point_budget(0),
+    render_views(false),
+    local_frame(false),
+    descriptor(false),
+    visual(false),
+    marker_scale_from_extent(false),
+    debug_decimation(1),
+    threads(-1)
+{
+  wamv.x_min = -1.5;
+  wamv.x_max = 1.5;
+  wamv.y_min = -3.5;
+  wamv.y_max = 3.2;
+  // the deployed 3-channel nets are fed raw 0/255 views
+  tensor_mean.assign(3, 0.0f);
+}
+
+void ClusteringConfig::load(const ros::NodeHandle& private_nh)
+{
+  private_nh.param("remove_wamv", remove_wamv, remove_wamv);
+  private_nh.param("wamv_x_min", wamv.x_min, wamv.x_min);
+  private_nh.param("wamv_x_max", wamv.x_max, wamv.x_max);
+  private_nh.param("wamv_y_min", wamv.y_min, wamv.y_min);
+  private_nh.param("wamv_y_max", wamv.y_max, wamv.y_max);
+  private_nh.param("outlier_radius", outlier_radius, outlier_radius);
+  private_nh.param("outlier_min_neighbors", outlier_min_neighbors, outlier_min_neighbors);
+  private_nh.param("cluster_tolerance", cluster_tolerance, cluster_tolerance);
+  private_nh.param("min_cluster_size", min_cluster_size, min_cluster_size);
+  private_nh.param("max_cluster_size", max_cluster_size, max_cluster_size);
+  private_nh.param("embed_points", embed_points, embed_points);
+  private_nh.param("point_budget", point_budget, point_budget);
+  private_nh.param("render_views", render_views, render_views);
+  private_nh.param("local_frame", local_frame, local_frame);
+  private_nh.param("descriptor", descriptor, descriptor);
+  private_nh.param("tensor_mean", tensor_mean, tensor_mean);
+  if (tensor_mean.size() != 3){
+    ROS_WARN("[%s] Param [tensor_mean] needs 3 values, using 0", name.c_str());
+    tensor_mean.assign(3, 0.0f);
+  }
+  private_nh.param("visual", visual, visual);
+  private_nh.param("marker_scale_from_extent", marker_scale_from_extent, marker_scale_from_extent);
+  private_nh.param("debug_decimation", debug_decimation, debug_decimation);
+  private_nh.param("threads", threads, threads);
+  ROS_INFO("[%s] Param [visual] = %d", name.c_str(), visual);
+  ROS_INFO("[%s] Param [point_budget] = %d", name.c_str(), point_budget);
+  ROS_INFO("[%s] Param [threads] = %d", name.c_str(), threads);
+}
+
+ClusteringPipeline::ClusteringPipeline(ros::NodeHandle& nh, const ClusteringConfig& config)
+  : config_(config),
+    task_pool_(new TaskPool(config.threads)),
+    cloud_in_(new ClusterCloud),
+    cloud_filtered_(new ClusterCloud),
+    result_(new PointCloudXYZRGB)
+{
+  debug_gate_.decimation = config_.debug_decimation;
+
+  pub_obstacle_ = nh.advertise< robotx_msgs::ObstaclePoseList > ("/obstacle_list", config_.queue_size);
+  pub_object_ = nh.advertise< robotx_msgs::ObjectPoseList > ("/obj_list", config_.queue_size);
+  pub_marker_ = nh.advertise<visualization_msgs::MarkerArray>("/obstacle_marker", 1);
+  pub_marker_line_ = nh.advertise<visualization_msgs::MarkerArray>("/obstacle_marker_line", 1);
+  pub_result_ = nh.advertise<sensor_msgs::PointCloud2> ("/cluster_result", 1);
+  pub_points_ = nh.advertise<robotx_msgs::PCL_points> ("/pcl_points", 1);
+  pub_tensor_ = nh.advertise<robotx_msgs::ClusterTensor> ("/cluster_tensor", 1);
+
+  if (config_.use_odom)
+  {
+    pcl_sub_.reset(new message_filters::Subscriber<sensor_msgs::PointCloud2>(nh, config_.input_topic, 10));
+    odom_sub_.reset(new message_filters::Subscriber<nav_msgs::Odometry>(nh, "/odometry/filtered", 10));
+    // ApproximateTime takes a queue size as its constructor argument, hence SyncPolicy(10)
+    sync_.reset(new message_filters::Synchronizer<SyncPolicy>(SyncPolicy(10), *pcl_sub_, *odom_sub_));
+    sync_->registerCallback(boost::bind(&ClusteringPipeline::syncCallback, this, _1, _2));
+  }
+  else
+    sub_ = nh.subscribe(config_.input_topic, 1, &ClusteringPipeline::cloudCallback, this);
+  ROS_INFO("[%s] Start clustering %s", config_.name.c_str(), sub_ ? sub_.getTopic().c_str() : pcl_sub_->getSubscriber().getTopic().c_str());
+}
+
+void ClusteringPipeline::cloudCallback(const sensor_msgs::PointCloud2ConstPtr& input)
+{
+  process(*input, NULL);
+}
+
+void ClusteringPipeline::syncCallback(const sensor_msgs::PointCloud2ConstPtr& input, const nav_msgs::OdometryConstPtr& odom)
+{
+  process(*input, odom.get());
+}
+
+void ClusteringPipeline::process(const sensor_msgs::PointCloud2& input, const nav_msgs::Odometry* odom)
+{
+  pcl::fromROSMsg (input, *cloud_in_);
+
+  ClusterFrame frame;
+  frame.header = input.header;
+  // Debug and secondary outputs are only built when someone listens
+  debug_gate_.nextFrame();
+  frame.build_result = debug_gate_.wants(pub_result_);
+  frame.build_points = debug_gate_.wants(pub_points_);
+  // not a debug output: the batched classifier needs every scan
+  frame.build_tensor = pub_tensor_.getNumSubscribers() > 0;
+  frame.result = result_;
+  frame.result->clear();
+
+  filter(*cloud_in_, cloud_filtered_);
+  cluster(cloud_filtered_, frame);
+  describe(cloud_filtered_, frame);
+  if (odom)
+  {
+    frame.pcl_points.varianceX = odom->pose.covariance[0];
+    frame.pcl_points.varianceY = odom->pose.covariance[7];
+  }
+  publish(frame);
+}
+
+//========== Filter ==========
+void ClusteringPipeline::filter(const ClusterCloud& in, ClusterCloud::Ptr& out) const
+{
+  if (config_.remove_wamv)
+    removeRegion(in, *out, config_.wamv);
+  else
+    *out = in;
+  if (config_.outlier_radius > 0)
+    removeRadiusOutlier<ClusterPoint>(out, config_.outlier_radius, config_.outlier_min_neighbors);
+}
+
+//========== Point Cloud Clustering ==========
+void ClusteringPipeline::cluster(const ClusterCloud::Ptr& cloud, ClusterFrame& frame) const
+{
+  extractClusters<ClusterPoint>(cloud, config_.cluster_tolerance, config_.min_cluster_size,
+                                config_.max_cluster_size, frame.cluster_indices);
+}
+
+//========== Describe ==========
+void ClusteringPipeline::describe(const ClusterCloud::Ptr& cloud, ClusterFrame& frame)
+{
+  // Every cluster owns slot k of each list and a fixed span of result,
+  // so the clusters can be assembled on the task pool without locking
+  const std::vector<pcl::PointIndices>& cluster_indices = frame.cluster_indices;
+  size_t n = cluster_indices.size();
+  frame.ob_list.list.resize(n);
+  frame.obj_list.list.resize(n);
+  if (frame.build_points){
+    frame.pcl_points.list.resize(n);
+    frame.pcl_points.centroids.resize(n);
+  }
+  if (frame.build_tensor){
+    // one image per cluster, cluster k at k * imageBytes()
+    frame.tensor.n = n;
+    frame.tensor.channels = 3;
+    frame.tensor.height = renderer_.size();
+    frame.tensor.width = renderer_.size();
+    frame.tensor.mean = config_.tensor_mean;
+    frame.tensor.data.resize(n * renderer_.imageBytes());
+  }
+  std::vector<size_t> result_offset(n);
+  if (frame.build_result){
+    size_t total = 0;
+    for (size_t k = 0; k < n; k++){
+      result_offset[k] = total;
+      total += cluster_indices[k].indices.size();
+    }
+    frame.result->points.resize(total);
+    frame.result->width = total;
+    frame.result->height = 1;
+  }
+  const ClusterCloud& points = *cloud;
+  task_pool_->parallelFor(n, [&](size_t k)
+  {
+    describeCluster(points, k, result_offset[k], frame);
+  });
+}
+
+void ClusteringPipeline::describeCluster(const ClusterCloud& cloud, size_t k, size_t result_offset, ClusterFrame& frame) const
+{
+  const pcl::PointIndices& cluster = frame.cluster_indices[k];
+  // Declare variable
+  float x_min_x = 10e5;
+  float x_min_y = 10e5;
+  float y_min_x = 10e5;
+  float y_min_y = 10e5;
+  float x_max_x = -10e5;
+  float x_max_y = -10e5;
+  float y_max_x = -10e5;
+  float y_max_y = -10e5;
+  robotx_msgs::ObstaclePose& ob_pose = frame.ob_list.list[k];
+  robotx_msgs::ObjectPose& obj_pose = frame.obj_list.list[k];
+  Eigen::Vector4f centroid;
+  ClusterCloud::Ptr cloud_cluster (new ClusterCloud);
+
+  cloud_cluster->points.reserve(cluster.indices.size());
+  for (std::vector<int>::const_iterator pit = cluster.indices.begin (); pit != cluster.indices.end (); ++pit)
+  {
+    const ClusterPoint& p = cloud.points[*pit];
+    cloud_cluster->points.push_back (p);
+    if (p.x < x_min_x)
+    {
+      x_min_x = p.x;
+      x_min_y = p.y;
+    }
+    if (p.x > x_max_x)
+    {
+      x_max_x = p.x;
+      x_max_y = p.y;
+    }
+    if (p.y < y_min_y)
+    {
+      y_min_x = p.x;
+      y_min_y = p.y;
+    }
+    if (p.y > y_max_y)
+    {
+      y_max_x = p.x;
+      y_max_y = p.y;
+    }
+  }
+  cloud_cluster->width = cloud_cluster->points.size();
+  cloud_cluster->height = 1;
+  if (frame.build_result)
+    copyColored(cloud, cluster.indices, 255, 255, 0, *frame.result, result_offset);
+
+  // ======= fixed point budget for the published cloud =======
+  ClusterCloud::Ptr cloud_pub = cloud_cluster;
+  if (config_.point_budget > 0){
+    FastRand rng(k + 1);
+    cloud_pub.reset(new ClusterCloud);
+    resampleToBudget(*cloud_cluster, config_.point_budget, 0.03, rng, *cloud_pub);
+  }
+
+  // ======= convert cluster pointcloud to points =======
+  geometry_msgs::PoseArray pose_arr;
+  if (frame.build_points || config_.embed_points){
+    pose_arr.poses.resize(cloud_pub->points.size());
+    for (size_t i = 0; i < cloud_pub->points.size(); i++){
+        pose_arr.poses[i].position.x = cloud_pub->points[i].x;
+        pose_arr.poses[i].position.y = cloud_pub->points[i].y;
+        pose_arr.poses[i].position.z = cloud_pub->points[i].z;
+    }
+  }
+
+  // ======= add cluster centroid =======
+  pcl::compute3DCentroid(*cloud_cluster, centroid);
+  geometry_msgs::Point c;
+  c.x = centroid[0];
+  c.y = centroid[1];
+  c.z = centroid[2];
+  if (frame.build_points){
+    frame.pcl_points.list[k] = pose_arr;
+    frame.pcl_points.centroids[k] = c;
+  }
+
+  sensor_msgs::PointCloud2 ros_cluster;
+  pcl::toROSMsg(*cloud_pub, ros_cluster);
+  ros_cluster.header = frame.header;
+
+  obj_pose.header = frame.header;
+  obj_pose.position = c;
+  obj_pose.point_count = cloud_cluster->points.size();
+  if (config_.set_position_local)
+    obj_pose.position_local = c;
+  obj_pose.cloud = ros_cluster;
+  if (config_.embed_points)
+    obj_pose.pcl_points = pose_arr;
+  // ======= sensor-bearing-aligned local frame =======
+  // x points from the sensor to the centroid, as in the classifiers
+  double yaw = std::atan2(c.y, c.x);
+  if (config_.local_frame && !cloud_pub->points.empty()){
+    Eigen::Matrix3f rot(Eigen::AngleAxisf(-yaw, Eigen::Vector3f::UnitZ()));
+    Eigen::Matrix3Xf local = rot * cloud_pub->getMatrixXfMap(3, sizeof(ClusterPoint) / sizeof(float), 0);
+    Eigen::Vector3f lo = local.rowwise().minCoeff();
+    Eigen::Vector3f hi = local.rowwise().maxCoeff();
+    obj_pose.local_yaw = yaw;
+    obj_pose.local_min.x = lo[0];
+    obj_pose.local_min.y = lo[1];
+    obj_pose.local_min.z = lo[2];
+    obj_pose.local_max.x = hi[0];
+    obj_pose.local_max.y = hi[1];
+    obj_pose.local_max.z = hi[2];
+    obj_pose.pcl_points_local.poses.resize(local.cols());
+    for (int i = 0; i < local.cols(); i++){
+      obj_pose.pcl_points_local.poses[i].position.x = local(0, i);
+      obj_pose.pcl_points_local.poses[i].position.y = local(1, i);
+      obj_pose.pcl_points_local.poses[i].position.z = local(2, i);
+    }
+  }
+
+  // ======= geometry for the cascade, from every raw point =======
+  if (config_.descriptor)
+    describeGeometry(*cloud_cluster, obj_pose.descriptor);
+
+  // ======= multi-view image for the classifiers =======
+  if (config_.render_views){
+    renderer_.render(*cloud_pub, yaw, obj_pose.views);
+    obj_pose.views.header = frame.header;
+  }
+  if (frame.build_tensor){
+    std::vector<uint8_t> image;
+    const uint8_t* views = config_.render_views ? &obj_pose.views.data[0] : NULL;
+    if (!views){
+      image.resize(renderer_.imageBytes());
+      renderer_.render(*cloud_pub, yaw, &image[0]);
+      views = &image[0];
+    }
+    renderer_.toTensor(views, &frame.tensor.mean[0], &frame.tensor.data[k * renderer_.imageBytes()]);
+  }
+
+  ob_pose.header = frame.header;
+  ob_pose.cloud = ros_cluster;
+  ob_pose.x = centroid[0];
+  ob_pose.y = centroid[1];
+  ob_pose.z = centroid[2];
+  Eigen::Vector4f min;
+  Eigen::Vector4f max;
+  pcl::getMinMax3D (*cloud_cluster, min, max);
+  ob_pose.min_x = min[0];
+  ob_pose.max_x = max[0];
+  ob_pose.min_y = min[1];
+  ob_pose.max_y = max[1];
+  ob_pose.min_z = min[2];
+  ob_pose.max_z = max[2];
+  ob_pose.x_min_x = x_min_x;
+  ob_pose.x_min_y = x_min_y;
+  ob_pose.x_max_x = x_max_x;
+  ob_pose.x_max_y = x_max_y;
+  ob_pose.y_min_x = y_min_x;
+  ob_pose.y_min_y = y_min_y;
+  ob_pose.y_max_x = y_max_x;
+  ob_pose.y_max_y = y_max_y;
+}
+
+//========== Publish ==========
+void ClusteringPipeline::publish(ClusterFrame& frame)
+{
+  //set obstacle list
+  frame.obj_list.header = frame.header;
+  frame.obj_list.size = frame.obj_list.list.size();
+  pub_object_.publish(frame.obj_list);
+
+  frame.ob_list.header = frame.header;
+  frame.ob_list.size = frame.ob_list.list.size();
+  pub_obstacle_.publish(frame.ob_list);
+
+  frame.pcl_points.header = frame.header;
+  if (frame.build_points)
+    pub_points_.publish(frame.pcl_points);
+  if (frame.build_tensor){
+    frame.tensor.header = frame.header;
+    pub_tensor_.publish(frame.tensor);
+  }
+  if (config_.visual && debug_gate_.wants(pub_marker_))
+    drawRviz(frame.ob_list);
+  if (config_.visual && debug_gate_.wants(pub_marker_line_))
+    drawRviz_line(frame.ob_list);
+  if (frame.build_result){
+    sensor_msgs::PointCloud2 ros_out;
+    pcl::toROSMsg(*frame.result, ros_out);
+    ros_out.header = frame.header;
+    pub_result_.publish(ros_out);
+  }
+}
+
+void ClusteringPipeline::drawRviz_line(const robotx_msgs::ObstaclePoseList& ob_list){
+  marker_array_line_.markers.resize(ob_list.size);
+  for (size_t i = 0; i < ob_list.size; i++)
+  {
+    visualization_msgs::Marker& marker = marker_array_line_.markers[i];
+    marker.header = ob_list.header;
+    marker.id = i;
+    marker.type = visualization_msgs::Marker::LINE_STRIP;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.points.clear();
+    marker.lifetime = ros::Duration(0.5);
+    marker.scale.x = (0.1);
+    geometry_msgs::Point x_min;
+    x_min.x = ob_list.list[i].x_min_x;
+    x_min.y = ob_list.list[i].x_min_y;
+    geometry_msgs::Point x_max;
+    x_max.x = ob_list.list[i].x_max_x;
+    x_max.y = ob_list.list[i].x_max_y;
+    geometry_msgs::Point y_min;
+    y_min.x = ob_list.list[i].y_min_x;
+    y_min.y = ob_list.list[i].y_min_y;
+    geometry_msgs::Point y_max;
+    y_max.x = ob_list.list[i].y_max_x;
+    y_max.y = ob_list.list[i].y_max_y;
+    marker.points.push_back(x_min);
+    marker.points.push_back(y_min);
+    marker.points.push_back(x_max);
+    marker.points.push_back(y_max);
+    marker.points.push_back(x_min);
+    if (ob_list.list[i].r == 1)
+    {
+      marker.text = "Buoy";
+      marker.color.r = 0;
+      marker.color.g = 0;
+      marker.color.b = 1;
+    }
+    else if (ob_list.list[i].r == 2)
+    {
+      marker.text = "Totem";
+      marker.color.r = 0;
+      marker.color.g = 1;
+      marker.color.b = 0;
+    }
+    else if (ob_list.list[i].r == 3)
+    {
+      marker.text = "Dock";
+      marker.color.r = 1;
+      marker.color.g = 1;
+      marker.color.b = 1;
+    }
+    else
+    {
+      marker.color.r = 1;
+      marker.color.g = 0;
+      marker.color.b = 0;
+    }
+    marker.color.a = 1;
+  }
+  pub_marker_line_.publish(marker_array_line_);
+}
+
+void ClusteringPipeline::drawRviz(const robotx_msgs::ObstaclePoseList& ob_list){
+  marker_array_.markers.resize(ob_list.size);
+  for (size_t i = 0; i < ob_list.size; i++)
+  {
+    visualization_msgs::Marker& marker = marker_array_.markers[i];
+    marker.header = ob_list.header;
+    marker.id = i;
+    marker.type = visualization_msgs::Marker::CUBE;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.lifetime = ros::Duration(0.5);
+    marker.pose.position.x = ob_list.list[i].x;
+    marker.pose.position.y = ob_list.list[i].y;
+    marker.pose.position.z = ob_list.list[i].z;
+    marker.pose.orientation.x = 0.0;
+    marker.pose.orientation.y = 0.0;
+    marker.pose.orientation.z = 0.0;
+    marker.pose.orientation.w = 1.0;
+    if (config_.marker_scale_from_extent)
+    {
+      marker.scale.x = std::max(0.1, ob_list.list[i].max_x-ob_list.list[i].min_x);
+      marker.scale.y = std::max(0.1, ob_list.list[i].max_y-ob_list.list[i].min_y);
+      marker.scale.z = std::max(0.1, ob_list.list[i].max_z-ob_list.list[i].min_z);
+    }
+    else
+    {
+      marker.scale.x = 1;
+      marker.scale.y = 1;
+      marker.scale.z = 1;
+    }
+    if (ob_list.list[i].r == 1)
+    {
+      marker.text = "Buoy";
+      marker.color.r = 0;
+      marker.color.g = 0;
+      marker.color.b = 1;
+    }
+    else if (ob_list.list[i].r == 2)
+    {
+      marker.text = "Totem";
+      marker.color.r = 0;
+      marker.color.g = 1;
+      marker.color.b = 0;
+    }
+    else if (ob_list.list[i].r == 3)
+    {
+      marker.text = "Dock";
+      marker.color.r = 1;
+      marker.color.g = 1;
+      marker.color.b = 1;
+    }
+    else
+    {
+      marker.color.r = 1;
+      marker.color.g = 0;
+      marker.color.b = 0;
+    }
+    marker.color.a = 0.5;
+  }
+  pub_marker_.publish(marker_array_);
+}
+
+} // namespace velodyne_perception
@@ -0,0 +1,328 @@
+/**********************************
+Cluster Shard Tests
+  Samples written by ShardWriter come back unchanged from the mapped
+  ShardReader, across shard boundaries, and the reader refuses files
+  whose header or index would point outside the shard.
+***********************************/
+#include <velodyne_perception/cluster_shard.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <pcl/point_types.h>
+
+using namespace velodyne_perception;
+
+namespace
+{
+
+class TempDir
+{
+public:
+  TempDir()
+  {
+    char path[] = "/tmp/cluster_shard_testXXXXXX";
+    path_ = mkdtemp(path);
+  }
+  ~TempDir()
+  {
+    const std::vector<std::string> names = files();
+    for (size_t i = 0; i < names.size(); i++)
+      unlink((path_ + "/" + names[i]).c_str());
+    rmdir(path_.c_str());
+  }
+  const std::string& path() const { return path_; }
+  std::vector<std::string> files() const
+  {
+    std::vector<std::string> names;
+    DIR* dir = opendir(path_.c_str());
+    while (struct dirent* entry = readdir(dir))
+      if (entry->d_name[0] != '.')
+        names.push_back(entry->d_name);
+    closedir(dir);
+    return names;
+  }
+
+private:
+  std::string path_;
+};
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream file(path.c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& contents)
+{
+  std::ofstream(path.c_str(), std::ios::binary) << contents;
+}
+
+template <typename T>
+void patch(std::string& file, size_t offset, T value)
+{
+  std::memcpy(&file[offset], &value, sizeof(value));
+}
+
+struct TestSample
+{
+  std::vector<float> xyz;
+  std::vector<uint32_t> labels;
+  int label;      // given to append
+};
+
+TestSample randomSample(size_t n, int label, unsigned int seed)
+{
+  TestSample s;
+  s.xyz.resize(3 * n);
+  s.labels.resize(n);
+  s.label = label;
+  srand(seed);
+  for (size_t i = 0; i < 3 * n; i++)
+    s.xyz[i] = (rand() % 20001 - 10000) / 100.0f;
+  for (size_t i = 0; i < n; i++)
+    s.labels[i] = rand() % 3 == 0 ? 0 : 2;   // mostly 2
+  return s;
+}
+
+void expectSample(const TestSample& expected, const ShardReader::Sample& s)
+{
+  const size_t n = expected.labels.size();
+  ASSERT_EQ(n, s.points);
+  EXPECT_EQ(expected.label >= 0 ? expected.label : (n ? 2 : -1), s.label);
+  // every array 16 byte aligned
+  EXPECT_EQ(0u, (uintptr_t)s.x % 16);
+  EXPECT_EQ(0u, (uintptr_t)s.y % 16);
+  EXPECT_EQ(0u, (uintptr_t)s.z % 16);
+  EXPECT_EQ(0u, (uintptr_t)s.labels % 16);
+  for (size_t i = 0; i < n; i++)
+  {
+    EXPECT_EQ(expected.xyz[3 * i], s.x[i]);
+    EXPECT_EQ(expected.xyz[3 * i + 1], s.y[i]);
+    EXPECT_EQ(expected.xyz[3 * i + 2], s.z[i]);
+    EXPECT_EQ(expected.labels[i], s.labels[i]);
+  }
+}
+
+// one finished shard of three samples, returned as bytes
+std::string smallShard(const TempDir& dir)
+{
+  ShardWriter writer;
+  std::string error;
+  EXPECT_TRUE(writer.open(dir.path() + "/small", 16, &error)) << error;
+  for (int k = 0; k < 3; k++)
+  {
+    const TestSample s = randomSample(5 + k, k, k + 1);
+    EXPECT_TRUE(writer.append(&s.xyz[0], &s.labels[0], s.labels.size(), s.label, &error)) << error;
+  }
+  EXPECT_TRUE(writer.close(&error)) << error;
+  return readFile(dir.path() + "/small-00000.shard");
+}
+
+// error of opening bytes as a shard, empty if it opened
+std::string openError(const TempDir& dir, const std::string& bytes)
+{
+  const std::string path = dir.path() + "/corrupt.shard";
+  writeFile(path, bytes);
+  ShardReader reader;
+  std::string error;
+  if (reader.open(path, &error))
+    return "";
+  EXPECT_EQ(0u, reader.size());
+  return error.empty() ? "no message" : error;
+}
+
+} // namespace
+
+//========== Round trip ==========
+TEST(ClusterShard, MajorityLabel)
+{
+  const uint32_t labels[] = {1, 3, 3, 0, 3, 1};
+  EXPECT_EQ(3, majorityLabel(labels, 6));
+  // ties go to the smaller label
+  EXPECT_EQ(1, majorityLabel(labels, 2));
+  EXPECT_EQ(-1, majorityLabel(labels, 0));
+}
+
+TEST(ClusterShard, RoundTripAcrossShards)
+{
+  TempDir dir;
+  std::vector<TestSample> samples;
+  // point counts around the padding to 4, an empty sample, given and majority labels
+  const size_t counts[] = {1, 2, 3, 4, 5, 0, 7, 8, 9, 1000};
+  for (int k = 0; k < 10; k++)
+    samples.push_back(randomSample(counts[k], k % 2 ? -1 : k, k + 10));
+
+  ShardWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(dir.path() + "/train", 4, &error)) << error;
+  for (size_t k = 0; k < samples.size(); k++)
+  {
+    const TestSample& s = samples[k];
+    ASSERT_TRUE(writer.append(s.xyz.empty() ? NULL : &s.xyz[0], s.labels.empty() ? NULL : &s.labels[0],
+                              s.labels.size(), s.label, &error)) << error;
+  }
+  ASSERT_TRUE(writer.close(&error)) << error;
+  EXPECT_EQ(10u, writer.samples());
+  ASSERT_EQ(3u, writer.shards().size());
+  EXPECT_EQ(dir.path() + "/train-00000.shard", writer.shards()[0]);
+  EXPECT_EQ(dir.path() + "/train-00002.shard", writer.shards()[2]);
+  // nothing left under the .tmp names
+  EXPECT_EQ(3u, dir.files().size());
+
+  size_t k = 0;
+  for (size_t i = 0; i < writer.shards().size(); i++)
+  {
+    ShardReader reader;
+    ASSERT_TRUE(reader.open(writer.shards()[i], &error)) << error;
+    EXPECT_EQ(i < 2 ? 4u : 2u, reader.size());
+    uint64_t points = 0;
+    for (size_t j = 0; j < reader.size(); j++, k++)
+    {
+      SCOPED_TRACE(k);
+      expectSample(samples[k], reader.sample(j));
+      points += samples[k].labels.size();
+    }
+    EXPECT_EQ(points, reader.points());
+  }
+  EXPECT_EQ(samples.size(), k);
+}
+
+TEST(ClusterShard, AppendsLabelledClouds)
+{
+  TempDir dir;
+  pcl::PointCloud<pcl::PointXYZL> cloud;
+  cloud.points.resize(6);
+  for (size_t i = 0; i < cloud.points.size(); i++)
+  {
+    cloud.points[i].x = i;
+    cloud.points[i].y = -(float)i;
+    cloud.points[i].z = 0.5f * i;
+    cloud.points[i].label = i < 4 ? 5 : 1;
+  }
+  ShardWriter writer;
+  std::string error;
+  ASSERT_TRUE(writer.open(dir.path() + "/cloud", 8, &error)) << error;
+  ASSERT_TRUE(writer.append(cloud, -1, &error)) << error;
+  ASSERT_TRUE(writer.append(cloud, 7, &error)) << error;
+  ASSERT_TRUE(writer.close(&error)) << error;
+
+  ShardReader reader;
+  ASSERT_TRUE(reader.open(writer.shards()[0], &error)) << error;
+  ASSERT_EQ(2u, reader.size());
+  EXPECT_EQ(5, reader.sample(0).label);
+  EXPECT_EQ(7, reader.sample(1).label);
+  const ShardReader::Sample s = reader.sample(1);
+  for (size_t i = 0; i < cloud.points.size(); i++)
+  {
+    EXPECT_EQ(cloud.points[i].x, s.x[i]);
+    EXPECT_EQ(cloud.points[i].y, s.y[i]);
+    EXPECT_EQ(cloud.points[i].z, s.z[i]);
+    EXPECT_EQ(cloud.points[i].label, s.labels[i]);
+  }
+}
+
+TEST(ClusterShard, WriterNeedsOpen)
+{
+  ShardWriter writer;
+  std::string error;
+  const float xyz[3] = {0, 0, 0};
+  const uint32_t label = 1;
+  EXPECT_FALSE(writer.append(xyz, &label, 1, -1, &error));
+  EXPECT_FALSE(error.empty());
+  TempDir dir;
+  EXPECT_FALSE(writer.open(dir.path() + "/x", 0, &error));
+  // closing a writer without samples writes nothing
+  ASSERT_TRUE(writer.open(dir.path() + "/x", 4, &error)) << error;
+  EXPECT_TRUE(writer.close(&error)) << error;
+  EXPECT_TRUE(writer.shards().empty());
+  EXPECT_TRUE(dir.files().empty());
+}
+
+//========== Corrupt shards ==========
+// ShardHeader: magic 0, version 8, header_bytes 12, samples 16, points 24,
+// index_offset 32; ShardIndexEntry: offset 0, points 8, label 12
+TEST(ClusterShard, RejectsBadHeaders)
+{
+  TempDir dir;
+  const std::string good = smallShard(dir);
+  ASSERT_EQ("", openError(dir, good));
+
+  EXPECT_NE("", openError(dir, ""));
+  EXPECT_NE("", openError(dir, good.substr(0, 63)));
+  std::string bad = good;
+  bad[0] = 'X';
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint32_t>(bad, 8, 2);
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint32_t>(bad, 12, 32);
+  EXPECT_NE("", openError(dir, bad));
+  // an unfinished shard: the placeholder header is all zero
+  EXPECT_NE("", openError(dir, std::string(64, '\0') + good.substr(64)));
+
+  ShardReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.open(dir.path() + "/missing.shard", &error));
+  EXPECT_NE(std::string::npos, error.find("missing.shard")) << error;
+}
+
+TEST(ClusterShard, RejectsBadIndexes)
+{
+  TempDir dir;
+  const std::string good = smallShard(dir);
+  uint64_t index_offset;
+  std::memcpy(&index_offset, &good[32], sizeof(index_offset));
+  ASSERT_EQ(good.size(), index_offset + 3 * sizeof(ShardIndexEntry));
+
+  // index cut off, or more samples than it holds
+  EXPECT_NE("", openError(dir, good.substr(0, good.size() - 1)));
+  std::string bad = good;
+  patch<uint64_t>(bad, 16, 4);
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint64_t>(bad, 16, UINT64_MAX / 8);
+  EXPECT_NE("", openError(dir, bad));
+  // index offset inside the header or past the end
+  bad = good;
+  patch<uint64_t>(bad, 32, 16);
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint64_t>(bad, 32, good.size() + 16);
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint64_t>(bad, 32, UINT64_MAX - 8);
+  EXPECT_NE("", openError(dir, bad));
+
+  // sample offsets in the header, unaligned, running into the index or
+  // wrapping around
+  const size_t entry = index_offset + 2 * sizeof(ShardIndexEntry);
+  const uint64_t offsets[] = {0, 48, 65, index_offset, UINT64_MAX - 15};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+  {
+    SCOPED_TRACE(offsets[i]);
+    bad = good;
+    patch<uint64_t>(bad, entry, offsets[i]);
+    EXPECT_NE("", openError(dir, bad));
+  }
+  bad = good;
+  patch<uint32_t>(bad, entry + 8, 1000);
+  EXPECT_NE("", openError(dir, bad));
+  bad = good;
+  patch<uint32_t>(bad, entry + 8, UINT32_MAX);
+  EXPECT_NE("", openError(dir, bad));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+/**********************************
+Dataset Loader Tests
+  Batches of a shard of saved clusters come out in order until the end of
+  a one-pass loader, and next() with every prefetch batch still held is
+  an error, not the end of the data.
+***********************************/
+#include <velodyne_perception/dataset_loader.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+#include <velodyne_perception/cluster_shard.h>
+
+using namespace velodyne_perception;
+
+namespace
+{
+
+// samples clusters of 20 points with labels 1, 2, 1, ... in one shard
+std::string writeShard(const std::string& dir, size_t samples)
+{
+  ShardWriter writer;
+  std::string error;
+  EXPECT_TRUE(writer.open(dir + "/clusters", 1024, &error)) << error;
+  srand(1);
+  for (size_t k = 0; k < samples; k++)
+  {
+    const size_t n = 20;
+    std::vector<float> xyz(3 * n);
+    std::vector<uint32_t> labels(n, 1 + k % 2);
+    for (size_t i = 0; i < 3 * n; i++)
+      xyz[i] = (i % 3 == 0 ? 10.0f : 0.0f) + (rand() % 1000) / 1000.0f;
+    EXPECT_TRUE(writer.append(&xyz[0], &labels[0], n, 1 + k % 2, &error)) << error;
+  }
+  EXPECT_TRUE(writer.close(&error)) << error;
+  return writer.shards().empty() ? "" : writer.shards()[0];
+}
+
+LoaderConfig smallConfig(int prefetch)
+{
+  LoaderConfig config;
+  config.size = 32;
+  config.batch = 4;
+  config.threads = 2;
+  config.prefetch = prefetch;
+  config.shuffle = false;
+  config.loop = false;
+  return config;
+}
+
+class ShardFile
+{
+public:
+  explicit ShardFile(size_t samples)
+  {
+    char path[] = "/tmp/dataset_loader_testXXXXXX";
+    dir_ = mkdtemp(path);
+    path_ = writeShard(dir_, samples);
+  }
+  ~ShardFile()
+  {
+    unlink(path_.c_str());
+    rmdir(dir_.c_str());
+  }
+  const std::string& path() const { return path_; }
+
+private:
+  std::string dir_;
+  std::string path_;
+};
+
+} // namespace
+
+//========== Batches ==========
+TEST(DatasetLoader, OnePassInOrder)
+{
+  ShardFile shard(10);
+  DatasetLoader loader;
+  std::string error;
+  ASSERT_TRUE(loader.open(shard.path(), smallConfig(2), &error)) << error;
+  ASSERT_EQ(10u, loader.samples());
+  const int counts[] = {4, 4, 2};
+  for (int b = 0; b < 3; b++)
+  {
+    const DatasetLoader::Batch* batch = loader.next(&error);
+    ASSERT_TRUE(batch != NULL) << error;
+    EXPECT_EQ((uint64_t)b, batch->index);
+    ASSERT_EQ(counts[b], batch->count);
+    for (int i = 0; i < batch->count; i++)
+      EXPECT_EQ(1 + (4 * b + i) % 2, batch->labels[i]);
+    loader.release(batch);
+  }
+  // the end of the data is no error
+  error = "not cleared";
+  EXPECT_TRUE(loader.next(&error) == NULL);
+  EXPECT_TRUE(error.empty()) << error;
+}
+
+TEST(DatasetLoader, AllBatchesHeld)
+{
+  ShardFile shard(40);
+  DatasetLoader loader;
+  std::string error;
+  ASSERT_TRUE(loader.open(shard.path(), smallConfig(2), &error)) << error;
+  const DatasetLoader::Batch* first = loader.next(&error);
+  const DatasetLoader::Batch* second = loader.next(&error);
+  ASSERT_TRUE(first != NULL && second != NULL) << error;
+  EXPECT_TRUE(loader.next(&error) == NULL);
+  EXPECT_NE(std::string::npos, error.find("held")) << error;
+
+  // handing one back lets the loader go on where it was
+  loader.release(first);
+  const DatasetLoader::Batch* third = loader.next(&error);
+  ASSERT_TRUE(third != NULL) << error;
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_EQ(2u, third->index);
+  loader.release(second);
+  loader.release(third);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
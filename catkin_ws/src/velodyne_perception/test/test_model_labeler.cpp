@@ -0,0 +1,224 @@
+/**********************************
+Model Labeler Tests
+  nearestModel() against a plain reference loop: the SSE2 path (groups of
+  four points) and the scalar tail give the same model for every point,
+  with and without footprints, on ties and for points no model takes.
+  labelByModels() labels the same with and without a TaskPool.
+***********************************/
+#include <velodyne_perception/model_labeler.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+#include <gtest/gtest.h>
+#include <pcl/point_types.h>
+
+using namespace velodyne_perception;
+
+namespace
+{
+
+float uniform(float lo, float hi)
+{
+  return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// the labelers' loop, one point and one model at a time
+int32_t referenceModel(float x, float y, const std::vector<LabelModel>& models)
+{
+  float best = std::numeric_limits<float>::infinity();
+  int32_t best_index = -1;
+  for (size_t j = 0; j < models.size(); j++)
+  {
+    const LabelModel& m = models[j];
+    const float dx = x - m.x, dy = y - m.y;
+    const float d = dx * dx + dy * dy;
+    if (m.half_length > 0 && m.half_width > 0)
+    {
+      const float c = std::cos(m.yaw), s = std::sin(m.yaw);
+      if (std::fabs(c * dx + s * dy) > m.half_length || std::fabs(c * dy - s * dx) > m.half_width)
+        continue;
+    }
+    if (d < best)
+    {
+      best = d;
+      best_index = j;
+    }
+  }
+  return best_index;
+}
+
+// a labeling scene: docks and buoys within 40 m, some with footprints
+std::vector<LabelModel> randomModels(size_t n, bool footprints)
+{
+  std::vector<LabelModel> models;
+  for (size_t j = 0; j < n; j++)
+  {
+    const float x = uniform(-40, 40), y = uniform(-40, 40);
+    const uint32_t label = 1 + j % 4;
+    if (footprints && j % 3 != 2)
+      models.push_back(footprintModel(x, y, label, uniform(-M_PI, M_PI), uniform(1, 8), uniform(1, 4)));
+    else
+      models.push_back(LabelModel(x, y, label));
+  }
+  return models;
+}
+
+void randomPoints(size_t n, std::vector<float>& x, std::vector<float>& y)
+{
+  x.resize(n);
+  y.resize(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    x[i] = uniform(-45, 45);
+    y[i] = uniform(-45, 45);
+  }
+}
+
+// index of every point from one call over all of them (SSE2 groups and a
+// tail) and from one call per point (always the scalar loop)
+void expectPaths(const std::vector<float>& x, const std::vector<float>& y, const std::vector<LabelModel>& models)
+{
+  const size_t n = x.size();
+  const LabelModel* m = models.empty() ? NULL : &models[0];
+  std::vector<int32_t> batch(n, -2);
+  nearestModel(&x[0], &y[0], n, m, models.size(), &batch[0]);
+  for (size_t i = 0; i < n; i++)
+  {
+    SCOPED_TRACE(i);
+    int32_t single = -2;
+    nearestModel(&x[i], &y[i], 1, m, models.size(), &single);
+    EXPECT_EQ(single, batch[i]);
+    EXPECT_EQ(referenceModel(x[i], y[i], models), batch[i]);
+  }
+}
+
+} // namespace
+
+//========== nearestModel ==========
+TEST(ModelLabeler, NearestCentre)
+{
+  srand(1);
+  const std::vector<LabelModel> models = randomModels(6, false);
+  // every remainder of the groups of four
+  for (size_t n = 1; n <= 13; n++)
+  {
+    SCOPED_TRACE(n);
+    std::vector<float> x, y;
+    randomPoints(n, x, y);
+    expectPaths(x, y, models);
+  }
+  std::vector<float> x, y;
+  randomPoints(1003, x, y);
+  expectPaths(x, y, models);
+}
+
+TEST(ModelLabeler, Footprints)
+{
+  srand(2);
+  const std::vector<LabelModel> models = randomModels(9, true);
+  std::vector<float> x, y;
+  randomPoints(2051, x, y);
+  expectPaths(x, y, models);
+
+  // with boxes only, some points are left to no model
+  std::vector<LabelModel> boxes;
+  for (size_t j = 0; j < models.size(); j++)
+    if (models[j].half_length > 0)
+      boxes.push_back(models[j]);
+  expectPaths(x, y, boxes);
+  std::vector<int32_t> index(x.size());
+  nearestModel(&x[0], &y[0], x.size(), &boxes[0], boxes.size(), &index[0]);
+  size_t unclaimed = 0;
+  for (size_t i = 0; i < index.size(); i++)
+    unclaimed += index[i] < 0;
+  EXPECT_GT(unclaimed, 0u);
+  EXPECT_LT(unclaimed, index.size());
+}
+
+TEST(ModelLabeler, FootprintEdges)
+{
+  // a box 4 x 2 turned by 90 degrees: its length lies along y
+  const std::vector<LabelModel> models(1, footprintModel(10, 0, 3, M_PI / 2, 2, 1));
+  const float x[] = {10, 10, 10, 10, 10.5f, 11.5f, 10, 10, 7};
+  const float y[] = {0, 1.9f, -1.9f, 2.1f, 0, 0, -2.5f, 0.5f, 0};
+  const int32_t expected[] = {0, 0, 0, -1, 0, -1, -1, 0, -1};
+  int32_t index[9];
+  nearestModel(x, y, 9, &models[0], 1, index);
+  for (size_t i = 0; i < 9; i++)
+    EXPECT_EQ(expected[i], index[i]) << i;
+}
+
+TEST(ModelLabeler, TiesGoToTheFirstModel)
+{
+  // two models at the same centre and points halfway between two others
+  std::vector<LabelModel> models;
+  models.push_back(LabelModel(0, 0, 1));
+  models.push_back(LabelModel(0, 0, 2));
+  models.push_back(LabelModel(10, 5, 3));
+  models.push_back(LabelModel(10, -5, 4));
+  const float x[] = {1, -2, 0.5f, 10, 10, 3, 11};
+  const float y[] = {1, 0, -0.5f, 0, 0, 0, 0};
+  const int32_t expected[] = {0, 0, 0, 2, 2, 0, 2};
+  int32_t index[7];
+  nearestModel(x, y, 7, &models[0], models.size(), index);
+  for (size_t i = 0; i < 7; i++)
+    EXPECT_EQ(expected[i], index[i]) << i;
+  expectPaths(std::vector<float>(x, x + 7), std::vector<float>(y, y + 7), models);
+}
+
+TEST(ModelLabeler, NoModels)
+{
+  const float x[] = {1, 2, 3, 4, 5}, y[] = {0, 0, 0, 0, 0};
+  int32_t index[5] = {7, 7, 7, 7, 7};
+  nearestModel(x, y, 5, NULL, 0, index);
+  for (size_t i = 0; i < 5; i++)
+    EXPECT_EQ(-1, index[i]);
+}
+
+//========== labelByModels ==========
+TEST(ModelLabeler, LabelsWithAndWithoutPool)
+{
+  srand(3);
+  const std::vector<LabelModel> models = randomModels(8, true);
+  // several blocks and a short last one
+  pcl::PointCloud<pcl::PointXYZ> in;
+  in.points.resize(3 * kLabelBlock + 77);
+  for (size_t i = 0; i < in.points.size(); i++)
+  {
+    in.points[i].x = uniform(-45, 45);
+    in.points[i].y = uniform(-45, 45);
+    in.points[i].z = uniform(0, 3);
+  }
+  in.width = in.points.size();
+  in.height = 1;
+
+  pcl::PointCloud<PointCloudLabel> serial, parallel;
+  labelByModels(in, models, serial, NULL, 6);
+  TaskPool pool(4);
+  labelByModels(in, models, parallel, &pool, 6);
+  ASSERT_EQ(in.points.size(), serial.points.size());
+  ASSERT_EQ(in.points.size(), parallel.points.size());
+  EXPECT_EQ(in.width, serial.width);
+  for (size_t i = 0; i < in.points.size(); i++)
+  {
+    SCOPED_TRACE(i);
+    const pcl::PointXYZ& p = in.points[i];
+    const int32_t j = referenceModel(p.x, p.y, models);
+    const uint32_t label = j < 0 ? 6 : models[j].label;
+    EXPECT_EQ(label, serial.points[i].label);
+    EXPECT_EQ(label, parallel.points[i].label);
+    EXPECT_EQ(p.x, serial.points[i].x);
+    EXPECT_EQ(p.z, parallel.points[i].z);
+    EXPECT_EQ(kLabelColor[label][0], parallel.points[i].r);
+    EXPECT_EQ(kLabelColor[label][2], parallel.points[i].b);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+# multiview_native against the NumPy fallback of classify_rot.py /
+# classify_scale.py / image_rot.py: the same rotation by the bearing and the
+# same toIMG(), which the nodes run when the module cannot be imported.
+import math
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+import numpy as np
+import multiview_native as mv
+
+def py2round(v):
+	# the nodes run on Python 2, whose round() goes half away from zero
+	return math.floor(v + 0.5) if v >= 0 else math.ceil(v - 0.5)
+
+def fallback_rotate(points, rad):
+	# fromTranslationRotation of quaternion_from_euler(0, 0, -rad)
+	c, s = math.cos(-rad), math.sin(-rad)
+	matrix = np.array([[c, -s, 0], [s, c, 0], [0, 0, 1]])
+	return np.dot(points, matrix.T)
+
+def fallback_to_img(image, pcl_array, plane, height, boundary, point_size):
+	# toIMG() of the classifiers, returning the scale it appends
+	pcl_size = len(pcl_array)
+	min_m = min(p[0] for p in pcl_array)
+	min_n = min(p[1] for p in pcl_array)
+	max_m = max(p[0] for p in pcl_array)
+	max_n = max(p[1] for p in pcl_array)
+	m_size = max_m - min_m
+	n_size = max_n - min_n
+	shift_m = shift_n = False
+	if m_size > n_size:
+		max_size, min_size, shift_n = m_size, n_size, True
+	else:
+		max_size, min_size, shift_m = n_size, m_size, True
+	scale = float((height - boundary*2)/max_size)
+	shift_size = int(py2round((height - boundary*2 - min_size*scale)/2))
+	channel = {'xz': 0, 'yz': 1, 'xy': 2}[plane]
+	for i in range(pcl_size):
+		m = int(py2round((pcl_array[i][0] - min_m)*scale)) + boundary
+		n = int(py2round((pcl_array[i][1] - min_n)*scale)) + boundary
+		if shift_m:
+			m += shift_size
+		elif shift_n:
+			n += shift_size
+		image[m - point_size:m + point_size + 1, n - point_size:n + point_size + 1, channel] = 255
+	return scale
+
+def fallback_render(points, rad, height, boundary, point_size):
+	local = fallback_rotate(points, rad)
+	image = np.zeros((height, height, 3), np.uint8)
+	scale = []
+	scale.append(fallback_to_img(image, local[:, [0, 1]].tolist(), 'xy', height, boundary, point_size))
+	scale.append(fallback_to_img(image, local[:, [1, 2]].tolist(), 'yz', height, boundary, point_size))
+	scale.append(fallback_to_img(image, local[:, [0, 2]].tolist(), 'xz', height, boundary, point_size))
+	return image, scale
+
+def write_shard(path, clusters, labels):
+	# the layout of cluster_shard.h: header, x / y / z / label arrays padded
+	# to 4 points per sample, index at the end
+	data, index = b'', b''
+	for points, label in zip(clusters, labels):
+		n = len(points)
+		m = (n + 3) // 4 * 4
+		pad = np.zeros(m - n)
+		index += struct.pack('<QIi', 64 + len(data), n, label)
+		for axis in range(3):
+			data += np.concatenate([points[:, axis], pad]).astype('<f4').tobytes()
+		data += np.concatenate([np.full(n, label), pad]).astype('<u4').tobytes()
+	header = struct.pack('<8sIIQQQ24x', b'CLSHARD\0', 1, 64, len(clusters),
+		sum(len(c) for c in clusters), 64 + len(data))
+	with open(path, 'wb') as f:
+		f.write(header + data + index)
+
+def cluster(rs, n):
+	# a buoy-like blob somewhere around the boat
+	centre = rs.uniform(-30, 30, 3) * [1, 1, 0.05]
+	return centre + rs.randn(n, 3) * rs.uniform(0.2, 2.0, 3)
+
+class TestMultiviewNative(unittest.TestCase):
+	def test_render_matches_fallback(self):
+		rs = np.random.RandomState(1)
+		# the sizes of classify_rot.py and classify_scale.py / image_rot.py
+		for height, boundary, point_size in [(227, 50, 4), (480, 50, 4)]:
+			# from 2 points: toIMG() divides by zero on a single one
+			for n in [2, 7, 64, 500]:
+				points = cluster(rs, n)
+				rad = math.atan2(points[:, 1].mean(), points[:, 0].mean())
+				expected, expected_scale = fallback_render(points, rad, height, boundary, point_size)
+				image = mv.render(points, rad, height, boundary, point_size)
+				self.assertEqual(image.shape, (height, height, 3))
+				self.assertEqual(image.dtype, np.uint8)
+				self.assertTrue(np.array_equal(image, expected), "n = %d, size = %d" %(n, height))
+				np.testing.assert_allclose(mv.scales(points, rad, height, boundary), expected_scale, rtol=1e-12)
+
+	def test_local_points_need_no_yaw(self):
+		# pcl_points_local are already rotated by the cluster node
+		rs = np.random.RandomState(2)
+		points = cluster(rs, 100)
+		rad = math.atan2(points[:, 1].mean(), points[:, 0].mean())
+		local = mv.rotate(points, rad)
+		np.testing.assert_allclose(local, fallback_rotate(points, rad), atol=1e-12)
+		self.assertTrue(np.array_equal(mv.render(local), mv.render(points, rad)))
+
+	def test_any_points_array(self):
+		rs = np.random.RandomState(3)
+		points = cluster(rs, 50)
+		image = mv.render(points, 0.4)
+		# Fortran order and nested lists are converted once
+		self.assertTrue(np.array_equal(mv.render(np.asfortranarray(points), 0.4), image))
+		self.assertTrue(np.array_equal(mv.render(points.tolist(), 0.4), image))
+		self.assertTrue(np.array_equal(mv.render(np.zeros((0, 3))), np.zeros((227, 227, 3), np.uint8)))
+		self.assertRaises(ValueError, mv.render, np.zeros((4, 2)))
+		self.assertRaises(ValueError, mv.render, points, 0, 100, 50)
+
+	def test_to_tensor(self):
+		image = mv.render(cluster(np.random.RandomState(4), 30))
+		mean = (104., 117., 123.)
+		tensor = mv.to_tensor(image, mean)
+		self.assertEqual(tensor.dtype, np.float32)
+		expected = image.transpose(2, 0, 1).astype(np.float32) - np.array(mean, np.float32).reshape(3, 1, 1)
+		self.assertTrue(np.array_equal(tensor, expected))
+		self.assertRaises(ValueError, mv.to_tensor, image, (0., 0.))
+
+	def test_geometry(self):
+		points = cluster(np.random.RandomState(5), 80)
+		lo, hi = mv.bounds(points)
+		np.testing.assert_array_equal(lo, points.min(axis=0))
+		np.testing.assert_array_equal(hi, points.max(axis=0))
+		descriptor = mv.describe(points)
+		self.assertEqual(descriptor.shape, (mv.DESCRIPTOR_SIZE,))
+		self.assertEqual(len(mv.DESCRIPTOR_NAMES), mv.DESCRIPTOR_SIZE)
+		self.assertEqual(descriptor[mv.DESCRIPTOR_NAMES.index('points')], 80)
+		self.assertEqual(mv.resample(points, 2048).shape, (2048, 3))
+		self.assertEqual(mv.resample(points, 16).shape, (16, 3))
+		self.assertEqual(mv.farthest_point_sample(points, 200).shape, (80, 3))
+
+	def test_loader_reports_bad_sources(self):
+		self.assertRaises(RuntimeError, mv.Loader, '/nonexistent/clouds')
+
+	def test_loader_iterates_with_small_prefetch(self):
+		rs = np.random.RandomState(6)
+		directory = tempfile.mkdtemp()
+		try:
+			path = os.path.join(directory, 'clusters-00000.shard')
+			write_shard(path, [cluster(rs, 20) for k in range(10)], [1 + k % 2 for k in range(10)])
+			# the loop variables hold the last batch while the next is fetched
+			for prefetch in [1, 2]:
+				seen = []
+				for images, labels in mv.Loader(path, size=32, batch=4, prefetch=prefetch, shuffle=False, loop=False):
+					self.assertEqual(images.shape[1:], (3, 32, 32))
+					seen.extend(labels.tolist())
+				self.assertEqual(seen, [1 + k % 2 for k in range(10)])
+			# keeping every batch is an error, not the end of the data
+			loader = mv.Loader(path, size=32, batch=2, prefetch=2, shuffle=False, loop=False)
+			held = [next(loader), next(loader)]
+			self.assertRaises(RuntimeError, next, loader)
+			del held[0]
+			self.assertEqual(next(loader)[1].tolist(), [1, 2])
+		finally:
+			shutil.rmtree(directory)
+
+if __name__ == '__main__':
+	unittest.main()